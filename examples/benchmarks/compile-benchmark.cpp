@@ -0,0 +1,87 @@
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <cstdlib>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <csim/model.h>
+#include <csim/error_codes.h>
+#include <csim/executable_functions.h>
+
+/*
+ * Compare the time and memory taken to instantiate a model using each of the compiler backends. Each backend is
+ * run in its own process so that the peak memory usage of one does not hide the other.
+ */
+
+void usage(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        std::cerr << "CSim benchmark: model compilation\n"
+                  << argv[0] << " <CellML model file> [output variable 1] [output 2...]" << std::endl;
+        std::cerr << "\tOutput variables should be indentified using component_name/variable_name\n"
+                  << "\tIf no outputs are given, all variables in the model will be flagged as outputs." << std::endl;
+        exit(-1);
+    }
+}
+
+static long peakMemory()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    // kilobytes on Linux, bytes on OS X
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+}
+
+static int benchmark(int argc, char* argv[], csim::CompilerBackend backend)
+{
+    csim::Model model;
+    if (model.loadCellmlModel(argv[1]) != csim::CSIM_OK) return -1;
+    if (argc > 2)
+    {
+        for (int i = 2; i < argc; ++i)
+        {
+            if (model.setVariableAsOutput(argv[i]) < 0) return -1;
+        }
+    }
+    else model.setAllVariablesAsOutput();
+    model.setCompilerBackend(backend);
+    long memoryBefore = peakMemory();
+    auto start = std::chrono::steady_clock::now();
+    int code = model.instantiate();
+    auto end = std::chrono::steady_clock::now();
+    if (code != csim::CSIM_OK)
+    {
+        std::cerr << "Unable to instantiate the model: " << code << std::endl;
+        return -1;
+    }
+    std::cerr << "BENCHMARK " << ((model.compilerBackend() == csim::IrBackend) ? "IR" : "clang")
+              << " backend: compile time "
+              << std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000.0
+              << " ms; peak memory " << peakMemory() << " kB (" << peakMemory() - memoryBefore
+              << " kB more than after loading the model)" << std::endl;
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+    usage(argc, argv);
+    const csim::CompilerBackend backends[] = { csim::IrBackend, csim::ClangBackend };
+    int failures = 0;
+    for (const auto backend: backends)
+    {
+        pid_t pid = fork();
+        if (pid == 0) return benchmark(argc, argv, backend);
+        int status;
+        waitpid(pid, &status, 0);
+        if (!WIFEXITED(status) || (WEXITSTATUS(status) != 0)) failures++;
+    }
+    return failures;
+}
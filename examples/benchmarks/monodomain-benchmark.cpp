@@ -0,0 +1,86 @@
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+
+#include <csim/model.h>
+#include <csim/monodomain.h>
+#include <csim/error_codes.h>
+#include <csim/executable_functions.h>
+
+/*
+ * Measure how the monodomain solver scales with the number of threads. A square sheet of cells is stimulated along one
+ * edge by raising the voltage, and then advanced using an increasing number of threads, reporting the time per step
+ * for the whole step and for the reaction steps alone (i.e., with no diffusion).
+ */
+
+void usage(int argc, char* argv[])
+{
+    if (argc < 3)
+    {
+        std::cerr << "CSim benchmark: monodomain\n"
+                  << argv[0] << " <CellML model file> <voltage variable> [cells per side] [number of steps] [step size]"
+                  << " [diffusion coefficient] [cell spacing]" << std::endl;
+        std::cerr << "\tThe voltage variable should be indentified using component_name/variable_name and must be a "
+                  << "state variable.\n\tThe defaults are a 512 x 512 sheet advanced for 100 steps of 0.01 with a "
+                  << "diffusion coefficient of 0.1 and spacing of 0.025." << std::endl;
+        exit(-1);
+    }
+}
+
+static double timePerStep(csim::Model& model, const std::string& voltage, int cells, int numberOfSteps,
+                          double step, double diffusion, double spacing, int numberOfThreads)
+{
+    csim::Monodomain monodomain;
+    if (monodomain.create(&model, voltage, cells, cells) != csim::CSIM_OK) return -1.0;
+    monodomain.setDiffusion(diffusion, spacing);
+    monodomain.setNumberOfThreads(numberOfThreads);
+    double* v = monodomain.voltage();
+    for (int j = 0; j < cells; ++j)
+    {
+        for (int i = 0; i < cells / 20 + 1; ++i) v[monodomain.cellIndex(i, j)] = 20.0;
+    }
+    auto start = std::chrono::steady_clock::now();
+    int code = monodomain.step(0.0, step, numberOfSteps, csim::RushLarsenMethod);
+    auto end = std::chrono::steady_clock::now();
+    if (code != csim::CSIM_OK) return -1.0;
+    return std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000.0 / numberOfSteps;
+}
+
+int main(int argc, char* argv[])
+{
+    usage(argc, argv);
+    std::string voltage = argv[2];
+    int cells = (argc > 3) ? atoi(argv[3]) : 512;
+    int numberOfSteps = (argc > 4) ? atoi(argv[4]) : 100;
+    double step = (argc > 5) ? atof(argv[5]) : 0.01;
+    double diffusion = (argc > 6) ? atof(argv[6]) : 0.1;
+    double spacing = (argc > 7) ? atof(argv[7]) : 0.025;
+
+    csim::Model model;
+    if (model.loadCellmlModel(argv[1]) != csim::CSIM_OK) return -1;
+    if (model.instantiate() != csim::CSIM_OK)
+    {
+        std::cerr << "Unable to instantiate the model." << std::endl;
+        return -1;
+    }
+    int maximumThreads = std::max(1u, std::thread::hardware_concurrency());
+    double reference = 0.0;
+    for (int threads = 1; threads <= maximumThreads; threads = (threads < maximumThreads)
+             ? std::min(2 * threads, maximumThreads) : (threads + 1))
+    {
+        double total = timePerStep(model, voltage, cells, numberOfSteps, step, diffusion, spacing, threads);
+        double reaction = timePerStep(model, voltage, cells, numberOfSteps, step, 0.0, spacing, threads);
+        if ((total < 0.0) || (reaction < 0.0))
+        {
+            std::cerr << "Unable to advance the monodomain problem." << std::endl;
+            return -1;
+        }
+        if (threads == 1) reference = total;
+        std::cerr << "BENCHMARK " << cells << " x " << cells << " cells, " << threads << " thread(s): " << total
+                  << " ms per step (reaction " << reaction << " ms, diffusion " << total - reaction
+                  << " ms); speedup " << reference / total << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,129 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+
+#include <csim/model.h>
+#include <csim/population.h>
+#include <csim/error_codes.h>
+#include <csim/executable_functions.h>
+
+/*
+ * Measure the memory bandwidth reached when advancing a large population of cells, first on the CPUs of each NUMA
+ * node on their own and then on every CPU with each of the memory placements. The population is advanced one step at
+ * a time, so that every step streams the whole population through memory: reading the states and inputs, and
+ * writing the states, rates and outputs.
+ */
+
+void usage(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        std::cerr << "CSim benchmark: population\n"
+                  << argv[0] << " <CellML model file> [number of cells] [number of steps] [step size]" << std::endl;
+        std::cerr << "\tThe defaults are 4000000 cells advanced for 50 steps of 0.01." << std::endl;
+        exit(-1);
+    }
+}
+
+// parse a Linux CPU list such as "0-15,32-47"
+static std::vector<int> parseCpuList(const std::string& list)
+{
+    std::vector<int> cpus;
+    std::stringstream stream(list);
+    std::string range;
+    while (std::getline(stream, range, ','))
+    {
+        if (range.empty()) continue;
+        size_t dash = range.find('-');
+        int first = atoi(range.substr(0, dash).c_str());
+        int last = (dash == std::string::npos) ? first : atoi(range.substr(dash + 1).c_str());
+        for (int cpu = first; cpu <= last; ++cpu) cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+// the CPUs of each NUMA node, or a single node with every CPU where the nodes are unknown
+static std::vector<std::vector<int> > numaNodes()
+{
+    std::vector<std::vector<int> > nodes;
+    for (int node = 0;; ++node)
+    {
+        std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+        std::string list;
+        if (!(file && std::getline(file, list))) break;
+        std::vector<int> cpus = parseCpuList(list);
+        if (!cpus.empty()) nodes.push_back(cpus);
+    }
+    if (nodes.empty())
+    {
+        nodes.push_back(std::vector<int>());
+        for (unsigned cpu = 0; cpu < std::max(1u, std::thread::hardware_concurrency()); ++cpu)
+            nodes.back().push_back(int(cpu));
+    }
+    return nodes;
+}
+
+// the bandwidth in GB/s, or a negative value on error
+static double bandwidth(csim::Model& model, int numberOfCells, int numberOfSteps, double step,
+                        const std::vector<int>& cpus, csim::MemoryPlacement placement)
+{
+    csim::Population population;
+    population.setNumberOfThreads(int(cpus.size()));
+    // where threads can not be pinned they are left to the operating system, including the calling thread
+    population.setThreadAffinity(cpus);
+    population.setMemoryPlacement(placement);
+    if (population.create(&model, numberOfCells) != csim::CSIM_OK) return -1.0;
+    // a first step to wake up the threads
+    if (population.step(0.0, step, 1, csim::RushLarsenMethod) != csim::CSIM_OK) return -1.0;
+    auto start = std::chrono::steady_clock::now();
+    for (int n = 0; n < numberOfSteps; ++n) population.step(n * step, step, 1, csim::RushLarsenMethod);
+    auto end = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() * 1.0e-6;
+    double bytes = double(numberOfCells) * sizeof(double) * numberOfSteps
+            * (3.0 * model.numberOfStateVariables() + model.numberOfOutputVariables()
+               + model.numberOfInputVariables());
+    return bytes / seconds * 1.0e-9;
+}
+
+int main(int argc, char* argv[])
+{
+    usage(argc, argv);
+    int numberOfCells = (argc > 2) ? atoi(argv[2]) : 4000000;
+    int numberOfSteps = (argc > 3) ? atoi(argv[3]) : 50;
+    double step = (argc > 4) ? atof(argv[4]) : 0.01;
+
+    csim::Model model;
+    if (model.loadCellmlModel(argv[1]) != csim::CSIM_OK) return -1;
+    if (model.instantiate() != csim::CSIM_OK)
+    {
+        std::cerr << "Unable to instantiate the model." << std::endl;
+        return -1;
+    }
+    std::vector<std::vector<int> > nodes = numaNodes();
+    std::vector<int> allCpus;
+    for (size_t node = 0; node < nodes.size(); ++node)
+    {
+        double gbs = bandwidth(model, numberOfCells, numberOfSteps, step, nodes[node], csim::FirstTouchPlacement);
+        if (gbs < 0.0)
+        {
+            std::cerr << "Unable to advance the population." << std::endl;
+            return -1;
+        }
+        std::cerr << "BENCHMARK node " << node << " (" << nodes[node].size() << " CPUs): " << gbs << " GB/s"
+                  << std::endl;
+        allCpus.insert(allCpus.end(), nodes[node].begin(), nodes[node].end());
+    }
+    const char* names[] = { "first touch", "interleaved" };
+    for (int placement = csim::FirstTouchPlacement; placement <= csim::InterleavedPlacement; ++placement)
+    {
+        double gbs = bandwidth(model, numberOfCells, numberOfSteps, step, allCpus, csim::MemoryPlacement(placement));
+        std::cerr << "BENCHMARK all " << nodes.size() << " node(s) (" << allCpus.size() << " CPUs), "
+                  << names[placement] << ": " << gbs << " GB/s" << std::endl;
+    }
+    return 0;
+}
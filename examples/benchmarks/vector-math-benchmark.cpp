@@ -0,0 +1,112 @@
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <string>
+#include <cmath>
+#include <cstring>
+
+#include "vector_math.h"
+
+/*
+ * Compare the throughput and accuracy of the vector math functions used by the JIT compiled models against the
+ * scalar libm functions they replace. The vector functions are called through pointers, as the generated code calls
+ * them, so this needs to be built for the widest instruction set the functions are to be benchmarked for.
+ */
+
+typedef double Double2 __attribute__((vector_size(16)));
+typedef double Double4 __attribute__((vector_size(32)));
+typedef double Double8 __attribute__((vector_size(64)));
+
+static const size_t N = 1 << 20;
+static const int REPEATS = 20;
+
+static double scalar(const std::string& name, double x, double y)
+{
+    if (name == "exp") return std::exp(x);
+    if (name == "log") return std::log(x);
+    if (name == "pow") return std::pow(x, y);
+    return std::tanh(x);
+}
+
+static void sample(const std::string& name, std::vector<double>& x, std::vector<double>& y)
+{
+    std::mt19937_64 generator(1);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    for (size_t i = 0; i < N; ++i)
+    {
+        // the range of arguments typically found in cell models
+        if (name == "exp") x[i] = -100.0 + 200.0 * uniform(generator);
+        else if (name == "log") x[i] = std::ldexp(0.5 + uniform(generator), -20 + (int)(40 * uniform(generator)));
+        else if (name == "pow") x[i] = 1.0e-3 + 10.0 * uniform(generator);
+        else x[i] = -5.0 + 10.0 * uniform(generator);
+        y[i] = -4.0 + 8.0 * uniform(generator);
+    }
+}
+
+template<typename V> static void evaluate(const VectorMathFunction& function, const std::vector<double>& x,
+                                          const std::vector<double>& y, std::vector<double>& result)
+{
+    const unsigned width = sizeof(V) / sizeof(double);
+    bool binary = std::strcmp(function.scalarName, "pow") == 0;
+    for (size_t i = 0; i < N; i += width)
+    {
+        V a, b, r;
+        std::memcpy(&a, &x[i], sizeof(V));
+        std::memcpy(&b, &y[i], sizeof(V));
+        if (binary) r = reinterpret_cast<V (*)(V, V)>(function.address)(a, b);
+        else r = reinterpret_cast<V (*)(V)>(function.address)(a);
+        std::memcpy(&result[i], &r, sizeof(V));
+    }
+}
+
+static double ulpError(double value, double reference)
+{
+    if (value == reference) return 0.0;
+    if (!std::isfinite(reference) || !std::isfinite(value)) return HUGE_VAL;
+    int exponent;
+    std::frexp(reference, &exponent);
+    return std::fabs(value - reference) / std::ldexp(1.0, std::max(exponent - 53, -1074));
+}
+
+int main()
+{
+    bool avx2 = __builtin_cpu_supports("avx2");
+    bool avx512 = __builtin_cpu_supports("avx512f");
+    std::vector<double> x(N), y(N), reference(N), result(N);
+    const char* names[] = { "exp", "log", "pow", "tanh" };
+    for (const std::string name: names)
+    {
+        sample(name, x, y);
+        auto start = std::chrono::steady_clock::now();
+        for (int r = 0; r < REPEATS; ++r)
+        {
+            for (size_t i = 0; i < N; ++i) reference[i] = scalar(name, x[i], y[i]);
+        }
+        double scalarTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cerr << "BENCHMARK libm " << name << ": " << N * REPEATS / scalarTime / 1.0e6 << " Mevals/s" << std::endl;
+
+        const csim::VectorMath libraries[] = { csim::AccurateVectorMath, csim::FastVectorMath };
+        for (const auto library: libraries)
+        {
+            for (const auto& function: getVectorMathFunctions(library, avx2, avx512))
+            {
+                if (name != function.scalarName) continue;
+                start = std::chrono::steady_clock::now();
+                for (int r = 0; r < REPEATS; ++r)
+                {
+                    if (function.width == 2) evaluate<Double2>(function, x, y, result);
+                    else if (function.width == 4) evaluate<Double4>(function, x, y, result);
+                    else evaluate<Double8>(function, x, y, result);
+                }
+                double time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                double maximumError = 0.0;
+                for (size_t i = 0; i < N; ++i) maximumError = std::max(maximumError, ulpError(result[i], reference[i]));
+                std::cerr << "BENCHMARK " << function.vectorName << ": " << N * REPEATS / time / 1.0e6
+                          << " Mevals/s (" << scalarTime / time << "x libm); maximum error " << maximumError << " ulp"
+                          << std::endl;
+            }
+        }
+    }
+    return 0;
+}
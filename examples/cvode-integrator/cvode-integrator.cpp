@@ -14,6 +14,7 @@
 #include <csim/model.h>
 #include <csim/error_codes.h>
 #include <csim/executable_functions.h>
+#include <csim/result_writer.h>
 
 /* Shared Problem Constants */
 
@@ -45,16 +46,6 @@ void usage(int argc, char* argv[])
     }
 }
 
-void printResults(UserData& ud)
-{
-    for (int i = 0; i < NV_LENGTH_S(ud.outputs); ++i)
-    {
-        if (i != 0) std::cout << "\t";
-        std::cout << NV_Ith_S(ud.outputs, i);
-    }
-    std::cout << std::endl;
-}
-
 int main(int argc, char* argv[])
 {
     // for collecting data passed into CVODE
@@ -103,10 +94,13 @@ int main(int argc, char* argv[])
     double reltol = RTOL, abstol = ATOL;
     // initialise the inputs and initial values of the state variables
     initFunction(NV_DATA_S(ud.states), NV_DATA_S(ud.outputs), NV_DATA_S(ud.inputs));
+    // the results are printed on a separate thread, so the integration doesn't wait for the output
+    csim::TextResultSink sink(std::cout, outputNames);
+    csim::ResultWriter writer;
+    writer.start(&sink, outputNames.size());
     // and calculate and print the initial state of the model
     ud.modelFunction(x0, NV_DATA_S(ud.states), NV_DATA_S(rates), NV_DATA_S(ud.outputs), NV_DATA_S(ud.inputs));
-    std::cout << "results headed goes here" << std::endl;
-    printResults(ud);
+    writer.addRow(NV_DATA_S(ud.outputs));
 
     // create and initialise our CVODE integrator
     void* cvode_mem = CVodeCreate(CV_ADAMS, CV_FUNCTIONAL);
@@ -131,9 +125,9 @@ int main(int argc, char* argv[])
         if (check_flag(&flag,"CVode",1)) return(1);
         // call the model's function to make sure all the outputs are at the current time
         ud.modelFunction(xout, NV_DATA_S(ud.states), NV_DATA_S(rates), NV_DATA_S(ud.outputs), NV_DATA_S(ud.inputs));
-        printResults(ud);
+        writer.addRow(NV_DATA_S(ud.outputs));
     }
-    return 0;
+    return writer.finish();
 }
 
 int f(realtype x, N_Vector y, N_Vector ydot, void *user_data)
@@ -0,0 +1,122 @@
+/*
+Copyright 2015 University of Auckland
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.Some license of other
+*/
+
+#ifndef CSIM_BIOMARKERS_H_
+#define CSIM_BIOMARKERS_H_
+
+#include "csim/csim_export.h"
+
+#include <vector>
+
+//! Everything in CSim is in this namespace.
+namespace csim {
+
+/**
+ * The biomarkers of a beat of an action potential, or of any signal with similar upstrokes. Times are in the units
+ * of the variable of integration, and values not yet known are NaN.
+ */
+struct CSIM_EXPORT Biomarkers
+{
+    int numberOfBeats;              // the number of complete beats seen
+    double restingValue;            // the minimum value before the upstroke
+    double peak;                    // the maximum value of the beat
+    double maximumUpstrokeVelocity; // the maximum rate of change over the beat, e.g., dV/dt max
+    double apd50;                   // the time from the upstroke to 50% repolarisation
+    double apd90;                   // the time from the upstroke to 90% repolarisation
+    double cycleLength;             // the time from the previous upstroke to this one
+};
+
+/**
+ * The BiomarkerDetector class extracts the csim::Biomarkers of the beats of a number of series of values sampled
+ * at the same times, as the samples are produced, so the traces never need to be stored.
+ *
+ * A beat starts with an upstroke, when a series rises through the threshold, and ends when the series falls back
+ * below 90% repolarisation, i.e., the resting value plus 10% of the amplitude of the beat. The times of crossing
+ * the threshold and the repolarisation levels are interpolated linearly between samples, and the upstroke velocity
+ * is the largest difference quotient between samples, so all of the biomarkers are only as accurate as the
+ * sampling allows. The biomarkers of each series are those of its last complete beat.
+ */
+class CSIM_EXPORT BiomarkerDetector
+{
+public:
+    /**
+     * Default constructor.
+     *
+     * Construct with no series.
+     */
+     BiomarkerDetector();
+
+    /**
+     * Forget any beats seen and set the number of series and the threshold.
+     * @param numberOfSeries The number of series.
+     * @param threshold The value a series rises through at the upstroke of a beat, e.g., -40 mV.
+     */
+     void reset(int numberOfSeries, double threshold);
+
+     inline int numberOfSeries() const
+     {
+         return int(mBiomarkers.size());
+     }
+
+     inline double threshold() const
+     {
+         return mThreshold;
+     }
+
+    /**
+     * Add a sample of every series.
+     * @param time The time of the sample, which must increase from sample to sample.
+     * @param values The value of each series.
+     */
+     void add(double time, const double* values);
+
+    /**
+     * Add a sample of a range of the series. Different ranges can be added from different threads at once.
+     * @param time The time of the sample, which must increase from sample to sample.
+     * @param values The value of each series, indexed by series.
+     * @param first The first series of the range.
+     * @param last One past the last series of the range.
+     */
+     void add(double time, const double* values, int first, int last);
+
+    /**
+     * Get the biomarkers of the last complete beat of a series.
+     * @param series The index of the series.
+     * @return The biomarkers.
+     */
+     inline const Biomarkers& biomarkers(int series) const
+     {
+         return mBiomarkers[series];
+     }
+
+private:
+     // what is known so far of the beat being tracked in a series
+     struct Beat
+     {
+         bool started, inBeat, repolarised50;
+         double previousTime, previousValue;
+         double restingValue, peak, maximumUpstrokeVelocity, apd50;
+         double upstrokeTime, previousUpstrokeTime;
+     };
+
+     double mThreshold;
+     std::vector<Beat> mBeats;
+     std::vector<Biomarkers> mBiomarkers;
+};
+
+} // namespace csim
+
+#endif // CSIM_BIOMARKERS_H_
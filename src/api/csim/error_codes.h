@@ -39,6 +39,23 @@ enum ErrorCodes
     MISSING_COMPILER = -12,
     MODEL_ALREADY_INSTANTIATED = -13,
     UNDEFINED_VARIABLE_TYPE = -14,
+    INVALID_LOOKUP_TABLE_RANGE = -15,
+    UNABLE_TO_SPECIALISE_MODEL = -16,
+    MODEL_NOT_INSTANTIATED = -17,
+    INVALID_NUMBER_OF_THREADS = -18,
+    INVALID_NUMBER_OF_CELLS = -19,
+    INVALID_CELL_INDEX = -21,
+    INVALID_DIFFUSION_PARAMETERS = -22,
+    DIFFUSION_SOLVER_NOT_CONVERGED = -23,
+    INVALID_THREAD_AFFINITY = -24,
+    INVALID_RESULT_LAYOUT = -25,
+    RESULT_WRITER_NOT_STARTED = -26,
+    UNABLE_TO_WRITE_RESULTS = -27,
+    INVALID_RESULT_FILE = -28,
+    INVALID_SAMPLING = -29,
+    INVALID_SOLVER_PARAMETERS = -30,
+    STEADY_STATE_NOT_CONVERGED = -31,
+    LIMIT_CYCLE_NOT_CONVERGED = -32,
     // Compiler::compileCodeString errors
     UNABLE_TO_CREATE_COMPILATION = -100,
     UNABLE_TO_HANDLE_COMPILATION_JOBS = -101,
@@ -47,6 +64,8 @@ enum ErrorCodes
     COMPILER_UNABLE_TO_COMPILE_CODESTRING = -104,
     COMPILER_UNABLE_TO_TAKE_MODULE = -105,
     COMPILER_UNABLE_TO_MAKE_EXECUTION_ENGINE = -106,
+    COMPILER_UNABLE_TO_GENERATE_MODULE = -107,
+    COMPILER_UNABLE_TO_LINK_RUNTIME = -108,
     // default unknown error
     UNKNOWN_ERROR = -1
 };
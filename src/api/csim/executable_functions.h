@@ -40,6 +40,106 @@ typedef void (*ModelFunction)(double, double*, double*, double*, double*);
  */
 typedef void (*InitialiseFunction)(double*, double*, double*);
 
+/**
+ * This prototype is used for the model step function - evaluate the model at the given value of the variable of
+ * integration (voi) and then advance the state variables by the given step. Gating variables (those whose rate is
+ * linear in the variable itself) are advanced using the exact exponential solution (Rush-Larsen method), all other
+ * state variables are advanced using the forward Euler method. The rates and outputs will be those evaluated at the
+ * start of the step.
+ *
+ * step(voi, step, states, rates, outputs, inputs)
+ */
+typedef void (*StepFunction)(double, double, double*, double*, double*, double*);
+
+/**
+ * This prototype is used for the variables function - evaluate the selected variables of the model, given the current
+ * state of the model and specified input values, for the given variable of integration (voi). Each selected variable
+ * is written to its own entry in the variables array, other entries are left untouched. The selection array is
+ * created by csim::Model::selectVariables() and only the parts of the model needed for the selected variables are
+ * evaluated.
+ *
+ * variables(voi, states, inputs, variables, selection)
+ */
+typedef void (*VariablesFunction)(double, double*, double*, double*, double*);
+
+/**
+ * This prototype is used for the fused integrator functions - advance the state variables of the model by the given
+ * number of fixed steps in a single call, starting from the given value of the variable of integration (voi). The
+ * model is evaluated inside the integrator rather than through calls to the model function. If samples is not NULL,
+ * the state variables are written to it after every step, one row of states per step. The rates and outputs will be
+ * those evaluated at the start of the last step.
+ *
+ * integrate(voi, step, numberOfSteps, states, rates, outputs, inputs, samples)
+ */
+typedef void (*IntegratorFunction)(double, double, int, double*, double*, double*, double*, double*);
+
+/**
+ * This prototype is used for the population integrator functions - advance cells first to last - 1 of a population of
+ * cells of the same model by the given number of fixed steps in a single call, starting from the given value of the
+ * variable of integration (voi). The population is stored as structures of arrays, the value of variable i of cell c
+ * is element i * stride + c of each array. The rates and outputs will be those evaluated at the start of the last
+ * step. Only available for the csim::EulerMethod and csim::RushLarsenMethod integration methods.
+ *
+ * integrate(voi, step, numberOfSteps, stride, first, last, states, rates, outputs, inputs)
+ */
+typedef void (*PopulationIntegratorFunction)(double, double, int, int, int, int, double*, double*, double*, double*);
+
+/**
+ * The fixed step integration methods available as fused integrator functions.
+ */
+enum IntegrationMethod
+{
+    EulerMethod       = 0, // forward Euler
+    RungeKutta4Method = 1, // the classic fourth order Runge-Kutta method
+    RushLarsenMethod  = 2  // exact exponential updates for the gating variables, forward Euler for the rest
+};
+
+/**
+ * The floating point precision used when generating the executable functions for a model.
+ */
+enum Precision
+{
+    DoublePrecision = 0, // everything is evaluated in double precision
+    SinglePrecision = 1, // single precision versions of the model functions are also generated
+    MixedPrecision  = 2  // the model function keeps its double precision arrays but evaluates the model in float
+};
+
+/**
+ * The way the code generated for a model is turned into its executable functions.
+ */
+enum CompilerBackend
+{
+    IrBackend    = 0, // build LLVM IR directly from the model's equations, using clang if the model needs C code
+    ClangBackend = 1  // generate C code for the model and compile it using the clang frontend
+};
+
+/**
+ * The vector math library used when the JIT compiler vectorises calls to exp, log, pow and tanh in a model's
+ * executable functions.
+ */
+enum VectorMath
+{
+    NoVectorMath       = 0, // leave the calls to the scalar libm functions
+    AccurateVectorMath = 1, // vector functions accurate to within a few ulp
+    FastVectorMath     = 2  // faster vector functions accurate to within about 10 ulp
+};
+
+/**
+ * The single precision version of csim::ModelFunction, generated when a model is instantiated with
+ * csim::SinglePrecision.
+ *
+ * model(voi, states, rates, outputs, inputs)
+ */
+typedef void (*ModelFunctionFloat)(float, float*, float*, float*, float*);
+
+/**
+ * The single precision version of csim::InitialiseFunction, generated when a model is instantiated with
+ * csim::SinglePrecision.
+ *
+ * initialise(states, outputs, inputs)
+ */
+typedef void (*InitialiseFunctionFloat)(float*, float*, float*);
+
 } // namespace csim
 
 #endif // CSIM_EXECUTABLE_FUNCTIONS_H
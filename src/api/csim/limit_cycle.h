@@ -0,0 +1,139 @@
+/*
+Copyright 2015 University of Auckland
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.Some license of other
+*/
+
+#ifndef CSIM_LIMIT_CYCLE_H_
+#define CSIM_LIMIT_CYCLE_H_
+
+#include "csim/csim_export.h"
+#include "csim/executable_functions.h"
+
+#include <functional>
+#include <vector>
+
+//! Everything in CSim is in this namespace.
+namespace csim {
+
+/**
+ * Advance the given states of a model by one period, in place.
+ */
+typedef std::function<void(double* states)> PeriodMap;
+
+/**
+ * What happened during the last solve of a csim::LimitCycleSolver.
+ */
+struct CSIM_EXPORT LimitCycleDiagnostics
+{
+    bool converged;        // whether the change of the states over a period was brought within the tolerances
+    int beats;             // the total number of periods simulated, including those used by the shooting
+    int pacedBeats;        // the number of periods simulated to pace the model from beat to beat
+    int newtonIterations;  // the number of Newton shooting iterations accepted
+    int krylovIterations;  // the number of GMRES iterations over all of the Newton iterations
+    double residualNorm;   // the change of the states over the last period, relative to the tolerances
+};
+
+/**
+ * The LimitCycleSolver class finds the periodic steady state of a model paced with a given period, i.e., the states
+ * which the model returns to after each period, far faster than pacing it for thousands of beats.
+ *
+ * The solver paces the model beat by beat, stopping as soon as the change of every state over a beat is within the
+ * tolerances. Slow processes (e.g., ion concentrations) make that change shrink very slowly, so after a few beats the
+ * solver switches to Newton shooting: Newton's method on the difference between the states after a period and at the
+ * start of it, with each Newton step solved by GMRES. The Jacobian of the period map is never formed, each of its
+ * products with a vector costs the simulation of one extra period from slightly perturbed states, and a few of them
+ * capture the slow processes. If a Newton step does not reduce the change over a period the solver goes back to
+ * pacing for a few beats.
+ */
+class CSIM_EXPORT LimitCycleSolver
+{
+public:
+    /**
+     * Default constructor.
+     *
+     * Construct a solver with relative and absolute tolerances of 1e-6 and 1e-8, up to 1000 beats, and shooting
+     * after every 5 paced beats with up to 20 GMRES iterations per Newton step.
+     */
+     LimitCycleSolver();
+
+    /**
+     * Set the tolerances on the change of the states over a period. The solver has converged when the change of each
+     * state is at most relativeTolerance * |state| + absoluteTolerance.
+     * @param relativeTolerance The relative tolerance.
+     * @param absoluteTolerance The absolute tolerance.
+     * @return csim::CSIM_OK on success, otherwise error code.
+     */
+     int setTolerances(double relativeTolerance, double absoluteTolerance);
+
+    /**
+     * Set the maximum number of periods to simulate, including those used by the shooting.
+     * @param beats The maximum number of periods.
+     * @return csim::CSIM_OK on success, otherwise error code.
+     */
+     int setMaximumBeats(int beats);
+
+    /**
+     * Set how the Newton shooting is used.
+     * @param pacedBeats The number of beats to pace before trying Newton shooting, or 0 to only pace the model.
+     * @param krylovIterations The maximum number of GMRES iterations, i.e., extra periods, per Newton step.
+     * @return csim::CSIM_OK on success, otherwise error code.
+     */
+     int setShooting(int pacedBeats, int krylovIterations);
+
+    /**
+     * Find the periodic steady state of a model given its period map, starting from the given states.
+     * @param periodMap Advances the states by one period, starting at the same phase of the pacing every time.
+     * @param numberOfStates The number of state variables.
+     * @param states The states at the start of a period, updated in place to those of the periodic steady state or,
+     * if the solver does not converge, to those reached by the last beat.
+     * @return csim::CSIM_OK if the periodic steady state was found, otherwise error code.
+     */
+     int solve(const PeriodMap& periodMap, int numberOfStates, double* states);
+
+    /**
+     * Find the periodic steady state of a model using one of its fused integrators, starting from the given states.
+     * Every period is simulated from the same value of the variable of integration, which is fine for a model
+     * which is paced periodically.
+     * @param integrator The fused integrator function of the model.
+     * @param voi The value of the variable of integration at the start of each period.
+     * @param period The period of the pacing.
+     * @param stepsPerPeriod The number of fixed steps of the integrator per period.
+     * @param numberOfStates The number of state variables.
+     * @param states The states at the start of a period, updated in place.
+     * @param rates The rates of the model, as evaluated at the start of the last step of the last period simulated.
+     * @param outputs The outputs of the model, as for the rates.
+     * @param inputs The inputs of the model.
+     * @return csim::CSIM_OK if the periodic steady state was found, otherwise error code.
+     */
+     int solve(IntegratorFunction integrator, double voi, double period, int stepsPerPeriod, int numberOfStates,
+               double* states, double* rates, double* outputs, double* inputs);
+
+     inline const LimitCycleDiagnostics& diagnostics() const
+     {
+         return mDiagnostics;
+     }
+
+private:
+     double changeNorm(const double* start, const double* end) const;
+     bool shoot(const PeriodMap& periodMap, std::vector<double>& states, std::vector<double>& end);
+
+     int mNumberOfStates;
+     double mRelativeTolerance, mAbsoluteTolerance;
+     int mMaximumBeats, mShootingBeats, mMaximumKrylovIterations;
+     LimitCycleDiagnostics mDiagnostics;
+};
+
+} // namespace csim
+
+#endif // CSIM_LIMIT_CYCLE_H_
@@ -0,0 +1,173 @@
+/*
+Copyright 2015 University of Auckland
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.Some license of other
+*/
+
+#ifndef CSIM_MAPPED_RESULTS_H_
+#define CSIM_MAPPED_RESULTS_H_
+
+#include "csim/csim_export.h"
+#include "csim/result_writer.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+ * A CSim mapped result file holds the results of a simulation as a plain array of doubles, row after row, so it can be
+ * memory-mapped and used in place by other programs, even while the simulation is still writing to it. All numbers
+ * are in the byte order of the machine writing the file.
+ *
+ *   0:  "CSIMMAP1"
+ *   8:  uint32 number of columns
+ *   12: int32 time column (-1 if none)
+ *   16: uint64 offset of the first row, a multiple of 4096
+ *   24: uint64 number of rows written, updated after each block of rows is complete
+ *   32: uint64 number of rows the file has room for
+ *   40: uint32 1 once the file is finished, otherwise 0
+ *   44: for each column: uint32 length of ID, the ID (no terminator)
+ *
+ * The file grows by a number of rows at a time as the simulation needs more room, and is trimmed to the rows written
+ * when it is finished.
+ */
+
+//! Everything in CSim is in this namespace.
+namespace csim {
+
+/**
+ * A MappedResultSink writes results into a CSim mapped result file through a memory mapping, so writing a block of
+ * results is a copy into memory which the operating system writes out to the file in the background.
+ */
+class CSIM_EXPORT MappedResultSink : public ResultSink
+{
+public:
+    /**
+     * Default constructor.
+     *
+     * Construct a sink with no file open.
+     */
+     MappedResultSink();
+
+    /**
+     * Destructor, which finishes the file if it is still open.
+     */
+     ~MappedResultSink();
+
+    /**
+     * Create the given file, replacing any existing file, with room for the given number of rows.
+     * @param fileName The name of the file.
+     * @param columnIds The ID of each column, e.g., the variable IDs.
+     * @param timeColumn The index of the column holding the variable of integration, or -1 if there is none.
+     * @param initialRows The number of rows to make room for to start with.
+     * @param growthRows The number of rows to make room for each time the file is full.
+     * @return csim::CSIM_OK on success, otherwise error code.
+     */
+     int open(const std::string& fileName, const std::vector<std::string>& columnIds, int timeColumn,
+              uint64_t initialRows = 65536, uint64_t growthRows = 65536);
+
+     int write(const double* values, int numberOfRows, int numberOfColumns) override;
+
+    /**
+     * Mark the file as finished, trim it to the rows written and close it.
+     */
+     int finish() override;
+
+private:
+     MappedResultSink(const MappedResultSink&) = delete;
+     MappedResultSink& operator=(const MappedResultSink&) = delete;
+
+     int map(uint64_t capacity);
+
+     int mFile;
+     unsigned char* mMapping;
+     uint64_t mMappedSize, mDataOffset, mCapacity, mGrowthRows, mNumberOfRows;
+     int mNumberOfColumns;
+};
+
+/**
+ * The MappedResults class gives read-only access to a CSim mapped result file without copying it, including a file
+ * which is still being written.
+ */
+class CSIM_EXPORT MappedResults
+{
+public:
+    /**
+     * Default constructor.
+     *
+     * Construct with no file open.
+     */
+     MappedResults();
+
+    /**
+     * Destructor.
+     */
+     ~MappedResults();
+
+    /**
+     * Map the given file.
+     * @param fileName The name of the file.
+     * @return csim::CSIM_OK on success, otherwise error code.
+     */
+     int open(const std::string& fileName);
+
+    /**
+     * Map any rows added to the file since it was opened or last refreshed.
+     * @return csim::CSIM_OK on success, otherwise error code.
+     */
+     int refresh();
+
+     inline const std::vector<std::string>& columnIds() const
+     {
+         return mColumnIds;
+     }
+
+     inline int timeColumn() const
+     {
+         return mTimeColumn;
+     }
+
+    /**
+     * Get the number of complete rows which can be used, up to the last refresh.
+     * @return The number of rows.
+     */
+     uint64_t numberOfRows() const;
+
+    /**
+     * Check if the simulation writing the file has finished.
+     * @return true if the file is finished, false otherwise.
+     */
+     bool isFinished() const;
+
+    /**
+     * Get the results, row after row with columnIds().size() values in each row.
+     * @return A pointer to numberOfRows() rows, or NULL if no file is open.
+     */
+     const double* values() const;
+
+private:
+     MappedResults(const MappedResults&) = delete;
+     MappedResults& operator=(const MappedResults&) = delete;
+
+     void close();
+
+     int mFile;
+     const unsigned char* mMapping;
+     uint64_t mMappedSize, mDataOffset;
+     int mTimeColumn;
+     std::vector<std::string> mColumnIds;
+};
+
+} // namespace csim
+
+#endif // CSIM_MAPPED_RESULTS_H_
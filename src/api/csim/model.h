@@ -22,6 +22,7 @@ limitations under the License.Some license of other
 
 #include <string>
 #include <map>
+#include <vector>
 
 class XmlDoc;
 
@@ -44,12 +45,6 @@ public:
      */
      Model();
 
-    /**
-     * Copy constructor
-     * @param src The source model to copy.
-     */
-     Model(const Model& src);
-
     /**
      * Destructor.
      */
@@ -147,15 +142,193 @@ public:
       */
      std::map<std::string, int> setAllVariablesAsOutput();
 
+     /**
+      * Request a lookup table for the specified variable. When the model is instantiated, any expressions
+      * in the model which depend only on this variable (and constant parameters not flagged as inputs) and which
+      * involve a function call, such as the exponential rate expressions common in cardiac models, will be
+      * precomputed into tables over the given range. The executable function will then use linear interpolation
+      * into these tables while the variable is within the range and evaluate the original expressions otherwise.
+      * Attempting to request a lookup table after this CellML model has been instantiated will raise an error.
+      * @param variableId The ID of the lookup variable in the format 'component_name/variable_name'.
+      * @param minimum The lower bound of the lookup table range.
+      * @param maximum The upper bound of the lookup table range.
+      * @param step The spacing between tabulated values of the lookup variable.
+      * @return csim::CSIM_OK on success, otherwise error code.
+      */
+     int setLookupTable(const std::string& variableId, double minimum, double maximum, double step);
+
+     /**
+      * Get the maximum absolute error introduced by the interpolation of lookup tables. This is measured at the
+      * mid-point of every table interval when the model is instantiated.
+      * @return The maximum interpolation error over all lookup tables, or zero if no lookup tables are in use.
+      */
+     double lookupTableError() const;
+
+     /**
+      * Set the way this model will be compiled into its executable functions. By default the executable functions
+      * are built directly from the model's equations as LLVM IR, which is much faster to compile for large models.
+      * Models requiring C code to be generated (for example, when using lookup tables or reduced precision) are
+      * always compiled with the clang frontend. Attempting to set the backend after this model has been
+      * instantiated will raise an error.
+      * @param backend The compiler backend to use.
+      * @return csim::CSIM_OK on success, otherwise error code.
+      */
+     int setCompilerBackend(CompilerBackend backend);
+
+     /**
+      * Get the compiler backend for this model. Once the model has been instantiated, this will be the backend
+      * actually used to compile the model.
+      * @return The compiler backend.
+      */
+     inline CompilerBackend compilerBackend() const
+     {
+         return mCompilerBackend;
+     }
+
+     /**
+      * Set the vector math library used when the compiler is able to vectorise calls to exp, log, pow and tanh in
+      * this model's executable functions. By default the accurate vector functions are used, csim::NoVectorMath
+      * will keep all calls to the scalar libm functions. Attempting to set the vector math library after this model
+      * has been instantiated will raise an error.
+      * @param vectorMath The vector math library to use.
+      * @return csim::CSIM_OK on success, otherwise error code.
+      */
+     int setVectorMath(VectorMath vectorMath);
+
+     /**
+      * Get the vector math library used for this model.
+      * @return The vector math library.
+      */
+     inline VectorMath vectorMath() const
+     {
+         return mVectorMath;
+     }
+
+     /**
+      * Set the time allowed for compiling this model's executable functions when it is instantiated or specialised.
+      * The model function and the other routines of very large models are split into chunks which are compiled in
+      * parallel. Chunks which are expected to take the compilation over the budget are compiled with less
+      * optimisation, and once the budget is used up the remaining chunks are not optimised at all. Only applies to
+      * models built directly into executable code. Attempting to set the budget after this model has been
+      * instantiated will raise an error.
+      * @param seconds The compile time budget in seconds, zero (the default) for no limit.
+      * @return csim::CSIM_OK on success, otherwise error code.
+      */
+     int setCompileTimeBudget(double seconds);
+
+     /**
+      * Set the number of threads used by evaluateModel(). With more than one thread, the equations of the model are
+      * split into a graph of tasks when the model is instantiated, which are then evaluated on a pool of threads
+      * kept for the life of the model. This is only worthwhile for very large models (around a thousand state
+      * variables or more), as each evaluation has a small fixed cost to hand out the work. Attempting to set the
+      * number of threads after this model has been instantiated will raise an error.
+      * @param numberOfThreads The number of threads to use, including the calling thread (defaults to one).
+      * @return csim::CSIM_OK on success, otherwise error code.
+      */
+     int setNumberOfThreads(int numberOfThreads);
+
+     /**
+      * Get the number of threads used by evaluateModel(). Once the model has been instantiated, this will be the
+      * number of threads actually used, which may be less than requested if the model is not able to be split
+      * into enough tasks.
+      * @return The number of threads.
+      */
+     int numberOfThreads() const;
+
+     /**
+      * Get the number of tasks the model function has been split into to be evaluated in parallel.
+      * @return The number of tasks, zero if the model is evaluated by a single thread.
+      */
+     int numberOfTasks() const;
+
+     /**
+      * Evaluate the model function, in parallel if more than one thread was requested when the model was
+      * instantiated. The arguments are the same as for the csim::ModelFunction returned by getModelFunction(), and
+      * so are the results. Only one evaluation can be in progress for a model at a time.
+      * @return csim::CSIM_OK on success, otherwise error code.
+      * @see setNumberOfThreads().
+      */
+     int evaluateModel(double voi, double* states, double* rates, double* outputs, double* inputs);
+
      /**
       * Instantiate the current model into an executable function. This method should only be called once all
       * required inputs and outputs have been set. Once a model is instantiated, no further modifications can be made
       * to the inputs and outputs.
       * @param verbose Tell the compiler to be verbose in its output (defaults to non-verbose output).
       * @param debug Generate a debug version of the executable functions for this model (defaults to optimised).
+      * @param precision The floating point precision to generate the executable functions in (defaults to double).
+      * With csim::SinglePrecision, single precision versions of the model and initialise functions are generated in
+      * addition to the double precision ones. With csim::MixedPrecision, the model function keeps its double
+      * precision interface (so states can be integrated in double precision) but evaluates the model in single
+      * precision.
+      * @return csim::CSIM_OK on success, otherwise error code.
+      * @see precisionError().
+      */
+     int instantiate(bool verbose = false, bool debug = false, Precision precision = DoublePrecision);
+
+     /**
+      * Get the index of every variable in the model in the array written by the variables function. Unlike outputs,
+      * the variables to evaluate are able to be chosen after the model has been instantiated. Several variables in
+      * the model may share the same index if they are connected to each other.
+      * @return The index of each variable, by variable ID. Will be empty if the model has not been instantiated.
+      * @see getVariablesFunction().
+      */
+     std::map<std::string, int> getAllVariableIndices() const;
+
+     /**
+      * Will provide the number of distinct variables in this model, which is the minimum size of the array written
+      * by the variables function. The returned number will only make sense after a model is successfully
+      * instantiated.
+      * @return The number of variables in this model.
+      */
+     int numberOfVariables() const;
+
+     /**
+      * Create the selection for the variables function to evaluate the given variables. Only the equations needed
+      * to compute the selected variables will be evaluated. A selection can be used with any number of calls to the
+      * variables function, and any number of selections can be used with the same model.
+      * @param variableIndices The indices of the variables to select.
+      * @return The selection array to pass to the variables function, or an empty array on error.
+      * @see getAllVariableIndices().
+      */
+     std::vector<double> selectVariables(const std::vector<int>& variableIndices) const;
+
+     /**
+      * Compile versions of this model's executable functions specialised on fixed values of some of its inputs. The
+      * fixed inputs become literal constants in the specialised functions, so expressions depending only on them are
+      * evaluated once here, piecewise expressions whose conditions they decide are reduced to the branch taken and
+      * equations which are then no longer needed are removed. The general functions remain available, and the model
+      * can be specialised again with different values, replacing the previous specialised functions. The specialised
+      * functions still take the full input array, but ignore the entries for the fixed inputs (the specialised
+      * initialise function sets them to their fixed values). Only models built directly into executable code (i.e.,
+      * double precision without lookup tables) are able to be specialised.
+      * @param inputValues The values to fix, indexed by the ID of the input variable in the format
+      * 'component_name/variable_name'. Each variable must have been flagged as an input before instantiating.
       * @return csim::CSIM_OK on success, otherwise error code.
       */
-     int instantiate(bool verbose = false, bool debug = false);
+     int specialise(const std::map<std::string, double>& inputValues);
+
+     /**
+      * Get the number of statements removed from the executable functions by the last call to specialise().
+      * @return The number of statements removed.
+      */
+     int numberOfSpecialisedStatements() const;
+
+     /**
+      * Get the number of statements removed from the generated code when the model was instantiated. Algebraic
+      * variables which are not needed, directly or indirectly, to compute the rates or the flagged outputs of the
+      * model are not evaluated by the model function.
+      * @return The number of statements removed from the model function.
+      */
+     int numberOfRemovedStatements() const;
+
+     /**
+      * Get the maximum relative difference between the reduced precision and double precision evaluation of the
+      * model's rates and outputs. This is measured at the initial state of the model when the model is instantiated
+      * using single or mixed precision (differences for values smaller than one are absolute).
+      * @return The maximum relative difference, or zero if the model was instantiated in double precision.
+      */
+     double precisionError() const;
 
      /**
       * Return a pointer to the initialisation function for this model.
@@ -169,6 +342,84 @@ public:
       */
      ModelFunction getModelFunction() const;
 
+     /**
+      * Get the Rush-Larsen step function for this model. This function advances the gating variables of the model
+      * using their exact exponential solution over the step, allowing much larger stable steps for models with
+      * Hodgkin-Huxley style gating variables than forward Euler.
+      * @return A pointer to the step function, or NULL on error.
+      * @see numberOfGatingVariables().
+      */
+     StepFunction getRushLarsenFunction() const;
+
+     /**
+      * Get the variables function for this model, which evaluates any selection of the model's variables.
+      * @return A pointer to the variables function, or NULL on error.
+      * @see selectVariables().
+      */
+     VariablesFunction getVariablesFunction() const;
+
+     /**
+      * Get the fused integrator function for the given fixed step method. The integrator advances the model by any
+      * number of steps in a single call, with the model evaluated inline rather than through the model function,
+      * which avoids the call overhead and extra passes over the state arrays for each step.
+      * @param method The integration method.
+      * @return A pointer to the integrator function, or NULL on error or if the model was compiled using clang (i.e.,
+      * with lookup tables or reduced precision).
+      * @see compilerBackend().
+      */
+     IntegratorFunction getIntegratorFunction(IntegrationMethod method) const;
+
+     /**
+      * Get the population integrator function for the given fixed step method, which advances a population of cells
+      * of this model stored as structures of arrays. Usually used through csim::Population rather than directly.
+      * @param method The integration method, either csim::EulerMethod or csim::RushLarsenMethod.
+      * @return A pointer to the population integrator function, or NULL on error, for other methods or if the model
+      * was compiled using clang or in chunks.
+      * @see csim::Population.
+      */
+     PopulationIntegratorFunction getPopulationIntegratorFunction(IntegrationMethod method) const;
+
+     /**
+      * Return a pointer to the initialisation function specialised by the last call to specialise().
+      * @return A pointer to the specialised initialisation function, NULL on error or if the model has not been
+      * specialised.
+      */
+     InitialiseFunction getSpecialisedInitialiseFunction() const;
+
+     /**
+      * Get the model function specialised by the last call to specialise().
+      * @return A pointer to the specialised model function, NULL on error or if the model has not been specialised.
+      */
+     ModelFunction getSpecialisedModelFunction() const;
+
+     /**
+      * Get the Rush-Larsen step function specialised by the last call to specialise().
+      * @return A pointer to the specialised step function, NULL on error or if the model has not been specialised.
+      */
+     StepFunction getSpecialisedRushLarsenFunction() const;
+
+     /**
+      * Get the fused integrator function specialised by the last call to specialise().
+      * @param method The integration method.
+      * @return A pointer to the specialised integrator function, NULL on error or if the model has not been
+      * specialised.
+      */
+     IntegratorFunction getSpecialisedIntegratorFunction(IntegrationMethod method) const;
+
+     /**
+      * Return a pointer to the single precision initialisation function for this model.
+      * @return A pointer to the single precision initialisation function, NULL on error or if this model was not
+      * instantiated using csim::SinglePrecision.
+      */
+     InitialiseFunctionFloat getSinglePrecisionInitialiseFunction() const;
+
+     /**
+      * Get the single precision model function for this model.
+      * @return A pointer to the single precision model function, NULL on error or if this model was not
+      * instantiated using csim::SinglePrecision.
+      */
+     ModelFunctionFloat getSinglePrecisionModelFunction() const;
+
     /**
      * Check if this model has been instantiated into executable code.
      * @return True if a suitable CellML model has been loaded and instantiated; false otherwise.
@@ -208,17 +459,38 @@ public:
          return mNumberOfOutputs;
      }
 
+     /**
+      * Will provide the number of state variables in this model which were identified as gating variables when the
+      * model was instantiated, i.e., variables whose rate is linear in the variable itself such as
+      * dy/dt = a(V)(1-y) - b(V)y or dy/dt = (y_inf - y)/tau. The returned number will only make sense after a model is
+      * successfully instantiated.
+      * @return The number of gating variables in this model.
+      */
+     inline int numberOfGatingVariables() const
+     {
+         return mNumberOfGatingVariables;
+     }
+
      std::string mapXpathToVariableId(const std::string& xpath,
                                       const std::map<std::string, std::string>& namespaces) const;
 
 private:
+     // a model owns its compiled code, specialised code and task graph, none of which are able to be shared
+     Model(const Model&) = delete;
+     Model& operator=(const Model&) = delete;
+
     /**
      * Internal representation of a CellML model.
      */
     void* mModelDefinition;
     void* mCompiler;
+    void* mSpecialisedCompiler;
+    void* mTaskGraph;
     bool mInstantiated;
-    int mNumberOfStates, mNumberOfInputs, mNumberOfOutputs;
+    int mNumberOfStates, mNumberOfInputs, mNumberOfOutputs, mNumberOfGatingVariables, mNumberOfThreads;
+    CompilerBackend mCompilerBackend;
+    VectorMath mVectorMath;
+    double mCompileTimeBudget;
     XmlDoc* mXmlDoc;
 };
 
@@ -0,0 +1,188 @@
+/*
+Copyright 2015 University of Auckland
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.Some license of other
+*/
+
+#ifndef CSIM_MONODOMAIN_H_
+#define CSIM_MONODOMAIN_H_
+
+#include "csim/csim_export.h"
+#include "csim/executable_functions.h"
+#include "csim/population.h"
+
+#include <string>
+#include <vector>
+
+//! Everything in CSim is in this namespace.
+namespace csim {
+
+/**
+ * The ways of splitting each step of a reaction-diffusion problem into a reaction step and a diffusion step.
+ */
+enum SplittingScheme
+{
+    GodunovSplitting = 0, // a reaction step followed by a backward Euler diffusion step, first order splitting
+    StrangSplitting  = 1  // Crank-Nicolson half diffusion steps either side of a reaction step, second order splitting
+};
+
+/**
+ * The Monodomain class solves the monodomain equations on a structured grid of cells: a cable, a sheet or a block of
+ * cells of the same csim::Model, coupled by the diffusion of one of the model's state variables (the membrane
+ * potential).
+ *
+ * Each step is split into a reaction step, which advances every cell of the grid's csim::Population independently
+ * using the model's population integrators, and implicit diffusion steps with no flux through the boundaries of the
+ * grid. The diffusion steps are solved directly for a cable and using the Jacobi preconditioned conjugate gradient
+ * method for a sheet or block, in parallel on the same number of threads as the reaction steps.
+ */
+class CSIM_EXPORT Monodomain
+{
+public:
+    /**
+     * Default constructor.
+     *
+     * Construct an empty csim::Monodomain.
+     */
+     Monodomain();
+
+    /**
+     * Destructor.
+     */
+     ~Monodomain();
+
+    /**
+     * Create the grid of cells for the given model, replacing any previous grid. Cell (i, j, k) of the grid is cell
+     * i + numberOfColumns * (j + numberOfRows * k) of the population. The model must have been instantiated, and must
+     * not be destroyed or instantiated again while it is used by this grid.
+     * @param model The model of each cell.
+     * @param voltageId The ID of the state variable which diffuses, in the format 'component_name/variable_name'.
+     * @param numberOfColumns The number of cells along the first axis of the grid.
+     * @param numberOfRows The number of cells along the second axis of the grid, 1 for a cable.
+     * @param numberOfLayers The number of cells along the third axis of the grid, 1 for a cable or sheet.
+     * @return csim::CSIM_OK on success, otherwise error code.
+     */
+     int create(Model* model, const std::string& voltageId, int numberOfColumns, int numberOfRows = 1,
+                int numberOfLayers = 1);
+
+    /**
+     * Set the diffusion of the voltage between neighbouring cells.
+     * @param coefficient The diffusion coefficient (the conductivity divided by the membrane capacitance and
+     * surface to volume ratio), in units of length squared per unit of the variable of integration.
+     * @param spacing The distance between neighbouring cells.
+     * @return csim::CSIM_OK on success, otherwise error code.
+     */
+     int setDiffusion(double coefficient, double spacing);
+
+    /**
+     * Set the way each step is split into reaction and diffusion steps, the default is csim::StrangSplitting. The
+     * order of the whole step is also limited by the integration method of the reaction steps. Crank-Nicolson diffusion
+     * steps can oscillate around sharp fronts when the coefficient times the step size is large compared to the square
+     * of the spacing, in which case csim::GodunovSplitting is more robust.
+     * @param scheme The splitting scheme.
+     * @return csim::CSIM_OK on success, otherwise error code.
+     */
+     int setSplitting(SplittingScheme scheme);
+
+    /**
+     * Set the convergence criteria for the conjugate gradient solver used for the diffusion steps of a sheet or block.
+     * @param tolerance The norm of the residual, relative to the norm of the voltage, to reach. The default is 1e-8.
+     * @param maximumIterations The maximum number of iterations of each solve, 1000 by default.
+     * @return csim::CSIM_OK on success, otherwise error code.
+     */
+     int setSolverTolerance(double tolerance, int maximumIterations);
+
+    /**
+     * Set the number of threads used for both the reaction and diffusion steps, including the calling thread.
+     * @param numberOfThreads The number of threads, at least one.
+     * @return csim::CSIM_OK on success, otherwise error code.
+     */
+     int setNumberOfThreads(int numberOfThreads);
+
+     inline int numberOfThreads() const
+     {
+         return mNumberOfThreads;
+     }
+
+    /**
+     * Pin the threads used for both the reaction and diffusion steps to the given CPUs.
+     * @param cpus The CPUs to pin the threads to, or empty to leave the threads unpinned (the default).
+     * @return csim::CSIM_OK on success, otherwise error code.
+     * @see Population::setThreadAffinity().
+     */
+     int setThreadAffinity(const std::vector<int>& cpus);
+
+    /**
+     * Get the population holding the cells of the grid, which gives access to every variable of the cells and to
+     * their inputs (e.g., to apply a stimulus or give regions of the grid their own parameter values).
+     * @return The population of cells.
+     */
+     inline Population& population()
+     {
+         return mPopulation;
+     }
+
+    /**
+     * Get the voltage of every cell of the grid, which can be modified in place.
+     * @return A pointer to the voltage of each cell, or NULL if the grid has not been created.
+     */
+     double* voltage();
+
+    /**
+     * Get the index in the population of the given cell of the grid.
+     * @return The index of the cell, or -1 if it is not in the grid.
+     */
+     int cellIndex(int column, int row = 0, int layer = 0) const;
+
+    /**
+     * Advance the grid by the given number of fixed steps.
+     * @param voi The value of the variable of integration at the start of the first step.
+     * @param stepSize The size of each step.
+     * @param numberOfSteps The number of steps to take.
+     * @param method The integration method for the reaction steps, either csim::EulerMethod or
+     * csim::RushLarsenMethod.
+     * @return csim::CSIM_OK on success, otherwise error code.
+     */
+     int step(double voi, double stepSize, int numberOfSteps, IntegrationMethod method);
+
+    /**
+     * Get the number of conjugate gradient iterations taken by the last diffusion step.
+     * @return The number of iterations, zero for a cable.
+     */
+     inline int solverIterations() const
+     {
+         return mSolverIterations;
+     }
+
+private:
+     Monodomain(const Monodomain&) = delete;
+     Monodomain& operator=(const Monodomain&) = delete;
+
+     int diffuse(double time, double theta);
+     void solveCable(double a, double theta);
+     int solveGrid(double a, double theta);
+
+     Population mPopulation;
+     int mVoltageIndex;
+     int mNumberOfColumns, mNumberOfRows, mNumberOfLayers, mNumberOfThreads;
+     double mDiffusionCoefficient, mSpacing;
+     SplittingScheme mSplitting;
+     double mTolerance;
+     int mMaximumIterations, mSolverIterations;
+     std::vector<double> mB, mR, mP, mQ;
+     void* mThreadPool;
+};
+
+} // namespace csim
+
+#endif // CSIM_MONODOMAIN_H_
@@ -0,0 +1,256 @@
+/*
+Copyright 2015 University of Auckland
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.Some license of other
+*/
+
+#ifndef CSIM_POPULATION_H_
+#define CSIM_POPULATION_H_
+
+#include "csim/csim_export.h"
+#include "csim/executable_functions.h"
+
+#include <string>
+#include <vector>
+
+//! Everything in CSim is in this namespace.
+namespace csim {
+
+class Model;
+class PopulationStatistics;
+
+/**
+ * The ways of placing the arrays of a population in memory on machines with more than one NUMA node.
+ */
+enum MemoryPlacement
+{
+    FirstTouchPlacement = 0,  // each thread's cells are placed on the node the thread runs on
+    InterleavedPlacement = 1  // the pages of the arrays are spread evenly over the nodes the threads run on
+};
+
+/**
+ * The Population class holds a population of cells of the same instantiated csim::Model and advances them all
+ * together.
+ *
+ * The states, rates, outputs and inputs of the cells are stored as structures of arrays: the values of each variable
+ * are contiguous across the cells, starting on a cache line boundary, so any variable can be viewed across the whole
+ * population without copying. The inputs of each cell can be set independently, to give the cells their own
+ * parameter values. The population is advanced by the model's population integrator functions, which evaluate a
+ * number of cells at once using the vector instructions of the processor, on as many threads as requested. Models
+ * too large to have population integrators (those compiled in chunks) are advanced a cell at a time by their fused
+ * integrator instead, which still uses all of the threads but not the vector instructions across cells.
+ *
+ * The arrays are first written to by the threads which advance the cells, so on machines with more than one NUMA
+ * node each thread's cells are in memory attached to the node it runs on. This is most effective with the threads
+ * pinned to CPUs using setThreadAffinity(), otherwise the operating system is free to move them away from their
+ * memory.
+ */
+class CSIM_EXPORT Population
+{
+public:
+    /**
+     * Default constructor.
+     *
+     * Construct an empty csim::Population.
+     */
+     Population();
+
+    /**
+     * Destructor.
+     */
+     ~Population();
+
+    /**
+     * Create the population of cells for the given model, replacing any previous population. Every cell starts with
+     * the initial values given by the model's initialisation function. The model must have been instantiated, and
+     * must not be destroyed or instantiated again while it is used by this population.
+     * @param model The model of each cell.
+     * @param numberOfCells The number of cells in the population.
+     * @return csim::CSIM_OK on success, otherwise error code.
+     */
+     int create(Model* model, int numberOfCells);
+
+    /**
+     * Reset every cell to the initial values given by the model's initialisation function, including the inputs.
+     * @return csim::CSIM_OK on success, otherwise error code.
+     */
+     int initialise();
+
+    /**
+     * Set the number of threads used to advance the population, including the calling thread. Each thread advances
+     * its own contiguous range of cells, the threads are kept waiting between steps for as long as the population
+     * exists. The arrays are moved to suit the new threads if the population has already been created.
+     * @param numberOfThreads The number of threads, at least one.
+     * @return csim::CSIM_OK on success, otherwise error code.
+     */
+     int setNumberOfThreads(int numberOfThreads);
+
+     inline int numberOfThreads() const
+     {
+         return mNumberOfThreads;
+     }
+
+    /**
+     * Pin the threads advancing the population to the given CPUs. Thread t, which advances the t-th range of cells,
+     * is pinned to cpus[t % cpus.size()]. Thread 0 is the thread calling step(), which is pinned to cpus[0] while
+     * the cells are advanced by more than one thread and then given back its own affinity. The arrays are moved next
+     * to the pinned threads.
+     * @param cpus The CPUs to pin the threads to, or empty to leave the threads unpinned (the default).
+     * @return csim::CSIM_OK on success, otherwise error code.
+     */
+     int setThreadAffinity(const std::vector<int>& cpus);
+
+     inline const std::vector<int>& threadAffinity() const
+     {
+         return mThreadAffinity;
+     }
+
+    /**
+     * Set how the arrays of the population are placed in memory, the default is csim::FirstTouchPlacement. The
+     * arrays are moved if the population has already been created.
+     * @param placement The memory placement.
+     * @return csim::CSIM_OK on success, otherwise error code.
+     */
+     int setMemoryPlacement(MemoryPlacement placement);
+
+     inline MemoryPlacement memoryPlacement() const
+     {
+         return mMemoryPlacement;
+     }
+
+     inline int numberOfCells() const
+     {
+         return mNumberOfCells;
+     }
+
+    /**
+     * The distance between the values of consecutive variables in the population arrays, which is the number of
+     * cells rounded up to a whole number of cache lines.
+     * @return The stride of the population arrays.
+     */
+     inline int stride() const
+     {
+         return mStride;
+     }
+
+    /**
+     * Set the value of the given input variable for a single cell.
+     * @param inputIndex The index of the input variable.
+     * @param cell The index of the cell.
+     * @param value The new value.
+     * @return csim::CSIM_OK on success, otherwise error code.
+     */
+     int setInput(int inputIndex, int cell, double value);
+
+    /**
+     * Set the value of the given input variable for every cell.
+     * @param inputIndex The index of the input variable.
+     * @param value The new value.
+     * @return csim::CSIM_OK on success, otherwise error code.
+     */
+     int setInput(int inputIndex, double value);
+
+    /**
+     * Get the values of a state variable across the population, one per cell. The values can be modified in place
+     * and remain valid until the population is created again.
+     * @param stateIndex The index of the state variable.
+     * @return A pointer to numberOfCells() values, or NULL if the index is not valid.
+     */
+     double* states(int stateIndex);
+
+    /**
+     * Get the values of the rate of a state variable across the population, as evaluated at the start of the last
+     * step.
+     * @param stateIndex The index of the state variable.
+     * @return A pointer to numberOfCells() values, or NULL if the index is not valid.
+     * @see states().
+     */
+     double* rates(int stateIndex);
+
+    /**
+     * Get the values of an output variable across the population, as evaluated at the start of the last step.
+     * @param outputIndex The index of the output variable.
+     * @return A pointer to numberOfCells() values, or NULL if the index is not valid.
+     * @see states().
+     */
+     double* outputs(int outputIndex);
+
+    /**
+     * Get the values of an input variable across the population.
+     * @param inputIndex The index of the input variable.
+     * @return A pointer to numberOfCells() values, or NULL if the index is not valid.
+     * @see states().
+     */
+     double* inputs(int inputIndex);
+
+    /**
+     * Get the values of the specified variable across the population in its role as the specified type.
+     * @param variableId The ID of the variable in the format 'component_name/variable_name'.
+     * @param variableType One of csim::StateType, csim::OutputType or csim::InputType.
+     * @return A pointer to numberOfCells() values, or NULL on error.
+     * @see states().
+     */
+     double* values(const std::string& variableId, unsigned char variableType);
+
+    /**
+     * Advance every cell in the population by the given number of fixed steps.
+     * @param voi The value of the variable of integration at the start of the first step.
+     * @param stepSize The size of each step.
+     * @param numberOfSteps The number of steps to take.
+     * @param method The integration method, either csim::EulerMethod or csim::RushLarsenMethod.
+     * @return csim::CSIM_OK on success, otherwise error code.
+     */
+     int step(double voi, double stepSize, int numberOfSteps, IntegrationMethod method);
+
+    /**
+     * Advance every cell in the population by the given number of samples of fixed steps, reducing the variables of
+     * the given statistics after each sample on the threads advancing the cells, while their values are still in
+     * cache. The sample times are the values of the variable of integration at the end of each sample, the outputs
+     * being those evaluated at the start of the last step of the sample as for outputs().
+     * @param voi The value of the variable of integration at the start of the first step.
+     * @param stepSize The size of each step.
+     * @param numberOfSamples The number of samples to take.
+     * @param stepsPerSample The number of steps between samples.
+     * @param method The integration method, either csim::EulerMethod or csim::RushLarsenMethod.
+     * @param statistics The statistics to add the samples to, which carry on from any samples already added.
+     * @return csim::CSIM_OK on success, otherwise error code.
+     */
+     int sample(double voi, double stepSize, int numberOfSamples, int stepsPerSample, IntegrationMethod method,
+                PopulationStatistics& statistics);
+
+private:
+     Population(const Population&) = delete;
+     Population& operator=(const Population&) = delete;
+
+     double* row(double* array, int numberOfRows, int index);
+     std::vector<int> cellBounds() const;
+     void* threadPool(int numberOfThreads);
+     void place(bool keepValues);
+
+     Model* mModel;
+     int mNumberOfCells, mStride, mNumberOfThreads;
+     int mNumberOfStates, mNumberOfOutputs, mNumberOfInputs;
+     std::vector<int> mThreadAffinity;
+     MemoryPlacement mMemoryPlacement;
+     double* mStorage;
+     size_t mStorageSize;
+     double* mStates;
+     double* mRates;
+     double* mOutputs;
+     double* mInputs;
+     void* mThreadPool;
+};
+
+} // namespace csim
+
+#endif // CSIM_POPULATION_H_
@@ -0,0 +1,192 @@
+/*
+Copyright 2015 University of Auckland
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.Some license of other
+*/
+
+#ifndef CSIM_RESULT_FORMAT_H_
+#define CSIM_RESULT_FORMAT_H_
+
+#include "csim/csim_export.h"
+#include "csim/result_writer.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/*
+ * The CSim compressed result format stores the results of a simulation column by column, in chunks of rows, with each
+ * column of each chunk compressed separately using zlib. All numbers are little-endian.
+ *
+ *   header:  "CSIMRES1", uint32 number of columns, int32 time column (-1 if none), then for each column:
+ *            uint32 length of ID, the ID (no terminator), uint8 encoding (csim::ColumnEncoding)
+ *   chunks:  "CHNK", uint32 number of rows, double first time, double last time, then for each column:
+ *            uint32 compressed size, the compressed bytes of the encoded column
+ *   index:   for each chunk: uint64 file offset, uint32 number of rows, double first time, double last time
+ *   footer:  uint64 number of chunks, uint64 file offset of the index, "CSIMIDX1"
+ *
+ * The time of a chunk is taken from the time column, which must not decrease, or is the row number of the file if
+ * there is no time column. A column is encoded by taking the bit pattern of each value as a 64-bit integer, replacing
+ * it by its difference from or exclusive or with the previous value's pattern if asked to, and then storing the
+ * lowest byte of every value of the chunk, followed by the next lowest byte of every value, and so on. Smooth time
+ * series leave long runs of equal bytes, which zlib compresses well. The encoding is lossless.
+ *
+ * The index and footer are written when the file is finished, a file without them (e.g., from a simulation which is
+ * still running) is read by scanning its chunks.
+ */
+
+//! Everything in CSim is in this namespace.
+namespace csim {
+
+/**
+ * The ways a column can be encoded before it is compressed.
+ */
+enum ColumnEncoding
+{
+    PlainEncoding = 0, // the values as they are
+    DeltaEncoding = 1, // the difference of each value's bit pattern from the previous one, best for smooth signals
+    XorEncoding   = 2  // the exclusive or of each value's bit pattern with the previous one, best for signals which
+                       // often repeat values or only change in their lowest bits
+};
+
+/**
+ * A CompressedResultSink writes results to a file in the CSim compressed result format, one chunk for each block of
+ * results it is given. Used with a csim::ResultWriter, the compression is done on the writer thread.
+ */
+class CSIM_EXPORT CompressedResultSink : public ResultSink
+{
+public:
+    /**
+     * Default constructor.
+     *
+     * Construct a sink with no file open.
+     */
+     CompressedResultSink();
+
+    /**
+     * Destructor, which finishes the file if it is still open.
+     */
+     ~CompressedResultSink();
+
+    /**
+     * Create the given file, replacing any existing file, and write its header.
+     * @param fileName The name of the file.
+     * @param columnIds The ID of each column, e.g., the variable IDs.
+     * @param timeColumn The index of the column holding the variable of integration, or -1 if there is none.
+     * @param encodings The encoding of each column, or empty to use csim::DeltaEncoding for every column.
+     * @return csim::CSIM_OK on success, otherwise error code.
+     */
+     int open(const std::string& fileName, const std::vector<std::string>& columnIds, int timeColumn,
+              const std::vector<ColumnEncoding>& encodings = std::vector<ColumnEncoding>());
+
+     int write(const double* values, int numberOfRows, int numberOfColumns) override;
+
+    /**
+     * Write the index and footer, and close the file.
+     */
+     int finish() override;
+
+private:
+     CompressedResultSink(const CompressedResultSink&) = delete;
+     CompressedResultSink& operator=(const CompressedResultSink&) = delete;
+
+     FILE* mFile;
+     int mTimeColumn;
+     std::vector<ColumnEncoding> mEncodings;
+     uint64_t mNumberOfRows;
+     std::vector<unsigned char> mEncoded, mCompressed;
+     std::vector<uint64_t> mChunkOffsets;
+     std::vector<uint32_t> mChunkRows;
+     std::vector<double> mChunkTimes;
+};
+
+/**
+ * The ResultReader class reads files in the CSim compressed result format. Only the chunks covering the requested
+ * range of time are read, and only the requested columns of those chunks are decompressed.
+ */
+class CSIM_EXPORT ResultReader
+{
+public:
+    /**
+     * Default constructor.
+     *
+     * Construct a reader with no file open.
+     */
+     ResultReader();
+
+    /**
+     * Destructor.
+     */
+     ~ResultReader();
+
+    /**
+     * Open the given file and read its header and index.
+     * @param fileName The name of the file.
+     * @return csim::CSIM_OK on success, otherwise error code.
+     */
+     int open(const std::string& fileName);
+
+     inline const std::vector<std::string>& columnIds() const
+     {
+         return mColumnIds;
+     }
+
+     inline int timeColumn() const
+     {
+         return mTimeColumn;
+     }
+
+    /**
+     * Get the index of the column with the given ID.
+     * @param columnId The ID of the column.
+     * @return The index of the column, or -1 if there is no such column.
+     */
+     int columnIndex(const std::string& columnId) const;
+
+    /**
+     * Get the total number of rows in the file.
+     * @return The number of rows.
+     */
+     uint64_t numberOfRows() const;
+
+    /**
+     * Read the given columns of every row whose time is within the given range, inclusive. Without a time column the
+     * time of each row is its row number.
+     * @param startTime The start of the range.
+     * @param endTime The end of the range.
+     * @param columns The indices of the columns to read.
+     * @param values Set to the values read, row after row, with the requested columns in each row.
+     * @return csim::CSIM_OK on success, otherwise error code.
+     */
+     int read(double startTime, double endTime, const std::vector<int>& columns, std::vector<double>& values);
+
+private:
+     ResultReader(const ResultReader&) = delete;
+     ResultReader& operator=(const ResultReader&) = delete;
+
+     int readChunkHeaders(int64_t start);
+
+     FILE* mFile;
+     int64_t mFileSize;
+     int mTimeColumn;
+     std::vector<std::string> mColumnIds;
+     std::vector<ColumnEncoding> mEncodings;
+     std::vector<uint64_t> mChunkOffsets;
+     std::vector<uint32_t> mChunkRows;
+     std::vector<double> mChunkTimes;
+};
+
+} // namespace csim
+
+#endif // CSIM_RESULT_FORMAT_H_
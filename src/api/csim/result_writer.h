@@ -0,0 +1,145 @@
+/*
+Copyright 2015 University of Auckland
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.Some license of other
+*/
+
+#ifndef CSIM_RESULT_WRITER_H_
+#define CSIM_RESULT_WRITER_H_
+
+#include "csim/csim_export.h"
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+//! Everything in CSim is in this namespace.
+namespace csim {
+
+/**
+ * A ResultSink is where a csim::ResultWriter sends the results of a simulation, e.g., a file. Sinks are always called
+ * from the writer's own thread, one block of results at a time.
+ */
+class CSIM_EXPORT ResultSink
+{
+public:
+     virtual ~ResultSink();
+
+    /**
+     * Write a block of results.
+     * @param values The results, stored row after row.
+     * @param numberOfRows The number of rows in the block.
+     * @param numberOfColumns The number of values in each row.
+     * @return csim::CSIM_OK on success, otherwise error code. Once a sink returns an error it is given no more
+     * results.
+     */
+     virtual int write(const double* values, int numberOfRows, int numberOfColumns) = 0;
+
+    /**
+     * Called once all of the results have been written.
+     * @return csim::CSIM_OK on success, otherwise error code.
+     */
+     virtual int finish();
+};
+
+/**
+ * A TextResultSink writes the results to a stream as text, one row per line with the values separated by tabs.
+ */
+class CSIM_EXPORT TextResultSink : public ResultSink
+{
+public:
+    /**
+     * Construct a text sink writing to the given stream, which must outlive the sink.
+     * @param stream The stream to write to.
+     * @param header If not empty, the column headings to write as the first line.
+     */
+     explicit TextResultSink(std::ostream& stream, const std::vector<std::string>& header = std::vector<std::string>());
+
+     int write(const double* values, int numberOfRows, int numberOfColumns) override;
+     int finish() override;
+
+private:
+     std::ostream& mStream;
+     std::vector<std::string> mHeader;
+};
+
+/**
+ * The ResultWriter class moves the writing of results off the thread running the simulation. The simulation fills
+ * rows of pre-allocated blocks, and each full block is handed to the writer's own thread through a lock-free queue.
+ * The writer thread passes the block to a csim::ResultSink and hands the empty block back to be filled again.
+ *
+ * The simulation only waits for the writer when every block is waiting to be written, so with enough blocks to ride
+ * out any bursts the simulation runs at the same speed whatever the sink, as long as the sink keeps up on average.
+ * The memory used is fixed by the size and number of blocks.
+ */
+class CSIM_EXPORT ResultWriter
+{
+public:
+    /**
+     * Default constructor.
+     *
+     * Construct a csim::ResultWriter which is not yet writing.
+     */
+     ResultWriter();
+
+    /**
+     * Destructor, which finishes writing any results.
+     */
+     ~ResultWriter();
+
+    /**
+     * Start writing results to the given sink, on a new thread.
+     * @param sink The sink to write the results to, which must outlive the writing.
+     * @param numberOfColumns The number of values in each row of results.
+     * @param rowsPerBlock The number of rows in each block handed to the sink.
+     * @param numberOfBlocks The number of blocks, at least two: one being filled while the other is written.
+     * @return csim::CSIM_OK on success, otherwise error code.
+     */
+     int start(ResultSink* sink, int numberOfColumns, int rowsPerBlock = 1024, int numberOfBlocks = 2);
+
+    /**
+     * Get the next row of results to fill in. The row is handed to the sink once it is filled and the next row is
+     * requested, or the writer is flushed.
+     * @return A pointer to the numberOfColumns values of the row, or NULL if the writer has not been started.
+     */
+     double* nextRow();
+
+    /**
+     * Add a row of results, copied from the given values.
+     * @param values The numberOfColumns values of the row.
+     * @return csim::CSIM_OK on success, otherwise error code.
+     */
+     int addRow(const double* values);
+
+    /**
+     * Hand all of the rows filled so far to the sink, and wait for them to be written.
+     * @return csim::CSIM_OK on success, otherwise the first error code given by the sink.
+     */
+     int flush();
+
+    /**
+     * Write all of the rows filled so far and stop the writer thread. The writer can then be started again.
+     * @return csim::CSIM_OK on success, otherwise the first error code given by the sink.
+     */
+     int finish();
+
+private:
+     ResultWriter(const ResultWriter&) = delete;
+     ResultWriter& operator=(const ResultWriter&) = delete;
+
+     void* mPipeline;
+};
+
+} // namespace csim
+
+#endif // CSIM_RESULT_WRITER_H_
@@ -0,0 +1,257 @@
+/*
+Copyright 2015 University of Auckland
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.Some license of other
+*/
+
+#ifndef CSIM_STATISTICS_H_
+#define CSIM_STATISTICS_H_
+
+#include "csim/csim_export.h"
+#include "csim/biomarkers.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//! Everything in CSim is in this namespace.
+namespace csim {
+
+/**
+ * The RunningStatistics class accumulates the mean, variance, minimum and maximum of a number of series of values
+ * sampled at the same times, along with the times of the minimum and maximum, without storing the values. The mean
+ * and variance are updated with Welford's algorithm, which stays accurate over any number of samples.
+ */
+class CSIM_EXPORT RunningStatistics
+{
+public:
+    /**
+     * Default constructor.
+     *
+     * Construct with no series.
+     */
+     RunningStatistics();
+
+    /**
+     * Clear the statistics and set the number of series.
+     * @param numberOfSeries The number of series.
+     */
+     void reset(int numberOfSeries);
+
+     inline int numberOfSeries() const
+     {
+         return int(mMean.size());
+     }
+
+    /**
+     * Add a sample of every series.
+     * @param time The time of the sample.
+     * @param values The value of each series.
+     */
+     void add(double time, const double* values);
+
+    /**
+     * Add a sample of a range of the series. Different ranges can be added from different threads at once.
+     * @param time The time of the sample.
+     * @param values The value of each series, indexed by series.
+     * @param first The first series of the range.
+     * @param last One past the last series of the range.
+     */
+     void add(double time, const double* values, int first, int last);
+
+     inline uint64_t count(int series) const
+     {
+         return mCount[series];
+     }
+
+     inline double mean(int series) const
+     {
+         return mMean[series];
+     }
+
+    /**
+     * Get the unbiased sample variance of a series.
+     * @param series The index of the series.
+     * @return The variance, or 0 with fewer than two samples.
+     */
+     inline double variance(int series) const
+     {
+         return (mCount[series] > 1) ? mM2[series] / double(mCount[series] - 1) : 0.0;
+     }
+
+     inline double minimum(int series) const
+     {
+         return mMinimum[series];
+     }
+
+     inline double maximum(int series) const
+     {
+         return mMaximum[series];
+     }
+
+    /**
+     * Get the time of the first sample at which a series reached its minimum.
+     * @param series The index of the series.
+     * @return The time of the minimum.
+     */
+     inline double timeOfMinimum(int series) const
+     {
+         return mTimeOfMinimum[series];
+     }
+
+    /**
+     * Get the time of the first sample at which a series reached its maximum, e.g., the time of the peak.
+     * @param series The index of the series.
+     * @return The time of the maximum.
+     */
+     inline double timeOfMaximum(int series) const
+     {
+         return mTimeOfMaximum[series];
+     }
+
+private:
+     std::vector<uint64_t> mCount;
+     std::vector<double> mMean, mM2, mMinimum, mMaximum, mTimeOfMinimum, mTimeOfMaximum;
+};
+
+/**
+ * The PopulationStatistics class holds the statistics of chosen variables of a csim::Population, reduced on the
+ * threads advancing the population as it is sampled by csim::Population::sample(), so the traces of the cells never
+ * need to be stored. For each variable there are two reductions:
+ *
+ *  - over time: the statistics of each cell's values over all of the samples, one series per cell;
+ *  - across cells: the mean, variance, minimum and maximum over the cells at each sample, one value per sample.
+ *
+ * The biomarkers of the beats of each cell can also be extracted from chosen variables, e.g., the action potential
+ * durations of the membrane potential.
+ */
+class CSIM_EXPORT PopulationStatistics
+{
+public:
+    /**
+     * Default constructor.
+     *
+     * Construct with no variables.
+     */
+     PopulationStatistics();
+
+    /**
+     * Add a variable to the statistics, clearing any statistics already accumulated.
+     * @param variableId The ID of the variable in the format 'component_name/variable_name'.
+     * @param variableType One of csim::StateType or csim::OutputType.
+     * @return The index of the variable in the statistics.
+     */
+     int addVariable(const std::string& variableId, unsigned char variableType);
+
+     inline int numberOfVariables() const
+     {
+         return int(mVariableIds.size());
+     }
+
+    /**
+     * Add a detector of the biomarkers of a variable, clearing any statistics already accumulated.
+     * @param variableId The ID of the variable in the format 'component_name/variable_name'.
+     * @param variableType One of csim::StateType or csim::OutputType.
+     * @param threshold The value the variable rises through at the upstroke of a beat.
+     * @return The index of the detector in the statistics.
+     */
+     int addBiomarkers(const std::string& variableId, unsigned char variableType, double threshold);
+
+     inline int numberOfBiomarkerDetectors() const
+     {
+         return int(mDetectors.size());
+     }
+
+    /**
+     * Clear the statistics accumulated, keeping the variables.
+     */
+     void reset();
+
+    /**
+     * Get the times of the samples.
+     * @return The time of each sample, in order.
+     */
+     inline const std::vector<double>& sampleTimes() const
+     {
+         return mSampleTimes;
+     }
+
+    /**
+     * Get the statistics of a variable over time, one series per cell.
+     * @param variable The index of the variable.
+     * @return The statistics of the variable.
+     */
+     const RunningStatistics& overTime(int variable) const;
+
+    /**
+     * Get the biomarkers detected for a variable, one series per cell.
+     * @param detector The index of the detector.
+     * @return The detector.
+     */
+     const BiomarkerDetector& biomarkers(int detector) const;
+
+    /**
+     * Get the mean of a variable across the cells at each sample.
+     * @param variable The index of the variable.
+     * @return A pointer to sampleTimes().size() values, or NULL if the index is not valid.
+     */
+     const double* ensembleMean(int variable) const;
+
+    /**
+     * Get the unbiased sample variance of a variable across the cells at each sample.
+     * @param variable The index of the variable.
+     * @return A pointer to sampleTimes().size() values, or NULL if the index is not valid.
+     */
+     const double* ensembleVariance(int variable) const;
+
+    /**
+     * Get the minimum of a variable across the cells at each sample.
+     * @param variable The index of the variable.
+     * @return A pointer to sampleTimes().size() values, or NULL if the index is not valid.
+     */
+     const double* ensembleMinimum(int variable) const;
+
+    /**
+     * Get the maximum of a variable across the cells at each sample.
+     * @param variable The index of the variable.
+     * @return A pointer to sampleTimes().size() values, or NULL if the index is not valid.
+     */
+     const double* ensembleMaximum(int variable) const;
+
+private:
+     friend class Population;
+
+     // the reduction of a range of cells at one sample
+     struct Partial
+     {
+         uint64_t count;
+         double mean, m2, minimum, maximum;
+     };
+
+     void reduce(int variable, double time, const double* values, int first, int last, Partial& partial);
+     void addSample(double time, const std::vector<Partial>& partials, int numberOfPartials);
+     const double* ensemble(int variable, int statistic) const;
+
+     std::vector<std::string> mVariableIds;
+     std::vector<unsigned char> mVariableTypes;
+     std::vector<RunningStatistics> mOverTime;
+     std::vector<double> mSampleTimes;
+     std::vector<std::vector<double> > mEnsemble;
+     std::vector<std::string> mDetectorIds;
+     std::vector<unsigned char> mDetectorTypes;
+     std::vector<BiomarkerDetector> mDetectors;
+};
+
+} // namespace csim
+
+#endif // CSIM_STATISTICS_H_
@@ -0,0 +1,129 @@
+/*
+Copyright 2015 University of Auckland
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.Some license of other
+*/
+
+#ifndef CSIM_STEADY_STATE_H_
+#define CSIM_STEADY_STATE_H_
+
+#include "csim/csim_export.h"
+#include "csim/executable_functions.h"
+
+#include <vector>
+
+//! Everything in CSim is in this namespace.
+namespace csim {
+
+/**
+ * What happened during the last solve of a csim::SteadyStateSolver.
+ */
+struct CSIM_EXPORT SteadyStateDiagnostics
+{
+    bool converged;           // whether the rates were brought within the tolerance
+    int newtonIterations;     // the number of damped Newton iterations taken
+    int pseudoTransientSteps; // the number of pseudo-transient continuation steps taken, including rejected steps
+    int modelEvaluations;     // the number of times the model function was called
+    double residualNorm;      // the largest absolute rate at the returned states
+    double stepNorm;          // the largest absolute change of a state in the last accepted iteration
+};
+
+/**
+ * The SteadyStateSolver class finds the states at which all of the rates of a model are zero, directly rather than
+ * by simulating until nothing changes.
+ *
+ * The solver starts with damped Newton iterations on the rates, using a Jacobian approximated by finite differences
+ * and halving each step until the rates decrease. Newton's method converges quickly close to a steady state but can
+ * fail from far away, so if a step can not be damped enough or the Jacobian is singular, the solver carries on with
+ * pseudo-transient continuation: implicit Euler steps in a pseudo-time, which follow the dynamics of the model
+ * towards a stable steady state while growing the steps as the rates fall, until they become Newton steps.
+ */
+class CSIM_EXPORT SteadyStateSolver
+{
+public:
+    /**
+     * Default constructor.
+     *
+     * Construct a solver with a tolerance of 1e-8, up to 50 Newton iterations and up to 1000 pseudo-transient
+     * steps starting from a pseudo-time step of 1e-3.
+     */
+     SteadyStateSolver();
+
+    /**
+     * Set the tolerance on the rates at a steady state.
+     * @param tolerance The largest absolute rate allowed.
+     * @return csim::CSIM_OK on success, otherwise error code.
+     */
+     int setTolerance(double tolerance);
+
+    /**
+     * Set the maximum number of iterations of each method.
+     * @param newtonIterations The maximum number of damped Newton iterations, zero to go straight to pseudo-transient
+     * continuation.
+     * @param pseudoTransientSteps The maximum number of pseudo-transient continuation steps, zero to only use Newton.
+     * @return csim::CSIM_OK on success, otherwise error code.
+     */
+     int setMaximumIterations(int newtonIterations, int pseudoTransientSteps);
+
+    /**
+     * Set the first pseudo-time step of the pseudo-transient continuation, which should be small enough to follow
+     * the fastest dynamics of the model.
+     * @param step The first pseudo-time step.
+     * @return csim::CSIM_OK on success, otherwise error code.
+     */
+     int setInitialPseudoTimeStep(double step);
+
+    /**
+     * Find a steady state of the given model, starting from the given states. The states are updated in place to
+     * the steady state found or, if the solver does not converge, to the states with the smallest rates found. The
+     * rates and outputs are those of the model at the returned states.
+     * @param model The model function.
+     * @param voi The value of the variable of integration at which to evaluate the model.
+     * @param numberOfStates The number of state variables.
+     * @param states The states of the model.
+     * @param rates The rates of the model.
+     * @param outputs The outputs of the model.
+     * @param inputs The inputs of the model.
+     * @return csim::CSIM_OK if a steady state was found, otherwise error code.
+     */
+     int solve(ModelFunction model, double voi, int numberOfStates, double* states, double* rates, double* outputs,
+               double* inputs);
+
+     inline const SteadyStateDiagnostics& diagnostics() const
+     {
+         return mDiagnostics;
+     }
+
+private:
+     double evaluate(const double* states, double* rates);
+     void jacobian(double* states, const double* rates);
+     bool factorise(bool requireRegular);
+     void backSubstitute(double* x) const;
+     void keepBest(const double* states, double norm);
+
+     ModelFunction mModel;
+     double mVoi;
+     double* mOutputs;
+     double* mInputs;
+     int mNumberOfStates;
+     double mTolerance, mInitialPseudoTimeStep;
+     int mMaximumNewtonIterations, mMaximumPseudoTransientSteps;
+     std::vector<double> mJacobian, mMatrix, mWork, mBest;
+     std::vector<int> mPivots;
+     double mBestNorm;
+     SteadyStateDiagnostics mDiagnostics;
+};
+
+} // namespace csim
+
+#endif // CSIM_STEADY_STATE_H_
@@ -29,15 +29,125 @@ CSIM_EXPORT int csim_getVariables(char** *outArray, int *outLength);
 // get the current value of all the outputs in the current model
 CSIM_EXPORT int csim_getValues(double* *outArray, int *outLength);
 
-// Not implemented.
+// find the steady state of the model from its current state, at the current value of the VOI,
+// updating the states in place. Damped Newton iterations are tried first, falling back to
+// pseudo-transient continuation if they fail. Fails if no steady state is found, leaving the
+// states with the smallest rates found.
 CSIM_EXPORT int csim_steadyState();
 
+// set the largest absolute rate allowed at a steady state (default 1e-8) and the maximum numbers of
+// Newton iterations (default 50) and pseudo-transient continuation steps (default 1000).
+CSIM_EXPORT int csim_setSteadyStateOptions(double tolerance, int maxNewtonIterations, int maxPseudoTransientSteps);
+
+// get the diagnostics of the last call to csim_steadyState: whether it converged (1 or 0), the
+// number of Newton iterations, the number of pseudo-transient steps, the number of evaluations of
+// the model, the largest absolute rate and the largest change of a state in the last iteration.
+CSIM_EXPORT int csim_getSteadyStateDiagnostics(double* *outArray, int *outLength);
+
+// find the periodic steady state of the model when paced with the given period, starting from its
+// current state, by pacing it beat by beat and then Newton shooting on the period map. Every period
+// is simulated from the current VOI in numSteps steps with the current integration method, for at
+// most maxBeats periods in all. The states are updated in place to those at the start of a period.
+CSIM_EXPORT int csim_limitCycle(double period, int numSteps, int maxBeats);
+
+// set the relative and absolute tolerances on the change of the states over a period (defaults
+// 1e-6 and 1e-8), the number of beats to pace before trying Newton shooting (default 5, 0 to only
+// pace) and the maximum number of extra periods simulated for each Newton step (default 20).
+CSIM_EXPORT int csim_setLimitCycleOptions(double relTol, double absTol, int pacedBeats, int krylovIterations);
+
+// get the diagnostics of the last call to csim_limitCycle: whether it converged (1 or 0), the
+// number of periods simulated in all, the number of those paced beat by beat, the number of Newton
+// iterations, the number of GMRES iterations and the change over the last period relative to the
+// tolerances.
+CSIM_EXPORT int csim_getLimitCycleDiagnostics(double* *outArray, int *outLength);
+
+// make the current state the one that csim_reset goes back to, e.g., after pre-pacing the model
+// with csim_limitCycle, so every experiment starts from the periodic steady state.
+CSIM_EXPORT int csim_checkpoint();
+
 // simulate the model over the given interval and return all the  data
 // each row of the matrix corresponds to getValues array.
 CSIM_EXPORT int csim_simulate(
         double initialTime, double startTime, double endTime, int numSteps,
         double** *outMatrix, int* outRows, int *outCols);
 
+// Called by csim_simulateStreaming with a block of numRows consecutive samples, stored row after row
+// with numCols values in each row in the same order as csim_getValues. The samples are only valid
+// during the call. Return 0 to carry on with the simulation or any other value to stop it.
+typedef int (*csim_SampleCallback)(const double* samples, int numRows, int numCols, void* userData);
+
+// simulate the model over the given interval like csim_simulate, but rather than returning all the
+// data pass the samples to the callback as they are produced, blockRows samples at a time (the last
+// block may be shorter). Only a single block of samples is held in memory, however long the
+// simulation.
+CSIM_EXPORT int csim_simulateStreaming(
+        double initialTime, double startTime, double endTime, int numSteps, int blockRows,
+        csim_SampleCallback callback, void* userData);
+
+// simulate the model over the given interval like csim_simulate, writing the data to the given
+// file as tab separated text, with a header line giving the variable IDs. The file is written on a
+// separate thread so the simulation does not wait for the disk.
+CSIM_EXPORT int csim_simulateToFile(
+        double initialTime, double startTime, double endTime, int numSteps, const char* fileName);
+
+// simulate the model over the given interval like csim_simulateToFile, writing the data to the
+// given file in the CSim compressed result format (see csim/result_format.h), with the variable of
+// integration as the first column, "time", followed by the variables in the order of
+// csim_getVariables. The columns are compressed on a separate thread.
+CSIM_EXPORT int csim_simulateToCompressedFile(
+        double initialTime, double startTime, double endTime, int numSteps, const char* fileName);
+
+// simulate the model over the given interval like csim_simulateToCompressedFile, writing the data
+// uncompressed to the given file in the CSim mapped result format (see csim/mapped_results.h). Other
+// programs can memory-map the file and use the data in place while the simulation is running.
+CSIM_EXPORT int csim_simulateToMappedFile(
+        double initialTime, double startTime, double endTime, int numSteps, const char* fileName);
+
+// simulate the model over the given interval like csim_simulate, but rather than returning all the
+// data return only its statistics, accumulated as the simulation runs. The matrix has a column for
+// each variable in the order of csim_getVariables, and six rows: the mean, the unbiased sample
+// variance, the minimum, the maximum, and the times of the minimum and of the maximum.
+CSIM_EXPORT int csim_simulateStatistics(
+        double initialTime, double startTime, double endTime, int numSteps,
+        double** *outMatrix, int* outRows, int *outCols);
+
+// detect the biomarkers of the beats of the given variable, e.g., the action potential durations
+// of the membrane potential, in every subsequent simulation. A beat starts when the variable rises
+// through the threshold and the biomarkers are extracted from the samples of the simulation as it
+// runs, so they are only as accurate as the number of steps allows.
+CSIM_EXPORT int csim_addBiomarkers(const char* variableId, double threshold);
+
+// stop detecting biomarkers for all variables.
+CSIM_EXPORT int csim_clearBiomarkers();
+
+// get the biomarkers of the last complete beat of the given variable in the last simulation: the
+// number of complete beats, the resting value, the peak, the maximum upstroke velocity, APD50,
+// APD90 and the cycle length. Values not known (e.g., the cycle length of the first beat) are NaN.
+CSIM_EXPORT int csim_getBiomarkers(const char* variableId, double* *outArray, int *outLength);
+
+// simulate the model over the given interval like csim_simulate, but only detect the biomarkers
+// without keeping any of the data.
+CSIM_EXPORT int csim_simulateBiomarkers(double initialTime, double startTime, double endTime, int numSteps);
+
+// stop every subsequent simulation early once the largest absolute rate has stayed at or below
+// rateTolerance for at least window (in units of the VOI), i.e., the model has settled to a steady
+// state, and, if stopOnNonFinite is not 0, as soon as a state is NaN or infinite. A rateTolerance of
+// 0 never stops on the rates. The criteria are checked at every step of the simulation, and the
+// simulation returns the samples up to and including the one at which it stopped.
+CSIM_EXPORT int csim_setTermination(double rateTolerance, double window, int stopOnNonFinite);
+
+// also stop every subsequent simulation as soon as the given variable is outside the given bounds,
+// replacing any bounds already set for the variable.
+CSIM_EXPORT int csim_setTerminationBounds(const char* variableId, double lowerBound, double upperBound);
+
+// remove all the termination criteria, so simulations always run to their end time.
+CSIM_EXPORT int csim_clearTermination();
+
+// get why the last simulation stopped: the reason (0 it reached its end time, 1 steady state, 2 a
+// state was not finite, 3 a variable was out of bounds, 4 the callback stopped it), the VOI at which
+// it stopped and the largest absolute rate at that time.
+CSIM_EXPORT int csim_getTermination(double* *outArray, int *outLength);
+
 // get the current value of the variable of integration (VOI, usually time)
 CSIM_EXPORT double csim_getVariableOfIntegration();
 
@@ -47,6 +157,11 @@ CSIM_EXPORT int csim_oneStep(double step);
 // Currently only using the maxSteps
 CSIM_EXPORT int csim_setTolerances(double aTol, double rTol, int maxSteps);
 
+// Select the integration method: "euler" (the default), "rush-larsen", which integrates gating
+// variables exactly and so allows much larger steps for models with Hodgkin-Huxley style gates, or
+// "runge-kutta" (fourth order, only available if the model was built without clang).
+CSIM_EXPORT int csim_setIntegrator(const char* method);
+
 CSIM_EXPORT int csim_sayHello(char* *outString, int *outLength);
 CSIM_EXPORT int csim_serialiseCellmlFromUrl(const char* url,
                                             char* *outString, int *outLength);
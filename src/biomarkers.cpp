@@ -0,0 +1,116 @@
+/*
+Copyright 2015 University of Auckland
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.Some license of other
+*/
+
+#include <algorithm>
+#include <limits>
+
+#include "csim/biomarkers.h"
+
+namespace csim {
+
+static const double NOT_KNOWN = std::numeric_limits<double>::quiet_NaN();
+
+// the time at which the line between two samples crosses the given level
+static double crossingTime(double time0, double value0, double time1, double value1, double level)
+{
+    return time0 + (level - value0) * (time1 - time0) / (value1 - value0);
+}
+
+BiomarkerDetector::BiomarkerDetector() : mThreshold(0.0)
+{
+}
+
+void BiomarkerDetector::reset(int numberOfSeries, double threshold)
+{
+    size_t size = size_t(std::max(numberOfSeries, 0));
+    mThreshold = threshold;
+    Beat beat;
+    beat.started = beat.inBeat = beat.repolarised50 = false;
+    beat.previousTime = beat.previousValue = beat.restingValue = beat.peak = 0.0;
+    beat.maximumUpstrokeVelocity = beat.apd50 = beat.upstrokeTime = 0.0;
+    beat.previousUpstrokeTime = NOT_KNOWN;
+    mBeats.assign(size, beat);
+    Biomarkers biomarkers;
+    biomarkers.numberOfBeats = 0;
+    biomarkers.restingValue = biomarkers.peak = biomarkers.maximumUpstrokeVelocity = NOT_KNOWN;
+    biomarkers.apd50 = biomarkers.apd90 = biomarkers.cycleLength = NOT_KNOWN;
+    mBiomarkers.assign(size, biomarkers);
+}
+
+void BiomarkerDetector::add(double time, const double* values)
+{
+    add(time, values, 0, numberOfSeries());
+}
+
+void BiomarkerDetector::add(double time, const double* values, int first, int last)
+{
+    for (int i = first; i < last; ++i)
+    {
+        Beat& beat = mBeats[i];
+        double value = values[i];
+        if (!beat.started)
+        {
+            beat.started = true;
+            beat.restingValue = value;
+        }
+        else if (!beat.inBeat)
+        {
+            if ((beat.previousValue < mThreshold) && (value >= mThreshold))
+            {
+                beat.inBeat = true;
+                beat.repolarised50 = false;
+                beat.upstrokeTime = crossingTime(beat.previousTime, beat.previousValue, time, value, mThreshold);
+                beat.peak = value;
+                beat.maximumUpstrokeVelocity = (value - beat.previousValue) / (time - beat.previousTime);
+            }
+            else beat.restingValue = std::min(beat.restingValue, value);
+        }
+        else
+        {
+            beat.maximumUpstrokeVelocity = std::max(beat.maximumUpstrokeVelocity,
+                                                    (value - beat.previousValue) / (time - beat.previousTime));
+            // the peak is settled once the beat is repolarising
+            if (!beat.repolarised50) beat.peak = std::max(beat.peak, value);
+            double amplitude = beat.peak - beat.restingValue;
+            double level50 = beat.peak - 0.5 * amplitude, level90 = beat.peak - 0.9 * amplitude;
+            if (!beat.repolarised50 && (beat.previousValue >= level50) && (value < level50))
+            {
+                beat.repolarised50 = true;
+                beat.apd50 = crossingTime(beat.previousTime, beat.previousValue, time, value, level50)
+                        - beat.upstrokeTime;
+            }
+            if (beat.repolarised50 && (beat.previousValue >= level90) && (value < level90))
+            {
+                Biomarkers& biomarkers = mBiomarkers[i];
+                ++biomarkers.numberOfBeats;
+                biomarkers.restingValue = beat.restingValue;
+                biomarkers.peak = beat.peak;
+                biomarkers.maximumUpstrokeVelocity = beat.maximumUpstrokeVelocity;
+                biomarkers.apd50 = beat.apd50;
+                biomarkers.apd90 = crossingTime(beat.previousTime, beat.previousValue, time, value, level90)
+                        - beat.upstrokeTime;
+                biomarkers.cycleLength = beat.upstrokeTime - beat.previousUpstrokeTime;
+                beat.previousUpstrokeTime = beat.upstrokeTime;
+                beat.inBeat = false;
+                beat.restingValue = value;
+            }
+        }
+        beat.previousTime = time;
+        beat.previousValue = value;
+    }
+}
+
+} // namespace csim
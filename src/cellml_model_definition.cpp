@@ -6,6 +6,10 @@
 #include <sstream>
 #include <string>
 #include <locale>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+#include <set>
 #ifdef CSIM_HAVE_STD_CODECVT
 #  include <codecvt>
 #else
@@ -24,6 +28,7 @@
 
 #include "csim/error_codes.h"
 #include "csim/variable_types.h"
+#include "code_analysis.h"
 
 /*
  * Prototype local methods
@@ -39,10 +44,32 @@ static ObjRef<iface::cellml_api::CellMLVariable> findLocalVariable(CellmlApiObje
 static std::string generateCodeForModel(CellmlApiObjects* capi,
                                         std::map<std::string, unsigned char>& variableTypes,
                                         std::map<std::string, std::map<unsigned char, int> >& variableIndices,
-                                        int numberOfInputs, int numberOfStates);
+                                        int numberOfInputs, int numberOfStates, int numberOfOutputs,
+                                        std::vector<LookupTable>& lookupTables,
+                                        int& numberOfGatingVariables, int& numberOfRemovedStatements,
+                                        csim::Precision precision, std::vector<CodeRoutine>& routines,
+                                        CodeRoutine& variablesRoutine,
+                                        std::map<std::string, int>& evaluationIndices, bool parallel,
+                                        ModelPartitions& partitions);
 typedef std::pair<std::string, std::string> CVpair;
 static CVpair splitName(const std::string& s);
-static std::string clearCodeAssignments(const std::string& s, const std::string& array, int count);
+static bool isKnownVariable(const std::string& target);
+static bool isKnownAssignment(const CodeStatement& statement);
+static CodeStatement copyAssignment(const std::string& target, const std::string& source, int index);
+static std::string generateLookupTables(iface::cellml_services::CodeInformation* cci,
+                                        std::vector<LookupTable>& lookupTables,
+                                        std::vector<CodeStatement>& statements);
+static CodeRoutine generateVariablesRoutine(iface::cellml_services::CodeInformation* cci,
+                                            const std::vector<CodeStatement>& initStatements,
+                                            const std::vector<CodeStatement>& statements, int numberOfConstants,
+                                            int numberOfAlgebraic, int numberOfStates, int numberOfOutputs,
+                                            std::map<std::string, int>& evaluationIndices);
+static CodeRoutine generateRushLarsenRoutine(const CodeRoutine& rhsRoutine,
+                                             const std::vector<CodeStatement>& statements, int numberOfStates,
+                                             int& numberOfGatingVariables);
+static std::string generateReducedPrecisionRoutines(const std::vector<CodeStatement>& body, int numberOfConstants,
+                                                    int numberOfAlgebraic, csim::Precision precision,
+                                                    int numberOfStates, int numberOfOutputs, int numberOfInputs);
 
 // need a method to uniquely identify variables by string, using the objid directly seemed
 // to give random overlaps. But separating out like this seems to have resolved the issue?
@@ -61,9 +88,14 @@ public:
     ObjRef<iface::cellml_services::CodeInformation> codeInformation;
 };
 
-CellmlModelDefinition::CellmlModelDefinition() : mUrl(""), mModelLoaded(false), mCapi(0)
+CellmlModelDefinition::CellmlModelDefinition() : mUrl(""), mModelLoaded(false), mCapi(0), mLookupTableError(0.0),
+    mNumberOfGatingVariables(0), mPrecisionError(0.0), mNumberOfRemovedStatements(0),
+    mNumberOfSpecialisedStatements(0),
+    mCompilerBackend(csim::ClangBackend)
 {
     mNumberOfIndependentVariables = 0;
+    mPartitions.numberOfConstants = 0;
+    mPartitions.numberOfAlgebraic = 0;
     mNumberOfInputVariables = 0;
     mNumberOfOutputVariables = 0;
     mStateCounter = 0;
@@ -293,17 +325,195 @@ int CellmlModelDefinition::getVariableIndex(const std::string& variableId, unsig
     return csim::MISMATCHED_COMPUTATION_TARGET;
 }
 
-int CellmlModelDefinition::instantiate(Compiler& compiler)
+int CellmlModelDefinition::setLookupTable(const std::string& variableId, double minimum, double maximum,
+                                          double step)
 {
+    if (! mCapi->codeInformation)
+    {
+        std::cerr << "CellML Model Definition::setLookupTable: missing model implementation?" << std::endl;
+        return csim::UNABLE_TO_FLAG_VARIABLE;
+    }
+    if (!(maximum > minimum) || !(step > 0.0))
+    {
+        std::cerr << "CellML Model Definition::setLookupTable: invalid range for lookup variable: "
+                  << variableId << std::endl;
+        return csim::INVALID_LOOKUP_TABLE_RANGE;
+    }
+    ObjRef<iface::cellml_api::CellMLVariable> sv = findLocalVariable(mCapi, variableId);
+    if (!sv)
+    {
+        std::cerr << "CellML Model Definition::setLookupTable: unable to find source variable for: "
+                  << variableId << std::endl;
+        return csim::UNABLE_TO_FLAG_VARIABLE;
+    }
+    LookupTable table;
+    table.variableId = getVariableUniqueId(sv);
+    table.minimum = minimum;
+    table.maximum = maximum;
+    table.step = step;
+    table.numberOfExpressions = 0;
+    mLookupTables.push_back(table);
+    return csim::CSIM_OK;
+}
+
+int CellmlModelDefinition::instantiate(Compiler& compiler, csim::Precision precision, csim::CompilerBackend backend,
+                                       bool parallel)
+{
+    std::vector<CodeRoutine> routines;
     std::string codeString = generateCodeForModel(mCapi, mVariableTypes, mVariableIndices,
                                                   mNumberOfInputVariables,
-                                                  mStateCounter);
+                                                  mStateCounter, mNumberOfOutputVariables, mLookupTables,
+                                                  mNumberOfGatingVariables, mNumberOfRemovedStatements,
+                                                  precision, routines, mVariablesRoutine, mEvaluationIndices,
+                                                  parallel, mPartitions);
     if (compiler.isVerbose())
     {
         std::cout << "Code string:\n***********************\n" << codeString << "\n#####################################\n"
                   << std::endl;
     }
-    return compiler.compileCodeString(codeString);
+    mRoutines = routines;
+    int code = csim::UNKNOWN_ERROR;
+    if ((backend == csim::IrBackend) && !routines.empty())
+    {
+        code = compiler.compileRoutines(routines);
+        if (code == csim::CSIM_OK) mCompilerBackend = csim::IrBackend;
+        else std::cerr << "CellML Model Definition::instantiate: unable to build the model directly, "
+                       << "falling back to the C code." << std::endl;
+    }
+    if (code != csim::CSIM_OK)
+    {
+        code = compiler.compileCodeString(codeString);
+        if (code != csim::CSIM_OK) return code;
+        mCompilerBackend = csim::ClangBackend;
+    }
+    if (mNumberOfRemovedStatements > 0)
+    {
+        std::cout << "Removed " << mNumberOfRemovedStatements
+                  << " statement(s) not required by the rates or outputs of the model" << std::endl;
+    }
+    // fill in the lookup tables now that we have the executable code.
+    int numberOfExpressions = 0;
+    for (const auto& table: mLookupTables) numberOfExpressions += table.numberOfExpressions;
+    if (numberOfExpressions > 0)
+    {
+        LookupTableFunction tableFunction = compiler.getLookupTableFunction();
+        if (! tableFunction) return csim::ERROR_GENERATING_CODE;
+        mLookupTableError = tableFunction();
+        std::cout << "Generated " << numberOfExpressions << " lookup table(s), maximum interpolation error: "
+                  << mLookupTableError << std::endl;
+    }
+    if (precision != csim::DoublePrecision)
+    {
+        PrecisionErrorFunction errorFunction = compiler.getPrecisionErrorFunction();
+        if (! errorFunction) return csim::ERROR_GENERATING_CODE;
+        mPrecisionError = errorFunction();
+        std::cout << "Maximum relative difference of the "
+                  << ((precision == csim::SinglePrecision) ? "single" : "mixed")
+                  << " precision model function from double precision: " << mPrecisionError << std::endl;
+    }
+    return csim::CSIM_OK;
+}
+
+int CellmlModelDefinition::getEvaluationIndex(const std::string& variableId)
+{
+    ObjRef<iface::cellml_api::CellMLVariable> sv = findLocalVariable(mCapi, variableId);
+    if (!sv)
+    {
+        std::cerr << "CellML Model Definition::getEvaluationIndex: unable to find source variable for: "
+                  << variableId << std::endl;
+        return csim::UNABLE_TO_FLAG_VARIABLE;
+    }
+    auto index = mEvaluationIndices.find(getVariableUniqueId(sv));
+    if (index == mEvaluationIndices.end()) return csim::NO_MATCHING_COMPUTATION_TARGET;
+    return index->second;
+}
+
+std::vector<double> CellmlModelDefinition::selectVariables(const std::vector<int>& indices) const
+{
+    const std::vector<CodeStatement>& statements = mVariablesRoutine.statements;
+    std::vector<double> selection(statements.size(), 0.0);
+    // the copies into the variables array are the last statements of the routine
+    int numberOfVariables = mEvaluationIndices.size();
+    size_t first = statements.size() - numberOfVariables;
+    std::set<std::string> required;
+    for (int index: indices)
+    {
+        if ((index < 0) || (index >= numberOfVariables))
+        {
+            std::cerr << "CellML Model Definition::selectVariables: invalid variable index: " << index << std::endl;
+            return std::vector<double>();
+        }
+        selection[first + index] = 1.0;
+        required.insert(statements[first + index].dependencies.begin(),
+                        statements[first + index].dependencies.end());
+    }
+    // statements are ordered so that variables are defined before they are used, as for removeUnusedStatements()
+    for (size_t i = first; i-- > 0;)
+    {
+        const CodeStatement& statement = statements[i];
+        // we can't tell what any code we were not able to parse depends on, so evaluate everything
+        if (!statement.expression) return std::vector<double>(statements.size(), 1.0);
+        if (required.count(statement.target))
+        {
+            selection[i] = 1.0;
+            required.insert(statement.dependencies.begin(), statement.dependencies.end());
+        }
+    }
+    return selection;
+}
+
+int CellmlModelDefinition::specialise(Compiler& compiler, const std::map<int, double>& inputValues)
+{
+    if (mRoutines.empty())
+    {
+        std::cerr << "CellML Model Definition::specialise: the model is only able to be specialised when it is built "
+                  << "directly, without lookup tables or reduced precision." << std::endl;
+        return csim::UNABLE_TO_SPECIALISE_MODEL;
+    }
+    std::map<std::string, double> values;
+    for (const auto& input: inputValues)
+    {
+        if ((input.first < 0) || (input.first >= mNumberOfInputVariables) || !std::isfinite(input.second))
+        {
+            std::cerr << "CellML Model Definition::specialise: invalid value for input " << input.first << std::endl;
+            return csim::UNABLE_TO_SPECIALISE_MODEL;
+        }
+        std::stringstream key;
+        key << "CSIM_INPUT[" << input.first << "]";
+        values[key.str()] = input.second;
+    }
+    std::vector<CodeRoutine> routines = mRoutines;
+    mNumberOfSpecialisedStatements = 0;
+    // the variables routine is left out as its statements need to stay in step with the selection arrays, and the
+    // partitions of the model function as they share arrays which can't be specialised independently
+    routines.erase(std::remove_if(routines.begin(), routines.end(), [](const CodeRoutine& routine) {
+        return (routine.name == "csim_variables_routine") || (routine.name.compare(0, 19, "csim_rhs_partition_") == 0);
+    }), routines.end());
+    for (auto& routine: routines)
+    {
+        // the initialise routine sets the fixed inputs to themselves, which is then folded into their fixed values
+        for (auto& statement: routine.statements)
+        {
+            if (values.count(statement.target))
+                statement.expression = parseCodeExpression(statement.target);
+        }
+        std::vector<std::string> localArrays;
+        for (const auto& array: routine.localArrays) localArrays.push_back(array.first);
+        int removed = specialiseStatements(routine.statements, values, localArrays);
+        if (removed < 0) return csim::UNABLE_TO_SPECIALISE_MODEL;
+        mNumberOfSpecialisedStatements += removed;
+    }
+    if (compiler.isVerbose())
+    {
+        std::cout << "Specialised code:\n***********************\n";
+        for (const auto& routine: routines) std::cout << routine.toString();
+        std::cout << "\n#####################################\n" << std::endl;
+    }
+    int code = compiler.compileRoutines(routines);
+    if (code != csim::CSIM_OK) return code;
+    std::cout << "Specialised the model on " << inputValues.size() << " input(s), removing "
+              << mNumberOfSpecialisedStatements << " statement(s)" << std::endl;
+    return csim::CSIM_OK;
 }
 
 std::wstring s2ws(const std::string& str)
@@ -508,7 +718,12 @@ CVpair splitName(const std::string& s)
 std::string generateCodeForModel(CellmlApiObjects* capi,
                                  std::map<std::string, unsigned char>& variableTypes,
                                  std::map<std::string, std::map<unsigned char, int> >& variableIndices,
-                                 int numberOfInputs, int numberOfStates)
+                                 int numberOfInputs, int numberOfStates, int numberOfOutputs,
+                                 std::vector<LookupTable>& lookupTables,
+                                 int& numberOfGatingVariables, int& numberOfRemovedStatements,
+                                 csim::Precision precision, std::vector<CodeRoutine>& routines,
+                                 CodeRoutine& variablesRoutine, std::map<std::string, int>& evaluationIndices,
+                                 bool parallel, ModelPartitions& partitions)
 {
     std::stringstream code;
     std::string codeString;
@@ -634,33 +849,46 @@ std::string generateCodeForModel(CellmlApiObjects* capi,
         int nAlgebraic = cci->algebraicIndexCount();
         int nConstants = cci->constantIndexCount();
 
-        code << "\n\nvoid csim_rhs_routine(double VOI, double* CSIM_STATE, double* CSIM_RATE, double* CSIM_OUTPUT, "
-             << "double* CSIM_INPUT)\n{\n\n"
-             << "double DUMMY_ASSIGNMENT;\n"
-             << "double CONSTANTS["
-             << nConstants
-             << "], ALGEBRAIC["
-             << nAlgebraic
-             << "];\n\n";
+        // the lookup table and gating variable passes need to work on the individual statements of the model
+        std::string rhsCode = ws2s(cci->ratesString()) + ws2s(cci->variablesString());
+        std::vector<CodeStatement> statements = parseCodeStatements(rhsCode);
+        // algebraic variables which are not needed to compute the rates or outputs can simply be left out
+        numberOfRemovedStatements = removeUnusedStatements(statements, "ALGEBRAIC");
+        if (lookupTables.size() > 0)
+        {
+            code << generateLookupTables(cci, lookupTables, statements);
+        }
+        if ((numberOfRemovedStatements > 0) || (lookupTables.size() > 0))
+        {
+            rhsCode.clear();
+            for (const auto& statement: statements) rhsCode += statement.toString();
+        }
 
         /* initConsts - all variables which aren't state variables but have
          *              an initial_value attribute, and any variables & rates
          *              which follow.
          */
-        code << ws2s(cci->initConstsString());
-
-        /* rates      - All rates which are not static.
-         */
-        code << ws2s(cci->ratesString());
+        std::vector<CodeStatement> initStatements = parseCodeStatements(ws2s(cci->initConstsString()));
 
-        /* variables  - All variables not computed by initConsts or rates
+        /* The body of the model function is made up of the initConsts statements, followed by the
+         * rates      - All rates which are not static.
+         * variables  - All variables not computed by initConsts or rates
          *  (i.e., these are not required for the integration of the model and
          *   thus only need to be called for output or presentation or similar
          *   purposes)
+         * and then the setting of any outputs that are not already defined. The states and inputs are known
+         * when evaluating the model function, so any assignments to them are left out.
          */
-        code << ws2s(cci->variablesString());
-
-        // add in the setting of any outputs that are not already defined
+        std::vector<CodeStatement> body;
+        body.reserve(initStatements.size() + statements.size());
+        for (const auto& statement: initStatements)
+        {
+            if (!isKnownAssignment(statement)) body.push_back(statement);
+        }
+        for (const auto& statement: statements)
+        {
+            if (!isKnownAssignment(statement)) body.push_back(statement);
+        }
         for (unsigned int i=0; i < capi->cevas->length(); i++)
         {
             ObjRef<iface::cellml_services::ConnectedVariableSet> cvs = capi->cevas->getVariableSet(i);
@@ -672,39 +900,95 @@ std::string generateCodeForModel(CellmlApiObjects* capi,
                 unsigned char vType = typeit->second;
                 if (vType & csim::OutputType)
                 {
+                    std::stringstream output;
+                    output << "CSIM_OUTPUT[" << variableIndices[currentId][csim::OutputType] << "]";
                     if (vType & csim::StateType)
-                        code << "CSIM_OUTPUT[" << variableIndices[currentId][csim::OutputType]
-                                << "] = CSIM_STATE[" << variableIndices[currentId][csim::StateType]
-                                   << "];\n";
+                        body.push_back(copyAssignment(output.str(), "CSIM_STATE",
+                                                      variableIndices[currentId][csim::StateType]));
                     else if (vType & csim::InputType)
-                        code << "CSIM_OUTPUT[" << variableIndices[currentId][csim::OutputType]
-                                << "] = CSIM_INPUT[" << variableIndices[currentId][csim::InputType]
-                                   << "];\n";
+                        body.push_back(copyAssignment(output.str(), "CSIM_INPUT",
+                                                      variableIndices[currentId][csim::InputType]));
                     else if (vType & csim::IndependentType)
-                        code << "CSIM_OUTPUT[" << variableIndices[currentId][csim::OutputType]
-                                << "] = VOI;\n";
+                        body.push_back(copyAssignment(output.str(), "VOI", -1));
                 }
             }
         }
 
-        // close the subroutine
-        code << "\n\n}//csim_rhs_routine()\n\n";
+        // in mixed precision the reduced precision routine takes over the name of the model function
+        CodeRoutine rhsRoutine;
+        rhsRoutine.name = (precision == csim::MixedPrecision) ? "csim_rhs_routine_double" : "csim_rhs_routine";
+        rhsRoutine.arguments = {
+            std::make_pair("VOI", false), std::make_pair("CSIM_STATE", true), std::make_pair("CSIM_RATE", true),
+            std::make_pair("CSIM_OUTPUT", true), std::make_pair("CSIM_INPUT", true)
+        };
+        rhsRoutine.localArrays = { std::make_pair("CONSTANTS", nConstants), std::make_pair("ALGEBRAIC", nAlgebraic) };
+        rhsRoutine.statements = body;
+        code << rhsRoutine.toString();
+        bool reducedPrecision = (precision != csim::DoublePrecision);
+        if (reducedPrecision)
+            code << generateReducedPrecisionRoutines(body, nConstants, nAlgebraic, precision, numberOfStates,
+                                                     numberOfOutputs, numberOfInputs);
 
-        // and now clear out initialisation of state variables and known variables from
-        // the RHS routine.
-        codeString = clearCodeAssignments(code.str(), "CSIM_STATE", numberOfStates);
-        codeString = clearCodeAssignments(codeString, "CSIM_INPUT", numberOfInputs);
+        // to evaluate the model function in parallel it is split into partitions which share the model's constants and
+        // algebraic variables, each partition having a few hundred operations to keep the scheduling overhead small
+        std::vector<CodeRoutine> partitionRoutines;
+        partitions.partitions.clear();
+        partitions.numberOfConstants = nConstants;
+        partitions.numberOfAlgebraic = nAlgebraic;
+        if (parallel && !reducedPrecision)
+        {
+            partitions.partitions = partitionStatements(body, 256);
+            for (size_t p = 0; p < partitions.partitions.size(); ++p)
+            {
+                CodeRoutine routine;
+                routine.name = "csim_rhs_partition_" + std::to_string(p);
+                routine.arguments = rhsRoutine.arguments;
+                routine.arguments.push_back(std::make_pair("CONSTANTS", true));
+                routine.arguments.push_back(std::make_pair("ALGEBRAIC", true));
+                for (int i: partitions.partitions[p].statements) routine.statements.push_back(body[i]);
+                code << routine.toString();
+                partitionRoutines.push_back(routine);
+            }
+        }
+
+        // the Rush-Larsen step routine evaluates the same RHS and then updates the states
+        CodeRoutine rushLarsenRoutine = generateRushLarsenRoutine(rhsRoutine, statements, numberOfStates,
+                                                                  numberOfGatingVariables);
+        code << rushLarsenRoutine.toString();
 
         // and finally create the initialisation routine
-        std::stringstream initRoutine;
-        initRoutine << "\nvoid csim_initialise_routine(double* CSIM_STATE, double* CSIM_OUTPUT, double* CSIM_INPUT)\n{\n";
-        // FIXME: this doesn't need to be in the interface?
-        initRoutine << "double CSIM_RATES[" << numberOfStates << "];\n";
-        initRoutine << "double CONSTANTS[" << nConstants << "];\n";
-        initRoutine << ws2s(cci->initConstsString());
-        initRoutine << "\n}\n";
+        CodeRoutine initRoutine;
+        initRoutine.name = "csim_initialise_routine";
+        initRoutine.arguments = {
+            std::make_pair("CSIM_STATE", true), std::make_pair("CSIM_OUTPUT", true), std::make_pair("CSIM_INPUT", true)
+        };
+        initRoutine.localArrays = { std::make_pair("CONSTANTS", nConstants) };
+        initRoutine.statements = initStatements;
+        code << initRoutine.toString();
 
-        codeString += initRoutine.str();
+        // the variables routine needs every statement, not just those required by the rates and outputs
+        variablesRoutine = generateVariablesRoutine(cci, initStatements,
+                                                    parseCodeStatements(ws2s(cci->ratesString())
+                                                                        + ws2s(cci->variablesString())),
+                                                    nConstants, nAlgebraic, numberOfStates, numberOfOutputs,
+                                                    evaluationIndices);
+        code << variablesRoutine.toString();
+        codeString = code.str();
+
+        // the routines can be built directly into executable code if there is no other code needed to support them
+        int numberOfTabulatedExpressions = 0;
+        for (const auto& table: lookupTables) numberOfTabulatedExpressions += table.numberOfExpressions;
+        routines.clear();
+        if (frag.empty() && (numberOfTabulatedExpressions == 0) && !reducedPrecision
+                && rhsRoutine.isStructured() && rushLarsenRoutine.isStructured() && initRoutine.isStructured()
+                && variablesRoutine.isStructured())
+        {
+            routines.push_back(rhsRoutine);
+            routines.push_back(rushLarsenRoutine);
+            routines.push_back(initRoutine);
+            routines.push_back(variablesRoutine);
+            routines.insert(routines.end(), partitionRoutines.begin(), partitionRoutines.end());
+        }
     }
     catch (...)
     {
@@ -714,20 +998,498 @@ std::string generateCodeForModel(CellmlApiObjects* capi,
     return codeString;
 }
 
-std::string clearCodeAssignments(const std::string& s, const std::string& array, int count)
+bool isKnownVariable(const std::string& target)
+{
+    return (target.compare(0, 11, "CSIM_STATE[") == 0) || (target.compare(0, 11, "CSIM_INPUT[") == 0);
+}
+
+bool isKnownAssignment(const CodeStatement& statement)
+{
+    if (!statement.target.empty()) return isKnownVariable(statement.target);
+    // the statement couldn't be parsed, so look for the assignment in its code
+    size_t start = statement.code.find_first_not_of(" \t\r\n");
+    if ((start == std::string::npos) || !isKnownVariable(statement.code.substr(start))) return false;
+    size_t close = statement.code.find(']', start);
+    size_t equals = (close == std::string::npos) ? close : statement.code.find_first_not_of(" \t", close + 1);
+    return (equals != std::string::npos) && (statement.code[equals] == '=')
+            && (statement.code.compare(equals, 2, "==") != 0);
+}
+
+CodeStatement copyAssignment(const std::string& target, const std::string& source, int index)
 {
-    std::string code(s);
-    for (int i=0; i < count; i++)
+    CodeStatement statement;
+    statement.target = target;
+    statement.expression = std::make_shared<CodeExpression>(
+                (index < 0) ? CodeExpression::Identifier : CodeExpression::Reference, source, index);
+    statement.dependencies.insert(statement.expression->key());
+    statement.code = target + " = " + statement.expression->toString() + ";";
+    return statement;
+}
+
+static std::string formatDouble(double value)
+{
+    std::stringstream s;
+    s.precision(17);
+    s << value;
+    std::string str = s.str();
+    // make sure this is always a floating point literal
+    if (str.find_first_of(".e") == std::string::npos) str += ".0";
+    return str;
+}
+
+static bool containsFunctionCall(const CodeExpressionPtr& expression)
+{
+    if (expression->type == CodeExpression::Call) return true;
+    for (const auto& a: expression->arguments)
     {
-        std::stringstream search;
-        search << array;
-        search << "[" << i << "]";
-        std::string r("DUMMY_ASSIGNMENT /*");
-        r += search.str();
-        search << " = ";
-        r += "*/ = ";
-        if (code.find(search.str()) != std::string::npos)
-            code.replace(code.find(search.str()), search.str().size(), r);
+        if (containsFunctionCall(a)) return true;
     }
-    return code;
+    return false;
+}
+
+/*
+ * Replace the largest sub-expressions of the given expression which depend only on the lookup variable and fixed
+ * constants with an interpolated lookup into a table. Identical expressions share the same table.
+ */
+static CodeExpressionPtr tabulateExpression(const CodeExpressionPtr& expression, const std::string& variable,
+                                            const LookupTable& table, const std::set<std::string>& fixedConstants,
+                                            std::map<std::string, int>& tableIndices,
+                                            std::vector<CodeExpressionPtr>& tabulated)
+{
+    std::set<std::string> dependencies;
+    collectDependencies(expression, dependencies);
+    bool tabulate = (dependencies.count(variable) > 0) && containsFunctionCall(expression);
+    for (const auto& d: dependencies)
+    {
+        if ((d != variable) && (fixedConstants.count(d) == 0)) tabulate = false;
+    }
+    if (!tabulate)
+    {
+        CodeExpressionPtr e = std::make_shared<CodeExpression>(expression->type, expression->value,
+                                                               expression->index);
+        for (const auto& a: expression->arguments)
+            e->arguments.push_back(tabulateExpression(a, variable, table, fixedConstants, tableIndices, tabulated));
+        return e;
+    }
+    std::string exact = expression->toString();
+    int index;
+    if (tableIndices.count(exact)) index = tableIndices[exact];
+    else
+    {
+        index = tabulated.size();
+        tableIndices[exact] = index;
+        tabulated.push_back(expression);
+    }
+    // values outside of the table range fall back to the exact expression
+    std::stringstream lookup;
+    lookup << "((" << variable << " >= " << formatDouble(table.minimum) << ") && (" << variable << " < "
+           << formatDouble(table.maximum) << ") ? csim_lookup_interpolate(CSIM_LOOKUP_TABLE_" << index << ", "
+           << variable << ", " << formatDouble(table.minimum) << ", " << formatDouble(1.0 / table.step) << ") : "
+           << exact << ")";
+    return parseCodeExpression(lookup.str());
+}
+
+std::string generateLookupTables(iface::cellml_services::CodeInformation* cci,
+                                 std::vector<LookupTable>& lookupTables,
+                                 std::vector<CodeStatement>& statements)
+{
+    // constants which do not depend on any inputs will never change, so can be used in tabulated expressions
+    std::set<std::string> fixedConstants;
+    std::vector<CodeStatement> fixedStatements;
+    std::vector<CodeStatement> initStatements = parseCodeStatements(ws2s(cci->initConstsString()));
+    for (const auto& statement: initStatements)
+    {
+        if (statement.target.compare(0, 10, "CONSTANTS[") != 0) continue;
+        bool fixed = true;
+        for (const auto& d: statement.dependencies)
+        {
+            if (fixedConstants.count(d) == 0) fixed = false;
+        }
+        if (fixed)
+        {
+            fixedConstants.insert(statement.target);
+            fixedStatements.push_back(statement);
+        }
+    }
+
+    std::map<std::string, int> tableIndices;
+    std::vector<CodeExpressionPtr> tabulated;
+    std::vector<std::pair<int, int> > tableRanges; // the tabulated expressions belonging to each lookup table
+    std::vector<std::string> variables;
+    for (auto& table: lookupTables)
+    {
+        // snap the maximum so that the range is a whole number of steps
+        int nIntervals = int(std::ceil((table.maximum - table.minimum) / table.step - 1.0e-9));
+        table.maximum = table.minimum + nIntervals * table.step;
+        std::string variable;
+        ObjRef<iface::cellml_services::ComputationTargetIterator> cti = cci->iterateTargets();
+        while (true)
+        {
+            ObjRef<iface::cellml_services::ComputationTarget> ct = cti->nextComputationTarget();
+            if (ct == NULL) break;
+            if (ct->degree() > 0) continue;
+            ObjRef<iface::cellml_api::CellMLVariable> v(ct->variable());
+            if (getVariableUniqueId(v) == table.variableId)
+            {
+                variable = ws2s(ct->name());
+                break;
+            }
+        }
+        variables.push_back(variable);
+        int first = tabulated.size();
+        if (!variable.empty())
+        {
+            // each lookup variable gets its own set of tables
+            tableIndices.clear();
+            for (auto& statement: statements)
+            {
+                if (!statement.expression) continue;
+                statement.expression = tabulateExpression(statement.expression, variable, table, fixedConstants,
+                                                          tableIndices, tabulated);
+            }
+        }
+        table.numberOfExpressions = tabulated.size() - first;
+        tableRanges.push_back(std::make_pair(first, int(tabulated.size())));
+    }
+    if (tabulated.empty()) return "";
+
+    std::stringstream code;
+    code << "\nstatic double csim_lookup_interpolate(const double* table, double value, double minimum, "
+         << "double inverseStep)\n{\n"
+         << "double position = (value - minimum) * inverseStep;\n"
+         << "int i = (int)position;\n"
+         << "return table[i] + (position - i) * (table[i+1] - table[i]);\n}\n\n";
+    for (size_t t = 0; t < lookupTables.size(); ++t)
+    {
+        const LookupTable& table = lookupTables[t];
+        int nPoints = int((table.maximum - table.minimum) / table.step + 0.5) + 1;
+        // an extra point beyond the maximum guards against round-off at the top of the range
+        for (int i = tableRanges[t].first; i < tableRanges[t].second; ++i)
+            code << "static double CSIM_LOOKUP_TABLE_" << i << "[" << nPoints + 1 << "];\n";
+    }
+    // the table routine fills in the tables and returns the maximum interpolation error
+    code << "\ndouble csim_lookup_table_routine()\n{\n"
+         << "double CONSTANTS[" << cci->constantIndexCount() << "];\n"
+         << "double CSIM_LOOKUP_VALUE, CSIM_LOOKUP_DIFFERENCE, CSIM_LOOKUP_ERROR = 0.0;\n"
+         << "int i;\n";
+    for (const auto& statement: fixedStatements) code << statement.toString();
+    for (size_t t = 0; t < lookupTables.size(); ++t)
+    {
+        if (tableRanges[t].first == tableRanges[t].second) continue;
+        const LookupTable& table = lookupTables[t];
+        CodeExpressionPtr value = parseCodeExpression("CSIM_LOOKUP_VALUE");
+        int nPoints = int((table.maximum - table.minimum) / table.step + 0.5) + 1;
+        code << "for (i = 0; i <= " << nPoints << "; ++i)\n{\n"
+             << "CSIM_LOOKUP_VALUE = " << formatDouble(table.minimum) << " + i * " << formatDouble(table.step)
+             << ";\n";
+        for (int i = tableRanges[t].first; i < tableRanges[t].second; ++i)
+        {
+            code << "CSIM_LOOKUP_TABLE_" << i << "[i] = "
+                 << substituteReference(tabulated[i], variables[t], value)->toString() << ";\n";
+        }
+        code << "}\n";
+        // check the interpolation at the mid-point of each interval
+        code << "for (i = 0; i < " << nPoints - 1 << "; ++i)\n{\n"
+             << "CSIM_LOOKUP_VALUE = " << formatDouble(table.minimum) << " + (i + 0.5) * "
+             << formatDouble(table.step) << ";\n";
+        for (int i = tableRanges[t].first; i < tableRanges[t].second; ++i)
+        {
+            code << "CSIM_LOOKUP_DIFFERENCE = fabs(csim_lookup_interpolate(CSIM_LOOKUP_TABLE_" << i
+                 << ", CSIM_LOOKUP_VALUE, " << formatDouble(table.minimum) << ", " << formatDouble(1.0 / table.step)
+                 << ") - " << substituteReference(tabulated[i], variables[t], value)->toString() << ");\n"
+                 << "if (CSIM_LOOKUP_DIFFERENCE > CSIM_LOOKUP_ERROR) CSIM_LOOKUP_ERROR = CSIM_LOOKUP_DIFFERENCE;\n";
+        }
+        code << "}\n";
+    }
+    code << "return CSIM_LOOKUP_ERROR;\n}\n";
+    return code.str();
+}
+
+CodeRoutine generateVariablesRoutine(iface::cellml_services::CodeInformation* cci,
+                                     const std::vector<CodeStatement>& initStatements,
+                                     const std::vector<CodeStatement>& statements, int numberOfConstants,
+                                     int numberOfAlgebraic, int numberOfStates, int numberOfOutputs,
+                                     std::map<std::string, int>& evaluationIndices)
+{
+    CodeRoutine routine;
+    routine.name = "csim_variables_routine";
+    routine.arguments = {
+        std::make_pair("VOI", false), std::make_pair("CSIM_STATE", true), std::make_pair("CSIM_INPUT", true),
+        std::make_pair("CSIM_VARIABLE", true), std::make_pair("CSIM_SELECTION", true)
+    };
+    // the rates and outputs are only intermediate values here
+    routine.localArrays = {
+        std::make_pair("CONSTANTS", numberOfConstants), std::make_pair("ALGEBRAIC", numberOfAlgebraic),
+        std::make_pair("CSIM_RATE", numberOfStates), std::make_pair("CSIM_OUTPUT", numberOfOutputs)
+    };
+    for (const auto& statement: initStatements)
+    {
+        if (!isKnownAssignment(statement)) routine.statements.push_back(statement);
+    }
+    for (const auto& statement: statements)
+    {
+        if (!isKnownAssignment(statement)) routine.statements.push_back(statement);
+    }
+    // then copy each variable of the model into its place in the variables array
+    evaluationIndices.clear();
+    ObjRef<iface::cellml_services::ComputationTargetIterator> cti = cci->iterateTargets();
+    while (true)
+    {
+        ObjRef<iface::cellml_services::ComputationTarget> ct = cti->nextComputationTarget();
+        if (ct == NULL) break;
+        if ((ct->degree() > 0) || (ct->type() == iface::cellml_services::LOCALLY_BOUND)) continue;
+        ObjRef<iface::cellml_api::CellMLVariable> v(ct->variable());
+        std::string id = getVariableUniqueId(v);
+        if (evaluationIndices.count(id)) continue;
+        CodeExpressionPtr source = (ct->type() == iface::cellml_services::VARIABLE_OF_INTEGRATION)
+                ? parseCodeExpression("VOI") : parseCodeExpression(ws2s(ct->name()));
+        if (!source || source->key().empty())
+        {
+            std::cerr << "CellML Model Definition::generateVariablesRoutine: unable to evaluate variable: " << id
+                      << std::endl;
+            continue;
+        }
+        int index = evaluationIndices.size();
+        evaluationIndices[id] = index;
+        std::stringstream target;
+        target << "CSIM_VARIABLE[" << index << "]";
+        routine.statements.push_back(copyAssignment(target.str(), source->value, source->index));
+    }
+    // and only evaluate the statements needed for the selected variables
+    for (size_t i = 0; i < routine.statements.size(); ++i)
+    {
+        CodeStatement& statement = routine.statements[i];
+        if (!statement.expression) continue;
+        statement.condition = std::make_shared<CodeExpression>(CodeExpression::Reference, "CSIM_SELECTION", i);
+        statement.dependencies.insert(statement.condition->key());
+        statement.code = statement.toString();
+        statement.code.erase(statement.code.size() - 1);
+    }
+    return routine;
+}
+
+CodeRoutine generateRushLarsenRoutine(const CodeRoutine& rhsRoutine, const std::vector<CodeStatement>& statements,
+                                      int numberOfStates, int& numberOfGatingVariables)
+{
+    std::map<std::string, CodeExpressionPtr> definitions;
+    for (const auto& statement: statements)
+    {
+        if (statement.expression) definitions[statement.target] = statement.expression;
+    }
+    // gating variables are those whose rate is linear in the variable itself, dy/dt = A + B*y, which we can
+    // integrate exactly over a step assuming A and B are constant: y += (dy/dt) / B * (exp(B*dt) - 1)
+    std::vector<std::string> coefficients(numberOfStates);
+    numberOfGatingVariables = 0;
+    for (int i = 0; i < numberOfStates; ++i)
+    {
+        std::stringstream state, rate;
+        state << "CSIM_STATE[" << i << "]";
+        rate << "CSIM_RATE[" << i << "]";
+        auto d = definitions.find(rate.str());
+        if (d == definitions.end()) continue;
+        CodeExpressionPtr c = linearCoefficient(d->second, state.str(), definitions);
+        if (!c || ((c->type == CodeExpression::Number) && (std::atof(c->value.c_str()) == 0.0))) continue;
+        coefficients[i] = c->toString();
+        numberOfGatingVariables++;
+    }
+    CodeRoutine routine;
+    routine.name = "csim_rush_larsen_routine";
+    routine.arguments = rhsRoutine.arguments;
+    routine.arguments.insert(routine.arguments.begin() + 1, std::make_pair("CSIM_STEP", false));
+    routine.localArrays = rhsRoutine.localArrays;
+    if (numberOfGatingVariables > 0)
+        routine.localArrays.push_back(std::make_pair("CSIM_GATE_COEFFICIENT", numberOfStates));
+    routine.statements = rhsRoutine.statements;
+    std::stringstream code;
+    // make sure all the coefficients are evaluated before any states are updated
+    for (int i = 0; i < numberOfStates; ++i)
+    {
+        if (!coefficients[i].empty())
+            code << "CSIM_GATE_COEFFICIENT[" << i << "] = " << coefficients[i] << ";\n";
+    }
+    for (int i = 0; i < numberOfStates; ++i)
+    {
+        if (coefficients[i].empty())
+            code << "CSIM_STATE[" << i << "] = CSIM_STATE[" << i << "] + CSIM_RATE[" << i << "] * CSIM_STEP;\n";
+        else
+            code << "CSIM_STATE[" << i << "] = CSIM_STATE[" << i << "] + ((fabs(CSIM_GATE_COEFFICIENT[" << i
+                 << "]) > 1.0e-12) ? CSIM_RATE[" << i << "] / CSIM_GATE_COEFFICIENT[" << i
+                 << "] * (exp(CSIM_GATE_COEFFICIENT[" << i << "] * CSIM_STEP) - 1.0) : CSIM_RATE[" << i
+                 << "] * CSIM_STEP);\n";
+    }
+    std::vector<CodeStatement> updates = parseCodeStatements(code.str());
+    routine.statements.insert(routine.statements.end(), updates.begin(), updates.end());
+    return routine;
+}
+
+static bool isSinglePrecisionFunction(const std::string& name)
+{
+    static const std::set<std::string> functions = {
+        "fabs", "acos", "acosh", "asin", "asinh", "atan", "atanh", "ceil", "cos", "cosh", "tan", "tanh", "sin",
+        "sinh", "exp", "floor", "pow", "log", "log10", "sqrt"
+    };
+    return functions.count(name) > 0;
+}
+
+/*
+ * Convert the given expression to be evaluated in single precision: literals become float literals and math
+ * library calls use their float versions. When casting the interface arrays (mixed precision), references to the
+ * double precision state, input and output arrays and the variable of integration are cast to float.
+ */
+static CodeExpressionPtr singlePrecisionExpression(const CodeExpressionPtr& expression, bool castInterface)
+{
+    CodeExpressionPtr e = std::make_shared<CodeExpression>(expression->type, expression->value, expression->index);
+    if (expression->type == CodeExpression::Number)
+    {
+        if (e->value.find_first_of(".eE") == std::string::npos) e->value += ".0";
+        e->value += "f";
+        return e;
+    }
+    if (castInterface && (((expression->type == CodeExpression::Reference)
+                           && (expression->value.compare(0, 5, "CSIM_") == 0))
+                          || ((expression->type == CodeExpression::Identifier) && (expression->value == "VOI"))))
+    {
+        CodeExpressionPtr cast = std::make_shared<CodeExpression>(CodeExpression::Unary, "(float)");
+        cast->arguments.push_back(e);
+        return cast;
+    }
+    size_t first = 0;
+    if (expression->type == CodeExpression::Call)
+    {
+        if (isSinglePrecisionFunction(expression->value)) e->value += "f";
+        else if ((expression->value == "gcd_multi") || (expression->value == "lcm_multi")
+                 || (expression->value == "multi_min") || (expression->value == "multi_max"))
+        {
+            // the first argument of the variadic functions is the number of arguments
+            if (!expression->arguments.empty()) e->arguments.push_back(copyCodeExpression(expression->arguments[0]));
+            first = 1;
+        }
+    }
+    for (size_t i = first; i < expression->arguments.size(); ++i)
+        e->arguments.push_back(singlePrecisionExpression(expression->arguments[i], castInterface));
+    return e;
+}
+
+std::string generateReducedPrecisionRoutines(const std::vector<CodeStatement>& body, int numberOfConstants,
+                                             int numberOfAlgebraic, csim::Precision precision,
+                                             int numberOfStates, int numberOfOutputs, int numberOfInputs)
+{
+    bool mixed = (precision == csim::MixedPrecision);
+    // the arrays in the generated routines need at least one entry to be valid C
+    int nStates = (numberOfStates > 0) ? numberOfStates : 1;
+    int nOutputs = (numberOfOutputs > 0) ? numberOfOutputs : 1;
+    int nInputs = (numberOfInputs > 0) ? numberOfInputs : 1;
+    std::stringstream code;
+    code << "\nfloat fabsf(float x);\nfloat acosf(float x);\nfloat acoshf(float x);\nfloat asinf(float x);\n"
+         << "float asinhf(float x);\nfloat atanf(float x);\nfloat atanhf(float x);\nfloat ceilf(float x);\n"
+         << "float cosf(float x);\nfloat coshf(float x);\nfloat tanf(float x);\nfloat tanhf(float x);\n"
+         << "float sinf(float x);\nfloat sinhf(float x);\nfloat expf(float x);\nfloat floorf(float x);\n"
+         << "float powf(float x, float y);\nfloat logf(float x);\nfloat log10f(float x);\nfloat sqrtf(float x);\n"
+         << "void csim_initialise_routine(double* CSIM_STATE, double* CSIM_OUTPUT, double* CSIM_INPUT);\n";
+
+    // the local variables of the model are always evaluated in single precision, but only if we understand all
+    // of the model's code
+    std::stringstream floatBody;
+    floatBody << "float CONSTANTS[" << numberOfConstants << "], ALGEBRAIC[" << numberOfAlgebraic << "];\n\n";
+    bool converted = true;
+    for (const auto& statement: body)
+    {
+        if (statement.expression)
+        {
+            // plain copies (e.g., states flagged as outputs) are left alone so they stay exact
+            if ((statement.expression->type == CodeExpression::Reference)
+                    || (statement.expression->type == CodeExpression::Identifier))
+                floatBody << statement.toString();
+            else
+                floatBody << statement.target << " = "
+                          << singlePrecisionExpression(statement.expression, mixed)->toString() << ";\n";
+        }
+        else converted = false;
+    }
+    if (!converted)
+    {
+        std::cerr << "CellML Model Definition::generateReducedPrecisionRoutines: unable to convert the model to "
+                  << "single precision, the reduced precision model function will evaluate the model in double "
+                  << "precision." << std::endl;
+    }
+
+    if (mixed)
+    {
+        code << "\nvoid csim_rhs_routine(double VOI, double* CSIM_STATE, double* CSIM_RATE, double* CSIM_OUTPUT, "
+             << "double* CSIM_INPUT)\n{\n\n";
+        if (converted) code << floatBody.str();
+        else code << "csim_rhs_routine_double(VOI, CSIM_STATE, CSIM_RATE, CSIM_OUTPUT, CSIM_INPUT);\n";
+        code << "\n}//csim_rhs_routine()\n";
+    }
+    else
+    {
+        code << "\nvoid csim_rhs_routine_float(float VOI, float* CSIM_STATE, float* CSIM_RATE, float* CSIM_OUTPUT, "
+             << "float* CSIM_INPUT)\n{\n\n";
+        if (converted) code << floatBody.str();
+        else
+        {
+            code << "double CSIM_DOUBLE_STATE[" << nStates << "], CSIM_DOUBLE_RATE[" << nStates
+                 << "], CSIM_DOUBLE_OUTPUT[" << nOutputs << "], CSIM_DOUBLE_INPUT[" << nInputs << "];\n"
+                 << "int i;\n"
+                 << "for (i = 0; i < " << numberOfStates << "; ++i) CSIM_DOUBLE_STATE[i] = CSIM_STATE[i];\n"
+                 << "for (i = 0; i < " << numberOfOutputs << "; ++i) CSIM_DOUBLE_OUTPUT[i] = CSIM_OUTPUT[i];\n"
+                 << "for (i = 0; i < " << numberOfInputs << "; ++i) CSIM_DOUBLE_INPUT[i] = CSIM_INPUT[i];\n"
+                 << "csim_rhs_routine(VOI, CSIM_DOUBLE_STATE, CSIM_DOUBLE_RATE, CSIM_DOUBLE_OUTPUT, "
+                 << "CSIM_DOUBLE_INPUT);\n"
+                 << "for (i = 0; i < " << numberOfStates << "; ++i) CSIM_RATE[i] = (float)CSIM_DOUBLE_RATE[i];\n"
+                 << "for (i = 0; i < " << numberOfOutputs << "; ++i) CSIM_OUTPUT[i] = (float)CSIM_DOUBLE_OUTPUT[i];\n";
+        }
+        code << "\n}//csim_rhs_routine_float()\n";
+
+        // initialisation is not performance critical, so just round the double precision values
+        code << "\nvoid csim_initialise_routine_float(float* CSIM_STATE, float* CSIM_OUTPUT, float* CSIM_INPUT)\n{\n"
+             << "double CSIM_DOUBLE_STATE[" << nStates << "], CSIM_DOUBLE_OUTPUT[" << nOutputs
+             << "], CSIM_DOUBLE_INPUT[" << nInputs << "];\n"
+             << "int i;\n"
+             << "csim_initialise_routine(CSIM_DOUBLE_STATE, CSIM_DOUBLE_OUTPUT, CSIM_DOUBLE_INPUT);\n"
+             << "for (i = 0; i < " << numberOfStates << "; ++i) CSIM_STATE[i] = (float)CSIM_DOUBLE_STATE[i];\n"
+             << "for (i = 0; i < " << numberOfOutputs << "; ++i) CSIM_OUTPUT[i] = (float)CSIM_DOUBLE_OUTPUT[i];\n"
+             << "for (i = 0; i < " << numberOfInputs << "; ++i) CSIM_INPUT[i] = (float)CSIM_DOUBLE_INPUT[i];\n"
+             << "}\n";
+    }
+
+    // the error report compares the reduced and double precision evaluations of the model at its initial state
+    code << "\ndouble csim_precision_error_routine()\n{\n"
+         << "double CSIM_STATE[" << nStates << "], CSIM_RATE[" << nStates << "], CSIM_OUTPUT[" << nOutputs
+         << "], CSIM_INPUT[" << nInputs << "];\n"
+         << "double CSIM_REFERENCE_RATE[" << nStates << "], CSIM_REFERENCE_OUTPUT[" << nOutputs << "];\n"
+         << "double CSIM_SCALE, CSIM_DIFFERENCE, CSIM_ERROR = 0.0;\n"
+         << "int i;\n"
+         << "csim_initialise_routine(CSIM_STATE, CSIM_OUTPUT, CSIM_INPUT);\n"
+         << "for (i = 0; i < " << numberOfOutputs << "; ++i) CSIM_REFERENCE_OUTPUT[i] = CSIM_OUTPUT[i];\n";
+    if (mixed)
+    {
+        code << "csim_rhs_routine_double(0.0, CSIM_STATE, CSIM_REFERENCE_RATE, CSIM_REFERENCE_OUTPUT, CSIM_INPUT);\n"
+             << "csim_rhs_routine(0.0, CSIM_STATE, CSIM_RATE, CSIM_OUTPUT, CSIM_INPUT);\n";
+    }
+    else
+    {
+        code << "{\nfloat CSIM_FLOAT_STATE[" << nStates << "], CSIM_FLOAT_RATE[" << nStates
+             << "], CSIM_FLOAT_OUTPUT[" << nOutputs << "], CSIM_FLOAT_INPUT[" << nInputs << "];\n"
+             << "for (i = 0; i < " << numberOfStates << "; ++i) CSIM_FLOAT_STATE[i] = (float)CSIM_STATE[i];\n"
+             << "for (i = 0; i < " << numberOfOutputs << "; ++i) CSIM_FLOAT_OUTPUT[i] = (float)CSIM_OUTPUT[i];\n"
+             << "for (i = 0; i < " << numberOfInputs << "; ++i) CSIM_FLOAT_INPUT[i] = (float)CSIM_INPUT[i];\n"
+             << "csim_rhs_routine(0.0, CSIM_STATE, CSIM_REFERENCE_RATE, CSIM_REFERENCE_OUTPUT, CSIM_INPUT);\n"
+             << "csim_rhs_routine_float(0.0f, CSIM_FLOAT_STATE, CSIM_FLOAT_RATE, CSIM_FLOAT_OUTPUT, "
+             << "CSIM_FLOAT_INPUT);\n"
+             << "for (i = 0; i < " << numberOfStates << "; ++i) CSIM_RATE[i] = CSIM_FLOAT_RATE[i];\n"
+             << "for (i = 0; i < " << numberOfOutputs << "; ++i) CSIM_OUTPUT[i] = CSIM_FLOAT_OUTPUT[i];\n"
+             << "}\n";
+    }
+    // relative differences, except for values close to zero where we use the absolute difference
+    code << "for (i = 0; i < " << numberOfStates << "; ++i)\n{\n"
+         << "CSIM_SCALE = fabs(CSIM_REFERENCE_RATE[i]) > 1.0 ? fabs(CSIM_REFERENCE_RATE[i]) : 1.0;\n"
+         << "CSIM_DIFFERENCE = fabs(CSIM_RATE[i] - CSIM_REFERENCE_RATE[i]) / CSIM_SCALE;\n"
+         << "if (CSIM_DIFFERENCE > CSIM_ERROR) CSIM_ERROR = CSIM_DIFFERENCE;\n}\n"
+         << "for (i = 0; i < " << numberOfOutputs << "; ++i)\n{\n"
+         << "CSIM_SCALE = fabs(CSIM_REFERENCE_OUTPUT[i]) > 1.0 ? fabs(CSIM_REFERENCE_OUTPUT[i]) : 1.0;\n"
+         << "CSIM_DIFFERENCE = fabs(CSIM_OUTPUT[i] - CSIM_REFERENCE_OUTPUT[i]) / CSIM_SCALE;\n"
+         << "if (CSIM_DIFFERENCE > CSIM_ERROR) CSIM_ERROR = CSIM_DIFFERENCE;\n}\n"
+         << "return CSIM_ERROR;\n}\n";
+    return code.str();
 }
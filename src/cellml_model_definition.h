@@ -9,6 +9,30 @@
 
 class CellmlApiObjects;
 
+/**
+ * A lookup table requested for a given variable. Expressions depending only on this variable (and fixed
+ * constants) will be replaced by linear interpolation into a table precomputed over the given range.
+ */
+struct LookupTable
+{
+    std::string variableId; // the unique ID of the source variable
+    double minimum;
+    double maximum;
+    double step;
+    int numberOfExpressions; // the number of expressions tabulated for this variable at code generation time
+};
+
+/**
+ * The model function split into partitions able to be evaluated in parallel, along with the sizes of the arrays
+ * shared between the partitions.
+ */
+struct ModelPartitions
+{
+    std::vector<StatementPartition> partitions;
+    int numberOfConstants;
+    int numberOfAlgebraic;
+};
+
 /**
  * An internal class to manage the use of CellML models.
  */
@@ -71,13 +95,140 @@ public:
      */
     int getVariableIndex(const std::string& variableId, unsigned char variableType);
 
+    /**
+     * Request that expressions depending only on the specified variable be replaced by linear interpolation into
+     * lookup tables precomputed over the given range when this model is instantiated. Only expressions which also
+     * involve a function call (exp, pow, etc.) and depend on nothing else but fixed constants will be tabulated.
+     * Values of the variable outside the given range fall back to evaluating the original expression.
+     * @param variableId The ID of the lookup variable in the format 'component_name/variable_name'.
+     * @param minimum The minimum value of the lookup variable to tabulate.
+     * @param maximum The maximum value of the lookup variable to tabulate.
+     * @param step The spacing of the tabulated values.
+     * @return CSIM_OK on success, otherwise an error code.
+     */
+    int setLookupTable(const std::string& variableId, double minimum, double maximum, double step);
+
+    /**
+     * The maximum absolute interpolation error over all lookup tables, as measured at the mid-point of every
+     * table interval when the model was instantiated.
+     * @return The maximum interpolation error, zero if no lookup tables have been generated.
+     */
+    inline double lookupTableError() const
+    {
+        return mLookupTableError;
+    }
+
+    /**
+     * The number of state variables whose rate was found to be linear in the state variable itself (e.g.,
+     * Hodgkin-Huxley style gating variables) when this model was instantiated. These are the state variables
+     * which are integrated exactly by the generated Rush-Larsen step routine.
+     * @return The number of gating variables.
+     */
+    inline int numberOfGatingVariables() const
+    {
+        return mNumberOfGatingVariables;
+    }
+
+    /**
+     * The number of statements computing algebraic variables which were removed from the generated code when this
+     * model was instantiated, as neither the rates nor the flagged outputs of the model depend on them.
+     * @return The number of removed statements.
+     */
+    inline int numberOfRemovedStatements() const
+    {
+        return mNumberOfRemovedStatements;
+    }
+
+    /**
+     * The maximum relative difference between the reduced precision and the double precision evaluation of the
+     * model's rates and outputs at its initial state, as measured when the model was instantiated.
+     * @return The maximum relative difference, zero if the model was instantiated in double precision.
+     */
+    inline double precisionError() const
+    {
+        return mPrecisionError;
+    }
+
     /**
      * Instantiate this model defintion into executable coode. Will cause code to be generated and compiled into
      * an executable function.
      * @param compiler The compiler to use for instantiating the model
+     * @param precision The floating point precision to generate the model functions in.
+     * @param backend The preferred way to compile the model. Models which need C code to be generated (e.g., with
+     * lookup tables or reduced precision) will always be compiled with clang.
+     * @param parallel Also generate the partitions of the model function, so that it is able to be evaluated in
+     * parallel (only in double precision).
      * @return CSIM_OK on success.
      */
-    int instantiate(Compiler& compiler);
+    int instantiate(Compiler& compiler, csim::Precision precision = csim::DoublePrecision,
+                    csim::CompilerBackend backend = csim::IrBackend, bool parallel = false);
+
+    /**
+     * The partitions of the model function generated when the model was instantiated, the routine evaluating each
+     * partition is named csim_rhs_partition_<index>.
+     * @return The partitions, which will be empty if they were not requested or the model function was not able to
+     * be partitioned.
+     */
+    inline const ModelPartitions& partitions() const
+    {
+        return mPartitions;
+    }
+
+    /**
+     * The number of variables able to be evaluated by the variables routine, i.e., every variable in the model.
+     * Will only be correct once the model has been instantiated.
+     * @return The number of variables.
+     */
+    inline int numberOfVariables() const
+    {
+        return mEvaluationIndices.size();
+    }
+
+    /**
+     * Get the index of the specified variable in the array written by the variables routine.
+     * @param variableId The ID of the variable in the format 'component_name/variable_name'.
+     * @return The index of the variable, or a negative error code if it can't be found.
+     */
+    int getEvaluationIndex(const std::string& variableId);
+
+    /**
+     * Work out which statements of the variables routine need to be evaluated in order to compute the given
+     * variables.
+     * @param indices The indices of the variables to evaluate.
+     * @return The selection array to pass to the variables routine, or an empty array if any of the indices are
+     * invalid.
+     */
+    std::vector<double> selectVariables(const std::vector<int>& indices) const;
+
+    /**
+     * Compile a version of this model's executable functions specialised on fixed values of some of its inputs. The
+     * inputs are replaced by their values in the code generated when the model was instantiated, the resulting
+     * constant expressions and piecewise conditions are folded and any equations no longer needed are removed. The
+     * general functions compiled by instantiate() are not affected.
+     * @param compiler The compiler to build the specialised functions with, which must not be the compiler used to
+     * instantiate the model.
+     * @param inputValues The values of the inputs to fix, indexed by their index in the input array.
+     * @return csim::CSIM_OK on success, otherwise an error code.
+     */
+    int specialise(Compiler& compiler, const std::map<int, double>& inputValues);
+
+    /**
+     * The number of statements removed from the executable functions by the last call to specialise().
+     * @return The number of removed statements.
+     */
+    inline int numberOfSpecialisedStatements() const
+    {
+        return mNumberOfSpecialisedStatements;
+    }
+
+    /**
+     * The backend that was actually used to compile this model when it was instantiated.
+     * @return The compiler backend used.
+     */
+    inline csim::CompilerBackend compilerBackend() const
+    {
+        return mCompilerBackend;
+    }
 
     /**
      * The number of state variables in this model. Will only be correct if a model has successfully been loaded.
@@ -126,6 +277,28 @@ private:
     std::map<std::string, unsigned char> mVariableTypes;
     std::map<std::string, std::map<unsigned char, int> > mVariableIndices;
 
+    std::vector<LookupTable> mLookupTables;
+    double mLookupTableError;
+    int mNumberOfGatingVariables;
+    double mPrecisionError;
+    int mNumberOfRemovedStatements;
+    int mNumberOfSpecialisedStatements;
+    csim::CompilerBackend mCompilerBackend;
+
+    /**
+     * The routines generated when the model was instantiated, kept so the model is able to be specialised. Will be
+     * empty if the model needed C code to be generated.
+     */
+    std::vector<CodeRoutine> mRoutines;
+
+    /**
+     * The routine evaluating any selection of the model's variables and the index of each variable, by unique ID, in
+     * the array it writes to.
+     */
+    CodeRoutine mVariablesRoutine;
+    std::map<std::string, int> mEvaluationIndices;
+    ModelPartitions mPartitions;
+
     int mNumberOfOutputVariables;
     int mNumberOfInputVariables;
     int mNumberOfIndependentVariables;
@@ -0,0 +1,886 @@
+#include "code_analysis.h"
+
+#include <iostream>
+#include <sstream>
+#include <cctype>
+#include <cstdlib>
+#include <cmath>
+#include <iomanip>
+#include <algorithm>
+
+/*
+ * A simple tokeniser and recursive descent parser for the subset of C generated by the CellML API.
+ */
+class ExpressionParser
+{
+public:
+    ExpressionParser(const std::string& code) : mCode(code), mPosition(0), mError(false)
+    {
+    }
+
+    CodeExpressionPtr parse()
+    {
+        CodeExpressionPtr e = parseConditional();
+        skipWhitespace();
+        if (mError || (mPosition != mCode.size())) return CodeExpressionPtr();
+        return e;
+    }
+
+private:
+    const std::string& mCode;
+    size_t mPosition;
+    bool mError;
+
+    void skipWhitespace()
+    {
+        while (mPosition < mCode.size())
+        {
+            if (std::isspace(mCode[mPosition])) mPosition++;
+            else if (mCode.compare(mPosition, 2, "/*") == 0)
+            {
+                size_t end = mCode.find("*/", mPosition + 2);
+                mPosition = (end == std::string::npos) ? mCode.size() : end + 2;
+            }
+            else break;
+        }
+    }
+
+    bool accept(const char* op)
+    {
+        skipWhitespace();
+        size_t l = std::char_traits<char>::length(op);
+        if (mCode.compare(mPosition, l, op) != 0) return false;
+        // make sure we don't split a two character operator
+        if ((l == 1) && (mPosition + 1 < mCode.size()))
+        {
+            char next = mCode[mPosition + 1];
+            if ((op[0] == '<' || op[0] == '>' || op[0] == '!' || op[0] == '=') && (next == '=')) return false;
+            if ((op[0] == '&' && next == '&') || (op[0] == '|' && next == '|')) return false;
+        }
+        mPosition += l;
+        return true;
+    }
+
+    CodeExpressionPtr binary(const std::string& op, CodeExpressionPtr left, CodeExpressionPtr right)
+    {
+        if (!left || !right)
+        {
+            mError = true;
+            return CodeExpressionPtr();
+        }
+        CodeExpressionPtr e = std::make_shared<CodeExpression>(CodeExpression::Binary, op);
+        e->arguments.push_back(left);
+        e->arguments.push_back(right);
+        return e;
+    }
+
+    CodeExpressionPtr parseConditional()
+    {
+        CodeExpressionPtr condition = parseBinary(0);
+        if (mError) return CodeExpressionPtr();
+        if (accept("?"))
+        {
+            CodeExpressionPtr t = parseConditional();
+            if (mError || !accept(":"))
+            {
+                mError = true;
+                return CodeExpressionPtr();
+            }
+            CodeExpressionPtr f = parseConditional();
+            if (mError) return CodeExpressionPtr();
+            CodeExpressionPtr e = std::make_shared<CodeExpression>(CodeExpression::Conditional, "?:");
+            e->arguments.push_back(condition);
+            e->arguments.push_back(t);
+            e->arguments.push_back(f);
+            return e;
+        }
+        return condition;
+    }
+
+    // binary operators in order of increasing precedence, all left associative.
+    CodeExpressionPtr parseBinary(int level)
+    {
+        static const char* const operators[][5] = {
+            { "||", 0 },
+            { "&&", 0 },
+            { "==", "!=", 0 },
+            { "<=", ">=", "<", ">", 0 },
+            { "+", "-", 0 },
+            { "*", "/", 0 }
+        };
+        static const int nLevels = sizeof(operators) / sizeof(operators[0]);
+        if (level == nLevels) return parseUnary();
+        CodeExpressionPtr left = parseBinary(level + 1);
+        while (!mError)
+        {
+            const char* matched = 0;
+            for (int i = 0; operators[level][i]; ++i)
+            {
+                if (accept(operators[level][i]))
+                {
+                    matched = operators[level][i];
+                    break;
+                }
+            }
+            if (!matched) break;
+            left = binary(matched, left, parseBinary(level + 1));
+        }
+        return left;
+    }
+
+    CodeExpressionPtr parseUnary()
+    {
+        const char* ops[] = { "-", "+", "!" };
+        for (int i = 0; i < 3; ++i)
+        {
+            if (accept(ops[i]))
+            {
+                CodeExpressionPtr operand = parseUnary();
+                if (!operand)
+                {
+                    mError = true;
+                    return CodeExpressionPtr();
+                }
+                CodeExpressionPtr e = std::make_shared<CodeExpression>(CodeExpression::Unary, ops[i]);
+                e->arguments.push_back(operand);
+                return e;
+            }
+        }
+        return parsePrimary();
+    }
+
+    CodeExpressionPtr parsePrimary()
+    {
+        skipWhitespace();
+        if (mPosition >= mCode.size())
+        {
+            mError = true;
+            return CodeExpressionPtr();
+        }
+        char c = mCode[mPosition];
+        if (accept("("))
+        {
+            CodeExpressionPtr e = parseConditional();
+            if (mError || !accept(")"))
+            {
+                mError = true;
+                return CodeExpressionPtr();
+            }
+            return e;
+        }
+        if (std::isdigit(c) || (c == '.'))
+        {
+            size_t start = mPosition;
+            while ((mPosition < mCode.size()) && (std::isdigit(mCode[mPosition]) || (mCode[mPosition] == '.')))
+                mPosition++;
+            if ((mPosition < mCode.size()) && ((mCode[mPosition] == 'e') || (mCode[mPosition] == 'E')))
+            {
+                mPosition++;
+                if ((mPosition < mCode.size()) && ((mCode[mPosition] == '+') || (mCode[mPosition] == '-')))
+                    mPosition++;
+                while ((mPosition < mCode.size()) && std::isdigit(mCode[mPosition])) mPosition++;
+            }
+            return std::make_shared<CodeExpression>(CodeExpression::Number,
+                                                    mCode.substr(start, mPosition - start));
+        }
+        if (std::isalpha(c) || (c == '_'))
+        {
+            size_t start = mPosition;
+            while ((mPosition < mCode.size()) && (std::isalnum(mCode[mPosition]) || (mCode[mPosition] == '_')))
+                mPosition++;
+            std::string name = mCode.substr(start, mPosition - start);
+            if (accept("["))
+            {
+                skipWhitespace();
+                size_t indexStart = mPosition;
+                while ((mPosition < mCode.size()) && std::isdigit(mCode[mPosition])) mPosition++;
+                size_t indexEnd = mPosition;
+                if ((indexStart == indexEnd) || !accept("]"))
+                {
+                    mError = true;
+                    return CodeExpressionPtr();
+                }
+                int index = std::atoi(mCode.substr(indexStart, indexEnd - indexStart).c_str());
+                return std::make_shared<CodeExpression>(CodeExpression::Reference, name, index);
+            }
+            if (accept("("))
+            {
+                CodeExpressionPtr e = std::make_shared<CodeExpression>(CodeExpression::Call, name);
+                if (accept(")")) return e;
+                do
+                {
+                    CodeExpressionPtr a = parseConditional();
+                    if (mError) return CodeExpressionPtr();
+                    e->arguments.push_back(a);
+                } while (accept(","));
+                if (!accept(")"))
+                {
+                    mError = true;
+                    return CodeExpressionPtr();
+                }
+                return e;
+            }
+            return std::make_shared<CodeExpression>(CodeExpression::Identifier, name);
+        }
+        mError = true;
+        return CodeExpressionPtr();
+    }
+};
+
+CodeExpression::CodeExpression(Type t, const std::string& v, int i) : type(t), value(v), index(i)
+{
+}
+
+std::string CodeExpression::toString() const
+{
+    std::stringstream s;
+    switch (type)
+    {
+    case Number:
+    case Identifier:
+        s << value;
+        break;
+    case Reference:
+        s << value << "[" << index << "]";
+        break;
+    case Call:
+        s << value << "(";
+        for (size_t i = 0; i < arguments.size(); ++i)
+        {
+            if (i > 0) s << ", ";
+            s << arguments[i]->toString();
+        }
+        s << ")";
+        break;
+    case Unary:
+        s << "(" << value << arguments[0]->toString() << ")";
+        break;
+    case Binary:
+        s << "(" << arguments[0]->toString() << " " << value << " " << arguments[1]->toString() << ")";
+        break;
+    case Conditional:
+        s << "(" << arguments[0]->toString() << " ? " << arguments[1]->toString() << " : "
+          << arguments[2]->toString() << ")";
+        break;
+    }
+    return s.str();
+}
+
+std::string CodeExpression::key() const
+{
+    if (type == Identifier) return value;
+    if (type == Reference)
+    {
+        std::stringstream s;
+        s << value << "[" << index << "]";
+        return s.str();
+    }
+    return "";
+}
+
+std::string CodeStatement::toString() const
+{
+    if (expression && condition)
+        return "if (" + condition->toString() + ") " + target + " = " + expression->toString() + ";\n";
+    if (expression) return target + " = " + expression->toString() + ";\n";
+    return code + "\n";
+}
+
+bool CodeRoutine::isStructured() const
+{
+    for (const auto& statement: statements)
+    {
+        if (!statement.expression) return false;
+    }
+    return true;
+}
+
+std::string CodeRoutine::toString() const
+{
+    std::stringstream s;
+    s << "\nvoid " << name << "(";
+    for (size_t i = 0; i < arguments.size(); ++i)
+    {
+        if (i > 0) s << ", ";
+        s << (arguments[i].second ? "double* " : "double ") << arguments[i].first;
+    }
+    s << ")\n{\n";
+    for (const auto& array: localArrays) s << "double " << array.first << "[" << array.second << "];\n";
+    s << "\n";
+    for (const auto& chunk: chunks)
+    {
+        s << chunk << "(";
+        for (size_t i = 0; i < arguments.size(); ++i) s << ((i > 0) ? ", " : "") << arguments[i].first;
+        for (const auto& array: localArrays) s << ", " << array.first;
+        s << ");\n";
+    }
+    for (const auto& statement: statements) s << statement.toString();
+    s << "\n}//" << name << "()\n";
+    return s.str();
+}
+
+CodeExpressionPtr parseCodeExpression(const std::string& code)
+{
+    ExpressionParser parser(code);
+    return parser.parse();
+}
+
+void collectDependencies(const CodeExpressionPtr& expression, std::set<std::string>& dependencies)
+{
+    if (!expression) return;
+    if ((expression->type == CodeExpression::Reference) || (expression->type == CodeExpression::Identifier))
+    {
+        dependencies.insert(expression->key());
+        return;
+    }
+    for (const auto& a: expression->arguments) collectDependencies(a, dependencies);
+}
+
+CodeExpressionPtr copyCodeExpression(const CodeExpressionPtr& expression)
+{
+    CodeExpressionPtr e = std::make_shared<CodeExpression>(expression->type, expression->value, expression->index);
+    for (const auto& a: expression->arguments) e->arguments.push_back(copyCodeExpression(a));
+    return e;
+}
+
+CodeExpressionPtr substituteReference(const CodeExpressionPtr& expression, const std::string& key,
+                                      const CodeExpressionPtr& replacement)
+{
+    if (!key.empty() && (expression->key() == key)) return copyCodeExpression(replacement);
+    CodeExpressionPtr e = std::make_shared<CodeExpression>(expression->type, expression->value, expression->index);
+    for (const auto& a: expression->arguments) e->arguments.push_back(substituteReference(a, key, replacement));
+    return e;
+}
+
+static void addStatement(std::vector<CodeStatement>& statements, const std::string& code)
+{
+    size_t start = code.find_first_not_of(" \t\r\n");
+    if (start == std::string::npos) return;
+    CodeStatement statement;
+    statement.code = code.substr(start);
+    // simple assignments are of the form TARGET = EXPRESSION;
+    size_t equals = statement.code.find('=');
+    if ((statement.code[statement.code.size()-1] == ';') && (equals != std::string::npos)
+            && (equals + 1 < statement.code.size()) && (statement.code[equals+1] != '='))
+    {
+        CodeExpressionPtr target = parseCodeExpression(statement.code.substr(0, equals));
+        CodeExpressionPtr expression = parseCodeExpression(
+                    statement.code.substr(equals + 1, statement.code.size() - equals - 2));
+        if (target && expression && !target->key().empty())
+        {
+            statement.target = target->key();
+            statement.expression = expression;
+            collectDependencies(expression, statement.dependencies);
+        }
+    }
+    statements.push_back(statement);
+}
+
+std::vector<CodeStatement> parseCodeStatements(const std::string& code)
+{
+    std::vector<CodeStatement> statements;
+    int parenthesisDepth = 0, braceDepth = 0;
+    size_t start = 0;
+    for (size_t i = 0; i < code.size(); ++i)
+    {
+        char c = code[i];
+        if ((c == '/') && (i + 1 < code.size()) && (code[i+1] == '*'))
+        {
+            size_t end = code.find("*/", i + 2);
+            i = (end == std::string::npos) ? code.size() - 1 : end + 1;
+            continue;
+        }
+        if ((c == '/') && (i + 1 < code.size()) && (code[i+1] == '/'))
+        {
+            size_t end = code.find('\n', i);
+            i = (end == std::string::npos) ? code.size() - 1 : end;
+            continue;
+        }
+        if (c == '(') parenthesisDepth++;
+        else if (c == ')') parenthesisDepth--;
+        else if (c == '{') braceDepth++;
+        else if (c == '}')
+        {
+            braceDepth--;
+            if ((braceDepth == 0) && (parenthesisDepth == 0))
+            {
+                addStatement(statements, code.substr(start, i + 1 - start));
+                start = i + 1;
+            }
+        }
+        else if ((c == ';') && (parenthesisDepth == 0) && (braceDepth == 0))
+        {
+            addStatement(statements, code.substr(start, i + 1 - start));
+            start = i + 1;
+        }
+    }
+    if (start < code.size()) addStatement(statements, code.substr(start));
+    return statements;
+}
+
+/*
+ * Tracks which variables depend (possibly indirectly) on a given variable and generates linear coefficients.
+ */
+class LinearAnalysis
+{
+public:
+    LinearAnalysis(const std::string& key, const std::map<std::string, CodeExpressionPtr>& definitions) :
+        mKey(key), mDefinitions(definitions)
+    {
+    }
+
+    bool dependsOn(const CodeExpressionPtr& expression)
+    {
+        std::set<std::string> dependencies;
+        collectDependencies(expression, dependencies);
+        for (const auto& d: dependencies)
+        {
+            if (variableDependsOn(d)) return true;
+        }
+        return false;
+    }
+
+    CodeExpressionPtr coefficient(const CodeExpressionPtr& expression)
+    {
+        if (!dependsOn(expression)) return zero();
+        switch (expression->type)
+        {
+        case CodeExpression::Reference:
+        case CodeExpression::Identifier:
+        {
+            std::string k = expression->key();
+            if (k == mKey) return std::make_shared<CodeExpression>(CodeExpression::Number, "1.0");
+            if (mCoefficients.count(k)) return mCoefficients[k];
+            CodeExpressionPtr c;
+            auto d = mDefinitions.find(k);
+            if (d != mDefinitions.end()) c = coefficient(d->second);
+            mCoefficients[k] = c;
+            return c;
+        }
+        case CodeExpression::Unary:
+        {
+            if (expression->value == "!") return CodeExpressionPtr();
+            CodeExpressionPtr c = coefficient(expression->arguments[0]);
+            if (!c || (expression->value == "+") || isZero(c)) return c;
+            return operation("-", CodeExpressionPtr(), c);
+        }
+        case CodeExpression::Binary:
+        {
+            const std::string& op = expression->value;
+            const CodeExpressionPtr& a = expression->arguments[0];
+            const CodeExpressionPtr& b = expression->arguments[1];
+            if ((op == "+") || (op == "-"))
+            {
+                CodeExpressionPtr ca = coefficient(a), cb = coefficient(b);
+                if (!ca || !cb) return CodeExpressionPtr();
+                if (isZero(cb)) return ca;
+                if (isZero(ca)) return (op == "+") ? cb : operation("-", CodeExpressionPtr(), cb);
+                return operation(op, ca, cb);
+            }
+            if (op == "*")
+            {
+                if (!dependsOn(a))
+                {
+                    CodeExpressionPtr cb = coefficient(b);
+                    return cb ? operation("*", copyCodeExpression(a), cb) : cb;
+                }
+                if (!dependsOn(b))
+                {
+                    CodeExpressionPtr ca = coefficient(a);
+                    return ca ? operation("*", ca, copyCodeExpression(b)) : ca;
+                }
+                return CodeExpressionPtr();
+            }
+            if ((op == "/") && !dependsOn(b))
+            {
+                CodeExpressionPtr ca = coefficient(a);
+                return ca ? operation("/", ca, copyCodeExpression(b)) : ca;
+            }
+            return CodeExpressionPtr();
+        }
+        case CodeExpression::Conditional:
+        {
+            if (dependsOn(expression->arguments[0])) return CodeExpressionPtr();
+            CodeExpressionPtr ct = coefficient(expression->arguments[1]);
+            CodeExpressionPtr cf = coefficient(expression->arguments[2]);
+            if (!ct || !cf) return CodeExpressionPtr();
+            CodeExpressionPtr e = std::make_shared<CodeExpression>(CodeExpression::Conditional, "?:");
+            e->arguments.push_back(copyCodeExpression(expression->arguments[0]));
+            e->arguments.push_back(ct);
+            e->arguments.push_back(cf);
+            return e;
+        }
+        default:
+            // function calls of the variable are not linear
+            return CodeExpressionPtr();
+        }
+    }
+
+    static bool isZero(const CodeExpressionPtr& e)
+    {
+        return (e->type == CodeExpression::Number) && (std::atof(e->value.c_str()) == 0.0);
+    }
+
+private:
+    std::string mKey;
+    const std::map<std::string, CodeExpressionPtr>& mDefinitions;
+    std::map<std::string, bool> mDependsOn;
+    std::map<std::string, CodeExpressionPtr> mCoefficients;
+
+    bool variableDependsOn(const std::string& k)
+    {
+        if (k == mKey) return true;
+        auto it = mDependsOn.find(k);
+        if (it != mDependsOn.end()) return it->second;
+        mDependsOn[k] = false; // guard against cycles
+        auto d = mDefinitions.find(k);
+        bool depends = (d != mDefinitions.end()) && dependsOn(d->second);
+        mDependsOn[k] = depends;
+        return depends;
+    }
+
+    static CodeExpressionPtr zero()
+    {
+        return std::make_shared<CodeExpression>(CodeExpression::Number, "0.0");
+    }
+
+    static CodeExpressionPtr operation(const std::string& op, CodeExpressionPtr a, CodeExpressionPtr b)
+    {
+        CodeExpressionPtr e = std::make_shared<CodeExpression>(a ? CodeExpression::Binary : CodeExpression::Unary,
+                                                               op);
+        if (a) e->arguments.push_back(a);
+        e->arguments.push_back(b);
+        return e;
+    }
+};
+
+CodeExpressionPtr linearCoefficient(const CodeExpressionPtr& expression, const std::string& key,
+                                    const std::map<std::string, CodeExpressionPtr>& definitions)
+{
+    LinearAnalysis analysis(key, definitions);
+    return analysis.coefficient(expression);
+}
+
+int removeUnusedStatements(std::vector<CodeStatement>& statements, const std::string& array)
+{
+    // we can't tell what any code we were not able to parse depends on, so leave everything alone
+    for (const auto& statement: statements)
+    {
+        if (!statement.expression) return 0;
+    }
+    std::string prefix = array + "[";
+    // statements are ordered so that variables are defined before they are used, so working backwards we will have
+    // seen every use of a variable before reaching its definition
+    std::set<std::string> required;
+    std::vector<bool> keep(statements.size(), false);
+    int removed = 0;
+    for (size_t i = statements.size(); i-- > 0;)
+    {
+        const CodeStatement& statement = statements[i];
+        if ((statement.target.compare(0, prefix.size(), prefix) != 0) || required.count(statement.target))
+        {
+            keep[i] = true;
+            required.insert(statement.dependencies.begin(), statement.dependencies.end());
+        }
+        else removed++;
+    }
+    if (removed == 0) return 0;
+    std::vector<CodeStatement> kept;
+    kept.reserve(statements.size() - removed);
+    for (size_t i = 0; i < statements.size(); ++i)
+    {
+        if (keep[i]) kept.push_back(statements[i]);
+    }
+    statements.swap(kept);
+    return removed;
+}
+
+static bool constantValue(const CodeExpressionPtr& e, double& value)
+{
+    if (e->type == CodeExpression::Number)
+    {
+        value = std::strtod(e->value.c_str(), NULL);
+        return true;
+    }
+    // negative constants are kept as a negated number so the serialised code is always valid C
+    if ((e->type == CodeExpression::Unary) && (e->value == "-")
+            && (e->arguments[0]->type == CodeExpression::Number))
+    {
+        value = -std::strtod(e->arguments[0]->value.c_str(), NULL);
+        return true;
+    }
+    return false;
+}
+
+static CodeExpressionPtr constantExpression(double value)
+{
+    std::stringstream s;
+    s << std::setprecision(17) << std::fabs(value);
+    std::string text = s.str();
+    if (text.find_first_of(".e") == std::string::npos) text += ".0";
+    CodeExpressionPtr e = std::make_shared<CodeExpression>(CodeExpression::Number, text);
+    if (!std::signbit(value)) return e;
+    CodeExpressionPtr negated = std::make_shared<CodeExpression>(CodeExpression::Unary, "-");
+    negated->arguments.push_back(e);
+    return negated;
+}
+
+static bool evaluateCall(const std::string& name, const std::vector<double>& a, double& value)
+{
+    typedef double (*Function1)(double);
+    static const std::map<std::string, Function1> functions = {
+        { "fabs", std::fabs }, { "exp", std::exp }, { "log", std::log }, { "log10", std::log10 },
+        { "sqrt", std::sqrt }, { "floor", std::floor }, { "ceil", std::ceil }, { "sin", std::sin },
+        { "cos", std::cos }, { "tan", std::tan }, { "asin", std::asin }, { "acos", std::acos },
+        { "atan", std::atan }, { "sinh", std::sinh }, { "cosh", std::cosh }, { "tanh", std::tanh },
+        { "asinh", std::asinh }, { "acosh", std::acosh }, { "atanh", std::atanh }
+    };
+    auto f = functions.find(name);
+    if ((f != functions.end()) && (a.size() == 1)) value = f->second(a[0]);
+    else if ((name == "pow") && (a.size() == 2)) value = std::pow(a[0], a[1]);
+    else if ((name == "arbitrary_log") && (a.size() == 2)) value = std::log(a[0]) / std::log(a[1]);
+    else return false;
+    return true;
+}
+
+CodeExpressionPtr foldConstants(const CodeExpressionPtr& expression, const std::map<std::string, double>& values)
+{
+    std::string key = expression->key();
+    if (!key.empty())
+    {
+        auto v = values.find(key);
+        if ((v != values.end()) && std::isfinite(v->second)) return constantExpression(v->second);
+    }
+    if (expression->type == CodeExpression::Conditional)
+    {
+        // only the branch taken needs to be folded when the condition is constant
+        CodeExpressionPtr condition = foldConstants(expression->arguments[0], values);
+        double c;
+        if (constantValue(condition, c)) return foldConstants(expression->arguments[(c != 0.0) ? 1 : 2], values);
+        CodeExpressionPtr e = std::make_shared<CodeExpression>(expression->type, expression->value);
+        e->arguments.push_back(condition);
+        e->arguments.push_back(foldConstants(expression->arguments[1], values));
+        e->arguments.push_back(foldConstants(expression->arguments[2], values));
+        return e;
+    }
+    CodeExpressionPtr e = std::make_shared<CodeExpression>(expression->type, expression->value, expression->index);
+    std::vector<double> a;
+    for (const auto& argument: expression->arguments)
+    {
+        e->arguments.push_back(foldConstants(argument, values));
+        double v;
+        if (constantValue(e->arguments.back(), v)) a.push_back(v);
+    }
+    if ((a.size() != e->arguments.size()) || a.empty()) return e;
+    double value;
+    const std::string& op = e->value;
+    if (e->type == CodeExpression::Unary)
+    {
+        // a negated number is already as folded as it gets
+        if (op == "-" && (e->arguments[0]->type == CodeExpression::Number)) return e;
+        if (op == "-") value = -a[0];
+        else if (op == "+") value = a[0];
+        else if (op == "!") value = (a[0] == 0.0) ? 1.0 : 0.0;
+        else return e;
+    }
+    else if (e->type == CodeExpression::Binary)
+    {
+        if (op == "+") value = a[0] + a[1];
+        else if (op == "-") value = a[0] - a[1];
+        else if (op == "*") value = a[0] * a[1];
+        else if (op == "/") value = a[0] / a[1];
+        else if (op == "<") value = (a[0] < a[1]) ? 1.0 : 0.0;
+        else if (op == ">") value = (a[0] > a[1]) ? 1.0 : 0.0;
+        else if (op == "<=") value = (a[0] <= a[1]) ? 1.0 : 0.0;
+        else if (op == ">=") value = (a[0] >= a[1]) ? 1.0 : 0.0;
+        else if (op == "==") value = (a[0] == a[1]) ? 1.0 : 0.0;
+        else if (op == "!=") value = (a[0] != a[1]) ? 1.0 : 0.0;
+        else if (op == "&&") value = ((a[0] != 0.0) && (a[1] != 0.0)) ? 1.0 : 0.0;
+        else if (op == "||") value = ((a[0] != 0.0) || (a[1] != 0.0)) ? 1.0 : 0.0;
+        else return e;
+    }
+    else if (e->type == CodeExpression::Call)
+    {
+        if (!evaluateCall(op, a, value)) return e;
+    }
+    else return e;
+    // leave anything that goes wrong to happen at run time, as it would have in the general code
+    if (!std::isfinite(value)) return e;
+    return constantExpression(value);
+}
+
+int specialiseStatements(std::vector<CodeStatement>& statements, const std::map<std::string, double>& values,
+                         const std::vector<std::string>& localArrays)
+{
+    for (const auto& statement: statements)
+    {
+        if (!statement.expression) return -1;
+    }
+    std::map<std::string, double> known = values;
+    std::vector<CodeStatement> specialised;
+    specialised.reserve(statements.size());
+    for (const auto& statement: statements)
+    {
+        CodeStatement s;
+        s.target = statement.target;
+        s.expression = foldConstants(statement.expression, known);
+        collectDependencies(s.expression, s.dependencies);
+        if (statement.condition)
+        {
+            s.condition = foldConstants(statement.condition, known);
+            collectDependencies(s.condition, s.dependencies);
+        }
+        s.code = s.toString();
+        s.code.erase(s.code.size() - 1);
+        bool local = false;
+        for (const auto& array: localArrays)
+        {
+            if (s.target.compare(0, array.size() + 1, array + "[") == 0) local = true;
+        }
+        double value;
+        if (!s.condition && constantValue(s.expression, value))
+        {
+            // the value is known from here on, so local variables no longer need to be assigned at all
+            known[s.target] = value;
+            if (local) continue;
+        }
+        else known.erase(s.target);
+        specialised.push_back(s);
+    }
+    int removed = int(statements.size() - specialised.size());
+    for (const auto& array: localArrays) removed += removeUnusedStatements(specialised, array);
+    statements.swap(specialised);
+    return removed;
+}
+
+static int expressionCost(const CodeExpressionPtr& expression)
+{
+    if (!expression) return 0;
+    int cost = 1;
+    for (const auto& argument: expression->arguments) cost += expressionCost(argument);
+    return cost;
+}
+
+std::vector<StatementPartition> partitionStatements(const std::vector<CodeStatement>& statements, int partitionCost)
+{
+    std::vector<StatementPartition> partitions;
+    // we can't tell what any code we were not able to parse depends on
+    for (const auto& statement: statements)
+    {
+        if (!statement.expression) return partitions;
+    }
+    // a statement has to wait for the statements assigning the variables it uses, the last assignment to its target
+    // and any uses of the previous value of its target
+    std::map<std::string, int> lastAssignment;
+    std::map<std::string, std::vector<int> > usesSinceAssignment;
+    std::vector<std::vector<int> > predecessors(statements.size());
+    std::vector<int> level(statements.size(), 0), cost(statements.size());
+    int numberOfLevels = 0;
+    for (size_t i = 0; i < statements.size(); ++i)
+    {
+        const CodeStatement& statement = statements[i];
+        std::vector<int>& before = predecessors[i];
+        for (const auto& key: statement.dependencies)
+        {
+            auto assignment = lastAssignment.find(key);
+            if (assignment != lastAssignment.end()) before.push_back(assignment->second);
+        }
+        auto assignment = lastAssignment.find(statement.target);
+        if (assignment != lastAssignment.end()) before.push_back(assignment->second);
+        std::vector<int>& uses = usesSinceAssignment[statement.target];
+        before.insert(before.end(), uses.begin(), uses.end());
+        uses.clear();
+        for (int j: before) level[i] = std::max(level[i], level[j] + 1);
+        numberOfLevels = std::max(numberOfLevels, level[i] + 1);
+        lastAssignment[statement.target] = int(i);
+        for (const auto& key: statement.dependencies) usesSinceAssignment[key].push_back(int(i));
+        cost[i] = expressionCost(statement.expression) + expressionCost(statement.condition);
+    }
+    std::vector<std::vector<int> > levels(numberOfLevels);
+    for (size_t i = 0; i < statements.size(); ++i) levels[level[i]].push_back(int(i));
+
+    std::vector<int> partitionOf(statements.size(), -1);
+    int open = -1; // the partition small levels are being merged into
+    for (const auto& members: levels)
+    {
+        int levelCost = 0;
+        for (int i: members) levelCost += cost[i];
+        int numberOfParts = levelCost / std::max(partitionCost, 1);
+        if (numberOfParts < 2)
+        {
+            if ((open < 0) || (partitions[open].cost >= partitionCost))
+            {
+                open = int(partitions.size());
+                partitions.push_back(StatementPartition());
+                partitions.back().cost = 0;
+            }
+            for (int i: members)
+            {
+                partitions[open].statements.push_back(i);
+                partitionOf[i] = open;
+            }
+            partitions[open].cost += levelCost;
+            continue;
+        }
+        // split the level into parts of equal cost, keeping neighbouring statements together
+        open = -1;
+        int partCost = (levelCost + numberOfParts - 1) / numberOfParts;
+        partitions.push_back(StatementPartition());
+        partitions.back().cost = 0;
+        for (int i: members)
+        {
+            if (partitions.back().cost >= partCost)
+            {
+                partitions.push_back(StatementPartition());
+                partitions.back().cost = 0;
+            }
+            partitions.back().statements.push_back(i);
+            partitions.back().cost += cost[i];
+            partitionOf[i] = int(partitions.size()) - 1;
+        }
+    }
+    for (size_t p = 0; p < partitions.size(); ++p)
+    {
+        StatementPartition& partition = partitions[p];
+        // merged levels still need to be evaluated in the original order
+        std::sort(partition.statements.begin(), partition.statements.end());
+        std::set<int> dependencies;
+        for (int i: partition.statements)
+        {
+            for (int j: predecessors[i])
+            {
+                if (partitionOf[j] != int(p)) dependencies.insert(partitionOf[j]);
+            }
+        }
+        partition.dependencies.assign(dependencies.begin(), dependencies.end());
+    }
+    return partitions;
+}
+
+std::vector<CodeRoutine> splitRoutine(CodeRoutine& routine, size_t maximumStatements)
+{
+    std::vector<CodeRoutine> chunks;
+    if ((maximumStatements == 0) || (routine.statements.size() <= maximumStatements) || !routine.chunks.empty())
+        return chunks;
+    for (const auto& statement: routine.statements)
+    {
+        if (!statement.expression) return chunks;
+        CodeExpressionPtr target = parseCodeExpression(statement.target);
+        if (!(target && (target->type == CodeExpression::Reference))) return chunks;
+    }
+    for (size_t first = 0; first < routine.statements.size(); first += maximumStatements)
+    {
+        CodeRoutine chunk;
+        std::stringstream name;
+        name << routine.name << "_chunk_" << chunks.size();
+        chunk.name = name.str();
+        chunk.arguments = routine.arguments;
+        for (const auto& array: routine.localArrays) chunk.arguments.push_back(std::make_pair(array.first, true));
+        size_t last = std::min(first + maximumStatements, routine.statements.size());
+        chunk.statements.assign(routine.statements.begin() + first, routine.statements.begin() + last);
+        routine.chunks.push_back(chunk.name);
+        chunks.push_back(chunk);
+    }
+    routine.statements.clear();
+    return chunks;
+}
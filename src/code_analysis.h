@@ -0,0 +1,265 @@
+#ifndef CODE_ANALYSIS_H
+#define CODE_ANALYSIS_H
+
+#include <string>
+#include <vector>
+#include <set>
+#include <map>
+#include <memory>
+
+/**
+ * A node in the expression tree of a statement from the code generated by the CellML API. The CellML API code
+ * generation service only ever produces a small subset of C for the model's equations (numbers, array references,
+ * function calls, arithmetic, logical and conditional operators) so that is all we need to handle here.
+ */
+class CodeExpression
+{
+public:
+    enum Type
+    {
+        Number,      // value holds the literal text
+        Reference,   // value holds the array name, index the array index
+        Identifier,  // value holds the identifier, e.g., VOI
+        Call,        // value holds the function name, arguments are the call arguments
+        Unary,       // value holds the operator, arguments[0] is the operand
+        Binary,      // value holds the operator, arguments[0] and arguments[1] are the operands
+        Conditional  // arguments are the condition, true and false expressions
+    };
+
+    CodeExpression(Type type, const std::string& value, int index = -1);
+
+    Type type;
+    std::string value;
+    int index;
+    std::vector<std::shared_ptr<CodeExpression> > arguments;
+
+    /**
+     * Serialise this expression back into C code. The serialised code is fully parenthesised so that it can
+     * safely be substituted into any other expression.
+     * @return The C code for this expression.
+     */
+    std::string toString() const;
+
+    /**
+     * The key used to identify references and identifiers in dependency sets, e.g., "ALGEBRAIC[3]" or "VOI".
+     * @return The key for this node, or an empty string if this node is not a reference or identifier.
+     */
+    std::string key() const;
+};
+
+typedef std::shared_ptr<CodeExpression> CodeExpressionPtr;
+
+/**
+ * A single statement from the code generated by the CellML API. Most statements are simple assignments
+ * (TARGET = EXPRESSION;), in which case the target and the parsed expression tree will be available. Anything we
+ * are not able to parse is kept as an opaque chunk of code.
+ */
+class CodeStatement
+{
+public:
+    /**
+     * The original code for this statement, including the trailing semicolon.
+     */
+    std::string code;
+
+    /**
+     * The key of the variable assigned by this statement, empty if this is not a simple assignment.
+     */
+    std::string target;
+
+    /**
+     * The parsed right hand side of the assignment, NULL if this is not a simple assignment.
+     */
+    CodeExpressionPtr expression;
+
+    /**
+     * The condition guarding this statement, NULL if the statement is always evaluated. The assignment is only made
+     * if the condition evaluates to anything other than zero.
+     */
+    CodeExpressionPtr condition;
+
+    /**
+     * The keys of all the variables referenced on the right hand side of this statement, including its condition.
+     */
+    std::set<std::string> dependencies;
+
+    /**
+     * Regenerate the code for this statement from its target and expression (if it is a simple assignment).
+     * @return The C code for this statement.
+     */
+    std::string toString() const;
+};
+
+/**
+ * A routine in the generated code. Routines are made up of simple statements operating on the routine's arguments and
+ * local arrays, which allows them to be emitted as C code or built directly as LLVM IR.
+ */
+class CodeRoutine
+{
+public:
+    /**
+     * The name of the routine.
+     */
+    std::string name;
+
+    /**
+     * The arguments of the routine, in order. The flag is true for array arguments (double*) and false for scalar
+     * arguments (double).
+     */
+    std::vector<std::pair<std::string, bool> > arguments;
+
+    /**
+     * The local arrays used in the routine, with their sizes.
+     */
+    std::vector<std::pair<std::string, int> > localArrays;
+
+    /**
+     * The names of the routines this routine has been split into, which are called in order before any statements
+     * of its own. Each chunk takes this routine's arguments followed by its local arrays.
+     * @see splitRoutine().
+     */
+    std::vector<std::string> chunks;
+
+    /**
+     * The statements making up the body of the routine.
+     */
+    std::vector<CodeStatement> statements;
+
+    /**
+     * Check if all of the statements in this routine are simple assignments.
+     * @return True if every statement has been parsed into its target and expression, false otherwise.
+     */
+    bool isStructured() const;
+
+    /**
+     * Generate the C code for this routine.
+     * @return The C code for this routine.
+     */
+    std::string toString() const;
+};
+
+/**
+ * A group of statements evaluated together as a single task when the model function is evaluated in parallel.
+ */
+struct StatementPartition
+{
+    std::vector<int> statements;   // the indices of the statements in this partition, in the order they are evaluated
+    std::vector<int> dependencies; // the partitions which must be evaluated before this one
+    int cost;                      // the estimated cost of evaluating the partition
+};
+
+/**
+ * Parse the given C expression into an expression tree.
+ * @param code The code to parse.
+ * @return The parsed expression tree, or NULL if the code is not able to be parsed.
+ */
+CodeExpressionPtr parseCodeExpression(const std::string& code);
+
+/**
+ * Split the given chunk of code generated by the CellML API into its individual statements.
+ * @param code The code to split, e.g., the rates string from the CellML API code information.
+ * @return The statements, in the same order they appear in the given code.
+ */
+std::vector<CodeStatement> parseCodeStatements(const std::string& code);
+
+/**
+ * Collect the keys of all references and identifiers used in the given expression.
+ * @param expression The expression to examine.
+ * @param dependencies The set to add the keys to.
+ */
+void collectDependencies(const CodeExpressionPtr& expression, std::set<std::string>& dependencies);
+
+/**
+ * Make a deep copy of the given expression.
+ * @param expression The expression to copy.
+ * @return The new expression.
+ */
+CodeExpressionPtr copyCodeExpression(const CodeExpressionPtr& expression);
+
+/**
+ * Make a deep copy of the given expression, replacing any reference or identifier whose key matches the given key
+ * with a copy of the given replacement expression.
+ * @param expression The expression to copy.
+ * @param key The key of the reference to replace.
+ * @param replacement The expression to substitute for the reference.
+ * @return The new expression.
+ */
+CodeExpressionPtr substituteReference(const CodeExpressionPtr& expression, const std::string& key,
+                                      const CodeExpressionPtr& replacement);
+
+/**
+ * Determine whether the given expression is linear (affine) in the given variable and, if so, generate the
+ * expression for the coefficient of that variable. References to other variables are followed through their
+ * definitions, so that, for example, a rate defined in terms of intermediate algebraic variables which depend on the
+ * given variable will still be analysed correctly. The generated coefficient only references variables which do not
+ * depend on the given variable.
+ * @param expression The expression to examine.
+ * @param key The key of the variable, e.g., "CSIM_STATE[2]".
+ * @param definitions The defining expressions of the intermediate variables, indexed by their key.
+ * @return The coefficient expression, a zero number if the expression does not depend on the variable, or NULL if
+ * the expression is not linear in the variable.
+ */
+CodeExpressionPtr linearCoefficient(const CodeExpressionPtr& expression, const std::string& key,
+                                    const std::map<std::string, CodeExpressionPtr>& definitions);
+
+/**
+ * Remove the assignments to the given array whose values are not needed, directly or indirectly, by any of the
+ * other statements. Assignments to anything other than the given array are always kept. If any of the statements
+ * could not be parsed, nothing will be removed as we are unable to determine what they depend on.
+ * @param statements The statements to prune, in the order they are evaluated.
+ * @param array The name of the array to prune the assignments of, e.g., "ALGEBRAIC".
+ * @return The number of statements removed.
+ */
+int removeUnusedStatements(std::vector<CodeStatement>& statements, const std::string& array);
+
+/**
+ * Fold the constant parts of the given expression. Operators and calls to the standard math functions whose operands
+ * are all numbers are evaluated, conditionals with a constant condition are replaced by the branch taken, and
+ * references with a known value are replaced by that value. Anything which would evaluate to infinity or NaN is
+ * left as it is.
+ * @param expression The expression to fold.
+ * @param values The known values of variables, indexed by their key, e.g., "CSIM_INPUT[0]".
+ * @return The folded expression, always a new expression tree.
+ */
+CodeExpressionPtr foldConstants(const CodeExpressionPtr& expression, const std::map<std::string, double>& values);
+
+/**
+ * Specialise the given statements on known values of some of the variables they use. References to those variables
+ * are replaced by their values and the resulting constant expressions are folded. Assignments of a constant to the
+ * given local arrays are propagated into the statements which follow and removed, along with any other assignments
+ * to those arrays which are no longer needed.
+ * @param statements The statements to specialise, in the order they are evaluated.
+ * @param values The known values of variables, indexed by their key.
+ * @param localArrays The names of the arrays local to the routine the statements belong to, e.g., "ALGEBRAIC".
+ * @return The number of statements removed, or -1 if any of the statements could not be parsed (in which case the
+ * statements are left unchanged).
+ */
+int specialiseStatements(std::vector<CodeStatement>& statements, const std::map<std::string, double>& values,
+                         const std::vector<std::string>& localArrays);
+
+/**
+ * Partition the given statements into a graph of tasks which are able to be evaluated in parallel. Each statement is
+ * placed at the level after the last of the statements it depends on (through the variables it uses, or by assigning
+ * a variable used or assigned by an earlier statement). The statements in a level are split into partitions of
+ * roughly the given cost, while consecutive levels which are too small to be worth splitting are merged into a single
+ * partition. The cost of a statement is the number of nodes in its expression tree.
+ * @param statements The statements to partition, in the order they are evaluated.
+ * @param partitionCost The target cost of each partition.
+ * @return The partitions, in an order in which every partition comes after all of its dependencies. Will be empty if
+ * any of the statements could not be parsed.
+ */
+std::vector<StatementPartition> partitionStatements(const std::vector<CodeStatement>& statements, int partitionCost);
+
+/**
+ * Split a routine with more than the given number of statements into chunks of at most that many statements, so that
+ * the time taken to optimise the generated code does not blow up for very large models. The statements are kept in
+ * the order they are evaluated, the chunks take the local arrays of the routine as arguments and the routine is left
+ * with no statements of its own, just the chunks to call. Routines assigning to anything other than an array element
+ * are not able to be split, as the value would not be passed on to the following chunks.
+ * @param routine The routine to split.
+ * @param maximumStatements The maximum number of statements in each chunk.
+ * @return The chunk routines, named <routine name>_chunk_<index>. Will be empty if the routine was not split.
+ */
+std::vector<CodeRoutine> splitRoutine(CodeRoutine& routine, size_t maximumStatements);
+
+#endif // CODE_ANALYSIS_H
@@ -6,6 +6,11 @@
 #include <vector>
 #include <cstdlib>
 #include <cstdio>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
 
 #include "clang/CodeGen/CodeGenAction.h"
 #include "clang/Basic/DiagnosticOptions.h"
@@ -16,21 +21,43 @@
 #include "clang/Frontend/CompilerInvocation.h"
 #include "clang/Frontend/FrontendDiagnostic.h"
 #include "clang/Frontend/TextDiagnosticPrinter.h"
+#include "llvm/Config/llvm-config.h"
 #include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Analysis/TargetLibraryInfo.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
+#if LLVM_VERSION_MAJOR >= 4
+#include "llvm/Bitcode/BitcodeReader.h"
+#else
+#include "llvm/Bitcode/ReaderWriter.h"
+#endif
 #include "llvm/ExecutionEngine/ExecutionEngine.h"
 #include "llvm/ExecutionEngine/MCJIT.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/LegacyPassManager.h"
 #include "llvm/IR/Module.h"
+#include "llvm/Linker/Linker.h"
+#include "llvm/Object/ObjectFile.h"
+#include "llvm/Support/DynamicLibrary.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/Host.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/ManagedStatic.h"
 #include "llvm/Support/Path.h"
 #include "llvm/Support/TargetSelect.h"
 #include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Transforms/IPO.h"
+#include "llvm/Transforms/IPO/PassManagerBuilder.h"
 #include <memory>
 using namespace clang;
 using namespace clang::driver;
 
 #include <csim/error_codes.h>
+#include "ir_generator.h"
+#include "vector_math.h"
+// generated at build time from runtime/csim_runtime.c
+#include "csim_runtime_bitcode.h"
 
 #define DUMMY_INPUT_FILENAME "/tmp/bob.c"
 
@@ -38,6 +65,8 @@ using namespace clang::driver;
 class LlvmObjects
 {
 public:
+    // only used for modules we generate ourselves, clang manages its own context
+    std::unique_ptr<llvm::LLVMContext> context;
     llvm::ExecutionEngine* ee;
 };
 
@@ -57,11 +86,12 @@ std::string GetExecutablePath(const char *Argv0) {
 }
 
 static llvm::ExecutionEngine *
-createExecutionEngine(std::unique_ptr<llvm::Module> M, std::string *ErrorStr) {
-    return llvm::EngineBuilder(std::move(M))
-            .setEngineKind(llvm::EngineKind::Either)
-            .setErrorStr(ErrorStr)
-            .create();
+createExecutionEngine(std::unique_ptr<llvm::Module> M, std::string *ErrorStr,
+                      llvm::TargetMachine* TM = nullptr) {
+    llvm::EngineBuilder builder(std::move(M));
+    builder.setEngineKind(llvm::EngineKind::Either).setErrorStr(ErrorStr);
+    // the execution engine takes ownership of the target machine
+    return TM ? builder.create(TM) : builder.create();
 }
 
 #if 0
@@ -93,8 +123,154 @@ static int Execute(LlvmObjects* llvmObjects) {
 }
 #endif
 
+static const char* const RUNTIME_FUNCTIONS[] = {
+    "factorial", "arbitrary_log", "gcd_pair", "lcm_pair", "gcd_multi", "lcm_multi", "multi_min", "multi_max",
+    "NR_MINIMISE"
+}; // the functions defined in runtime/csim_runtime.c
+
+/*
+ * Link the helper functions used by the generated code (factorial, gcd_multi, NR_MINIMISE, etc.) into the given
+ * module from the CSim runtime bitcode, so that they can be inlined into the model routines. Only the functions
+ * actually used are linked in, and they are made internal so that they don't clash between models.
+ */
+static int linkRuntime(llvm::Module& module)
+{
+    // most models use none of the runtime, so don't even parse it for them
+    bool used = false;
+    for (const char* name: RUNTIME_FUNCTIONS)
+    {
+        llvm::Function* function = module.getFunction(name);
+        if (function && function->isDeclaration()) used = true;
+    }
+    if (!used) return csim::CSIM_OK;
+    if (csimRuntimeBitcodeSize == 0) return csim::CSIM_OK; // built without the runtime bitcode
+    llvm::StringRef bitcode(reinterpret_cast<const char*>(csimRuntimeBitcode), csimRuntimeBitcodeSize);
+    llvm::MemoryBufferRef buffer(bitcode, "csim_runtime");
+    auto parsed = llvm::parseBitcodeFile(buffer, module.getContext());
+    if (!parsed)
+    {
+#if LLVM_VERSION_MAJOR >= 4
+        llvm::consumeError(parsed.takeError());
+#endif
+        std::cerr << "linkRuntime: Unable to parse the runtime bitcode." << std::endl;
+        return csim::COMPILER_UNABLE_TO_LINK_RUNTIME;
+    }
+    std::unique_ptr<llvm::Module> runtime = std::move(parsed.get());
+    runtime->setDataLayout(module.getDataLayout());
+    runtime->setTargetTriple(module.getTargetTriple());
+    std::vector<std::string> runtimeFunctions;
+    for (const auto& function: *runtime)
+        if (!function.isDeclaration()) runtimeFunctions.push_back(function.getName().str());
+    if (llvm::Linker::linkModules(module, std::move(runtime), llvm::Linker::Flags::LinkOnlyNeeded))
+    {
+        std::cerr << "linkRuntime: Unable to link the runtime into the module." << std::endl;
+        return csim::COMPILER_UNABLE_TO_LINK_RUNTIME;
+    }
+    for (const auto& name: runtimeFunctions)
+    {
+        llvm::Function* function = module.getFunction(name);
+        if (function && !function->isDeclaration()) function->setLinkage(llvm::GlobalValue::InternalLinkage);
+    }
+    return csim::CSIM_OK;
+}
+
+/*
+ * Register the native target with LLVM. The target registry is not safe to change from more than one thread at a
+ * time, so this is only ever done once, by the first thread to need it.
+ */
+static void initialiseNativeTarget()
+{
+    static std::once_flag initialised;
+    std::call_once(initialised, []() {
+        llvm::InitializeNativeTarget();
+        llvm::InitializeNativeTargetAsmPrinter();
+    });
+}
+
+/*
+ * Create a target machine for the host CPU with all of its features enabled, so that the generated code is able to
+ * use the widest vector instructions available.
+ */
+static llvm::TargetMachine* createHostTargetMachine(bool& avx2, bool& avx512)
+{
+    initialiseNativeTarget();
+    llvm::StringMap<bool> features;
+    llvm::SmallVector<std::string, 32> attributes;
+    if (llvm::sys::getHostCPUFeatures(features))
+    {
+        for (const auto& feature: features)
+            attributes.push_back((feature.second ? "+" : "-") + feature.first().str());
+    }
+    avx2 = features.lookup("avx2");
+    avx512 = features.lookup("avx512f");
+    llvm::EngineBuilder builder;
+    return builder.selectTarget(llvm::Triple(llvm::sys::getProcessTriple()), "", llvm::sys::getHostCPUName(),
+                                attributes);
+}
+
+/*
+ * Make sure every function in the module is compiled for the target machine. Clang marks the functions it generates
+ * with its default CPU, which would stop the optimiser from using (or calling vector math functions which use) the
+ * host's vector instructions.
+ */
+static void useTargetMachine(llvm::Module& module, llvm::TargetMachine* targetMachine, bool avx512)
+{
+    module.setTargetTriple(targetMachine->getTargetTriple().str());
+    module.setDataLayout(targetMachine->createDataLayout());
+    for (auto& function: module)
+    {
+        function.removeFnAttr("target-cpu");
+        function.removeFnAttr("target-features");
+        // otherwise 512 bit vectors are passed in pairs of 256 bit registers, which the vector math doesn't expect
+        if (avx512)
+        {
+            function.addFnAttr("prefer-vector-width", "512");
+            function.addFnAttr("min-legal-vector-width", "512");
+        }
+    }
+}
+
+/*
+ * Optimise the module the same way as the clang frontend would for the given optimisation level, allowing the
+ * vectorisers to replace calls to the scalar math functions with the given vector math functions.
+ */
+static void optimiseModule(llvm::Module& module, unsigned optimisationLevel, llvm::TargetMachine* targetMachine,
+                           const std::vector<VectorMathFunction>& vectorMath)
+{
+    llvm::PassManagerBuilder builder;
+    builder.OptLevel = optimisationLevel;
+    builder.LoopVectorize = builder.SLPVectorize = (optimisationLevel > 1);
+    // the runtime functions and the model routines used by the fused integrators need to be inlined
+    if (optimisationLevel > 1) builder.Inliner = llvm::createFunctionInliningPass();
+    llvm::TargetLibraryInfoImpl* library = new llvm::TargetLibraryInfoImpl(llvm::Triple(module.getTargetTriple()));
+    std::vector<llvm::VecDesc> vectorFunctions;
+    for (const auto& function: vectorMath)
+    {
+#if LLVM_VERSION_MAJOR >= 12
+        llvm::VecDesc description = { function.scalarName, function.vectorName,
+                                      llvm::ElementCount::getFixed(function.width) };
+#else
+        llvm::VecDesc description = { function.scalarName, function.vectorName, function.width };
+#endif
+        vectorFunctions.push_back(description);
+        llvm::sys::DynamicLibrary::AddSymbol(function.vectorName, function.address);
+    }
+    library->addVectorizableFunctions(vectorFunctions);
+    builder.LibraryInfo = library; // the builder takes ownership
+    llvm::legacy::FunctionPassManager functionPasses(&module);
+    functionPasses.add(llvm::createTargetTransformInfoWrapperPass(targetMachine->getTargetIRAnalysis()));
+    builder.populateFunctionPassManager(functionPasses);
+    llvm::legacy::PassManager modulePasses;
+    modulePasses.add(llvm::createTargetTransformInfoWrapperPass(targetMachine->getTargetIRAnalysis()));
+    builder.populateModulePassManager(modulePasses);
+    functionPasses.doInitialization();
+    for (auto& function: module) functionPasses.run(function);
+    functionPasses.doFinalization();
+    modulePasses.run(module);
+}
+
 Compiler::Compiler(bool verbose, bool debug) :
-    mVerbose(verbose), mDebug(debug), mLLVM(0)
+    mVerbose(verbose), mDebug(debug), mVectorMath(csim::AccurateVectorMath), mCompileTimeBudget(0.0), mLLVM(0)
 {
     //llvm::InitializeNativeTarget();
     //llvm::InitializeNativeTargetAsmPrinter();
@@ -202,12 +378,20 @@ int Compiler::compileCodeString(const std::string& code)
 
     if (std::unique_ptr<llvm::Module> Module = Act->takeModule())
     {
-        llvm::InitializeNativeTarget();
-        llvm::InitializeNativeTargetAsmPrinter();
+        // the runtime functions have only been declared in the code, so link them in and optimise again to inline
+        // them and make use of the host's vector instructions
+        int code = linkRuntime(*Module);
+        if (code != csim::CSIM_OK) return code;
+        bool avx2, avx512;
+        llvm::TargetMachine* targetMachine = createHostTargetMachine(avx2, avx512);
+        if (!targetMachine) return csim::COMPILER_UNABLE_TO_MAKE_EXECUTION_ENGINE;
+        useTargetMachine(*Module, targetMachine, avx512);
+        if (!mDebug)
+            optimiseModule(*Module, 3, targetMachine, getVectorMathFunctions(mVectorMath, avx2, avx512));
         mLLVM = new LlvmObjects();
         std::string Error;
         // This takes over managing the compiledModel object.
-        mLLVM->ee = createExecutionEngine(std::move(Module), &Error);
+        mLLVM->ee = createExecutionEngine(std::move(Module), &Error, targetMachine);
         if (! mLLVM->ee)
         {
             llvm::errs() << "unable to make execution engine: " << Error << "\n";
@@ -228,12 +412,276 @@ int Compiler::compileCodeString(const std::string& code)
     return csim::CSIM_OK;
 }
 
+/*
+ * The maximum number of statements in each chunk of a routine, beyond this the time taken to optimise a single
+ * function grows much faster than its size.
+ */
+static const size_t CHUNK_STATEMENTS = 1000;
+
+/*
+ * The state shared between the threads compiling the chunks of the model routines.
+ */
+class ChunkCompilation
+{
+public:
+    const std::vector<CodeRoutine>* chunks;
+    std::vector<VectorMathFunction> vectorMath;
+    bool verbose;
+    unsigned optimisationLevel;
+    double budget;
+    std::chrono::steady_clock::time_point start;
+    std::atomic<size_t> next;
+    std::mutex mutex;
+    // the time taken per statement to compile the chunks fully optimised so far
+    double optimisedSeconds, optimisedStatements;
+    int numberOfReducedChunks;
+    int code;
+    std::vector<std::unique_ptr<llvm::MemoryBuffer> > objects;
+
+    /*
+     * Choose the optimisation level for a chunk, dropping to a lower level if compiling the chunk fully optimised
+     * is expected to take us over the budget and not optimising at all once the budget is used up.
+     */
+    unsigned level(size_t numberOfStatements)
+    {
+        if ((budget <= 0.0) || (optimisationLevel == 0)) return optimisationLevel;
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::lock_guard<std::mutex> lock(mutex);
+        double estimate = (optimisedStatements > 0.0)
+                ? optimisedSeconds * numberOfStatements / optimisedStatements : 0.0;
+        unsigned chosen = optimisationLevel;
+        if (elapsed >= budget) chosen = 0;
+        else if (elapsed + estimate > budget) chosen = 1;
+        if (chosen < optimisationLevel) numberOfReducedChunks++;
+        return chosen;
+    }
+};
+
+/*
+ * Compile the chunks handed out by the given compilation into object code until there are none left. Each chunk is
+ * built in a context of its own, so any number of chunks can be compiled at the same time.
+ */
+static void compileChunks(ChunkCompilation* compilation)
+{
+    size_t i;
+    while ((i = compilation->next++) < compilation->chunks->size())
+    {
+        const CodeRoutine& chunk = (*compilation->chunks)[i];
+        auto start = std::chrono::steady_clock::now();
+        unsigned level = compilation->level(chunk.statements.size());
+        llvm::LLVMContext context;
+        std::unique_ptr<llvm::Module> module = generateModule(context, std::vector<CodeRoutine>(1, chunk),
+                                                              compilation->verbose);
+        int code = module ? linkRuntime(*module) : int(csim::COMPILER_UNABLE_TO_GENERATE_MODULE);
+        bool avx2, avx512;
+        std::unique_ptr<llvm::TargetMachine> targetMachine;
+        if (code == csim::CSIM_OK)
+        {
+            targetMachine.reset(createHostTargetMachine(avx2, avx512));
+            if (!targetMachine) code = csim::COMPILER_UNABLE_TO_MAKE_EXECUTION_ENGINE;
+        }
+        llvm::SmallVector<char, 0> object;
+        if (code == csim::CSIM_OK)
+        {
+            useTargetMachine(*module, targetMachine.get(), avx512);
+            optimiseModule(*module, level, targetMachine.get(), compilation->vectorMath);
+            llvm::raw_svector_ostream stream(object);
+            llvm::legacy::PassManager passes;
+#if LLVM_VERSION_MAJOR >= 18
+            bool failed = targetMachine->addPassesToEmitFile(passes, stream, nullptr,
+                                                             llvm::CodeGenFileType::ObjectFile);
+#elif LLVM_VERSION_MAJOR >= 10
+            bool failed = targetMachine->addPassesToEmitFile(passes, stream, nullptr, llvm::CGFT_ObjectFile);
+#elif LLVM_VERSION_MAJOR >= 7
+            bool failed = targetMachine->addPassesToEmitFile(passes, stream, nullptr,
+                                                             llvm::TargetMachine::CGFT_ObjectFile);
+#else
+            bool failed = targetMachine->addPassesToEmitFile(passes, stream, llvm::TargetMachine::CGFT_ObjectFile);
+#endif
+            if (failed) code = csim::COMPILER_UNABLE_TO_MAKE_EXECUTION_ENGINE;
+            else passes.run(*module);
+        }
+        std::lock_guard<std::mutex> lock(compilation->mutex);
+        if (code != csim::CSIM_OK)
+        {
+            std::cerr << "compileChunks: Unable to compile the routine chunk: " << chunk.name << std::endl;
+            compilation->code = code;
+            continue;
+        }
+        compilation->objects[i] = llvm::MemoryBuffer::getMemBufferCopy(llvm::StringRef(object.data(), object.size()),
+                                                                       chunk.name);
+        if (level == compilation->optimisationLevel)
+        {
+            compilation->optimisedSeconds +=
+                    std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            compilation->optimisedStatements += chunk.statements.size();
+        }
+    }
+}
+
+int Compiler::compileRoutines(const std::vector<CodeRoutine>& routines)
+{
+    ChunkCompilation compilation;
+    compilation.start = std::chrono::steady_clock::now();
+    // very large routines are split into chunks, which are compiled separately and in parallel
+    std::vector<CodeRoutine> mainRoutines = routines, chunks;
+    for (auto& routine: mainRoutines)
+    {
+        std::vector<CodeRoutine> split = splitRoutine(routine, CHUNK_STATEMENTS);
+        chunks.insert(chunks.end(), split.begin(), split.end());
+    }
+    std::unique_ptr<llvm::LLVMContext> context(new llvm::LLVMContext());
+    std::unique_ptr<llvm::Module> module = generateModule(*context, mainRoutines, mVerbose, chunks);
+    if (!module)
+    {
+        std::cerr << "Compiler::compileRoutines: Unable to generate the module." << std::endl;
+        return csim::COMPILER_UNABLE_TO_GENERATE_MODULE;
+    }
+
+    int code = linkRuntime(*module);
+    if (code != csim::CSIM_OK) return code;
+    bool avx2, avx512;
+    // the native target is registered here, on this thread, before any threads compiling chunks are started
+    initialiseNativeTarget();
+    llvm::TargetMachine* targetMachine = createHostTargetMachine(avx2, avx512);
+    if (!targetMachine) return csim::COMPILER_UNABLE_TO_MAKE_EXECUTION_ENGINE;
+    std::vector<VectorMathFunction> vectorMath = getVectorMathFunctions(mVectorMath, avx2, avx512);
+    if (!chunks.empty())
+    {
+        compilation.chunks = &chunks;
+        compilation.vectorMath = vectorMath;
+        compilation.verbose = mVerbose;
+        compilation.optimisationLevel = mDebug ? 0 : 3;
+        compilation.budget = mCompileTimeBudget;
+        compilation.next = 0;
+        compilation.optimisedSeconds = compilation.optimisedStatements = 0.0;
+        compilation.numberOfReducedChunks = 0;
+        compilation.code = csim::CSIM_OK;
+        compilation.objects.resize(chunks.size());
+        size_t numberOfThreads = std::max(1u, std::thread::hardware_concurrency());
+        numberOfThreads = std::min(numberOfThreads, chunks.size());
+        std::vector<std::thread> threads;
+        for (size_t t = 1; t < numberOfThreads; ++t) threads.push_back(std::thread(compileChunks, &compilation));
+        compileChunks(&compilation);
+        for (auto& thread: threads) thread.join();
+        if (compilation.code != csim::CSIM_OK)
+        {
+            delete targetMachine;
+            return compilation.code;
+        }
+        if (compilation.numberOfReducedChunks > 0)
+        {
+            std::cerr << "Compiler::compileRoutines: reduced the optimisation of "
+                      << compilation.numberOfReducedChunks << " of " << chunks.size()
+                      << " routine chunk(s) to keep within the compile time budget." << std::endl;
+        }
+    }
+    useTargetMachine(*module, targetMachine, avx512);
+    optimiseModule(*module, mDebug ? 0 : 3, targetMachine, vectorMath);
+
+    std::string Error;
+    llvm::ExecutionEngine* ee = createExecutionEngine(std::move(module), &Error, targetMachine);
+    if (! ee)
+    {
+        llvm::errs() << "unable to make execution engine: " << Error << "\n";
+        return csim::COMPILER_UNABLE_TO_MAKE_EXECUTION_ENGINE;
+    }
+    // the routines in the module call their chunks, which are resolved from the chunks' object code
+    for (auto& buffer: compilation.objects)
+    {
+        auto object = llvm::object::ObjectFile::createObjectFile(buffer->getMemBufferRef());
+        if (!object)
+        {
+#if LLVM_VERSION_MAJOR >= 4
+            llvm::consumeError(object.takeError());
+#endif
+            std::cerr << "Compiler::compileRoutines: Unable to load the object code for a routine chunk." << std::endl;
+            delete ee;
+            return csim::COMPILER_UNABLE_TO_MAKE_EXECUTION_ENGINE;
+        }
+        ee->addObjectFile(llvm::object::OwningBinary<llvm::object::ObjectFile>(std::move(*object),
+                                                                                std::move(buffer)));
+    }
+    ee->finalizeObject();
+    if (mLLVM) delete mLLVM;
+    mLLVM = new LlvmObjects();
+    mLLVM->context = std::move(context);
+    mLLVM->ee = ee;
+    return csim::CSIM_OK;
+}
+
 csim::InitialiseFunction Compiler::getInitialiseFunction()
 {
     return (csim::InitialiseFunction)(mLLVM->ee->getPointerToNamedFunction(
                                           "csim_initialise_routine"));
 }
 
+csim::StepFunction Compiler::getRushLarsenFunction()
+{
+    return (csim::StepFunction)(mLLVM->ee->getPointerToNamedFunction(
+                                    "csim_rush_larsen_routine"));
+}
+
+csim::IntegratorFunction Compiler::getIntegratorFunction(csim::IntegrationMethod method)
+{
+    // only generated when the routines are built directly, so don't abort if missing
+    const char* name = NULL;
+    if (method == csim::EulerMethod) name = "csim_euler_integrator";
+    else if (method == csim::RungeKutta4Method) name = "csim_rk4_integrator";
+    else if (method == csim::RushLarsenMethod) name = "csim_rush_larsen_integrator";
+    if (!name) return NULL;
+    return (csim::IntegratorFunction)(mLLVM->ee->getPointerToNamedFunction(name, false));
+}
+
+csim::PopulationIntegratorFunction Compiler::getPopulationIntegratorFunction(csim::IntegrationMethod method)
+{
+    // only generated when the routines are built directly, so don't abort if missing
+    const char* name = NULL;
+    if (method == csim::EulerMethod) name = "csim_population_euler_integrator";
+    else if (method == csim::RushLarsenMethod) name = "csim_population_rush_larsen_integrator";
+    if (!name) return NULL;
+    return (csim::PopulationIntegratorFunction)(mLLVM->ee->getPointerToNamedFunction(name, false));
+}
+
+csim::VariablesFunction Compiler::getVariablesFunction()
+{
+    return (csim::VariablesFunction)(mLLVM->ee->getPointerToNamedFunction(
+                                         "csim_variables_routine"));
+}
+
+PartitionFunction Compiler::getPartitionFunction(int index)
+{
+    // only generated when the model is to be evaluated in parallel, so don't abort if missing
+    std::string name = "csim_rhs_partition_" + std::to_string(index);
+    return (PartitionFunction)(mLLVM->ee->getPointerToNamedFunction(name, false));
+}
+
+LookupTableFunction Compiler::getLookupTableFunction()
+{
+    // only generated when lookup tables are requested, so don't abort if missing
+    return (LookupTableFunction)(mLLVM->ee->getPointerToNamedFunction(
+                                     "csim_lookup_table_routine", false));
+}
+
+csim::ModelFunctionFloat Compiler::getModelFunctionFloat()
+{
+    // only generated for single precision models
+    return (csim::ModelFunctionFloat)(mLLVM->ee->getPointerToNamedFunction(
+                                          "csim_rhs_routine_float", false));
+}
+
+csim::InitialiseFunctionFloat Compiler::getInitialiseFunctionFloat()
+{
+    return (csim::InitialiseFunctionFloat)(mLLVM->ee->getPointerToNamedFunction(
+                                               "csim_initialise_routine_float", false));
+}
+
+PrecisionErrorFunction Compiler::getPrecisionErrorFunction()
+{
+    return (PrecisionErrorFunction)(mLLVM->ee->getPointerToNamedFunction(
+                                        "csim_precision_error_routine", false));
+}
+
 csim::ModelFunction Compiler::getModelFunction()
 {
     return (csim::ModelFunction)(mLLVM->ee->getPointerToNamedFunction(
@@ -2,10 +2,31 @@
 #define COMPILER_H
 
 #include <string>
+#include <vector>
 #include "csim/executable_functions.h"
+#include "code_analysis.h"
 
 class LlvmObjects;
 
+/**
+ * The generated routine used to fill in the model's lookup tables, returning the maximum interpolation error.
+ */
+typedef double (*LookupTableFunction)();
+
+/**
+ * The generated routine used to compare the reduced precision model function against the double precision one,
+ * returning the maximum relative difference.
+ */
+typedef double (*PrecisionErrorFunction)();
+
+/**
+ * The generated routines evaluating one partition of the model function when it is evaluated in parallel. The
+ * constants and algebraic variables are shared between the partitions rather than local to each routine.
+ *
+ * partition(voi, states, rates, outputs, inputs, constants, algebraic)
+ */
+typedef void (*PartitionFunction)(double, double*, double*, double*, double*, double*, double*);
+
 class Compiler
 {
 public:
@@ -13,8 +34,57 @@ public:
     ~Compiler();
 
     int compileCodeString(const std::string& code);
+
+    /**
+     * Build the given routines directly into executable code, without going through C code and the clang frontend.
+     * @param routines The routines to compile, all of which must be structured.
+     * @return csim::CSIM_OK on success, otherwise an error code.
+     */
+    int compileRoutines(const std::vector<CodeRoutine>& routines);
+    /**
+     * Set the vector math library to use when vectorising calls to the math functions in the compiled code.
+     * @param vectorMath The vector math library.
+     */
+    inline void setVectorMath(csim::VectorMath vectorMath)
+    {
+        mVectorMath = vectorMath;
+    }
+    /**
+     * Set the time allowed for compiling the routines of a model. Very large routines are split into chunks which
+     * are compiled separately, and chunks which are expected to take the compilation over the budget are compiled
+     * with less optimisation.
+     * @param seconds The compile time budget, in seconds. Zero or less means there is no limit.
+     */
+    inline void setCompileTimeBudget(double seconds)
+    {
+        mCompileTimeBudget = seconds;
+    }
     csim::ModelFunction getModelFunction();
     csim::InitialiseFunction getInitialiseFunction();
+    csim::StepFunction getRushLarsenFunction();
+    /**
+     * Get the fused integrator for the given method, which is only available for models built directly.
+     * @param method The integration method.
+     * @return The integrator function, or NULL if it is not available.
+     */
+    csim::IntegratorFunction getIntegratorFunction(csim::IntegrationMethod method);
+    /**
+     * Get the population integrator for the given method, which is only available for models built directly.
+     * @param method The integration method.
+     * @return The population integrator function, or NULL if it is not available.
+     */
+    csim::PopulationIntegratorFunction getPopulationIntegratorFunction(csim::IntegrationMethod method);
+    csim::VariablesFunction getVariablesFunction();
+    /**
+     * Get the routine evaluating the given partition of the model function.
+     * @param index The index of the partition.
+     * @return The partition function, or NULL if it is not available.
+     */
+    PartitionFunction getPartitionFunction(int index);
+    LookupTableFunction getLookupTableFunction();
+    csim::ModelFunctionFloat getModelFunctionFloat();
+    csim::InitialiseFunctionFloat getInitialiseFunctionFloat();
+    PrecisionErrorFunction getPrecisionErrorFunction();
     inline bool isVerbose() const
     {
         return mVerbose;
@@ -27,6 +97,8 @@ public:
 private:
     bool mVerbose;
     bool mDebug;
+    csim::VectorMath mVectorMath;
+    double mCompileTimeBudget;
     LlvmObjects* mLLVM;
 };
 
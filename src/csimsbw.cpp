@@ -1,5 +1,9 @@
+#include <algorithm>
+#include <cmath>
+#include <fstream>
 #include <iostream>
 #include <map>
+#include <vector>
 #include <cstring>
 
 #include <csimsbw.h>
@@ -7,17 +11,35 @@
 #include "csim/model.h"
 #include "csim/executable_functions.h"
 #include "csim/error_codes.h"
+#include "csim/result_writer.h"
+#include "csim/result_format.h"
+#include "csim/mapped_results.h"
+#include "csim/statistics.h"
+#include "csim/biomarkers.h"
+#include "csim/steady_state.h"
+#include "csim/limit_cycle.h"
 #include "xmlutils.h"
 
 #define CSIM_SUCCESS 0
 #define CSIM_FAILED 1
 
+#define CSIM_EULER 0
+#define CSIM_RUSH_LARSEN 1
+#define CSIM_RUNGE_KUTTA 2
+
+// why the last simulation stopped
+#define CSIM_END_TIME 0
+#define CSIM_STEADY 1
+#define CSIM_NON_FINITE 2
+#define CSIM_OUT_OF_BOUNDS 3
+#define CSIM_STOPPED 4
+
 // assuming we only deal with one model at a time
 class CsimWrapper {
 public:
-    CsimWrapper() : initFunction(NULL), modelFunction(NULL), model(NULL),
-        voi(0.0), states(NULL), rates(NULL), inputs(NULL), outputs(NULL),
-        maxSteps(1)
+    CsimWrapper() : initFunction(NULL), modelFunction(NULL), stepFunction(NULL), integrator(NULL),
+        variablesFunction(NULL), model(NULL), voi(0.0), states(NULL), rates(NULL), inputs(NULL), outputs(NULL),
+        maxSteps(1), method(CSIM_EULER)
     {}
     ~CsimWrapper() {
         if (model) delete model;
@@ -27,13 +49,127 @@ public:
         if (outputs) delete [] outputs;
     }
 
+    // all the variables are evaluated using the variables function, so no outputs need to be flagged
+    void evaluateVariables()
+    {
+        variablesFunction(voi, states, inputs, variables.data(), selection.data());
+    }
+
+    // the current values of the output variables, in the same order as csim_getVariables
+    void sample(double* values)
+    {
+        evaluateVariables();
+        for (size_t i = 0; i < outputOrder.size(); ++i) values[i] = variables[outputOrder[i]];
+    }
+
+    // simulate the model, passing the samples to the callback a block at a time, optionally with the
+    // variable of integration as the first value of each sample
+    int simulate(double initialTime, double startTime, double endTime, int numSteps, int blockRows,
+                 csim_SampleCallback callback, void* userData, bool withTime = false)
+    {
+        if ((numSteps < 0) || (blockRows < 1) || !callback) return CSIM_FAILED;
+        int length = outputOrder.size() + (withTime ? 1 : 0);
+        std::vector<double> block(size_t(blockRows) * length + 1);
+        // set the initial time and step to the start time
+        voi = initialTime;
+        integrate(startTime);
+        for (auto& d: detectors) d.detector.reset(1, d.detector.threshold());
+        termination.reason = CSIM_END_TIME;
+        termination.time = endTime;
+        termination.steadySince = voi;
+        double dt = (endTime - startTime) / ((double)numSteps);
+        int rows = 0;
+        for (int n=0; n<=numSteps; ++n)
+        {
+            if (n > 0) integrate(voi + dt);
+            double* row = block.data() + size_t(rows) * length;
+            if (withTime) *(row++) = voi;
+            sample(row);
+            for (auto& d: detectors) d.detector.add(voi, row + d.column);
+            int reason = checkTermination(row);
+            if ((++rows == blockRows) || (n == numSteps) || (reason != CSIM_END_TIME))
+            {
+                if (callback(block.data(), rows, length, userData) != 0)
+                {
+                    reason = CSIM_STOPPED;
+                }
+                rows = 0;
+            }
+            if (reason != CSIM_END_TIME)
+            {
+                termination.reason = reason;
+                termination.time = voi;
+                break;
+            }
+        }
+        return CSIM_SUCCESS;
+    }
+
+    // check the current state against the termination criteria, with the samples of the variables
+    // taken at the same time
+    int checkTermination(const double* values)
+    {
+        int n = model->numberOfStateVariables();
+        termination.largestRate = 0.0;
+        // written so that a NaN rate is the largest, and never counts as steady
+        for (int i=0; i<n; ++i)
+        {
+            double rate = std::fabs(rates[i]);
+            if (!(rate <= termination.largestRate)) termination.largestRate = rate;
+        }
+        if (termination.nonFinite)
+        {
+            for (int i=0; i<n; ++i) if (!std::isfinite(states[i])) return CSIM_NON_FINITE;
+        }
+        // written so that NaN is out of bounds too
+        for (const auto& b: termination.bounds)
+        {
+            if (!((values[b.column] >= b.lower) && (values[b.column] <= b.upper))) return CSIM_OUT_OF_BOUNDS;
+        }
+        if (termination.rateTolerance > 0.0)
+        {
+            if (!(termination.largestRate <= termination.rateTolerance)) termination.steadySince = voi;
+            else if (voi - termination.steadySince >= termination.window) return CSIM_STEADY;
+        }
+        return CSIM_END_TIME;
+    }
+
     csim::InitialiseFunction initFunction;
     csim::ModelFunction modelFunction;
+    csim::StepFunction stepFunction;
+    csim::IntegratorFunction integrator; // the fused integrator for the current method, if available
+    csim::VariablesFunction variablesFunction;
+    std::vector<double> variables, selection;
+    std::vector<int> outputOrder; // the index of each output variable in variables
     csim::Model* model;
     std::map<std::string, int> inputVariables;
     std::map<std::string, int> outputVariables;
     double voi, *states, *rates, *inputs, *outputs;
     int maxSteps; // currently used to define how many steps to take internally
+    struct Detector
+    {
+        std::string variableId;
+        int column; // the index of the variable in the samples
+        csim::BiomarkerDetector detector;
+    };
+    std::vector<Detector> detectors; // run on every sample of every simulation
+    csim::SteadyStateSolver steadyStateSolver;
+    csim::LimitCycleSolver limitCycleSolver;
+    struct Bounds
+    {
+        int column; // the index of the variable in the samples
+        double lower, upper;
+    };
+    struct
+    {
+        double rateTolerance = 0.0; // stop once the largest absolute rate stays below this, if positive
+        double window = 0.0; // for at least this long
+        bool nonFinite = false; // stop as soon as a state is NaN or infinite
+        std::vector<Bounds> bounds; // stop as soon as a variable leaves its bounds
+        int reason = CSIM_END_TIME; // why the last simulation stopped
+        double time = 0.0, largestRate = 0.0, steadySince = 0.0;
+    } termination;
+    int method; // the integration method to use
 
     struct
     {
@@ -83,8 +219,27 @@ public:
         return CSIM_SUCCESS;
     }
 
+    int setMethod(int m)
+    {
+        csim::IntegrationMethod methods[] = { csim::EulerMethod, csim::RushLarsenMethod, csim::RungeKutta4Method };
+        csim::IntegratorFunction f = model->getIntegratorFunction(methods[m]);
+        // there is no fallback for Runge-Kutta when the model was compiled using clang
+        if ((m == CSIM_RUNGE_KUTTA) && !f) return CSIM_FAILED;
+        method = m;
+        integrator = f;
+        return CSIM_SUCCESS;
+    }
+
     int integrate(double tOut)
     {
+        if (integrator)
+        {
+            // all the steps in a single call, evaluating the model at the start of each step
+            integrator(voi, (tOut - voi) / ((double)maxSteps), maxSteps, states, rates, outputs, inputs, NULL);
+            voi = tOut;
+            return CSIM_SUCCESS;
+        }
+        if (method == CSIM_RUSH_LARSEN) return integrateRushLarsen(tOut);
         int n = model->numberOfStateVariables();
         double interval = tOut - voi;
         double step = interval / ((double)maxSteps);
@@ -100,10 +255,30 @@ public:
         }
         return CSIM_SUCCESS;
     }
+
+    int integrateRushLarsen(double tOut)
+    {
+        double interval = tOut - voi;
+        double step = interval / ((double)maxSteps);
+        for (int j=0; j<maxSteps; ++j)
+        {
+            stepFunction(voi, step, states, rates, outputs, inputs);
+            voi += step;
+        }
+        return CSIM_SUCCESS;
+    }
 };
 
 static CsimWrapper* _csim = NULL;
 
+// the entry points using the model fail, rather than crash, when no model has been loaded successfully
+static bool modelLoaded()
+{
+    if (_csim && _csim->model && _csim->modelFunction) return true;
+    std::cerr << "No model has been loaded" << std::endl;
+    return false;
+}
+
 int csim_loadCellml(const char* modelString)
 {
     if (_csim) delete _csim;
@@ -117,7 +292,6 @@ int csim_loadCellml(const char* modelString)
     }
     // need to flag all the variables before instantiating
     _csim->inputVariables = _csim->model->setAllVariablesAsInput();
-    _csim->outputVariables = _csim->model->setAllVariablesAsOutput();
     code = _csim->model->instantiate();
     if (code != csim::CSIM_OK)
     {
@@ -129,17 +303,26 @@ int csim_loadCellml(const char* modelString)
         _csim->states = new double[_csim->model->numberOfStateVariables()];
         _csim->rates = new double[_csim->model->numberOfStateVariables()];
     }
-    if (_csim->model->numberOfOutputVariables() > 0)
+    if (_csim->model->numberOfInputVariables() > 0)
     {
         _csim->inputs = new double[_csim->model->numberOfInputVariables()];
     }
-    if (_csim->model->numberOfInputVariables() > 0)
+    if (_csim->model->numberOfOutputVariables() > 0)
     {
         _csim->outputs = new double[_csim->model->numberOfOutputVariables()];
     }
+    _csim->outputVariables = _csim->model->getAllVariableIndices();
+    for (const auto& ov: _csim->outputVariables) _csim->outputOrder.push_back(ov.second);
+    _csim->variables.assign(_csim->model->numberOfVariables(), 0.0);
+    std::vector<int> all;
+    for (int i = 0; i < _csim->model->numberOfVariables(); ++i) all.push_back(i);
+    _csim->selection = _csim->model->selectVariables(all);
+    _csim->variablesFunction = _csim->model->getVariablesFunction();
     _csim->initFunction = _csim->model->getInitialiseFunction();
     _csim->initFunction(_csim->states, _csim->outputs, _csim->inputs);
     _csim->modelFunction = _csim->model->getModelFunction();
+    _csim->stepFunction = _csim->model->getRushLarsenFunction();
+    _csim->setMethod(CSIM_EULER);
     _csim->modelFunction(_csim->voi, _csim->states, _csim->rates, _csim->outputs,
                          _csim->inputs);
     _csim->cacheState();
@@ -187,57 +370,414 @@ double* _getValues(int* length)
 {
     *length = _csim->outputVariables.size();
     double* values = (double*)malloc(sizeof(double)*(*length));
-    int i = 0;
-    for (const auto& ov: _csim->outputVariables)
-    {
-        values[i++] = _csim->outputs[ov.second];
-    }
+    _csim->sample(values);
     return values;
 }
 
 int csim_getValues(double* *outArray, int *outLength)
 {
-    // make sure we are up-to-date
-    _csim->modelFunction(_csim->voi, _csim->states, _csim->rates, _csim->outputs,
-                         _csim->inputs);
     *outArray = _getValues(outLength);
     return CSIM_SUCCESS;
 }
 
 int csim_steadyState()
 {
-    return CSIM_FAILED;
+    if (!modelLoaded()) return CSIM_FAILED;
+    int code = _csim->steadyStateSolver.solve(_csim->modelFunction, _csim->voi,
+                                              _csim->model->numberOfStateVariables(), _csim->states, _csim->rates,
+                                              _csim->outputs, _csim->inputs);
+    if (code != csim::CSIM_OK)
+    {
+        std::cerr << "Unable to find a steady state, the largest rate is: "
+                  << _csim->steadyStateSolver.diagnostics().residualNorm << std::endl;
+        return CSIM_FAILED;
+    }
+    return CSIM_SUCCESS;
+}
+
+int csim_setSteadyStateOptions(double tolerance, int maxNewtonIterations, int maxPseudoTransientSteps)
+{
+    if (!modelLoaded()) return CSIM_FAILED;
+    if ((_csim->steadyStateSolver.setTolerance(tolerance) != csim::CSIM_OK) ||
+            (_csim->steadyStateSolver.setMaximumIterations(maxNewtonIterations, maxPseudoTransientSteps) !=
+             csim::CSIM_OK)) return CSIM_FAILED;
+    return CSIM_SUCCESS;
+}
+
+int csim_getSteadyStateDiagnostics(double* *outArray, int *outLength)
+{
+    if (!modelLoaded()) return CSIM_FAILED;
+    const csim::SteadyStateDiagnostics& diagnostics = _csim->steadyStateSolver.diagnostics();
+    double* values = (double*)malloc(sizeof(double)*6);
+    values[0] = diagnostics.converged ? 1.0 : 0.0;
+    values[1] = diagnostics.newtonIterations;
+    values[2] = diagnostics.pseudoTransientSteps;
+    values[3] = diagnostics.modelEvaluations;
+    values[4] = diagnostics.residualNorm;
+    values[5] = diagnostics.stepNorm;
+    *outArray = values;
+    *outLength = 6;
+    return CSIM_SUCCESS;
+}
+
+int csim_limitCycle(double period, int numSteps, int maxBeats)
+{
+    if (!modelLoaded()) return CSIM_FAILED;
+    if (!(period > 0.0) || (numSteps < 1) || (_csim->limitCycleSolver.setMaximumBeats(maxBeats) != csim::CSIM_OK))
+        return CSIM_FAILED;
+    int n = _csim->model->numberOfStateVariables();
+    double startTime = _csim->voi;
+    double dt = period / ((double)numSteps);
+    // every period is simulated from the current time with the current integration method
+    csim::PeriodMap periodMap = [&](double* states) {
+        std::copy(states, states + n, _csim->states);
+        _csim->voi = startTime;
+        for (int i=1; i<=numSteps; ++i) _csim->integrate(startTime + i * dt);
+        std::copy(_csim->states, _csim->states + n, states);
+    };
+    std::vector<double> states(_csim->states, _csim->states + n);
+    int code = _csim->limitCycleSolver.solve(periodMap, n, states.data());
+    std::copy(states.begin(), states.end(), _csim->states);
+    _csim->voi = startTime;
+    if (code != csim::CSIM_OK)
+    {
+        std::cerr << "Unable to find a limit cycle, the change over the last period relative to the tolerances is: "
+                  << _csim->limitCycleSolver.diagnostics().residualNorm << std::endl;
+        return CSIM_FAILED;
+    }
+    return CSIM_SUCCESS;
+}
+
+int csim_setLimitCycleOptions(double relTol, double absTol, int pacedBeats, int krylovIterations)
+{
+    if (!modelLoaded()) return CSIM_FAILED;
+    if ((_csim->limitCycleSolver.setTolerances(relTol, absTol) != csim::CSIM_OK) ||
+            (_csim->limitCycleSolver.setShooting(pacedBeats, krylovIterations) != csim::CSIM_OK)) return CSIM_FAILED;
+    return CSIM_SUCCESS;
+}
+
+int csim_getLimitCycleDiagnostics(double* *outArray, int *outLength)
+{
+    if (!modelLoaded()) return CSIM_FAILED;
+    const csim::LimitCycleDiagnostics& diagnostics = _csim->limitCycleSolver.diagnostics();
+    double* values = (double*)malloc(sizeof(double)*6);
+    values[0] = diagnostics.converged ? 1.0 : 0.0;
+    values[1] = diagnostics.beats;
+    values[2] = diagnostics.pacedBeats;
+    values[3] = diagnostics.newtonIterations;
+    values[4] = diagnostics.krylovIterations;
+    values[5] = diagnostics.residualNorm;
+    *outArray = values;
+    *outLength = 6;
+    return CSIM_SUCCESS;
+}
+
+int csim_checkpoint()
+{
+    if (!modelLoaded()) return CSIM_FAILED;
+    return _csim->cacheState();
+}
+
+// collect the streamed samples into the rows of a matrix
+struct MatrixCollector
+{
+    double** data;
+    int rows;
+};
+
+static int collectRows(const double* samples, int numRows, int numCols, void* userData)
+{
+    MatrixCollector* collector = static_cast<MatrixCollector*>(userData);
+    for (int r=0; r<numRows; ++r)
+    {
+        double* row = (double*)malloc(sizeof(double)*numCols);
+        memcpy(row, samples + size_t(r) * numCols, sizeof(double)*numCols);
+        collector->data[collector->rows++] = row;
+    }
+    return 0;
 }
 
 int csim_simulate(
         double initialTime, double startTime, double endTime, int numSteps,
         double** *outMatrix, int* outRows, int *outCols)
 {
-    int length = _csim->outputVariables.size();
     int nData = numSteps + 1;
-    double** data = (double**)malloc(sizeof(double*)*nData);
-    //for (int i=0; i<length; ++i) data[i] = (double*)malloc(sizeof(double)*nData);
-    // set the initial time
-    _csim->voi = initialTime;
-    // step to the start time
-    _csim->integrate(startTime);
-    // grab the values
-    data[0] = _getValues(&length);
-    //std::cout << std::endl;
-    double dt = (endTime - startTime) / ((double)numSteps);
-    for (int n=1; n<=numSteps; ++n)
-    {
-        csim_oneStep(dt);
-        data[n] = _getValues(&length);
-    }
-    *outCols = length;
-    *outRows = nData;
+    MatrixCollector collector;
+    collector.data = (double**)malloc(sizeof(double*)*nData);
+    collector.rows = 0;
+    int code = _csim->simulate(initialTime, startTime, endTime, numSteps, 64, collectRows, &collector);
+    if (code != CSIM_SUCCESS)
+    {
+        free(collector.data);
+        return code;
+    }
+    *outCols = _csim->outputOrder.size();
+    *outRows = collector.rows;
+    *outMatrix = collector.data;
+    return CSIM_SUCCESS;
+}
+
+int csim_simulateStreaming(
+        double initialTime, double startTime, double endTime, int numSteps, int blockRows,
+        csim_SampleCallback callback, void* userData)
+{
+    if (!modelLoaded()) return CSIM_FAILED;
+    return _csim->simulate(initialTime, startTime, endTime, numSteps, blockRows, callback, userData);
+}
+
+// hand the streamed samples over to a result writer
+static int writeRows(const double* samples, int numRows, int numCols, void* userData)
+{
+    csim::ResultWriter* writer = static_cast<csim::ResultWriter*>(userData);
+    for (int r=0; r<numRows; ++r) writer->addRow(samples + size_t(r) * numCols);
+    return 0;
+}
+
+int csim_simulateToFile(
+        double initialTime, double startTime, double endTime, int numSteps, const char* fileName)
+{
+    if (!modelLoaded()) return CSIM_FAILED;
+    std::ofstream file(fileName);
+    if (!file)
+    {
+        std::cerr << "Unable to open the results file: " << fileName << std::endl;
+        return CSIM_FAILED;
+    }
+    std::vector<std::string> header;
+    for (const auto& ov: _csim->outputVariables) header.push_back(ov.first);
+    file.precision(17);
+    csim::TextResultSink sink(file, header);
+    csim::ResultWriter writer;
+    if (writer.start(&sink, header.size(), 1024, 4) != csim::CSIM_OK) return CSIM_FAILED;
+    int code = _csim->simulate(initialTime, startTime, endTime, numSteps, 64, writeRows, &writer);
+    if (writer.finish() != csim::CSIM_OK)
+    {
+        std::cerr << "Error writing the results file: " << fileName << std::endl;
+        return CSIM_FAILED;
+    }
+    return code;
+}
+
+int csim_simulateToCompressedFile(
+        double initialTime, double startTime, double endTime, int numSteps, const char* fileName)
+{
+    if (!modelLoaded()) return CSIM_FAILED;
+    std::vector<std::string> columns(1, "time");
+    for (const auto& ov: _csim->outputVariables) columns.push_back(ov.first);
+    csim::CompressedResultSink sink;
+    if (sink.open(fileName, columns, 0) != csim::CSIM_OK) return CSIM_FAILED;
+    // the columns are compressed on the writer thread, a chunk per block
+    csim::ResultWriter writer;
+    if (writer.start(&sink, columns.size(), 4096, 4) != csim::CSIM_OK) return CSIM_FAILED;
+    int code = _csim->simulate(initialTime, startTime, endTime, numSteps, 64, writeRows, &writer, true);
+    if (writer.finish() != csim::CSIM_OK)
+    {
+        std::cerr << "Error writing the results file: " << fileName << std::endl;
+        return CSIM_FAILED;
+    }
+    return code;
+}
+
+int csim_simulateToMappedFile(
+        double initialTime, double startTime, double endTime, int numSteps, const char* fileName)
+{
+    if (!modelLoaded()) return CSIM_FAILED;
+    std::vector<std::string> columns(1, "time");
+    for (const auto& ov: _csim->outputVariables) columns.push_back(ov.first);
+    csim::MappedResultSink sink;
+    // all the samples fit without growing the file
+    uint64_t rows = uint64_t(std::max(numSteps, 0)) + 1;
+    if (sink.open(fileName, columns, 0, rows) != csim::CSIM_OK) return CSIM_FAILED;
+    // small blocks so readers see the results soon after they are produced
+    csim::ResultWriter writer;
+    if (writer.start(&sink, columns.size(), 256, 4) != csim::CSIM_OK) return CSIM_FAILED;
+    int code = _csim->simulate(initialTime, startTime, endTime, numSteps, 64, writeRows, &writer, true);
+    if (writer.finish() != csim::CSIM_OK)
+    {
+        std::cerr << "Error writing the results file: " << fileName << std::endl;
+        return CSIM_FAILED;
+    }
+    return code;
+}
+
+// reduce the streamed samples, the first value of each row being the time
+static int reduceRows(const double* samples, int numRows, int numCols, void* userData)
+{
+    csim::RunningStatistics* statistics = static_cast<csim::RunningStatistics*>(userData);
+    for (int r=0; r<numRows; ++r)
+    {
+        const double* row = samples + size_t(r) * numCols;
+        statistics->add(row[0], row + 1);
+    }
+    return 0;
+}
+
+int csim_simulateStatistics(
+        double initialTime, double startTime, double endTime, int numSteps,
+        double** *outMatrix, int* outRows, int *outCols)
+{
+    if (!modelLoaded()) return CSIM_FAILED;
+    int nVariables = _csim->outputOrder.size();
+    csim::RunningStatistics statistics;
+    statistics.reset(nVariables);
+    int code = _csim->simulate(initialTime, startTime, endTime, numSteps, 64, reduceRows, &statistics, true);
+    if (code != CSIM_SUCCESS) return code;
+    const int nStatistics = 6;
+    double** data = (double**)malloc(sizeof(double*)*nStatistics);
+    for (int r=0; r<nStatistics; ++r) data[r] = (double*)malloc(sizeof(double)*nVariables);
+    for (int i=0; i<nVariables; ++i)
+    {
+        data[0][i] = statistics.mean(i);
+        data[1][i] = statistics.variance(i);
+        data[2][i] = statistics.minimum(i);
+        data[3][i] = statistics.maximum(i);
+        data[4][i] = statistics.timeOfMinimum(i);
+        data[5][i] = statistics.timeOfMaximum(i);
+    }
+    *outRows = nStatistics;
+    *outCols = nVariables;
     *outMatrix = data;
     return CSIM_SUCCESS;
 }
 
+int csim_addBiomarkers(const char* variableId, double threshold)
+{
+    if (!modelLoaded()) return CSIM_FAILED;
+    int column = 0;
+    for (const auto& ov: _csim->outputVariables)
+    {
+        if (ov.first == variableId) break;
+        ++column;
+    }
+    if (column == int(_csim->outputVariables.size()))
+    {
+        std::cerr << "Unknown variable for biomarkers: " << variableId << std::endl;
+        return CSIM_FAILED;
+    }
+    CsimWrapper::Detector* detector = NULL;
+    for (auto& d: _csim->detectors) if (d.variableId == variableId) detector = &d;
+    if (!detector)
+    {
+        _csim->detectors.push_back(CsimWrapper::Detector());
+        detector = &_csim->detectors.back();
+        detector->variableId = variableId;
+        detector->column = column;
+    }
+    detector->detector.reset(1, threshold);
+    return CSIM_SUCCESS;
+}
+
+int csim_clearBiomarkers()
+{
+    if (!modelLoaded()) return CSIM_FAILED;
+    _csim->detectors.clear();
+    return CSIM_SUCCESS;
+}
+
+int csim_getBiomarkers(const char* variableId, double* *outArray, int *outLength)
+{
+    if (!modelLoaded()) return CSIM_FAILED;
+    for (const auto& d: _csim->detectors)
+    {
+        if (d.variableId != variableId) continue;
+        const csim::Biomarkers& biomarkers = d.detector.biomarkers(0);
+        double* values = (double*)malloc(sizeof(double)*7);
+        values[0] = biomarkers.numberOfBeats;
+        values[1] = biomarkers.restingValue;
+        values[2] = biomarkers.peak;
+        values[3] = biomarkers.maximumUpstrokeVelocity;
+        values[4] = biomarkers.apd50;
+        values[5] = biomarkers.apd90;
+        values[6] = biomarkers.cycleLength;
+        *outArray = values;
+        *outLength = 7;
+        return CSIM_SUCCESS;
+    }
+    std::cerr << "No biomarkers for variable: " << variableId << std::endl;
+    return CSIM_FAILED;
+}
+
+int csim_setTermination(double rateTolerance, double window, int stopOnNonFinite)
+{
+    if (!modelLoaded()) return CSIM_FAILED;
+    if (window < 0.0)
+    {
+        std::cerr << "The steady state window must not be negative: " << window << std::endl;
+        return CSIM_FAILED;
+    }
+    _csim->termination.rateTolerance = rateTolerance;
+    _csim->termination.window = window;
+    _csim->termination.nonFinite = (stopOnNonFinite != 0);
+    return CSIM_SUCCESS;
+}
+
+int csim_setTerminationBounds(const char* variableId, double lowerBound, double upperBound)
+{
+    if (!modelLoaded()) return CSIM_FAILED;
+    int column = 0;
+    for (const auto& ov: _csim->outputVariables)
+    {
+        if (ov.first == variableId) break;
+        ++column;
+    }
+    if ((column == int(_csim->outputVariables.size())) || !(lowerBound <= upperBound))
+    {
+        std::cerr << "Invalid termination bounds for variable: " << variableId << std::endl;
+        return CSIM_FAILED;
+    }
+    CsimWrapper::Bounds bounds;
+    bounds.column = column;
+    bounds.lower = lowerBound;
+    bounds.upper = upperBound;
+    for (auto& b: _csim->termination.bounds)
+    {
+        if (b.column == column)
+        {
+            b = bounds;
+            return CSIM_SUCCESS;
+        }
+    }
+    _csim->termination.bounds.push_back(bounds);
+    return CSIM_SUCCESS;
+}
+
+int csim_clearTermination()
+{
+    if (!modelLoaded()) return CSIM_FAILED;
+    _csim->termination.rateTolerance = 0.0;
+    _csim->termination.window = 0.0;
+    _csim->termination.nonFinite = false;
+    _csim->termination.bounds.clear();
+    return CSIM_SUCCESS;
+}
+
+int csim_getTermination(double* *outArray, int *outLength)
+{
+    if (!modelLoaded()) return CSIM_FAILED;
+    double* values = (double*)malloc(sizeof(double)*3);
+    values[0] = _csim->termination.reason;
+    values[1] = _csim->termination.time;
+    values[2] = _csim->termination.largestRate;
+    *outArray = values;
+    *outLength = 3;
+    return CSIM_SUCCESS;
+}
+
+// the samples are not needed, only what the biomarker detectors make of them
+static int discardRows(const double*, int, int, void*)
+{
+    return 0;
+}
+
+int csim_simulateBiomarkers(double initialTime, double startTime, double endTime, int numSteps)
+{
+    if (!modelLoaded()) return CSIM_FAILED;
+    return _csim->simulate(initialTime, startTime, endTime, numSteps, 64, discardRows, NULL);
+}
+
 int csim_oneStep(double step)
 {
+    if (!modelLoaded()) return CSIM_FAILED;
     double final = _csim->voi + step;
     _csim->integrate(final);
     return CSIM_SUCCESS;
@@ -249,6 +789,17 @@ int csim_setTolerances(double aTol, double rTol, int maxSteps)
     return CSIM_SUCCESS;
 }
 
+int csim_setIntegrator(const char* method)
+{
+    if (!modelLoaded()) return CSIM_FAILED;
+    std::string m(method);
+    if (m == "euler") return _csim->setMethod(CSIM_EULER);
+    if (m == "rush-larsen") return _csim->setMethod(CSIM_RUSH_LARSEN);
+    if (m == "runge-kutta") return _csim->setMethod(CSIM_RUNGE_KUTTA);
+    std::cerr << "Unknown integration method: " << m << std::endl;
+    return CSIM_FAILED;
+}
+
 int csim_sayHello(char* *outString, int *outLength)
 {
     *outLength = 11;
@@ -0,0 +1,815 @@
+#include "ir_generator.h"
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <set>
+#include <string>
+#include <cstdlib>
+#include <functional>
+
+#include "csim/executable_functions.h"
+
+#include "llvm/Config/llvm-config.h"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Intrinsics.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/Support/raw_ostream.h"
+
+/*
+ * Builds a single routine into a function in the given module. The cell version of a routine (<name>_cell) evaluates
+ * one cell of a population stored as structures of arrays, it takes the stride of the arrays and the index of the
+ * cell as two extra integer arguments and element i of its array arguments is element i * stride + cell of the
+ * population's arrays. Local arrays are still local to each call.
+ */
+class RoutineBuilder
+{
+public:
+    RoutineBuilder(llvm::Module* module, const CodeRoutine& routine, bool cell = false) :
+        mModule(module), mRoutine(routine), mCell(cell), mBuilder(module->getContext()),
+        mDouble(llvm::Type::getDoubleTy(module->getContext())), mStride(NULL), mCellIndex(NULL)
+    {
+    }
+
+    bool build()
+    {
+        llvm::LLVMContext& context = mModule->getContext();
+        std::string name = mCell ? (mRoutine.name + "_cell") : mRoutine.name;
+        if (mCell && !mRoutine.chunks.empty())
+        {
+            std::cerr << "RoutineBuilder::build: unable to build the cell version of a routine split into chunks: "
+                      << mRoutine.name << std::endl;
+            return false;
+        }
+        std::vector<llvm::Type*> argumentTypes;
+        for (const auto& a: mRoutine.arguments)
+            argumentTypes.push_back(a.second ? llvm::Type::getDoublePtrTy(context) : mDouble);
+        if (mCell) argumentTypes.insert(argumentTypes.end(), 2, llvm::Type::getInt64Ty(context));
+        llvm::FunctionType* type = llvm::FunctionType::get(llvm::Type::getVoidTy(context), argumentTypes, false);
+        // chunks may already have been declared by the routine calling them
+        mFunction = mModule->getFunction(name);
+        if (mFunction && !(mFunction->isDeclaration() && (mFunction->getFunctionType() == type)))
+        {
+            std::cerr << "RoutineBuilder::build: duplicate routine: " << name << std::endl;
+            return false;
+        }
+        if (!mFunction) mFunction = llvm::Function::Create(type, llvm::Function::ExternalLinkage, name, mModule);
+        llvm::BasicBlock* entry = llvm::BasicBlock::Create(context, "entry", mFunction);
+        mBuilder.SetInsertPoint(entry);
+
+        size_t i = 0;
+        for (auto argument = mFunction->arg_begin(); argument != mFunction->arg_end(); ++argument, ++i)
+        {
+            if (i >= mRoutine.arguments.size())
+            {
+                argument->setName((i == mRoutine.arguments.size()) ? "CSIM_STRIDE" : "CSIM_CELL");
+                if (i == mRoutine.arguments.size()) mStride = &*argument;
+                else mCellIndex = &*argument;
+                continue;
+            }
+            const std::string& name = mRoutine.arguments[i].first;
+            argument->setName(name);
+            if (mRoutine.arguments[i].second)
+            {
+                mArrays[name] = &*argument;
+                if (mCell) mCellArrays.insert(name);
+            }
+            else
+            {
+                // scalars live in memory so they can be treated the same as any other assigned identifier
+                llvm::Value* scalar = mBuilder.CreateAlloca(mDouble, nullptr, name);
+                mBuilder.CreateStore(&*argument, scalar);
+                mScalars[name] = scalar;
+            }
+        }
+        for (const auto& array: mRoutine.localArrays)
+        {
+            // zero sized arrays are fine in C but would be pointless here
+            llvm::ArrayType* arrayType = llvm::ArrayType::get(mDouble, (array.second > 0) ? array.second : 1);
+            llvm::Value* storage = mBuilder.CreateAlloca(arrayType, nullptr, array.first);
+            mArrays[array.first] = mBuilder.CreateConstInBoundsGEP2_32(arrayType, storage, 0, 0);
+        }
+
+        for (const auto& chunk: mRoutine.chunks) callChunk(chunk);
+        for (const auto& statement: mRoutine.statements)
+        {
+            if (!statement.expression)
+            {
+                std::cerr << "RoutineBuilder::build: unable to build unstructured statement: " << statement.code
+                          << std::endl;
+                return false;
+            }
+            llvm::BasicBlock* next = NULL;
+            if (statement.condition)
+            {
+                llvm::Value* condition = expression(statement.condition);
+                if (!condition) return false;
+                llvm::BasicBlock* assign = llvm::BasicBlock::Create(context, "assign", mFunction);
+                next = llvm::BasicBlock::Create(context, "next", mFunction);
+                mBuilder.CreateCondBr(truth(condition), assign, next);
+                mBuilder.SetInsertPoint(assign);
+            }
+            llvm::Value* target = address(parseCodeExpression(statement.target), true);
+            llvm::Value* value = expression(statement.expression);
+            if (!(target && value)) return false;
+            mBuilder.CreateStore(value, target);
+            if (next)
+            {
+                mBuilder.CreateBr(next);
+                mBuilder.SetInsertPoint(next);
+            }
+        }
+        mBuilder.CreateRetVoid();
+        if (llvm::verifyFunction(*mFunction, &llvm::errs()))
+        {
+            std::cerr << "RoutineBuilder::build: invalid function generated for: " << name << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+private:
+    llvm::Module* mModule;
+    const CodeRoutine& mRoutine;
+    bool mCell;
+    llvm::IRBuilder<> mBuilder;
+    llvm::Type* mDouble;
+    llvm::Function* mFunction;
+    llvm::Value* mStride;
+    llvm::Value* mCellIndex;
+    std::map<std::string, llvm::Value*> mArrays;
+    std::map<std::string, llvm::Value*> mScalars;
+    std::set<std::string> mCellArrays; // the arrays holding the values of every cell
+
+    llvm::Value* address(const CodeExpressionPtr& e, bool assignment)
+    {
+        if (e && (e->type == CodeExpression::Reference))
+        {
+            auto array = mArrays.find(e->value);
+            if ((array != mArrays.end()) && mCellArrays.count(e->value))
+            {
+                llvm::Value* index = mBuilder.CreateMul(mBuilder.getInt64(e->index), mStride);
+                return mBuilder.CreateInBoundsGEP(mDouble, array->second, mBuilder.CreateAdd(index, mCellIndex));
+            }
+            if (array != mArrays.end())
+                return mBuilder.CreateConstInBoundsGEP1_32(mDouble, array->second, e->index);
+        }
+        else if (e && (e->type == CodeExpression::Identifier))
+        {
+            auto scalar = mScalars.find(e->value);
+            if (scalar != mScalars.end()) return scalar->second;
+            if (assignment)
+            {
+                // a new local variable, which needs to be allocated in the entry block
+                llvm::IRBuilder<> entry(&mFunction->getEntryBlock(), mFunction->getEntryBlock().begin());
+                llvm::Value* local = entry.CreateAlloca(mDouble, nullptr, e->value);
+                mScalars[e->value] = local;
+                return local;
+            }
+        }
+        std::cerr << "RoutineBuilder::address: unknown variable: " << (e ? e->toString() : "") << " in routine: "
+                  << mRoutine.name << std::endl;
+        return NULL;
+    }
+
+    void callChunk(const std::string& name)
+    {
+        // chunks take the arguments of the routine followed by its local arrays
+        llvm::Type* pointer = llvm::Type::getDoublePtrTy(mModule->getContext());
+        std::vector<llvm::Type*> types;
+        std::vector<llvm::Value*> values;
+        for (const auto& a: mRoutine.arguments)
+        {
+            types.push_back(a.second ? pointer : mDouble);
+            values.push_back(a.second ? mArrays[a.first] : mBuilder.CreateLoad(mDouble, mScalars[a.first]));
+        }
+        for (const auto& array: mRoutine.localArrays)
+        {
+            types.push_back(pointer);
+            values.push_back(mArrays[array.first]);
+        }
+        llvm::FunctionType* type = llvm::FunctionType::get(llvm::Type::getVoidTy(mModule->getContext()), types, false);
+        llvm::Function* f = mModule->getFunction(name);
+        if (!f) f = llvm::Function::Create(type, llvm::Function::ExternalLinkage, name, mModule);
+        mBuilder.CreateCall(f, values);
+    }
+
+    llvm::Value* truth(llvm::Value* value)
+    {
+        // anything other than zero is true, including NaN
+        return mBuilder.CreateFCmpUNE(value, llvm::ConstantFP::get(mDouble, 0.0));
+    }
+
+    llvm::Value* number(llvm::Value* condition)
+    {
+        return mBuilder.CreateUIToFP(condition, mDouble);
+    }
+
+    llvm::Function* function(const std::string& name, size_t numberOfArguments)
+    {
+        llvm::Function* f = mModule->getFunction(name);
+        if (f)
+        {
+            if (f->arg_size() != numberOfArguments)
+            {
+                std::cerr << "RoutineBuilder::function: inconsistent number of arguments in call to: " << name
+                          << std::endl;
+                return NULL;
+            }
+            return f;
+        }
+        std::vector<llvm::Type*> argumentTypes(numberOfArguments, mDouble);
+        llvm::FunctionType* type = llvm::FunctionType::get(mDouble, argumentTypes, false);
+        f = llvm::Function::Create(type, llvm::Function::ExternalLinkage, name, mModule);
+        // nothing is interested in errno, so the math library functions are pure which allows them to be vectorised
+        static const std::set<std::string> mathFunctions = {
+            "acos", "acosh", "asin", "asinh", "atan", "atanh", "cosh", "sinh", "tan", "tanh"
+        };
+        if (mathFunctions.count(name))
+        {
+            f->setDoesNotAccessMemory();
+            f->setDoesNotThrow();
+        }
+        return f;
+    }
+
+    llvm::Function* intrinsic(const std::string& name, size_t numberOfArguments)
+    {
+        // the libm functions with an LLVM intrinsic, which the optimiser understands (and is able to vectorise)
+        static const std::map<std::string, std::pair<llvm::Intrinsic::ID, size_t> > intrinsics = {
+            { "exp", { llvm::Intrinsic::exp, 1 } }, { "log", { llvm::Intrinsic::log, 1 } },
+            { "log10", { llvm::Intrinsic::log10, 1 } }, { "pow", { llvm::Intrinsic::pow, 2 } },
+            { "sin", { llvm::Intrinsic::sin, 1 } }, { "cos", { llvm::Intrinsic::cos, 1 } },
+            { "fabs", { llvm::Intrinsic::fabs, 1 } }, { "floor", { llvm::Intrinsic::floor, 1 } },
+            { "ceil", { llvm::Intrinsic::ceil, 1 } }, { "sqrt", { llvm::Intrinsic::sqrt, 1 } }
+        };
+        auto i = intrinsics.find(name);
+        if ((i == intrinsics.end()) || (i->second.second != numberOfArguments)) return NULL;
+        return llvm::Intrinsic::getDeclaration(mModule, i->second.first, mDouble);
+    }
+
+    llvm::Value* variadicCall(const std::string& name, const std::vector<llvm::Value*>& values)
+    {
+        // expand the variadic functions into a chain of simple operations the optimiser is able to see through
+        if (values.empty())
+        {
+            std::cerr << "RoutineBuilder::variadicCall: no arguments given to: " << name << std::endl;
+            return NULL;
+        }
+        llvm::Function* pair = NULL;
+        if (name == "gcd_multi") pair = function("gcd_pair", 2);
+        else if (name == "lcm_multi") pair = function("lcm_pair", 2);
+        if ((name == "gcd_multi" || name == "lcm_multi") && !pair) return NULL;
+        llvm::Value* result = values[0];
+        for (size_t i = 1; i < values.size(); ++i)
+        {
+            if (pair) result = mBuilder.CreateCall(pair, { result, values[i] });
+            else if (name == "multi_min")
+                result = mBuilder.CreateSelect(mBuilder.CreateFCmpOLT(values[i], result), values[i], result);
+            else result = mBuilder.CreateSelect(mBuilder.CreateFCmpOGT(values[i], result), values[i], result);
+        }
+        // match the C versions, which start from gcd 0 and lcm 1
+        if (pair && (values.size() == 1))
+            result = mBuilder.CreateCall(pair, { llvm::ConstantFP::get(mDouble, (name == "gcd_multi") ? 0.0 : 1.0),
+                                                 result });
+        return result;
+    }
+
+    llvm::Value* call(const CodeExpressionPtr& e)
+    {
+        // the variadic functions take the number of arguments as their first argument, which is implied here
+        bool variadic = (e->value == "gcd_multi") || (e->value == "lcm_multi") || (e->value == "multi_min")
+                || (e->value == "multi_max");
+        std::vector<llvm::Value*> arguments;
+        for (size_t i = variadic ? 1 : 0; i < e->arguments.size(); ++i)
+        {
+            llvm::Value* a = expression(e->arguments[i]);
+            if (!a) return NULL;
+            arguments.push_back(a);
+        }
+        if (variadic) return variadicCall(e->value, arguments);
+        llvm::Function* f = intrinsic(e->value, arguments.size());
+        if (!f) f = function(e->value, arguments.size());
+        if (!f) return NULL;
+        return mBuilder.CreateCall(f, arguments);
+    }
+
+    llvm::Value* expression(const CodeExpressionPtr& e)
+    {
+        switch (e->type)
+        {
+        case CodeExpression::Number:
+            return llvm::ConstantFP::get(mDouble, std::strtod(e->value.c_str(), NULL));
+        case CodeExpression::Reference:
+        case CodeExpression::Identifier:
+        {
+            llvm::Value* a = address(e, false);
+            if (!a) return NULL;
+            return mBuilder.CreateLoad(mDouble, a);
+        }
+        case CodeExpression::Call:
+            return call(e);
+        case CodeExpression::Unary:
+        {
+            llvm::Value* operand = expression(e->arguments[0]);
+            if (!operand) return NULL;
+            if (e->value == "-") return mBuilder.CreateFNeg(operand);
+            if (e->value == "+") return operand;
+            if (e->value == "!") return number(mBuilder.CreateNot(truth(operand)));
+            break;
+        }
+        case CodeExpression::Binary:
+        {
+            llvm::Value* a = expression(e->arguments[0]);
+            llvm::Value* b = expression(e->arguments[1]);
+            if (!(a && b)) return NULL;
+            const std::string& op = e->value;
+            if (op == "+") return mBuilder.CreateFAdd(a, b);
+            if (op == "-") return mBuilder.CreateFSub(a, b);
+            if (op == "*") return mBuilder.CreateFMul(a, b);
+            if (op == "/") return mBuilder.CreateFDiv(a, b);
+            if (op == "<") return number(mBuilder.CreateFCmpOLT(a, b));
+            if (op == ">") return number(mBuilder.CreateFCmpOGT(a, b));
+            if (op == "<=") return number(mBuilder.CreateFCmpOLE(a, b));
+            if (op == ">=") return number(mBuilder.CreateFCmpOGE(a, b));
+            if (op == "==") return number(mBuilder.CreateFCmpOEQ(a, b));
+            if (op == "!=") return number(mBuilder.CreateFCmpUNE(a, b));
+            // the operands have no side effects, so there is no need to short circuit
+            if (op == "&&") return number(mBuilder.CreateAnd(truth(a), truth(b)));
+            if (op == "||") return number(mBuilder.CreateOr(truth(a), truth(b)));
+            break;
+        }
+        case CodeExpression::Conditional:
+        {
+            llvm::Value* condition = expression(e->arguments[0]);
+            llvm::Value* a = expression(e->arguments[1]);
+            llvm::Value* b = expression(e->arguments[2]);
+            if (!(condition && a && b)) return NULL;
+            return mBuilder.CreateSelect(truth(condition), a, b);
+        }
+        }
+        std::cerr << "RoutineBuilder::expression: unable to build expression: " << e->toString() << std::endl;
+        return NULL;
+    }
+};
+
+/*
+ * Builds the fused fixed step integrators for a model, which advance the model by a number of steps in a single call.
+ * The model routine is inlined into the loop over the steps and the states are kept in local arrays, so the optimiser
+ * is able to keep them in registers from one step to the next.
+ */
+class IntegratorBuilder
+{
+public:
+    IntegratorBuilder(llvm::Module* module, int numberOfStates, int numberOfOutputs) :
+        mModule(module), mBuilder(module->getContext()), mDouble(llvm::Type::getDoubleTy(module->getContext())),
+        mNumberOfStates(numberOfStates), mNumberOfOutputs(numberOfOutputs)
+    {
+    }
+
+    bool build(const std::string& name, csim::IntegrationMethod method, llvm::Function* routine)
+    {
+        llvm::LLVMContext& context = mModule->getContext();
+        llvm::Type* pointer = llvm::Type::getDoublePtrTy(context);
+        llvm::Type* integer = llvm::Type::getInt32Ty(context);
+        llvm::FunctionType* type = llvm::FunctionType::get(
+                    llvm::Type::getVoidTy(context),
+                    { mDouble, mDouble, integer, pointer, pointer, pointer, pointer, pointer }, false);
+        mFunction = llvm::Function::Create(type, llvm::Function::ExternalLinkage, name, mModule);
+        std::vector<llvm::Value*> arguments;
+        for (auto argument = mFunction->arg_begin(); argument != mFunction->arg_end(); ++argument)
+            arguments.push_back(&*argument);
+        llvm::Value* voi = arguments[0];
+        llvm::Value* step = arguments[1];
+        llvm::Value* numberOfSteps = arguments[2];
+        llvm::Value* states = arguments[3];
+        llvm::Value* rates = arguments[4];
+        llvm::Value* outputs = arguments[5];
+        llvm::Value* inputs = arguments[6];
+        llvm::Value* samples = arguments[7];
+        // the arrays are all distinct, which lets the optimiser move loads of the inputs out of the loop
+        for (unsigned i = 3; i < 8; ++i)
+        {
+#if LLVM_VERSION_MAJOR >= 5
+            mFunction->addParamAttr(i, llvm::Attribute::NoAlias);
+#else
+            mFunction->setDoesNotAlias(i + 1);
+#endif
+        }
+        routine->addFnAttr(llvm::Attribute::AlwaysInline);
+
+        llvm::BasicBlock* entry = llvm::BasicBlock::Create(context, "entry", mFunction);
+        mBuilder.SetInsertPoint(entry);
+        llvm::Value* y = localArray("y", mNumberOfStates);
+        llvm::Value* r = localArray("r", mNumberOfStates);
+        copy(states, y);
+        copy(rates, r);
+        llvm::Value* hasSamples = mBuilder.CreateICmpNE(samples, llvm::ConstantPointerNull::get(
+                                                            llvm::cast<llvm::PointerType>(pointer)));
+
+        llvm::BasicBlock* header = llvm::BasicBlock::Create(context, "step", mFunction);
+        llvm::BasicBlock* body = llvm::BasicBlock::Create(context, "body", mFunction);
+        llvm::BasicBlock* sample = llvm::BasicBlock::Create(context, "sample", mFunction);
+        llvm::BasicBlock* latch = llvm::BasicBlock::Create(context, "next", mFunction);
+        llvm::BasicBlock* exit = llvm::BasicBlock::Create(context, "exit", mFunction);
+        llvm::BasicBlock* preheader = mBuilder.GetInsertBlock();
+        mBuilder.CreateBr(header);
+        mBuilder.SetInsertPoint(header);
+        llvm::PHINode* i = mBuilder.CreatePHI(integer, 2, "i");
+        i->addIncoming(llvm::ConstantInt::get(integer, 0), preheader);
+        mBuilder.CreateCondBr(mBuilder.CreateICmpSLT(i, numberOfSteps), body, exit);
+
+        mBuilder.SetInsertPoint(body);
+        // avoid accumulating round off in the variable of integration
+        llvm::Value* t = mBuilder.CreateFAdd(voi, mBuilder.CreateFMul(mBuilder.CreateSIToFP(i, mDouble), step));
+        if (method == csim::EulerMethod)
+        {
+            mBuilder.CreateCall(routine, { t, y, r, outputs, inputs });
+            forEachState([&](llvm::Value* j) {
+                store(y, j, mBuilder.CreateFAdd(load(y, j), mBuilder.CreateFMul(load(r, j), step)));
+            });
+        }
+        else if (method == csim::RushLarsenMethod) mBuilder.CreateCall(routine, { t, step, y, r, outputs, inputs });
+        else if (method == csim::RungeKutta4Method) rungeKutta4(routine, t, step, y, r, outputs, inputs);
+        else
+        {
+            std::cerr << "IntegratorBuilder::build: unknown integration method: " << method << std::endl;
+            return false;
+        }
+        mBuilder.CreateCondBr(hasSamples, sample, latch);
+
+        mBuilder.SetInsertPoint(sample);
+        llvm::Value* row = mBuilder.CreateMul(mBuilder.CreateSExt(i, mBuilder.getInt64Ty()),
+                                              mBuilder.getInt64(mNumberOfStates));
+        forEachState([&](llvm::Value* j) {
+            mBuilder.CreateStore(load(y, j), mBuilder.CreateInBoundsGEP(mDouble, samples, mBuilder.CreateAdd(row, j)));
+        });
+        mBuilder.CreateBr(latch);
+
+        mBuilder.SetInsertPoint(latch);
+        llvm::Value* next = mBuilder.CreateAdd(i, llvm::ConstantInt::get(integer, 1));
+        i->addIncoming(next, latch);
+        mBuilder.CreateBr(header);
+
+        mBuilder.SetInsertPoint(exit);
+        copy(y, states);
+        copy(r, rates);
+        mBuilder.CreateRetVoid();
+        if (llvm::verifyFunction(*mFunction, &llvm::errs()))
+        {
+            std::cerr << "IntegratorBuilder::build: invalid function generated for: " << name << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+private:
+    llvm::Module* mModule;
+    llvm::IRBuilder<> mBuilder;
+    llvm::Type* mDouble;
+    llvm::Function* mFunction;
+    int mNumberOfStates, mNumberOfOutputs;
+
+    static const int UNROLLED_STATES = 256;
+
+    llvm::Value* localArray(const std::string& name, int size)
+    {
+        // allocated in the entry block, so they can be promoted to registers
+        llvm::IRBuilder<> entry(&mFunction->getEntryBlock(), mFunction->getEntryBlock().begin());
+        llvm::ArrayType* arrayType = llvm::ArrayType::get(mDouble, (size > 0) ? size : 1);
+        llvm::Value* storage = entry.CreateAlloca(arrayType, nullptr, name);
+        return entry.CreateConstInBoundsGEP2_32(arrayType, storage, 0, 0);
+    }
+
+    llvm::Value* load(llvm::Value* array, llvm::Value* index)
+    {
+        return mBuilder.CreateLoad(mDouble, mBuilder.CreateInBoundsGEP(mDouble, array, index));
+    }
+
+    void store(llvm::Value* array, llvm::Value* index, llvm::Value* value)
+    {
+        mBuilder.CreateStore(value, mBuilder.CreateInBoundsGEP(mDouble, array, index));
+    }
+
+    void copy(llvm::Value* from, llvm::Value* to)
+    {
+        forEachState([&](llvm::Value* j) { store(to, j, load(from, j)); });
+    }
+
+    /*
+     * Build the given operation on each state. For all but the largest models this is unrolled, so that the states
+     * are able to be kept in registers, otherwise it is built as a loop to stop the integrator growing with the
+     * number of states and taking too long to optimise.
+     */
+    void forEachState(const std::function<void(llvm::Value*)>& operation)
+    {
+        if (mNumberOfStates <= UNROLLED_STATES)
+        {
+            for (int j = 0; j < mNumberOfStates; ++j) operation(mBuilder.getInt64(j));
+            return;
+        }
+        llvm::LLVMContext& context = mModule->getContext();
+        llvm::BasicBlock* before = mBuilder.GetInsertBlock();
+        llvm::BasicBlock* loop = llvm::BasicBlock::Create(context, "each_state", mFunction);
+        llvm::BasicBlock* done = llvm::BasicBlock::Create(context, "each_state_done", mFunction);
+        mBuilder.CreateBr(loop);
+        mBuilder.SetInsertPoint(loop);
+        llvm::PHINode* j = mBuilder.CreatePHI(mBuilder.getInt64Ty(), 2, "j");
+        j->addIncoming(mBuilder.getInt64(0), before);
+        operation(j);
+        llvm::Value* next = mBuilder.CreateAdd(j, mBuilder.getInt64(1));
+        j->addIncoming(next, mBuilder.GetInsertBlock());
+        mBuilder.CreateCondBr(mBuilder.CreateICmpSLT(next, mBuilder.getInt64(mNumberOfStates)), loop, done);
+        mBuilder.SetInsertPoint(done);
+    }
+
+    void rungeKutta4(llvm::Function* routine, llvm::Value* t, llvm::Value* step, llvm::Value* y, llvm::Value* r,
+                     llvm::Value* outputs, llvm::Value* inputs)
+    {
+        // the stages are a loop around a single call to the model routine, so it is only inlined once. Only the
+        // first stage gives the rates and outputs at the start of the step, the others write their outputs to a
+        // scratch array
+        llvm::Value* k = localArray("k", mNumberOfStates);
+        llvm::Value* sum = localArray("sum", mNumberOfStates);
+        llvm::Value* stageStates = localArray("stage_states", mNumberOfStates);
+        llvm::Value* scratch = localArray("stage_outputs", mNumberOfOutputs);
+        llvm::Value* zero = llvm::ConstantFP::get(mDouble, 0.0);
+        forEachState([&](llvm::Value* j) {
+            store(k, j, zero);
+            store(sum, j, zero);
+        });
+        llvm::LLVMContext& context = mModule->getContext();
+        llvm::Type* integer = llvm::Type::getInt32Ty(context);
+        llvm::BasicBlock* before = mBuilder.GetInsertBlock();
+        llvm::BasicBlock* stage = llvm::BasicBlock::Create(context, "stage", mFunction);
+        llvm::BasicBlock* done = llvm::BasicBlock::Create(context, "stages_done", mFunction);
+        mBuilder.CreateBr(stage);
+        mBuilder.SetInsertPoint(stage);
+        llvm::PHINode* s = mBuilder.CreatePHI(integer, 2, "s");
+        s->addIncoming(llvm::ConstantInt::get(integer, 0), before);
+        llvm::Value* first = mBuilder.CreateICmpEQ(s, llvm::ConstantInt::get(integer, 0));
+        llvm::Value* last = mBuilder.CreateICmpEQ(s, llvm::ConstantInt::get(integer, 3));
+        // stage offsets (0, 1/2, 1/2, 1) and weights (1, 2, 2, 1)/6
+        llvm::Value* c = mBuilder.CreateSelect(first, zero, mBuilder.CreateSelect(
+                                                   last, llvm::ConstantFP::get(mDouble, 1.0),
+                                                   llvm::ConstantFP::get(mDouble, 0.5)));
+        llvm::Value* w = mBuilder.CreateSelect(mBuilder.CreateOr(first, last), llvm::ConstantFP::get(mDouble, 1.0),
+                                               llvm::ConstantFP::get(mDouble, 2.0));
+        llvm::Value* h = mBuilder.CreateFMul(c, step);
+        forEachState([&](llvm::Value* j) {
+            store(stageStates, j, mBuilder.CreateFAdd(load(y, j), mBuilder.CreateFMul(h, load(k, j))));
+        });
+        mBuilder.CreateCall(routine, { mBuilder.CreateFAdd(t, h), stageStates, k,
+                                       mBuilder.CreateSelect(first, outputs, scratch), inputs });
+        forEachState([&](llvm::Value* j) {
+            llvm::Value* kj = load(k, j);
+            store(sum, j, mBuilder.CreateFAdd(load(sum, j), mBuilder.CreateFMul(w, kj)));
+            store(r, j, mBuilder.CreateSelect(first, kj, load(r, j)));
+        });
+        llvm::Value* next = mBuilder.CreateAdd(s, llvm::ConstantInt::get(integer, 1));
+        s->addIncoming(next, mBuilder.GetInsertBlock());
+        mBuilder.CreateCondBr(last, done, stage);
+        mBuilder.SetInsertPoint(done);
+        llvm::Value* sixth = mBuilder.CreateFDiv(step, llvm::ConstantFP::get(mDouble, 6.0));
+        forEachState([&](llvm::Value* j) {
+            store(y, j, mBuilder.CreateFAdd(load(y, j), mBuilder.CreateFMul(sixth, load(sum, j))));
+        });
+    }
+};
+
+/*
+ * Builds the population integrators, which advance a population of cells of the same model by a number of fixed
+ * steps. The population is stored as structures of arrays, so that the value of each variable is contiguous across
+ * the cells. The cells are advanced a block at a time, which keeps the block in cache from one step to the next, and
+ * the loop over the cells of a block is marked as free of dependencies between the cells to let the optimiser
+ * vectorise it.
+ */
+class PopulationBuilder
+{
+public:
+    PopulationBuilder(llvm::Module* module, int numberOfStates) :
+        mModule(module), mBuilder(module->getContext()), mDouble(llvm::Type::getDoubleTy(module->getContext())),
+        mNumberOfStates(numberOfStates)
+    {
+    }
+
+    bool build(const std::string& name, csim::IntegrationMethod method, llvm::Function* routine)
+    {
+        if ((method != csim::EulerMethod) && (method != csim::RushLarsenMethod))
+        {
+            std::cerr << "PopulationBuilder::build: unsupported integration method: " << method << std::endl;
+            return false;
+        }
+        llvm::LLVMContext& context = mModule->getContext();
+        llvm::Type* pointer = llvm::Type::getDoublePtrTy(context);
+        llvm::Type* integer = llvm::Type::getInt32Ty(context);
+        llvm::Type* index = llvm::Type::getInt64Ty(context);
+        llvm::FunctionType* type = llvm::FunctionType::get(
+                    llvm::Type::getVoidTy(context),
+                    { mDouble, mDouble, integer, integer, integer, integer, pointer, pointer, pointer, pointer },
+                    false);
+        mFunction = llvm::Function::Create(type, llvm::Function::ExternalLinkage, name, mModule);
+        std::vector<llvm::Value*> arguments;
+        for (auto argument = mFunction->arg_begin(); argument != mFunction->arg_end(); ++argument)
+            arguments.push_back(&*argument);
+        llvm::Value* voi = arguments[0];
+        llvm::Value* step = arguments[1];
+        llvm::Value* numberOfSteps = arguments[2];
+        llvm::Value* states = arguments[6];
+        llvm::Value* rates = arguments[7];
+        llvm::Value* outputs = arguments[8];
+        llvm::Value* inputs = arguments[9];
+        for (unsigned i = 6; i < 10; ++i)
+        {
+#if LLVM_VERSION_MAJOR >= 5
+            mFunction->addParamAttr(i, llvm::Attribute::NoAlias);
+#else
+            mFunction->setDoesNotAlias(i + 1);
+#endif
+        }
+        routine->addFnAttr(llvm::Attribute::AlwaysInline);
+
+        llvm::BasicBlock* entry = llvm::BasicBlock::Create(context, "entry", mFunction);
+        llvm::BasicBlock* blockHeader = llvm::BasicBlock::Create(context, "block", mFunction);
+        llvm::BasicBlock* blockBody = llvm::BasicBlock::Create(context, "block_body", mFunction);
+        llvm::BasicBlock* stepHeader = llvm::BasicBlock::Create(context, "step", mFunction);
+        llvm::BasicBlock* stepBody = llvm::BasicBlock::Create(context, "step_body", mFunction);
+        llvm::BasicBlock* cells = llvm::BasicBlock::Create(context, "cells", mFunction);
+        llvm::BasicBlock* stepLatch = llvm::BasicBlock::Create(context, "next_step", mFunction);
+        llvm::BasicBlock* blockLatch = llvm::BasicBlock::Create(context, "next_block", mFunction);
+        llvm::BasicBlock* exit = llvm::BasicBlock::Create(context, "exit", mFunction);
+
+        mBuilder.SetInsertPoint(entry);
+        llvm::Value* stride = mBuilder.CreateSExt(arguments[3], index);
+        llvm::Value* first = mBuilder.CreateSExt(arguments[4], index);
+        llvm::Value* last = mBuilder.CreateSExt(arguments[5], index);
+        mBuilder.CreateBr(blockHeader);
+
+        mBuilder.SetInsertPoint(blockHeader);
+        llvm::PHINode* b = mBuilder.CreatePHI(index, 2, "b");
+        b->addIncoming(first, entry);
+        mBuilder.CreateCondBr(mBuilder.CreateICmpSLT(b, last), blockBody, exit);
+
+        mBuilder.SetInsertPoint(blockBody);
+        llvm::Value* blockEnd = mBuilder.CreateAdd(b, mBuilder.getInt64(BLOCK_CELLS));
+        llvm::Value* end = mBuilder.CreateSelect(mBuilder.CreateICmpSLT(blockEnd, last), blockEnd, last);
+        mBuilder.CreateBr(stepHeader);
+
+        mBuilder.SetInsertPoint(stepHeader);
+        llvm::PHINode* i = mBuilder.CreatePHI(integer, 2, "i");
+        i->addIncoming(llvm::ConstantInt::get(integer, 0), blockBody);
+        mBuilder.CreateCondBr(mBuilder.CreateICmpSLT(i, numberOfSteps), stepBody, blockLatch);
+
+        mBuilder.SetInsertPoint(stepBody);
+        // avoid accumulating round off in the variable of integration
+        llvm::Value* t = mBuilder.CreateFAdd(voi, mBuilder.CreateFMul(mBuilder.CreateSIToFP(i, mDouble), step));
+        mBuilder.CreateBr(cells);
+
+        // there is always at least one cell in a block
+        mBuilder.SetInsertPoint(cells);
+        llvm::PHINode* c = mBuilder.CreatePHI(index, 2, "c");
+        c->addIncoming(b, stepBody);
+        std::vector<llvm::Instruction*> accesses;
+        if (method == csim::EulerMethod)
+        {
+            accesses.push_back(mBuilder.CreateCall(routine, { t, states, rates, outputs, inputs, stride, c }));
+            for (int j = 0; j < mNumberOfStates; ++j)
+            {
+                llvm::Value* offset = mBuilder.CreateAdd(mBuilder.CreateMul(mBuilder.getInt64(j), stride), c);
+                llvm::Value* state = mBuilder.CreateInBoundsGEP(mDouble, states, offset);
+                llvm::Instruction* y = mBuilder.CreateLoad(mDouble, state);
+                llvm::Instruction* r = mBuilder.CreateLoad(mDouble, mBuilder.CreateInBoundsGEP(mDouble, rates, offset));
+                accesses.push_back(y);
+                accesses.push_back(r);
+                accesses.push_back(mBuilder.CreateStore(mBuilder.CreateFAdd(y, mBuilder.CreateFMul(r, step)), state));
+            }
+        }
+        else accesses.push_back(mBuilder.CreateCall(routine, { t, step, states, rates, outputs, inputs, stride, c }));
+        llvm::Value* nextCell = mBuilder.CreateAdd(c, mBuilder.getInt64(1));
+        c->addIncoming(nextCell, cells);
+        llvm::Instruction* branch = mBuilder.CreateCondBr(mBuilder.CreateICmpSLT(nextCell, end), cells, stepLatch);
+        independentCells(branch, accesses);
+
+        mBuilder.SetInsertPoint(stepLatch);
+        i->addIncoming(mBuilder.CreateAdd(i, llvm::ConstantInt::get(integer, 1)), stepLatch);
+        mBuilder.CreateBr(stepHeader);
+
+        mBuilder.SetInsertPoint(blockLatch);
+        b->addIncoming(blockEnd, blockLatch);
+        mBuilder.CreateBr(blockHeader);
+
+        mBuilder.SetInsertPoint(exit);
+        mBuilder.CreateRetVoid();
+        if (llvm::verifyFunction(*mFunction, &llvm::errs()))
+        {
+            std::cerr << "PopulationBuilder::build: invalid function generated for: " << name << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+private:
+    llvm::Module* mModule;
+    llvm::IRBuilder<> mBuilder;
+    llvm::Type* mDouble;
+    llvm::Function* mFunction;
+    int mNumberOfStates;
+
+    // the number of cells advanced together, small enough for a block of a typical cell model to stay in cache
+    static const int BLOCK_CELLS = 256;
+
+    /*
+     * Mark the loop over the cells ending with the given branch as one which should be vectorised, and the given
+     * memory accesses (including those in the inlined model routine) as not depending on any other cell.
+     */
+    void independentCells(llvm::Instruction* branch, const std::vector<llvm::Instruction*>& accesses)
+    {
+        llvm::LLVMContext& context = mModule->getContext();
+        std::vector<llvm::Metadata*> properties;
+        properties.push_back(NULL);
+        properties.push_back(llvm::MDNode::get(context, {
+                                                   llvm::MDString::get(context, "llvm.loop.vectorize.enable"),
+                                                   llvm::ConstantAsMetadata::get(mBuilder.getTrue()) }));
+#if LLVM_VERSION_MAJOR >= 8
+        llvm::MDNode* group = llvm::MDNode::getDistinct(context, {});
+        properties.push_back(llvm::MDNode::get(context, {
+                                                   llvm::MDString::get(context, "llvm.loop.parallel_accesses"),
+                                                   group }));
+        for (auto access: accesses) access->setMetadata(llvm::LLVMContext::MD_access_group, group);
+#else
+        (void)accesses;
+#endif
+        llvm::MDNode* loop = llvm::MDNode::getDistinct(context, properties);
+        loop->replaceOperandWith(0, loop);
+        branch->setMetadata(llvm::LLVMContext::MD_loop, loop);
+    }
+};
+
+/*
+ * The size of the given array implied by the assignments to it in the given routine, including those in any chunks
+ * the routine has been split into.
+ */
+static int assignedSize(const CodeRoutine& routine, const std::string& array,
+                        const std::map<std::string, const CodeRoutine*>& chunks)
+{
+    int size = 0;
+    for (const auto& name: routine.chunks)
+    {
+        auto chunk = chunks.find(name);
+        if (chunk != chunks.end()) size = std::max(size, assignedSize(*(chunk->second), array, chunks));
+    }
+    for (const auto& statement: routine.statements)
+    {
+        CodeExpressionPtr target = parseCodeExpression(statement.target);
+        if (target && (target->type == CodeExpression::Reference) && (target->value == array)
+                && (target->index >= size))
+            size = target->index + 1;
+    }
+    return size;
+}
+
+std::unique_ptr<llvm::Module> generateModule(llvm::LLVMContext& context, const std::vector<CodeRoutine>& routines,
+                                             bool verbose, const std::vector<CodeRoutine>& externalRoutines)
+{
+    std::map<std::string, const CodeRoutine*> chunks;
+    for (const auto& routine: routines) chunks[routine.name] = &routine;
+    for (const auto& routine: externalRoutines) chunks[routine.name] = &routine;
+    std::unique_ptr<llvm::Module> module(new llvm::Module("csim", context));
+    for (const auto& routine: routines)
+    {
+        RoutineBuilder builder(module.get(), routine);
+        if (!builder.build()) return std::unique_ptr<llvm::Module>();
+    }
+    // every state has a rate and every output is assigned by the model routines, which gives us the array sizes
+    // needed for the fused integrators
+    for (const auto& routine: routines)
+    {
+        bool rhs = (routine.name == "csim_rhs_routine");
+        if (!rhs && (routine.name != "csim_rush_larsen_routine")) continue;
+        IntegratorBuilder integrator(module.get(), assignedSize(routine, "CSIM_RATE", chunks),
+                                     assignedSize(routine, "CSIM_OUTPUT", chunks));
+        llvm::Function* f = module->getFunction(routine.name);
+        bool built = rhs ? (integrator.build("csim_euler_integrator", csim::EulerMethod, f)
+                            && integrator.build("csim_rk4_integrator", csim::RungeKutta4Method, f))
+                         : integrator.build("csim_rush_larsen_integrator", csim::RushLarsenMethod, f);
+        if (!built) return std::unique_ptr<llvm::Module>();
+        // the population integrators need the cell version of the routine, which is only able to be built when the
+        // routine is all in this module
+        if (!routine.chunks.empty()) continue;
+        RoutineBuilder cell(module.get(), routine, true);
+        if (!cell.build()) return std::unique_ptr<llvm::Module>();
+        PopulationBuilder population(module.get(), assignedSize(routine, "CSIM_RATE", chunks));
+        f = module->getFunction(routine.name + "_cell");
+        built = rhs ? population.build("csim_population_euler_integrator", csim::EulerMethod, f)
+                    : population.build("csim_population_rush_larsen_integrator", csim::RushLarsenMethod, f);
+        if (!built) return std::unique_ptr<llvm::Module>();
+    }
+    if (verbose) module->print(llvm::errs(), nullptr);
+    return module;
+}
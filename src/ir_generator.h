@@ -0,0 +1,37 @@
+#ifndef IR_GENERATOR_H
+#define IR_GENERATOR_H
+
+#include <memory>
+#include <vector>
+
+#include "code_analysis.h"
+
+namespace llvm
+{
+class LLVMContext;
+class Module;
+}
+
+/**
+ * Build the given routines directly into an LLVM module, without going through C code and the clang frontend. All
+ * values are evaluated in double precision, comparisons and logical operators evaluate to 0.0 or 1.0 as in C, and
+ * statements with a condition are only evaluated when their condition is not zero.
+ * Calls to the libm functions with an LLVM intrinsic are mapped to that intrinsic, the variadic helper functions
+ * (multi_min, gcd_multi, etc.) are expanded inline and all other function calls are declared as external functions
+ * taking and returning doubles, to be resolved from the CSim runtime or when the module is executed. The fused
+ * integrators (csim_euler_integrator, csim_rk4_integrator and csim_rush_larsen_integrator) are also built for the
+ * model function and Rush-Larsen step routines, if present. Routines which have been split into chunks call each of
+ * their chunks in turn, chunks which are not built into this module are declared as external functions.
+ * @param context The LLVM context to create the module in.
+ * @param routines The routines to build, all of which must be structured.
+ * @param verbose Dump the generated IR if true.
+ * @param externalRoutines Chunks of the given routines which are built into another module, needed to work out the
+ * sizes of the arrays used by the fused integrators.
+ * @return The new module, or NULL if any of the routines are not able to be built.
+ */
+std::unique_ptr<llvm::Module> generateModule(llvm::LLVMContext& context, const std::vector<CodeRoutine>& routines,
+                                             bool verbose,
+                                             const std::vector<CodeRoutine>& externalRoutines =
+                                                 std::vector<CodeRoutine>());
+
+#endif // IR_GENERATOR_H
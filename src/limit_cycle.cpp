@@ -0,0 +1,217 @@
+/*
+Copyright 2015 University of Auckland
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.Some license of other
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "csim/limit_cycle.h"
+#include "csim/error_codes.h"
+
+namespace csim {
+
+// how far GMRES reduces the residual of each Newton step
+static const double FORCING_TERM = 0.01;
+
+static double norm2(const double* x, int n)
+{
+    double sum = 0.0;
+    for (int i = 0; i < n; ++i) sum += x[i] * x[i];
+    return std::sqrt(sum);
+}
+
+LimitCycleSolver::LimitCycleSolver() : mNumberOfStates(0), mRelativeTolerance(1.0e-6), mAbsoluteTolerance(1.0e-8),
+    mMaximumBeats(1000), mShootingBeats(5), mMaximumKrylovIterations(20)
+{
+    mDiagnostics.converged = false;
+    mDiagnostics.beats = mDiagnostics.pacedBeats = mDiagnostics.newtonIterations = mDiagnostics.krylovIterations = 0;
+    mDiagnostics.residualNorm = 0.0;
+}
+
+int LimitCycleSolver::setTolerances(double relativeTolerance, double absoluteTolerance)
+{
+    if (!((relativeTolerance > 0.0) && (absoluteTolerance > 0.0))) return INVALID_SOLVER_PARAMETERS;
+    mRelativeTolerance = relativeTolerance;
+    mAbsoluteTolerance = absoluteTolerance;
+    return CSIM_OK;
+}
+
+int LimitCycleSolver::setMaximumBeats(int beats)
+{
+    if (beats < 1) return INVALID_SOLVER_PARAMETERS;
+    mMaximumBeats = beats;
+    return CSIM_OK;
+}
+
+int LimitCycleSolver::setShooting(int pacedBeats, int krylovIterations)
+{
+    if ((pacedBeats < 0) || (krylovIterations < 1)) return INVALID_SOLVER_PARAMETERS;
+    mShootingBeats = pacedBeats;
+    mMaximumKrylovIterations = krylovIterations;
+    return CSIM_OK;
+}
+
+double LimitCycleSolver::changeNorm(const double* start, const double* end) const
+{
+    double norm = 0.0;
+    for (int i = 0; i < mNumberOfStates; ++i)
+    {
+        double change = std::fabs(end[i] - start[i]) / (mRelativeTolerance * std::fabs(end[i]) + mAbsoluteTolerance);
+        if (!std::isfinite(change)) return std::numeric_limits<double>::infinity();
+        norm = std::max(norm, change);
+    }
+    return norm;
+}
+
+bool LimitCycleSolver::shoot(const PeriodMap& periodMap, std::vector<double>& states, std::vector<double>& end)
+{
+    // GMRES on the Newton equation for the change over a period, with each state scaled by its tolerance so the states
+    // count equally whatever their units: (D^-1 (J - I) D) z = -D^-1 (end - states), the step being D z
+    int n = mNumberOfStates;
+    int m = std::min(mMaximumKrylovIterations, n);
+    std::vector<double> scale(n), basis(size_t(m + 1) * n), hessenberg(size_t(m + 1) * m, 0.0), cosines(m),
+            sines(m), residuals(m + 1, 0.0), w(n), perturbed(n);
+    for (int i = 0; i < n; ++i)
+    {
+        scale[i] = mRelativeTolerance * std::fabs(states[i]) + mAbsoluteTolerance;
+        basis[i] = (states[i] - end[i]) / scale[i];
+    }
+    double beta = norm2(basis.data(), n);
+    if (!(beta > 0.0) || !std::isfinite(beta)) return false;
+    for (int i = 0; i < n; ++i) basis[i] /= beta;
+    residuals[0] = beta;
+    // perturbations of the states about the square root of the machine precision
+    double epsilon = std::sqrt(std::numeric_limits<double>::epsilon()) / mRelativeTolerance;
+    int k = 0;
+    while ((k < m) && (mDiagnostics.beats < mMaximumBeats))
+    {
+        const double* v = &basis[size_t(k) * n];
+        for (int i = 0; i < n; ++i) perturbed[i] = states[i] + epsilon * scale[i] * v[i];
+        periodMap(perturbed.data());
+        ++mDiagnostics.beats;
+        ++mDiagnostics.krylovIterations;
+        for (int i = 0; i < n; ++i) w[i] = (perturbed[i] - end[i]) / (epsilon * scale[i]) - v[i];
+        for (int j = 0; j <= k; ++j)
+        {
+            const double* vj = &basis[size_t(j) * n];
+            double h = 0.0;
+            for (int i = 0; i < n; ++i) h += w[i] * vj[i];
+            for (int i = 0; i < n; ++i) w[i] -= h * vj[i];
+            hessenberg[size_t(j) * m + k] = h;
+        }
+        double h = norm2(w.data(), n);
+        if (!std::isfinite(h)) return false;
+        hessenberg[size_t(k + 1) * m + k] = h;
+        for (int j = 0; j < k; ++j)
+        {
+            double& a = hessenberg[size_t(j) * m + k];
+            double& b = hessenberg[size_t(j + 1) * m + k];
+            double rotated = cosines[j] * a + sines[j] * b;
+            b = -sines[j] * a + cosines[j] * b;
+            a = rotated;
+        }
+        double& a = hessenberg[size_t(k) * m + k];
+        double r = std::hypot(a, h);
+        cosines[k] = (r > 0.0) ? a / r : 1.0;
+        sines[k] = (r > 0.0) ? h / r : 0.0;
+        a = r;
+        hessenberg[size_t(k + 1) * m + k] = 0.0;
+        residuals[k + 1] = -sines[k] * residuals[k];
+        residuals[k] *= cosines[k];
+        ++k;
+        if ((h == 0.0) || (std::fabs(residuals[k]) <= FORCING_TERM * beta)) break;
+        for (int i = 0; i < n; ++i) basis[size_t(k) * n + i] = w[i] / h;
+    }
+    if (k == 0) return false;
+    // the combination of the basis vectors minimising the residual
+    std::vector<double> y(k), step(n, 0.0);
+    for (int j = k - 1; j >= 0; --j)
+    {
+        double sum = residuals[j];
+        for (int l = j + 1; l < k; ++l) sum -= hessenberg[size_t(j) * m + l] * y[l];
+        if (hessenberg[size_t(j) * m + j] == 0.0) return false;
+        y[j] = sum / hessenberg[size_t(j) * m + j];
+    }
+    for (int j = 0; j < k; ++j)
+    {
+        for (int i = 0; i < n; ++i) step[i] += y[j] * basis[size_t(j) * n + i];
+    }
+    // accept the Newton step, or part of it, only if it brings the states closer to periodic
+    double change = changeNorm(states.data(), end.data());
+    for (double damping = 1.0; (damping >= 0.25) && (mDiagnostics.beats < mMaximumBeats); damping *= 0.5)
+    {
+        for (int i = 0; i < n; ++i) perturbed[i] = states[i] + damping * scale[i] * step[i];
+        w = perturbed;
+        periodMap(w.data());
+        ++mDiagnostics.beats;
+        if (changeNorm(perturbed.data(), w.data()) < change)
+        {
+            states.swap(perturbed);
+            end.swap(w);
+            ++mDiagnostics.newtonIterations;
+            return true;
+        }
+    }
+    return false;
+}
+
+int LimitCycleSolver::solve(const PeriodMap& periodMap, int numberOfStates, double* states)
+{
+    if (!periodMap || (numberOfStates < 0)) return INVALID_SOLVER_PARAMETERS;
+    mNumberOfStates = numberOfStates;
+    mDiagnostics.converged = false;
+    mDiagnostics.beats = mDiagnostics.pacedBeats = mDiagnostics.newtonIterations = mDiagnostics.krylovIterations = 0;
+    std::vector<double> start(states, states + numberOfStates), end(start);
+    periodMap(end.data());
+    mDiagnostics.beats = mDiagnostics.pacedBeats = 1;
+    double change = changeNorm(start.data(), end.data());
+    int beatsSinceShooting = 1;
+    while ((change > 1.0) && std::isfinite(change) && (mDiagnostics.beats < mMaximumBeats))
+    {
+        if ((mShootingBeats > 0) && (beatsSinceShooting >= mShootingBeats))
+        {
+            if (shoot(periodMap, start, end))
+            {
+                change = changeNorm(start.data(), end.data());
+                continue;
+            }
+            // pace for a while before trying again
+            beatsSinceShooting = 0;
+            if (mDiagnostics.beats >= mMaximumBeats) break;
+        }
+        start = end;
+        periodMap(end.data());
+        ++mDiagnostics.beats;
+        ++mDiagnostics.pacedBeats;
+        ++beatsSinceShooting;
+        change = changeNorm(start.data(), end.data());
+    }
+    mDiagnostics.converged = change <= 1.0;
+    mDiagnostics.residualNorm = change;
+    std::copy(end.begin(), end.end(), states);
+    return mDiagnostics.converged ? CSIM_OK : LIMIT_CYCLE_NOT_CONVERGED;
+}
+
+int LimitCycleSolver::solve(IntegratorFunction integrator, double voi, double period, int stepsPerPeriod,
+                            int numberOfStates, double* states, double* rates, double* outputs, double* inputs)
+{
+    if (!integrator || !(period > 0.0) || (stepsPerPeriod < 1)) return INVALID_SOLVER_PARAMETERS;
+    double step = period / stepsPerPeriod;
+    return solve([=](double* x) { integrator(voi, step, stepsPerPeriod, x, rates, outputs, inputs, NULL); },
+                 numberOfStates, states);
+}
+
+} // namespace csim
@@ -0,0 +1,274 @@
+/*
+Copyright 2015 University of Auckland
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.Some license of other
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <iostream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "csim/mapped_results.h"
+#include "csim/error_codes.h"
+
+namespace csim {
+
+static const char MAGIC[] = "CSIMMAP1";
+// the offsets of the fields of the header
+static const size_t NUMBER_OF_COLUMNS = 8;
+static const size_t TIME_COLUMN = 12;
+static const size_t DATA_OFFSET = 16;
+static const size_t NUMBER_OF_ROWS = 24;
+static const size_t CAPACITY = 32;
+static const size_t FINISHED = 40;
+static const size_t COLUMN_IDS = 44;
+static const uint64_t PAGE_SIZE = 4096;
+
+// the number of rows is shared with readers in other threads and processes while the file is being written
+static std::atomic<uint64_t>* rowCount(const unsigned char* mapping)
+{
+    return reinterpret_cast<std::atomic<uint64_t>*>(const_cast<unsigned char*>(mapping) + NUMBER_OF_ROWS);
+}
+
+static std::atomic<uint32_t>* finishedFlag(const unsigned char* mapping)
+{
+    return reinterpret_cast<std::atomic<uint32_t>*>(const_cast<unsigned char*>(mapping) + FINISHED);
+}
+
+template<typename T> static T field(const unsigned char* mapping, size_t offset)
+{
+    T value;
+    memcpy(&value, mapping + offset, sizeof(T));
+    return value;
+}
+
+template<typename T> static void setField(unsigned char* mapping, size_t offset, T value)
+{
+    memcpy(mapping + offset, &value, sizeof(T));
+}
+
+MappedResultSink::MappedResultSink() : mFile(-1), mMapping(NULL), mMappedSize(0), mDataOffset(0), mCapacity(0),
+    mGrowthRows(0), mNumberOfRows(0), mNumberOfColumns(0)
+{
+}
+
+MappedResultSink::~MappedResultSink()
+{
+    if (mFile >= 0) finish();
+}
+
+int MappedResultSink::open(const std::string& fileName, const std::vector<std::string>& columnIds, int timeColumn,
+                           uint64_t initialRows, uint64_t growthRows)
+{
+#ifdef _WIN32
+    std::cerr << "MappedResultSink::open: mapped result files are not available on this platform" << std::endl;
+    return NOT_IMPLEMENTED;
+#else
+    if (mFile >= 0) finish();
+    if (columnIds.empty() || (timeColumn >= int(columnIds.size())) || (growthRows < 1))
+    {
+        std::cerr << "MappedResultSink::open: need at least one column, a valid time column and room to grow"
+                  << std::endl;
+        return INVALID_RESULT_LAYOUT;
+    }
+    mFile = ::open(fileName.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (mFile < 0)
+    {
+        std::cerr << "MappedResultSink::open: unable to create the file: " << fileName << std::endl;
+        return UNABLE_TO_WRITE_RESULTS;
+    }
+    size_t headerSize = COLUMN_IDS;
+    for (const auto& id: columnIds) headerSize += 4 + id.size();
+    mDataOffset = (headerSize + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE;
+    mNumberOfColumns = int(columnIds.size());
+    mGrowthRows = growthRows;
+    mNumberOfRows = 0;
+    int code = map(std::max(initialRows, uint64_t(1)));
+    if (code != CSIM_OK) return code;
+    memcpy(mMapping, MAGIC, 8);
+    setField<uint32_t>(mMapping, NUMBER_OF_COLUMNS, uint32_t(mNumberOfColumns));
+    setField<int32_t>(mMapping, TIME_COLUMN, (timeColumn < 0) ? -1 : timeColumn);
+    setField<uint64_t>(mMapping, DATA_OFFSET, mDataOffset);
+    size_t offset = COLUMN_IDS;
+    for (const auto& id: columnIds)
+    {
+        setField<uint32_t>(mMapping, offset, uint32_t(id.size()));
+        memcpy(mMapping + offset + 4, id.data(), id.size());
+        offset += 4 + id.size();
+    }
+    rowCount(mMapping)->store(0, std::memory_order_release);
+    finishedFlag(mMapping)->store(0, std::memory_order_release);
+    return CSIM_OK;
+#endif
+}
+
+int MappedResultSink::map(uint64_t capacity)
+{
+#ifdef _WIN32
+    return NOT_IMPLEMENTED;
+#else
+    if (mMapping) munmap(mMapping, mMappedSize);
+    mMapping = NULL;
+    uint64_t size = mDataOffset + capacity * mNumberOfColumns * sizeof(double);
+    if (ftruncate(mFile, off_t(size)) != 0) return UNABLE_TO_WRITE_RESULTS;
+    void* mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, mFile, 0);
+    if (mapping == MAP_FAILED)
+    {
+        std::cerr << "MappedResultSink::map: unable to map " << size << " bytes" << std::endl;
+        return UNABLE_TO_WRITE_RESULTS;
+    }
+    mMapping = static_cast<unsigned char*>(mapping);
+    mMappedSize = size;
+    mCapacity = capacity;
+    setField<uint64_t>(mMapping, CAPACITY, capacity);
+    return CSIM_OK;
+#endif
+}
+
+int MappedResultSink::write(const double* values, int numberOfRows, int numberOfColumns)
+{
+    if (!mMapping || (numberOfColumns != mNumberOfColumns)) return INVALID_RESULT_LAYOUT;
+    if (mNumberOfRows + numberOfRows > mCapacity)
+    {
+        int code = map(std::max(mCapacity + mGrowthRows, mNumberOfRows + numberOfRows));
+        if (code != CSIM_OK) return code;
+    }
+    size_t rowSize = size_t(numberOfColumns) * sizeof(double);
+    memcpy(mMapping + mDataOffset + mNumberOfRows * rowSize, values, numberOfRows * rowSize);
+    mNumberOfRows += numberOfRows;
+    // the rows are only counted once they are all there
+    rowCount(mMapping)->store(mNumberOfRows, std::memory_order_release);
+    return CSIM_OK;
+}
+
+int MappedResultSink::finish()
+{
+#ifdef _WIN32
+    return NOT_IMPLEMENTED;
+#else
+    if (mFile < 0) return CSIM_OK;
+    bool written = mMapping != NULL;
+    if (mMapping)
+    {
+        finishedFlag(mMapping)->store(1, std::memory_order_release);
+        written = (msync(mMapping, mMappedSize, MS_SYNC) == 0);
+        munmap(mMapping, mMappedSize);
+        mMapping = NULL;
+        uint64_t size = mDataOffset + mNumberOfRows * mNumberOfColumns * sizeof(double);
+        written = (ftruncate(mFile, off_t(size)) == 0) && written;
+    }
+    written = (::close(mFile) == 0) && written;
+    mFile = -1;
+    return written ? CSIM_OK : UNABLE_TO_WRITE_RESULTS;
+#endif
+}
+
+MappedResults::MappedResults() : mFile(-1), mMapping(NULL), mMappedSize(0), mDataOffset(0), mTimeColumn(-1)
+{
+}
+
+MappedResults::~MappedResults()
+{
+    close();
+}
+
+void MappedResults::close()
+{
+#ifndef _WIN32
+    if (mMapping) munmap(const_cast<unsigned char*>(mMapping), mMappedSize);
+    if (mFile >= 0) ::close(mFile);
+#endif
+    mMapping = NULL;
+    mMappedSize = 0;
+    mFile = -1;
+    mColumnIds.clear();
+}
+
+int MappedResults::open(const std::string& fileName)
+{
+#ifdef _WIN32
+    std::cerr << "MappedResults::open: mapped result files are not available on this platform" << std::endl;
+    return NOT_IMPLEMENTED;
+#else
+    close();
+    mFile = ::open(fileName.c_str(), O_RDONLY);
+    if ((mFile < 0) || (refresh() != CSIM_OK) || (memcmp(mMapping, MAGIC, 8) != 0))
+    {
+        std::cerr << "MappedResults::open: not a CSim mapped result file: " << fileName << std::endl;
+        close();
+        return INVALID_RESULT_FILE;
+    }
+    uint32_t numberOfColumns = field<uint32_t>(mMapping, NUMBER_OF_COLUMNS);
+    mTimeColumn = field<int32_t>(mMapping, TIME_COLUMN);
+    mDataOffset = field<uint64_t>(mMapping, DATA_OFFSET);
+    size_t offset = COLUMN_IDS;
+    for (uint32_t c = 0; c < numberOfColumns; ++c)
+    {
+        uint32_t length = (offset + 4 <= mDataOffset) ? field<uint32_t>(mMapping, offset) : 0;
+        if ((offset + 4 + length > mDataOffset) || (mDataOffset > mMappedSize))
+        {
+            std::cerr << "MappedResults::open: invalid header in the file: " << fileName << std::endl;
+            close();
+            return INVALID_RESULT_FILE;
+        }
+        mColumnIds.push_back(std::string(reinterpret_cast<const char*>(mMapping) + offset + 4, length));
+        offset += 4 + length;
+    }
+    return CSIM_OK;
+#endif
+}
+
+int MappedResults::refresh()
+{
+#ifdef _WIN32
+    return NOT_IMPLEMENTED;
+#else
+    if (mFile < 0) return INVALID_RESULT_FILE;
+    struct stat status;
+    if ((fstat(mFile, &status) != 0) || (uint64_t(status.st_size) < COLUMN_IDS)) return INVALID_RESULT_FILE;
+    uint64_t size = uint64_t(status.st_size);
+    if (size == mMappedSize) return CSIM_OK;
+    if (mMapping) munmap(const_cast<unsigned char*>(mMapping), mMappedSize);
+    void* mapping = mmap(NULL, size, PROT_READ, MAP_SHARED, mFile, 0);
+    mMapping = (mapping == MAP_FAILED) ? NULL : static_cast<const unsigned char*>(mapping);
+    mMappedSize = mMapping ? size : 0;
+    return mMapping ? CSIM_OK : INVALID_RESULT_FILE;
+#endif
+}
+
+uint64_t MappedResults::numberOfRows() const
+{
+    if (!mMapping || mColumnIds.empty() || (mMappedSize < mDataOffset)) return 0;
+    uint64_t rows = rowCount(mMapping)->load(std::memory_order_acquire);
+    return std::min(rows, (mMappedSize - mDataOffset) / (mColumnIds.size() * sizeof(double)));
+}
+
+bool MappedResults::isFinished() const
+{
+    return mMapping && (finishedFlag(mMapping)->load(std::memory_order_acquire) == 1);
+}
+
+const double* MappedResults::values() const
+{
+    return mMapping ? reinterpret_cast<const double*>(mMapping + mDataOffset) : NULL;
+}
+
+} // namespace csim
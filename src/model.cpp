@@ -20,27 +20,21 @@ limitations under the License.Some license of other
 #include "csim/variable_types.h"
 #include "cellml_model_definition.h"
 #include "compiler.h"
+#include "task_graph.h"
 #include "xmlutils.h"
 
 namespace csim {
 
-Model::Model() : mModelDefinition(0), mCompiler(0), mInstantiated(false), mXmlDoc(0)
+Model::Model() : mModelDefinition(0), mCompiler(0), mSpecialisedCompiler(0), mTaskGraph(0), mInstantiated(false),
+    mNumberOfGatingVariables(0), mNumberOfThreads(1), mCompilerBackend(IrBackend), mVectorMath(AccurateVectorMath),
+    mCompileTimeBudget(0.0), mXmlDoc(0)
 {
 }
 
-Model::Model(const Model &src)
-{
-    mModelDefinition = src.mModelDefinition;
-    mCompiler = src.mCompiler;
-    mInstantiated = src.mInstantiated;
-    mNumberOfStates = src.mNumberOfStates;
-    mNumberOfInputs = src.mNumberOfInputs;
-    mNumberOfOutputs = src.mNumberOfOutputs;
-    // FIXME: need to copy the xmldoc?
-}
-
 Model::~Model()
 {
+    // the threads evaluate the compiled code, so need to be stopped first
+    if (mTaskGraph) delete static_cast<TaskGraph*>(mTaskGraph);
     if (mModelDefinition)
     {
         CellmlModelDefinition* cellml = static_cast<CellmlModelDefinition*>(mModelDefinition);
@@ -51,6 +45,7 @@ Model::~Model()
         Compiler* compiler = static_cast<Compiler*>(mCompiler);
         delete compiler;
     }
+    if (mSpecialisedCompiler) delete static_cast<Compiler*>(mSpecialisedCompiler);
     if (mXmlDoc) delete mXmlDoc;
 }
 
@@ -194,7 +189,7 @@ std::map<std::string, int> Model::setAllVariablesAsOutput()
     return outputVariables;
 }
 
-int Model::instantiate(bool verbose, bool debug)
+int Model::instantiate(bool verbose, bool debug, Precision precision)
 {
     if (! mModelDefinition) return MISSING_MODEL_DEFINTION;
     // TODO: should first check if using a CellML model...
@@ -207,16 +202,205 @@ int Model::instantiate(bool verbose, bool debug)
         mCompiler = static_cast<void*>(compiler);
     }
     else compiler = static_cast<Compiler*>(mCompiler);
-    int code = cellml->instantiate(*compiler);
+    compiler->setVectorMath(mVectorMath);
+    compiler->setCompileTimeBudget(mCompileTimeBudget);
+    // an existing task graph's threads evaluate the code that is about to be replaced
+    if (mTaskGraph)
+    {
+        delete static_cast<TaskGraph*>(mTaskGraph);
+        mTaskGraph = 0;
+    }
+    bool parallel = (mNumberOfThreads > 1);
+    int code = cellml->instantiate(*compiler, precision, mCompilerBackend, parallel);
     if (code == CSIM_OK)
     {
         mInstantiated = true;
         mNumberOfInputs = cellml->numberOfInputVariables();
         mNumberOfOutputs = cellml->numberOfOutputVariables();
+        mNumberOfGatingVariables = cellml->numberOfGatingVariables();
+        mCompilerBackend = cellml->compilerBackend();
+        if (parallel)
+        {
+            const ModelPartitions& partitions = cellml->partitions();
+            std::vector<PartitionFunction> functions;
+            for (size_t p = 0; p < partitions.partitions.size(); ++p)
+            {
+                PartitionFunction function = compiler->getPartitionFunction(int(p));
+                if (! function)
+                {
+                    functions.clear();
+                    break;
+                }
+                functions.push_back(function);
+            }
+            if (functions.empty())
+            {
+                std::cerr << "Model::instantiate: unable to partition the model function, it will be evaluated "
+                          << "by a single thread." << std::endl;
+                mNumberOfThreads = 1;
+            }
+            else
+            {
+                TaskGraph* graph = new TaskGraph(functions, partitions.partitions, partitions.numberOfConstants,
+                                                 partitions.numberOfAlgebraic, mNumberOfThreads);
+                mTaskGraph = static_cast<void*>(graph);
+                mNumberOfThreads = graph->numberOfThreads();
+                std::cout << "Split the model function into " << graph->numberOfTasks() << " task(s) on "
+                          << mNumberOfThreads << " thread(s)" << std::endl;
+            }
+        }
     }
     return code;
 }
 
+int Model::setCompileTimeBudget(double seconds)
+{
+    if (mInstantiated) return MODEL_ALREADY_INSTANTIATED;
+    mCompileTimeBudget = seconds;
+    return CSIM_OK;
+}
+
+int Model::setNumberOfThreads(int numberOfThreads)
+{
+    if (mInstantiated) return MODEL_ALREADY_INSTANTIATED;
+    if (numberOfThreads < 1) return INVALID_NUMBER_OF_THREADS;
+    mNumberOfThreads = numberOfThreads;
+    return CSIM_OK;
+}
+
+int Model::numberOfThreads() const
+{
+    return mNumberOfThreads;
+}
+
+int Model::numberOfTasks() const
+{
+    if (! mTaskGraph) return 0;
+    return static_cast<TaskGraph*>(mTaskGraph)->numberOfTasks();
+}
+
+int Model::evaluateModel(double voi, double* states, double* rates, double* outputs, double* inputs)
+{
+    if (! mInstantiated) return MODEL_NOT_INSTANTIATED;
+    if (mTaskGraph) static_cast<TaskGraph*>(mTaskGraph)->evaluate(voi, states, rates, outputs, inputs);
+    else
+    {
+        ModelFunction function = getModelFunction();
+        function(voi, states, rates, outputs, inputs);
+    }
+    return CSIM_OK;
+}
+
+int Model::specialise(const std::map<std::string, double>& inputValues)
+{
+    if (! mModelDefinition) return MISSING_MODEL_DEFINTION;
+    if (! mInstantiated) return MODEL_NOT_INSTANTIATED;
+    CellmlModelDefinition* cellml = static_cast<CellmlModelDefinition*>(mModelDefinition);
+    std::map<int, double> values;
+    for (const auto& input: inputValues)
+    {
+        int index = cellml->getVariableIndex(input.first, InputType);
+        if (index < 0)
+        {
+            std::cerr << "Model::specialise: the variable " << input.first << " is not an input of the model"
+                      << std::endl;
+            return UNABLE_TO_SPECIALISE_MODEL;
+        }
+        values[index] = input.second;
+    }
+    Compiler* general = static_cast<Compiler*>(mCompiler);
+    Compiler* compiler = new Compiler(general->isVerbose(), general->isDebug());
+    compiler->setVectorMath(mVectorMath);
+    compiler->setCompileTimeBudget(mCompileTimeBudget);
+    int code = cellml->specialise(*compiler, values);
+    if (code != CSIM_OK)
+    {
+        delete compiler;
+        return code;
+    }
+    if (mSpecialisedCompiler) delete static_cast<Compiler*>(mSpecialisedCompiler);
+    mSpecialisedCompiler = static_cast<void*>(compiler);
+    return CSIM_OK;
+}
+
+std::map<std::string, int> Model::getAllVariableIndices() const
+{
+    std::map<std::string, int> variables;
+    if (! (mModelDefinition && mInstantiated)) return variables;
+    CellmlModelDefinition* cellml = static_cast<CellmlModelDefinition*>(mModelDefinition);
+    for (const auto& id: mXmlDoc->getVariableIds())
+    {
+        // several variables in a model can map to the same source variable
+        int index = cellml->getEvaluationIndex(id);
+        if (index >= 0) variables[id] = index;
+    }
+    return variables;
+}
+
+int Model::numberOfVariables() const
+{
+    if (! mModelDefinition) return 0;
+    CellmlModelDefinition* cellml = static_cast<CellmlModelDefinition*>(mModelDefinition);
+    return cellml->numberOfVariables();
+}
+
+std::vector<double> Model::selectVariables(const std::vector<int>& variableIndices) const
+{
+    if (! (mModelDefinition && mInstantiated)) return std::vector<double>();
+    CellmlModelDefinition* cellml = static_cast<CellmlModelDefinition*>(mModelDefinition);
+    return cellml->selectVariables(variableIndices);
+}
+
+int Model::numberOfSpecialisedStatements() const
+{
+    if (! mModelDefinition) return 0;
+    CellmlModelDefinition* cellml = static_cast<CellmlModelDefinition*>(mModelDefinition);
+    return cellml->numberOfSpecialisedStatements();
+}
+
+int Model::setCompilerBackend(CompilerBackend backend)
+{
+    if (mInstantiated) return MODEL_ALREADY_INSTANTIATED;
+    mCompilerBackend = backend;
+    return CSIM_OK;
+}
+
+int Model::setVectorMath(VectorMath vectorMath)
+{
+    if (mInstantiated) return MODEL_ALREADY_INSTANTIATED;
+    mVectorMath = vectorMath;
+    return CSIM_OK;
+}
+
+int Model::setLookupTable(const std::string& variableId, double minimum, double maximum, double step)
+{
+    if (mInstantiated) return MODEL_ALREADY_INSTANTIATED;
+    if (! mModelDefinition) return MISSING_MODEL_DEFINTION;
+    CellmlModelDefinition* cellml = static_cast<CellmlModelDefinition*>(mModelDefinition);
+    return cellml->setLookupTable(variableId, minimum, maximum, step);
+}
+
+double Model::lookupTableError() const
+{
+    if (! mModelDefinition) return 0.0;
+    CellmlModelDefinition* cellml = static_cast<CellmlModelDefinition*>(mModelDefinition);
+    return cellml->lookupTableError();
+}
+
+int Model::numberOfRemovedStatements() const
+{
+    if (! mModelDefinition) return 0;
+    CellmlModelDefinition* cellml = static_cast<CellmlModelDefinition*>(mModelDefinition);
+    return cellml->numberOfRemovedStatements();
+}
+
+double Model::precisionError() const
+{
+    if (! mModelDefinition) return 0.0;
+    CellmlModelDefinition* cellml = static_cast<CellmlModelDefinition*>(mModelDefinition);
+    return cellml->precisionError();
+}
+
 InitialiseFunction Model::getInitialiseFunction() const
 {
     if (! mCompiler) return NULL;
@@ -231,6 +415,76 @@ ModelFunction Model::getModelFunction() const
     return compiler->getModelFunction();
 }
 
+StepFunction Model::getRushLarsenFunction() const
+{
+    if (! mCompiler) return NULL;
+    Compiler* compiler = static_cast<Compiler*>(mCompiler);
+    return compiler->getRushLarsenFunction();
+}
+
+VariablesFunction Model::getVariablesFunction() const
+{
+    if (! mCompiler) return NULL;
+    Compiler* compiler = static_cast<Compiler*>(mCompiler);
+    return compiler->getVariablesFunction();
+}
+
+IntegratorFunction Model::getIntegratorFunction(IntegrationMethod method) const
+{
+    if (! mCompiler) return NULL;
+    Compiler* compiler = static_cast<Compiler*>(mCompiler);
+    return compiler->getIntegratorFunction(method);
+}
+
+PopulationIntegratorFunction Model::getPopulationIntegratorFunction(IntegrationMethod method) const
+{
+    if (! mCompiler) return NULL;
+    Compiler* compiler = static_cast<Compiler*>(mCompiler);
+    return compiler->getPopulationIntegratorFunction(method);
+}
+
+InitialiseFunction Model::getSpecialisedInitialiseFunction() const
+{
+    if (! mSpecialisedCompiler) return NULL;
+    Compiler* compiler = static_cast<Compiler*>(mSpecialisedCompiler);
+    return compiler->getInitialiseFunction();
+}
+
+ModelFunction Model::getSpecialisedModelFunction() const
+{
+    if (! mSpecialisedCompiler) return NULL;
+    Compiler* compiler = static_cast<Compiler*>(mSpecialisedCompiler);
+    return compiler->getModelFunction();
+}
+
+StepFunction Model::getSpecialisedRushLarsenFunction() const
+{
+    if (! mSpecialisedCompiler) return NULL;
+    Compiler* compiler = static_cast<Compiler*>(mSpecialisedCompiler);
+    return compiler->getRushLarsenFunction();
+}
+
+IntegratorFunction Model::getSpecialisedIntegratorFunction(IntegrationMethod method) const
+{
+    if (! mSpecialisedCompiler) return NULL;
+    Compiler* compiler = static_cast<Compiler*>(mSpecialisedCompiler);
+    return compiler->getIntegratorFunction(method);
+}
+
+InitialiseFunctionFloat Model::getSinglePrecisionInitialiseFunction() const
+{
+    if (! mCompiler) return NULL;
+    Compiler* compiler = static_cast<Compiler*>(mCompiler);
+    return compiler->getInitialiseFunctionFloat();
+}
+
+ModelFunctionFloat Model::getSinglePrecisionModelFunction() const
+{
+    if (! mCompiler) return NULL;
+    Compiler* compiler = static_cast<Compiler*>(mCompiler);
+    return compiler->getModelFunctionFloat();
+}
+
 std::string Model::mapXpathToVariableId(const std::string &xpath,
                                         const std::map<std::string, std::string>& namespaces)
 const
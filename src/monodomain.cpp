@@ -0,0 +1,334 @@
+/*
+Copyright 2015 University of Auckland
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.Some license of other
+*/
+
+#include <cmath>
+#include <functional>
+#include <iostream>
+
+#include "csim/monodomain.h"
+#include "csim/model.h"
+#include "csim/error_codes.h"
+#include "csim/variable_types.h"
+#include "thread_pool.h"
+
+namespace csim {
+
+/*
+ * The partial sums of each thread, in a cache line of their own.
+ */
+struct PartialSums
+{
+    double value[8];
+};
+
+/*
+ * Set out = (I + c K) in for the given lines of the grid, where K is the graph Laplacian of the grid: each cell's
+ * entry is the sum of its differences from its neighbours. Cells on the boundary have fewer neighbours, which gives
+ * no flux through the boundaries.
+ */
+static void applyOperator(const double* in, double* out, double c, int columns, int rows, int layers, int firstLine,
+                          int lastLine)
+{
+    size_t plane = size_t(columns) * rows;
+    for (int line = firstLine; line < lastLine; ++line)
+    {
+        int row = line % rows, layer = line / rows;
+        const double* x = in + size_t(line) * columns;
+        const double* below = (row > 0) ? (x - columns) : NULL;
+        const double* above = (row < rows - 1) ? (x + columns) : NULL;
+        const double* back = (layer > 0) ? (x - plane) : NULL;
+        const double* front = (layer < layers - 1) ? (x + plane) : NULL;
+        int neighbours = (below ? 1 : 0) + (above ? 1 : 0) + (back ? 1 : 0) + (front ? 1 : 0);
+        double* y = out + size_t(line) * columns;
+        for (int i = 0; i < columns; ++i)
+        {
+            double sum = 0.0;
+            int degree = neighbours;
+            if (i > 0)
+            {
+                sum += x[i - 1];
+                degree++;
+            }
+            if (i < columns - 1)
+            {
+                sum += x[i + 1];
+                degree++;
+            }
+            if (below) sum += below[i];
+            if (above) sum += above[i];
+            if (back) sum += back[i];
+            if (front) sum += front[i];
+            y[i] = x[i] + c * (degree * x[i] - sum);
+        }
+    }
+}
+
+static void runOnThreads(void* pool, const std::function<void(int)>& task)
+{
+    if (pool) static_cast<ThreadPool*>(pool)->run(task);
+    else task(0);
+}
+
+Monodomain::Monodomain() : mVoltageIndex(-1), mNumberOfColumns(0), mNumberOfRows(0), mNumberOfLayers(0),
+    mNumberOfThreads(1), mDiffusionCoefficient(0.0), mSpacing(1.0), mSplitting(StrangSplitting), mTolerance(1.0e-8),
+    mMaximumIterations(1000), mSolverIterations(0), mThreadPool(0)
+{
+}
+
+Monodomain::~Monodomain()
+{
+    if (mThreadPool) delete static_cast<ThreadPool*>(mThreadPool);
+}
+
+int Monodomain::create(Model* model, const std::string& voltageId, int numberOfColumns, int numberOfRows,
+                       int numberOfLayers)
+{
+    if (!(model && model->isInstantiated())) return MODEL_NOT_INSTANTIATED;
+    if ((numberOfColumns < 1) || (numberOfRows < 1) || (numberOfLayers < 1)) return INVALID_NUMBER_OF_CELLS;
+    int voltageIndex = model->getVariableIndex(voltageId, StateType);
+    if (voltageIndex < 0)
+    {
+        std::cerr << "Monodomain::create: the voltage must be a state variable: " << voltageId << std::endl;
+        return UNDEFINED_VARIABLE_TYPE;
+    }
+    int code = mPopulation.create(model, numberOfColumns * numberOfRows * numberOfLayers);
+    if (code != CSIM_OK) return code;
+    mVoltageIndex = voltageIndex;
+    mNumberOfColumns = numberOfColumns;
+    mNumberOfRows = numberOfRows;
+    mNumberOfLayers = numberOfLayers;
+    size_t n = size_t(mPopulation.numberOfCells());
+    mB.assign(n, 0.0);
+    mR.assign(n, 0.0);
+    if ((numberOfRows > 1) || (numberOfLayers > 1))
+    {
+        mP.assign(n, 0.0);
+        mQ.assign(n, 0.0);
+    }
+    return CSIM_OK;
+}
+
+int Monodomain::setDiffusion(double coefficient, double spacing)
+{
+    if ((coefficient < 0.0) || !(spacing > 0.0)) return INVALID_DIFFUSION_PARAMETERS;
+    mDiffusionCoefficient = coefficient;
+    mSpacing = spacing;
+    return CSIM_OK;
+}
+
+int Monodomain::setSplitting(SplittingScheme scheme)
+{
+    if ((scheme != GodunovSplitting) && (scheme != StrangSplitting)) return NOT_IMPLEMENTED;
+    mSplitting = scheme;
+    return CSIM_OK;
+}
+
+int Monodomain::setSolverTolerance(double tolerance, int maximumIterations)
+{
+    if (!(tolerance > 0.0) || (maximumIterations < 1)) return INVALID_DIFFUSION_PARAMETERS;
+    mTolerance = tolerance;
+    mMaximumIterations = maximumIterations;
+    return CSIM_OK;
+}
+
+int Monodomain::setNumberOfThreads(int numberOfThreads)
+{
+    int code = mPopulation.setNumberOfThreads(numberOfThreads);
+    if (code != CSIM_OK) return code;
+    mNumberOfThreads = numberOfThreads;
+    if (mThreadPool) delete static_cast<ThreadPool*>(mThreadPool);
+    mThreadPool = (numberOfThreads > 1) ? new ThreadPool(numberOfThreads, mPopulation.threadAffinity()) : 0;
+    return CSIM_OK;
+}
+
+int Monodomain::setThreadAffinity(const std::vector<int>& cpus)
+{
+    int code = mPopulation.setThreadAffinity(cpus);
+    if (code != CSIM_OK) return code;
+    return setNumberOfThreads(mNumberOfThreads);
+}
+
+double* Monodomain::voltage()
+{
+    return mPopulation.states(mVoltageIndex);
+}
+
+int Monodomain::cellIndex(int column, int row, int layer) const
+{
+    if ((column < 0) || (column >= mNumberOfColumns) || (row < 0) || (row >= mNumberOfRows) || (layer < 0)
+            || (layer >= mNumberOfLayers))
+        return -1;
+    return column + mNumberOfColumns * (row + mNumberOfRows * layer);
+}
+
+int Monodomain::step(double voi, double stepSize, int numberOfSteps, IntegrationMethod method)
+{
+    if (!voltage()) return MODEL_NOT_INSTANTIATED;
+    for (int n = 0; n < numberOfSteps; ++n)
+    {
+        // avoid accumulating round off in the variable of integration
+        double t = voi + n * stepSize;
+        int code = CSIM_OK;
+        if (mSplitting == StrangSplitting) code = diffuse(0.5 * stepSize, 0.5);
+        if (code == CSIM_OK) code = mPopulation.step(t, stepSize, 1, method);
+        if (code == CSIM_OK)
+        {
+            if (mSplitting == StrangSplitting) code = diffuse(0.5 * stepSize, 0.5);
+            else code = diffuse(stepSize, 1.0);
+        }
+        if (code != CSIM_OK) return code;
+    }
+    return CSIM_OK;
+}
+
+/*
+ * Diffuse the voltage for the given time using the theta method, i.e., solve
+ * (I + theta a K) v_new = (I - (1 - theta) a K) v_old with a = D time / h^2.
+ */
+int Monodomain::diffuse(double time, double theta)
+{
+    double a = mDiffusionCoefficient * time / (mSpacing * mSpacing);
+    mSolverIterations = 0;
+    if ((a == 0.0) || (mPopulation.numberOfCells() == 1)) return CSIM_OK;
+    if ((mNumberOfRows == 1) && (mNumberOfLayers == 1))
+    {
+        solveCable(a, theta);
+        return CSIM_OK;
+    }
+    return solveGrid(a, theta);
+}
+
+void Monodomain::solveCable(double a, double theta)
+{
+    // the Thomas algorithm for the tridiagonal system, with the modified upper diagonal kept in mR
+    int n = mNumberOfColumns;
+    double* v = voltage();
+    applyOperator(v, mB.data(), -(1.0 - theta) * a, n, 1, 1, 0, 1);
+    double offDiagonal = -theta * a;
+    double diagonal = 1.0 + theta * a;
+    mR[0] = offDiagonal / diagonal;
+    v[0] = mB[0] / diagonal;
+    for (int i = 1; i < n; ++i)
+    {
+        double d = ((i == n - 1) ? diagonal : (diagonal + theta * a)) - offDiagonal * mR[i - 1];
+        mR[i] = offDiagonal / d;
+        v[i] = (mB[i] - offDiagonal * v[i - 1]) / d;
+    }
+    for (int i = n - 2; i >= 0; --i) v[i] -= mR[i] * v[i + 1];
+}
+
+int Monodomain::solveGrid(double a, double theta)
+{
+    // Jacobi preconditioned conjugate gradient, with each thread working on its own lines of the grid and the dot
+    // products summed over the threads between the phases of each iteration. The diagonal of the operator only
+    // depends on the number of neighbours of each cell, so the preconditioner is a small table rather than an array
+    int columns = mNumberOfColumns, rows = mNumberOfRows, layers = mNumberOfLayers;
+    int lines = rows * layers;
+    int numberOfThreads = mThreadPool ? static_cast<ThreadPool*>(mThreadPool)->numberOfThreads() : 1;
+    std::vector<int> bounds(numberOfThreads + 1);
+    for (int t = 0; t <= numberOfThreads; ++t) bounds[t] = int(int64_t(lines) * t / numberOfThreads);
+    std::vector<PartialSums> partial(numberOfThreads);
+    auto sum = [&](int k) {
+        double total = 0.0;
+        for (const auto& p: partial) total += p.value[k];
+        return total;
+    };
+    double c = theta * a;
+    double inverseDiagonal[7];
+    for (int degree = 0; degree < 7; ++degree) inverseDiagonal[degree] = 1.0 / (1.0 + c * degree);
+    // the preconditioner for the cells of a line starts from the number of neighbours the line has
+    auto lineInverseDiagonal = [&](int line) {
+        int row = line % rows, layer = line / rows;
+        return inverseDiagonal + (row > 0) + (row < rows - 1) + (layer > 0) + (layer < layers - 1);
+    };
+    double* x = voltage();
+    double* b = mB.data();
+    double* r = mR.data();
+    double* p = mP.data();
+    double* q = mQ.data();
+
+    runOnThreads(mThreadPool, [&](int t) {
+        applyOperator(x, b, -(1.0 - theta) * a, columns, rows, layers, bounds[t], bounds[t + 1]);
+        applyOperator(x, q, c, columns, rows, layers, bounds[t], bounds[t + 1]);
+        double rz = 0.0, rr = 0.0, bb = 0.0;
+        for (int line = bounds[t]; line < bounds[t + 1]; ++line)
+        {
+            size_t first = size_t(line) * columns;
+            const double* preconditioner = lineInverseDiagonal(line);
+            for (int i = 0; i < columns; ++i)
+            {
+                size_t k = first + i;
+                r[k] = b[k] - q[k];
+                p[k] = r[k] * preconditioner[(i > 0) + (i < columns - 1)];
+                rz += r[k] * p[k];
+                rr += r[k] * r[k];
+                bb += b[k] * b[k];
+            }
+        }
+        partial[t].value[0] = rz;
+        partial[t].value[1] = rr;
+        partial[t].value[2] = bb;
+    });
+    double rz = sum(0), target = mTolerance * mTolerance * sum(2);
+    if (sum(1) <= target) return CSIM_OK;
+    for (int iteration = 1; iteration <= mMaximumIterations; ++iteration)
+    {
+        runOnThreads(mThreadPool, [&](int t) {
+            applyOperator(p, q, c, columns, rows, layers, bounds[t], bounds[t + 1]);
+            double pq = 0.0;
+            for (size_t k = size_t(bounds[t]) * columns; k < size_t(bounds[t + 1]) * columns; ++k) pq += p[k] * q[k];
+            partial[t].value[0] = pq;
+        });
+        double alpha = rz / sum(0);
+        runOnThreads(mThreadPool, [&](int t) {
+            double rzNext = 0.0, rr = 0.0;
+            for (int line = bounds[t]; line < bounds[t + 1]; ++line)
+            {
+                size_t first = size_t(line) * columns;
+                const double* preconditioner = lineInverseDiagonal(line);
+                for (int i = 0; i < columns; ++i)
+                {
+                    size_t k = first + i;
+                    x[k] += alpha * p[k];
+                    r[k] -= alpha * q[k];
+                    rzNext += r[k] * r[k] * preconditioner[(i > 0) + (i < columns - 1)];
+                    rr += r[k] * r[k];
+                }
+            }
+            partial[t].value[0] = rzNext;
+            partial[t].value[1] = rr;
+        });
+        mSolverIterations = iteration;
+        if (sum(1) <= target) return CSIM_OK;
+        double rzNext = sum(0);
+        double beta = rzNext / rz;
+        rz = rzNext;
+        runOnThreads(mThreadPool, [&](int t) {
+            for (int line = bounds[t]; line < bounds[t + 1]; ++line)
+            {
+                size_t first = size_t(line) * columns;
+                const double* preconditioner = lineInverseDiagonal(line);
+                for (int i = 0; i < columns; ++i)
+                    p[first + i] = r[first + i] * preconditioner[(i > 0) + (i < columns - 1)] + beta * p[first + i];
+            }
+        });
+    }
+    std::cerr << "Monodomain::solveGrid: the diffusion solve did not converge in " << mMaximumIterations
+              << " iterations." << std::endl;
+    return DIFFUSION_SOLVER_NOT_CONVERGED;
+}
+
+} // namespace csim
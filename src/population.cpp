@@ -0,0 +1,392 @@
+/*
+Copyright 2015 University of Auckland
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.Some license of other
+*/
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+#include "csim/population.h"
+#include "csim/model.h"
+#include "csim/error_codes.h"
+#include "csim/statistics.h"
+#include "csim/variable_types.h"
+#include "thread_pool.h"
+
+namespace csim {
+
+// the number of values in a cache line, each variable's values start on a new cache line
+static const int CELLS_PER_LINE = 8;
+// the number of values in a page of memory, the unit in which memory is placed on NUMA nodes
+static const size_t VALUES_PER_PAGE = 4096 / sizeof(double);
+
+/*
+ * Allocate storage without writing to it, so that its pages are only placed in memory when first written to. On
+ * Linux the storage is mapped directly, as the C library may otherwise hand back memory already written to.
+ */
+static double* allocateStorage(size_t size)
+{
+#ifdef __linux__
+    void* storage = mmap(NULL, size * sizeof(double), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (storage == MAP_FAILED) throw std::bad_alloc();
+    return static_cast<double*>(storage);
+#else
+    return new double[size];
+#endif
+}
+
+static void freeStorage(double* storage, size_t size)
+{
+    if (!storage) return;
+#ifdef __linux__
+    munmap(storage, size * sizeof(double));
+#else
+    (void)size;
+    delete[] storage;
+#endif
+}
+
+Population::Population() : mModel(0), mNumberOfCells(0), mStride(0), mNumberOfThreads(1), mNumberOfStates(0),
+    mNumberOfOutputs(0), mNumberOfInputs(0), mMemoryPlacement(FirstTouchPlacement), mStorage(0), mStorageSize(0),
+    mStates(0), mRates(0), mOutputs(0), mInputs(0), mThreadPool(0)
+{
+}
+
+Population::~Population()
+{
+    if (mThreadPool) delete static_cast<ThreadPool*>(mThreadPool);
+    freeStorage(mStorage, mStorageSize);
+}
+
+int Population::create(Model* model, int numberOfCells)
+{
+    if (!(model && model->isInstantiated())) return MODEL_NOT_INSTANTIATED;
+    if (numberOfCells < 1) return INVALID_NUMBER_OF_CELLS;
+    mModel = model;
+    mNumberOfCells = numberOfCells;
+    mStride = (numberOfCells + CELLS_PER_LINE - 1) / CELLS_PER_LINE * CELLS_PER_LINE;
+    mNumberOfStates = model->numberOfStateVariables();
+    mNumberOfOutputs = model->numberOfOutputVariables();
+    mNumberOfInputs = model->numberOfInputVariables();
+    place(false);
+    return initialise();
+}
+
+void Population::place(bool keepValues)
+{
+    // one block of storage for all of the arrays, with room to start it on a cache line boundary
+    size_t rows = 2 * size_t(mNumberOfStates) + mNumberOfOutputs + mNumberOfInputs;
+    size_t size = rows * mStride + CELLS_PER_LINE;
+    double* storage = allocateStorage(size);
+    uintptr_t address = reinterpret_cast<uintptr_t>(storage);
+    size_t misalignment = (address % (CELLS_PER_LINE * sizeof(double))) / sizeof(double);
+    double* start = storage + ((misalignment > 0) ? (CELLS_PER_LINE - misalignment) : 0);
+    // the threads which advance the cells write to the new storage first, copying any values being kept
+    const double* previous = keepValues ? mStates : NULL;
+    std::vector<int> bounds = cellBounds();
+    int numberOfThreads = int(bounds.size()) - 1;
+    auto touch = [start, previous](size_t first, size_t last) {
+        if (previous) std::copy(previous + first, previous + last, start + first);
+        else std::fill(start + first, start + last, 0.0);
+    };
+    std::function<void(int)> task = [&](int t) {
+        if (mMemoryPlacement == InterleavedPlacement)
+        {
+            size_t total = rows * mStride;
+            for (size_t page = t; page * VALUES_PER_PAGE < total; page += numberOfThreads)
+                touch(page * VALUES_PER_PAGE, std::min((page + 1) * VALUES_PER_PAGE, total));
+        }
+        else
+        {
+            size_t first = bounds[t], last = (t == numberOfThreads - 1) ? mStride : bounds[t + 1];
+            for (size_t r = 0; r < rows; ++r) touch(r * mStride + first, r * mStride + last);
+        }
+    };
+    ThreadPool* pool = static_cast<ThreadPool*>(threadPool(numberOfThreads));
+    if (pool) pool->run(task);
+    else task(0);
+    freeStorage(mStorage, mStorageSize);
+    mStorage = storage;
+    mStorageSize = size;
+    mStates = start;
+    mRates = mStates + size_t(mNumberOfStates) * mStride;
+    mOutputs = mRates + size_t(mNumberOfStates) * mStride;
+    mInputs = mOutputs + size_t(mNumberOfOutputs) * mStride;
+}
+
+int Population::initialise()
+{
+    if (!mModel) return MODEL_NOT_INSTANTIATED;
+    InitialiseFunction initialise = mModel->getInitialiseFunction();
+    if (!initialise) return MODEL_NOT_INSTANTIATED;
+    // initialise a single cell and copy it to the rest
+    std::vector<double> cellStates(mNumberOfStates + 1), cellOutputs(mNumberOfOutputs + 1),
+            cellInputs(mNumberOfInputs + 1);
+    initialise(cellStates.data(), cellOutputs.data(), cellInputs.data());
+    for (int i = 0; i < mNumberOfStates; ++i)
+    {
+        std::fill(states(i), states(i) + mNumberOfCells, cellStates[i]);
+        std::fill(rates(i), rates(i) + mNumberOfCells, 0.0);
+    }
+    for (int i = 0; i < mNumberOfOutputs; ++i) std::fill(outputs(i), outputs(i) + mNumberOfCells, cellOutputs[i]);
+    for (int i = 0; i < mNumberOfInputs; ++i) std::fill(inputs(i), inputs(i) + mNumberOfCells, cellInputs[i]);
+    return CSIM_OK;
+}
+
+int Population::setNumberOfThreads(int numberOfThreads)
+{
+    if (numberOfThreads < 1) return INVALID_NUMBER_OF_THREADS;
+    mNumberOfThreads = numberOfThreads;
+    // the threads are started again when they are next needed
+    if (mThreadPool) delete static_cast<ThreadPool*>(mThreadPool);
+    mThreadPool = 0;
+    if (mModel) place(true);
+    return CSIM_OK;
+}
+
+int Population::setThreadAffinity(const std::vector<int>& cpus)
+{
+    if (!(cpus.empty() || ThreadPool::supportsAffinity()))
+    {
+        std::cerr << "Population::setThreadAffinity: threads can not be pinned to CPUs on this platform" << std::endl;
+        return NOT_IMPLEMENTED;
+    }
+    for (int cpu: cpus)
+    {
+        if (cpu < 0) return INVALID_THREAD_AFFINITY;
+    }
+    mThreadAffinity = cpus;
+    if (mThreadPool) delete static_cast<ThreadPool*>(mThreadPool);
+    mThreadPool = 0;
+    if (mModel) place(true);
+    return CSIM_OK;
+}
+
+int Population::setMemoryPlacement(MemoryPlacement placement)
+{
+    if ((placement != FirstTouchPlacement) && (placement != InterleavedPlacement)) return NOT_IMPLEMENTED;
+    mMemoryPlacement = placement;
+    if (mModel) place(true);
+    return CSIM_OK;
+}
+
+int Population::setInput(int inputIndex, int cell, double value)
+{
+    double* values = inputs(inputIndex);
+    if (!values) return UNDEFINED_VARIABLE_TYPE;
+    if ((cell < 0) || (cell >= mNumberOfCells)) return INVALID_CELL_INDEX;
+    values[cell] = value;
+    return CSIM_OK;
+}
+
+int Population::setInput(int inputIndex, double value)
+{
+    double* values = inputs(inputIndex);
+    if (!values) return UNDEFINED_VARIABLE_TYPE;
+    std::fill(values, values + mNumberOfCells, value);
+    return CSIM_OK;
+}
+
+std::vector<int> Population::cellBounds() const
+{
+    // each thread advances whole cache lines of cells, so no two threads ever write to the same line
+    int lines = mStride / CELLS_PER_LINE;
+    int numberOfThreads = std::max(1, std::min(mNumberOfThreads, lines));
+    std::vector<int> bounds(numberOfThreads + 1);
+    for (int t = 0; t <= numberOfThreads; ++t)
+        bounds[t] = std::min(int(int64_t(lines) * t / numberOfThreads) * CELLS_PER_LINE, mNumberOfCells);
+    return bounds;
+}
+
+void* Population::threadPool(int numberOfThreads)
+{
+    if (numberOfThreads == 1) return NULL;
+    ThreadPool* pool = static_cast<ThreadPool*>(mThreadPool);
+    if (!(pool && (pool->numberOfThreads() == numberOfThreads)))
+    {
+        delete pool;
+        pool = new ThreadPool(numberOfThreads, mThreadAffinity);
+        mThreadPool = pool;
+    }
+    return pool;
+}
+
+double* Population::row(double* array, int numberOfRows, int index)
+{
+    if ((index < 0) || (index >= numberOfRows)) return NULL;
+    return array + size_t(index) * mStride;
+}
+
+double* Population::states(int stateIndex)
+{
+    return row(mStates, mNumberOfStates, stateIndex);
+}
+
+double* Population::rates(int stateIndex)
+{
+    return row(mRates, mNumberOfStates, stateIndex);
+}
+
+double* Population::outputs(int outputIndex)
+{
+    return row(mOutputs, mNumberOfOutputs, outputIndex);
+}
+
+double* Population::inputs(int inputIndex)
+{
+    return row(mInputs, mNumberOfInputs, inputIndex);
+}
+
+double* Population::values(const std::string& variableId, unsigned char variableType)
+{
+    if (!mModel) return NULL;
+    int index = mModel->getVariableIndex(variableId, variableType);
+    if (variableType == StateType) return states(index);
+    if (variableType == OutputType) return outputs(index);
+    if (variableType == InputType) return inputs(index);
+    return NULL;
+}
+
+typedef std::function<void(double, double, int, int, int, int, double*, double*, double*, double*)> CellsIntegrator;
+
+/*
+ * Get the function advancing a range of the cells of a population of the given model with the given method, with the
+ * same arguments as a csim::PopulationIntegratorFunction. Models compiled in chunks have no population integrators,
+ * so their cells are advanced one at a time by the model's fused integrator instead, gathering the values of each
+ * cell from the population's arrays and scattering them back after its steps.
+ */
+static CellsIntegrator cellsIntegrator(const Model* model, IntegrationMethod method)
+{
+    PopulationIntegratorFunction population = model->getPopulationIntegratorFunction(method);
+    if (population) return population;
+    if ((method != EulerMethod) && (method != RushLarsenMethod)) return CellsIntegrator();
+    IntegratorFunction integrate = model->getIntegratorFunction(method);
+    if (!integrate) return CellsIntegrator();
+    int numberOfStates = model->numberOfStateVariables(), numberOfOutputs = model->numberOfOutputVariables();
+    int numberOfInputs = model->numberOfInputVariables();
+    return [=](double voi, double stepSize, int numberOfSteps, int stride, int first, int last, double* states,
+               double* rates, double* outputs, double* inputs) {
+        std::vector<double> cellStates(numberOfStates + 1), cellRates(numberOfStates + 1);
+        std::vector<double> cellOutputs(numberOfOutputs + 1), cellInputs(numberOfInputs + 1);
+        for (int c = first; c < last; ++c)
+        {
+            for (int i = 0; i < numberOfStates; ++i) cellStates[i] = states[size_t(i) * stride + c];
+            for (int i = 0; i < numberOfInputs; ++i) cellInputs[i] = inputs[size_t(i) * stride + c];
+            integrate(voi, stepSize, numberOfSteps, cellStates.data(), cellRates.data(), cellOutputs.data(),
+                      cellInputs.data(), NULL);
+            for (int i = 0; i < numberOfStates; ++i)
+            {
+                states[size_t(i) * stride + c] = cellStates[i];
+                rates[size_t(i) * stride + c] = cellRates[i];
+            }
+            for (int i = 0; i < numberOfOutputs; ++i) outputs[size_t(i) * stride + c] = cellOutputs[i];
+        }
+    };
+}
+
+int Population::step(double voi, double stepSize, int numberOfSteps, IntegrationMethod method)
+{
+    if (!mModel) return MODEL_NOT_INSTANTIATED;
+    CellsIntegrator integrate = cellsIntegrator(mModel, method);
+    if (!integrate)
+    {
+        std::cerr << "Population::step: no integrator available for method: " << method << std::endl;
+        return NOT_IMPLEMENTED;
+    }
+    std::vector<int> bounds = cellBounds();
+    ThreadPool* pool = static_cast<ThreadPool*>(threadPool(int(bounds.size()) - 1));
+    if (!pool)
+    {
+        integrate(voi, stepSize, numberOfSteps, mStride, 0, mNumberOfCells, mStates, mRates, mOutputs, mInputs);
+        return CSIM_OK;
+    }
+    pool->run([&](int t) {
+        integrate(voi, stepSize, numberOfSteps, mStride, bounds[t], bounds[t + 1], mStates, mRates, mOutputs, mInputs);
+    });
+    return CSIM_OK;
+}
+
+int Population::sample(double voi, double stepSize, int numberOfSamples, int stepsPerSample,
+                       IntegrationMethod method, PopulationStatistics& statistics)
+{
+    if (!mModel) return MODEL_NOT_INSTANTIATED;
+    if ((numberOfSamples < 0) || (stepsPerSample < 1)) return INVALID_SAMPLING;
+    CellsIntegrator integrate = cellsIntegrator(mModel, method);
+    if (!integrate)
+    {
+        std::cerr << "Population::sample: no integrator available for method: " << method << std::endl;
+        return NOT_IMPLEMENTED;
+    }
+    // the arrays move when the threads change, so the variables are looked up afresh
+    bool first = statistics.mSampleTimes.empty();
+    int numberOfVariables = statistics.numberOfVariables();
+    std::vector<const double*> variables(numberOfVariables);
+    for (int v = 0; v < numberOfVariables; ++v)
+    {
+        variables[v] = values(statistics.mVariableIds[v], statistics.mVariableTypes[v]);
+        if (!variables[v])
+        {
+            std::cerr << "Population::sample: no such variable: " << statistics.mVariableIds[v] << std::endl;
+            return UNDEFINED_VARIABLE_TYPE;
+        }
+        if (first) statistics.mOverTime[v].reset(mNumberOfCells);
+        else if (statistics.mOverTime[v].numberOfSeries() != mNumberOfCells) return INVALID_NUMBER_OF_CELLS;
+    }
+    int numberOfDetectors = statistics.numberOfBiomarkerDetectors();
+    std::vector<const double*> detected(numberOfDetectors);
+    for (int d = 0; d < numberOfDetectors; ++d)
+    {
+        BiomarkerDetector& detector = statistics.mDetectors[d];
+        detected[d] = values(statistics.mDetectorIds[d], statistics.mDetectorTypes[d]);
+        if (!detected[d])
+        {
+            std::cerr << "Population::sample: no such variable: " << statistics.mDetectorIds[d] << std::endl;
+            return UNDEFINED_VARIABLE_TYPE;
+        }
+        if (first) detector.reset(mNumberOfCells, detector.threshold());
+        else if (detector.numberOfSeries() != mNumberOfCells) return INVALID_NUMBER_OF_CELLS;
+    }
+    std::vector<int> bounds = cellBounds();
+    int numberOfThreads = int(bounds.size()) - 1;
+    ThreadPool* pool = static_cast<ThreadPool*>(threadPool(numberOfThreads));
+    std::vector<PopulationStatistics::Partial> partials(size_t(numberOfThreads) * numberOfVariables);
+    for (int n = 0; n < numberOfSamples; ++n)
+    {
+        double start = voi + double(n) * stepsPerSample * stepSize;
+        double time = voi + double(n + 1) * stepsPerSample * stepSize;
+        std::function<void(int)> task = [&](int t) {
+            integrate(start, stepSize, stepsPerSample, mStride, bounds[t], bounds[t + 1], mStates, mRates, mOutputs,
+                      mInputs);
+            for (int v = 0; v < numberOfVariables; ++v)
+                statistics.reduce(v, time, variables[v], bounds[t], bounds[t + 1],
+                                  partials[size_t(t) * numberOfVariables + v]);
+            for (int d = 0; d < numberOfDetectors; ++d)
+                statistics.mDetectors[d].add(time, detected[d], bounds[t], bounds[t + 1]);
+        };
+        if (pool) pool->run(task);
+        else task(0);
+        statistics.addSample(time, partials, numberOfThreads);
+    }
+    return CSIM_OK;
+}
+
+} // namespace csim
@@ -0,0 +1,403 @@
+/*
+Copyright 2015 University of Auckland
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.Some license of other
+*/
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include <zlib.h>
+
+#include "csim/result_format.h"
+#include "csim/error_codes.h"
+
+namespace csim {
+
+static const char FILE_MAGIC[] = "CSIMRES1";
+static const char CHUNK_MAGIC[] = "CHNK";
+static const char INDEX_MAGIC[] = "CSIMIDX1";
+// the size of a chunk's header: magic, number of rows and the first and last times
+static const size_t CHUNK_HEADER_SIZE = 4 + 4 + 8 + 8;
+// the size of each entry of the index, and of the footer
+static const size_t INDEX_ENTRY_SIZE = 8 + 4 + 8 + 8;
+static const size_t FOOTER_SIZE = 8 + 8 + 8;
+
+static int seekFile(FILE* file, int64_t offset, int origin)
+{
+#ifdef _WIN32
+    return _fseeki64(file, offset, origin);
+#else
+    return fseeko(file, off_t(offset), origin);
+#endif
+}
+
+static int64_t tellFile(FILE* file)
+{
+#ifdef _WIN32
+    return _ftelli64(file);
+#else
+    return int64_t(ftello(file));
+#endif
+}
+
+static void append(std::vector<unsigned char>& buffer, uint64_t value, int numberOfBytes)
+{
+    for (int b = 0; b < numberOfBytes; ++b) buffer.push_back((unsigned char)(value >> (8 * b)));
+}
+
+static void appendDouble(std::vector<unsigned char>& buffer, double value)
+{
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    append(buffer, bits, 8);
+}
+
+static uint64_t extract(const unsigned char* buffer, int numberOfBytes)
+{
+    uint64_t value = 0;
+    for (int b = 0; b < numberOfBytes; ++b) value |= uint64_t(buffer[b]) << (8 * b);
+    return value;
+}
+
+static double extractDouble(const unsigned char* buffer)
+{
+    uint64_t bits = extract(buffer, 8);
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static bool readBytes(FILE* file, std::vector<unsigned char>& buffer, size_t size)
+{
+    buffer.resize(size);
+    return (size == 0) || (fread(buffer.data(), 1, size, file) == size);
+}
+
+CompressedResultSink::CompressedResultSink() : mFile(NULL), mTimeColumn(-1), mNumberOfRows(0)
+{
+}
+
+CompressedResultSink::~CompressedResultSink()
+{
+    if (mFile) finish();
+}
+
+int CompressedResultSink::open(const std::string& fileName, const std::vector<std::string>& columnIds,
+                               int timeColumn, const std::vector<ColumnEncoding>& encodings)
+{
+    if (mFile) finish();
+    if (columnIds.empty() || (timeColumn >= int(columnIds.size()))
+            || !(encodings.empty() || (encodings.size() == columnIds.size())))
+    {
+        std::cerr << "CompressedResultSink::open: need an encoding for every column and a valid time column"
+                  << std::endl;
+        return INVALID_RESULT_LAYOUT;
+    }
+    mFile = fopen(fileName.c_str(), "wb");
+    if (!mFile)
+    {
+        std::cerr << "CompressedResultSink::open: unable to create the file: " << fileName << std::endl;
+        return UNABLE_TO_WRITE_RESULTS;
+    }
+    mTimeColumn = (timeColumn < 0) ? -1 : timeColumn;
+    mEncodings = encodings;
+    if (mEncodings.empty()) mEncodings.assign(columnIds.size(), DeltaEncoding);
+    mNumberOfRows = 0;
+    mChunkOffsets.clear();
+    mChunkRows.clear();
+    mChunkTimes.clear();
+    std::vector<unsigned char> header(FILE_MAGIC, FILE_MAGIC + 8);
+    append(header, columnIds.size(), 4);
+    append(header, uint32_t(int32_t(mTimeColumn)), 4);
+    for (size_t c = 0; c < columnIds.size(); ++c)
+    {
+        append(header, columnIds[c].size(), 4);
+        header.insert(header.end(), columnIds[c].begin(), columnIds[c].end());
+        header.push_back((unsigned char)mEncodings[c]);
+    }
+    // flushed so the file can be read while the simulation is still writing to it
+    if ((fwrite(header.data(), 1, header.size(), mFile) != header.size()) || (fflush(mFile) != 0))
+    {
+        return UNABLE_TO_WRITE_RESULTS;
+    }
+    return CSIM_OK;
+}
+
+int CompressedResultSink::write(const double* values, int numberOfRows, int numberOfColumns)
+{
+    if (!mFile || (numberOfColumns != int(mEncodings.size()))) return INVALID_RESULT_LAYOUT;
+    if (numberOfRows < 1) return CSIM_OK;
+    double firstTime = double(mNumberOfRows), lastTime = double(mNumberOfRows + numberOfRows - 1);
+    if (mTimeColumn >= 0)
+    {
+        firstTime = values[mTimeColumn];
+        lastTime = values[size_t(numberOfRows - 1) * numberOfColumns + mTimeColumn];
+    }
+    mChunkOffsets.push_back(uint64_t(tellFile(mFile)));
+    mChunkRows.push_back(uint32_t(numberOfRows));
+    mChunkTimes.push_back(firstTime);
+    mChunkTimes.push_back(lastTime);
+    std::vector<unsigned char> chunk(CHUNK_MAGIC, CHUNK_MAGIC + 4);
+    append(chunk, uint32_t(numberOfRows), 4);
+    appendDouble(chunk, firstTime);
+    appendDouble(chunk, lastTime);
+    mEncoded.resize(size_t(numberOfRows) * 8);
+    mCompressed.resize(compressBound(uLong(mEncoded.size())));
+    for (int c = 0; c < numberOfColumns; ++c)
+    {
+        // encode the bit patterns, and store each byte of the patterns together
+        uint64_t previous = 0;
+        for (int r = 0; r < numberOfRows; ++r)
+        {
+            uint64_t bits;
+            memcpy(&bits, values + size_t(r) * numberOfColumns + c, sizeof(bits));
+            uint64_t encoded = bits;
+            if (mEncodings[c] == DeltaEncoding) encoded = bits - previous;
+            else if (mEncodings[c] == XorEncoding) encoded = bits ^ previous;
+            previous = bits;
+            for (int b = 0; b < 8; ++b) mEncoded[size_t(b) * numberOfRows + r] = (unsigned char)(encoded >> (8 * b));
+        }
+        uLongf size = uLongf(mCompressed.size());
+        if (compress2(mCompressed.data(), &size, mEncoded.data(), uLong(mEncoded.size()), Z_BEST_SPEED) != Z_OK)
+        {
+            return UNABLE_TO_WRITE_RESULTS;
+        }
+        append(chunk, uint32_t(size), 4);
+        chunk.insert(chunk.end(), mCompressed.begin(), mCompressed.begin() + size);
+    }
+    if ((fwrite(chunk.data(), 1, chunk.size(), mFile) != chunk.size()) || (fflush(mFile) != 0))
+    {
+        return UNABLE_TO_WRITE_RESULTS;
+    }
+    mNumberOfRows += numberOfRows;
+    return CSIM_OK;
+}
+
+int CompressedResultSink::finish()
+{
+    if (!mFile) return CSIM_OK;
+    std::vector<unsigned char> index;
+    uint64_t indexOffset = uint64_t(tellFile(mFile));
+    for (size_t k = 0; k < mChunkOffsets.size(); ++k)
+    {
+        append(index, mChunkOffsets[k], 8);
+        append(index, mChunkRows[k], 4);
+        appendDouble(index, mChunkTimes[2 * k]);
+        appendDouble(index, mChunkTimes[2 * k + 1]);
+    }
+    append(index, mChunkOffsets.size(), 8);
+    append(index, indexOffset, 8);
+    index.insert(index.end(), INDEX_MAGIC, INDEX_MAGIC + 8);
+    bool written = fwrite(index.data(), 1, index.size(), mFile) == index.size();
+    written = (fclose(mFile) == 0) && written;
+    mFile = NULL;
+    return written ? CSIM_OK : UNABLE_TO_WRITE_RESULTS;
+}
+
+ResultReader::ResultReader() : mFile(NULL), mFileSize(0), mTimeColumn(-1)
+{
+}
+
+ResultReader::~ResultReader()
+{
+    if (mFile) fclose(mFile);
+}
+
+int ResultReader::open(const std::string& fileName)
+{
+    if (mFile) fclose(mFile);
+    mColumnIds.clear();
+    mEncodings.clear();
+    mChunkOffsets.clear();
+    mChunkRows.clear();
+    mChunkTimes.clear();
+    mFile = fopen(fileName.c_str(), "rb");
+    if (!mFile)
+    {
+        std::cerr << "ResultReader::open: unable to open the file: " << fileName << std::endl;
+        return INVALID_RESULT_FILE;
+    }
+    // the lengths and offsets in the file are checked against its size before anything is allocated for them
+    seekFile(mFile, 0, SEEK_END);
+    mFileSize = tellFile(mFile);
+    seekFile(mFile, 0, SEEK_SET);
+    std::vector<unsigned char> buffer;
+    if (!(readBytes(mFile, buffer, 16) && (memcmp(buffer.data(), FILE_MAGIC, 8) == 0)))
+    {
+        std::cerr << "ResultReader::open: not a CSim result file: " << fileName << std::endl;
+        return INVALID_RESULT_FILE;
+    }
+    uint32_t numberOfColumns = uint32_t(extract(buffer.data() + 8, 4));
+    mTimeColumn = int32_t(uint32_t(extract(buffer.data() + 12, 4)));
+    for (uint32_t c = 0; c < numberOfColumns; ++c)
+    {
+        if (!readBytes(mFile, buffer, 4)) return INVALID_RESULT_FILE;
+        uint64_t length = extract(buffer.data(), 4);
+        if ((length + 1 > uint64_t(mFileSize - tellFile(mFile))) || !readBytes(mFile, buffer, size_t(length) + 1))
+        {
+            std::cerr << "ResultReader::open: invalid identifier for column " << c << " in the file: " << fileName
+                      << std::endl;
+            return INVALID_RESULT_FILE;
+        }
+        mColumnIds.push_back(std::string(buffer.begin(), buffer.begin() + length));
+        mEncodings.push_back(ColumnEncoding(buffer[length]));
+    }
+    int64_t chunksStart = tellFile(mFile);
+    // use the index if the file was finished, otherwise find the chunks written so far
+    if ((seekFile(mFile, -int64_t(FOOTER_SIZE), SEEK_END) == 0) && readBytes(mFile, buffer, FOOTER_SIZE)
+            && (memcmp(buffer.data() + 16, INDEX_MAGIC, 8) == 0))
+    {
+        uint64_t numberOfChunks = extract(buffer.data(), 8);
+        uint64_t indexOffset = extract(buffer.data() + 8, 8);
+        // the index has to sit exactly between the chunks and the footer
+        uint64_t footerOffset = uint64_t(mFileSize) - FOOTER_SIZE;
+        if ((indexOffset < uint64_t(chunksStart)) || (indexOffset > footerOffset)
+                || (numberOfChunks != (footerOffset - indexOffset) / INDEX_ENTRY_SIZE)
+                || ((footerOffset - indexOffset) % INDEX_ENTRY_SIZE != 0))
+        {
+            std::cerr << "ResultReader::open: invalid index in the file: " << fileName << std::endl;
+            return INVALID_RESULT_FILE;
+        }
+        if ((seekFile(mFile, int64_t(indexOffset), SEEK_SET) == 0)
+                && readBytes(mFile, buffer, size_t(numberOfChunks * INDEX_ENTRY_SIZE)))
+        {
+            for (uint64_t k = 0; k < numberOfChunks; ++k)
+            {
+                const unsigned char* entry = buffer.data() + k * INDEX_ENTRY_SIZE;
+                uint64_t offset = extract(entry, 8);
+                if ((offset < uint64_t(chunksStart)) || (offset + CHUNK_HEADER_SIZE > indexOffset))
+                {
+                    std::cerr << "ResultReader::open: invalid offset for chunk " << k << " in the file: " << fileName
+                              << std::endl;
+                    return INVALID_RESULT_FILE;
+                }
+                mChunkOffsets.push_back(offset);
+                mChunkRows.push_back(uint32_t(extract(entry + 8, 4)));
+                mChunkTimes.push_back(extractDouble(entry + 12));
+                mChunkTimes.push_back(extractDouble(entry + 20));
+            }
+            return CSIM_OK;
+        }
+    }
+    return readChunkHeaders(chunksStart);
+}
+
+int ResultReader::readChunkHeaders(int64_t start)
+{
+    std::vector<unsigned char> buffer;
+    int64_t offset = start;
+    while (true)
+    {
+        if ((seekFile(mFile, offset, SEEK_SET) != 0) || !readBytes(mFile, buffer, CHUNK_HEADER_SIZE)
+                || (memcmp(buffer.data(), CHUNK_MAGIC, 4) != 0)) break;
+        uint32_t rows = uint32_t(extract(buffer.data() + 4, 4));
+        double firstTime = extractDouble(buffer.data() + 8), lastTime = extractDouble(buffer.data() + 16);
+        int64_t next = offset + CHUNK_HEADER_SIZE;
+        bool complete = true;
+        for (size_t c = 0; (c < mColumnIds.size()) && complete; ++c)
+        {
+            complete = (seekFile(mFile, next, SEEK_SET) == 0) && readBytes(mFile, buffer, 4);
+            if (complete) next += 4 + int64_t(extract(buffer.data(), 4));
+        }
+        // a chunk still being written is left out
+        if (!complete || (next > mFileSize)) break;
+        mChunkOffsets.push_back(uint64_t(offset));
+        mChunkRows.push_back(rows);
+        mChunkTimes.push_back(firstTime);
+        mChunkTimes.push_back(lastTime);
+        offset = next;
+    }
+    return CSIM_OK;
+}
+
+int ResultReader::columnIndex(const std::string& columnId) const
+{
+    auto it = std::find(mColumnIds.begin(), mColumnIds.end(), columnId);
+    return (it == mColumnIds.end()) ? -1 : int(it - mColumnIds.begin());
+}
+
+uint64_t ResultReader::numberOfRows() const
+{
+    uint64_t rows = 0;
+    for (uint32_t chunkRows: mChunkRows) rows += chunkRows;
+    return rows;
+}
+
+int ResultReader::read(double startTime, double endTime, const std::vector<int>& columns,
+                       std::vector<double>& values)
+{
+    values.clear();
+    if (!mFile) return INVALID_RESULT_FILE;
+    for (int column: columns)
+    {
+        if ((column < 0) || (column >= int(mColumnIds.size()))) return INVALID_RESULT_LAYOUT;
+    }
+    // the time column is needed to pick out the rows within the range
+    std::vector<int> needed(columns);
+    if (mTimeColumn >= 0) needed.push_back(mTimeColumn);
+    std::vector<std::vector<double> > decoded(mColumnIds.size());
+    std::vector<unsigned char> compressed, encoded;
+    uint64_t firstRow = 0;
+    for (size_t k = 0; k < mChunkOffsets.size(); firstRow += mChunkRows[k], ++k)
+    {
+        if ((mChunkTimes[2 * k + 1] < startTime) || (mChunkTimes[2 * k] > endTime)) continue;
+        uint32_t rows = mChunkRows[k];
+        int64_t offset = int64_t(mChunkOffsets[k]) + CHUNK_HEADER_SIZE;
+        for (size_t c = 0; c < mColumnIds.size(); ++c)
+        {
+            if ((seekFile(mFile, offset, SEEK_SET) != 0) || !readBytes(mFile, compressed, 4))
+                return INVALID_RESULT_FILE;
+            uint32_t size = uint32_t(extract(compressed.data(), 4));
+            offset += 4 + size;
+            if (offset > mFileSize)
+            {
+                std::cerr << "ResultReader::read: column " << c << " of chunk " << k << " runs past the end of the file"
+                          << std::endl;
+                return INVALID_RESULT_FILE;
+            }
+            if (std::find(needed.begin(), needed.end(), int(c)) == needed.end()) continue;
+            encoded.resize(size_t(rows) * 8);
+            uLongf length = uLongf(encoded.size());
+            if (!readBytes(mFile, compressed, size)
+                    || (uncompress(encoded.data(), &length, compressed.data(), size) != Z_OK)
+                    || (length != encoded.size()))
+            {
+                std::cerr << "ResultReader::read: unable to decompress column " << c << " of chunk " << k
+                          << std::endl;
+                return INVALID_RESULT_FILE;
+            }
+            decoded[c].resize(rows);
+            uint64_t previous = 0;
+            for (uint32_t r = 0; r < rows; ++r)
+            {
+                uint64_t bits = 0;
+                for (int b = 0; b < 8; ++b) bits |= uint64_t(encoded[size_t(b) * rows + r]) << (8 * b);
+                if (mEncodings[c] == DeltaEncoding) bits += previous;
+                else if (mEncodings[c] == XorEncoding) bits ^= previous;
+                previous = bits;
+                memcpy(&decoded[c][r], &bits, sizeof(bits));
+            }
+        }
+        for (uint32_t r = 0; r < rows; ++r)
+        {
+            double time = (mTimeColumn >= 0) ? decoded[mTimeColumn][r] : double(firstRow + r);
+            if ((time < startTime) || (time > endTime)) continue;
+            for (int column: columns) values.push_back(decoded[column][r]);
+        }
+    }
+    return CSIM_OK;
+}
+
+} // namespace csim
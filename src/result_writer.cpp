@@ -0,0 +1,215 @@
+/*
+Copyright 2015 University of Auckland
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.Some license of other
+*/
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+#include "csim/result_writer.h"
+#include "csim/error_codes.h"
+#include "spsc_queue.h"
+
+namespace csim {
+
+ResultSink::~ResultSink()
+{
+}
+
+int ResultSink::finish()
+{
+    return CSIM_OK;
+}
+
+TextResultSink::TextResultSink(std::ostream& stream, const std::vector<std::string>& header) : mStream(stream),
+    mHeader(header)
+{
+}
+
+int TextResultSink::write(const double* values, int numberOfRows, int numberOfColumns)
+{
+    if (!mHeader.empty())
+    {
+        for (size_t i = 0; i < mHeader.size(); ++i) mStream << ((i > 0) ? "\t" : "") << mHeader[i];
+        mStream << "\n";
+        mHeader.clear();
+    }
+    for (int r = 0; r < numberOfRows; ++r)
+    {
+        const double* row = values + size_t(r) * numberOfColumns;
+        for (int i = 0; i < numberOfColumns; ++i)
+        {
+            if (i != 0) mStream << "\t";
+            mStream << row[i];
+        }
+        mStream << "\n";
+    }
+    return mStream ? CSIM_OK : UNABLE_TO_WRITE_RESULTS;
+}
+
+int TextResultSink::finish()
+{
+    mStream.flush();
+    return mStream ? CSIM_OK : UNABLE_TO_WRITE_RESULTS;
+}
+
+/*
+ * Wait a little while for the other thread: briefly yielding in case it is about to be done, and then sleeping so an
+ * idle writer does not keep a processor busy.
+ */
+static void pause(int& spins)
+{
+    if (++spins < 64) std::this_thread::yield();
+    else std::this_thread::sleep_for(std::chrono::microseconds(50));
+}
+
+/*
+ * The blocks being passed between the simulation and writer threads. Blocks are passed as indices through two
+ * queues: full blocks to the writer, and written blocks back to the simulation.
+ */
+struct Pipeline
+{
+    Pipeline(ResultSink* sink, int numberOfColumns, int rowsPerBlock, int numberOfBlocks) : sink(sink),
+        numberOfColumns(numberOfColumns), rowsPerBlock(rowsPerBlock),
+        values(size_t(numberOfBlocks) * rowsPerBlock * numberOfColumns), rows(numberOfBlocks, 0),
+        full(numberOfBlocks), empty(numberOfBlocks), current(-1), currentRows(0), handedOver(0), written(0),
+        error(CSIM_OK), stop(false)
+    {
+        for (int b = 0; b < numberOfBlocks; ++b) empty.push(b);
+    }
+
+    double* block(int b)
+    {
+        return values.data() + size_t(b) * rowsPerBlock * numberOfColumns;
+    }
+
+    void handOver()
+    {
+        int spins = 0;
+        rows[current] = currentRows;
+        while (!full.push(current)) pause(spins);
+        handedOver.fetch_add(1, std::memory_order_relaxed);
+        current = -1;
+    }
+
+    void write()
+    {
+        int spins = 0;
+        while (true)
+        {
+            bool stopping = stop.load(std::memory_order_acquire);
+            int b;
+            if (full.pop(b))
+            {
+                if (error.load(std::memory_order_relaxed) == CSIM_OK)
+                {
+                    int code = sink->write(block(b), rows[b], numberOfColumns);
+                    if (code != CSIM_OK) error.store(code, std::memory_order_relaxed);
+                }
+                while (!empty.push(b)) pause(spins);
+                written.fetch_add(1, std::memory_order_release);
+                spins = 0;
+            }
+            else if (stopping) return;
+            else pause(spins);
+        }
+    }
+
+    ResultSink* sink;
+    int numberOfColumns, rowsPerBlock;
+    std::vector<double> values;
+    std::vector<int> rows;
+    SpscQueue<int> full, empty;
+    // the block being filled by the simulation thread, and the number of rows it has filled
+    int current, currentRows;
+    std::atomic<long long> handedOver, written;
+    std::atomic<int> error;
+    std::atomic<bool> stop;
+    std::thread thread;
+};
+
+ResultWriter::ResultWriter() : mPipeline(0)
+{
+}
+
+ResultWriter::~ResultWriter()
+{
+    finish();
+}
+
+int ResultWriter::start(ResultSink* sink, int numberOfColumns, int rowsPerBlock, int numberOfBlocks)
+{
+    if (!sink || (numberOfColumns < 1) || (rowsPerBlock < 1) || (numberOfBlocks < 2))
+    {
+        std::cerr << "ResultWriter::start: need a sink, at least one column and row per block, and two blocks"
+                  << std::endl;
+        return INVALID_RESULT_LAYOUT;
+    }
+    finish();
+    Pipeline* pipeline = new Pipeline(sink, numberOfColumns, rowsPerBlock, numberOfBlocks);
+    pipeline->thread = std::thread(&Pipeline::write, pipeline);
+    mPipeline = pipeline;
+    return CSIM_OK;
+}
+
+double* ResultWriter::nextRow()
+{
+    Pipeline* pipeline = static_cast<Pipeline*>(mPipeline);
+    if (!pipeline) return NULL;
+    if ((pipeline->current >= 0) && (pipeline->currentRows == pipeline->rowsPerBlock)) pipeline->handOver();
+    if (pipeline->current < 0)
+    {
+        int spins = 0;
+        while (!pipeline->empty.pop(pipeline->current)) pause(spins);
+        pipeline->currentRows = 0;
+    }
+    return pipeline->block(pipeline->current) + size_t(pipeline->currentRows++) * pipeline->numberOfColumns;
+}
+
+int ResultWriter::addRow(const double* values)
+{
+    double* row = nextRow();
+    if (!row) return RESULT_WRITER_NOT_STARTED;
+    memcpy(row, values, sizeof(double) * static_cast<Pipeline*>(mPipeline)->numberOfColumns);
+    return CSIM_OK;
+}
+
+int ResultWriter::flush()
+{
+    Pipeline* pipeline = static_cast<Pipeline*>(mPipeline);
+    if (!pipeline) return RESULT_WRITER_NOT_STARTED;
+    if ((pipeline->current >= 0) && (pipeline->currentRows > 0)) pipeline->handOver();
+    int spins = 0;
+    while (pipeline->written.load(std::memory_order_acquire) != pipeline->handedOver.load(std::memory_order_relaxed))
+        pause(spins);
+    return pipeline->error.load(std::memory_order_relaxed);
+}
+
+int ResultWriter::finish()
+{
+    Pipeline* pipeline = static_cast<Pipeline*>(mPipeline);
+    if (!pipeline) return RESULT_WRITER_NOT_STARTED;
+    int code = flush();
+    pipeline->stop.store(true, std::memory_order_release);
+    pipeline->thread.join();
+    if (code == CSIM_OK) code = pipeline->sink->finish();
+    delete pipeline;
+    mPipeline = 0;
+    return code;
+}
+
+} // namespace csim
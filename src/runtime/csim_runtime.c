@@ -0,0 +1,139 @@
+/*
+Copyright 2015 University of Auckland
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.Some license of other
+*/
+
+/*
+ * The helper functions used by the code generated for CellML models. This file is compiled to LLVM bitcode when
+ * CSim is built and linked into every module we JIT compile, so that the optimiser is able to inline these functions
+ * into the model routines.
+ */
+
+#include <math.h>
+#include <stdarg.h>
+
+double factorial(double x)
+{
+    double result = 1.0;
+    double i;
+    for (i = 2.0; i <= x; i += 1.0) result *= i;
+    return result;
+}
+
+double arbitrary_log(double x, double base)
+{
+    return log(x) / log(base);
+}
+
+double gcd_pair(double a, double b)
+{
+    double t;
+    a = fabs(floor(a + 0.5));
+    b = fabs(floor(b + 0.5));
+    while (b > 0.0)
+    {
+        t = fmod(a, b);
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+double lcm_pair(double a, double b)
+{
+    double gcd = gcd_pair(a, b);
+    if (gcd == 0.0) return 0.0;
+    return fabs(floor(a + 0.5) * floor(b + 0.5)) / gcd;
+}
+
+/*
+ * The variadic versions are only used by C code compiled with clang, the IR backend expands these into calls to the
+ * pairwise functions.
+ */
+double gcd_multi(unsigned int size, ...)
+{
+    va_list values;
+    double result = 0.0;
+    unsigned int i;
+    va_start(values, size);
+    for (i = 0; i < size; ++i) result = gcd_pair(result, va_arg(values, double));
+    va_end(values);
+    return result;
+}
+
+double lcm_multi(unsigned int size, ...)
+{
+    va_list values;
+    double result = 1.0;
+    unsigned int i;
+    va_start(values, size);
+    for (i = 0; i < size; ++i) result = lcm_pair(result, va_arg(values, double));
+    va_end(values);
+    return result;
+}
+
+double multi_min(unsigned int size, ...)
+{
+    va_list values;
+    double result = HUGE_VAL, value;
+    unsigned int i;
+    va_start(values, size);
+    for (i = 0; i < size; ++i)
+    {
+        value = va_arg(values, double);
+        if (value < result) result = value;
+    }
+    va_end(values);
+    return result;
+}
+
+double multi_max(unsigned int size, ...)
+{
+    va_list values;
+    double result = -HUGE_VAL, value;
+    unsigned int i;
+    va_start(values, size);
+    for (i = 0; i < size; ++i)
+    {
+        value = va_arg(values, double);
+        if (value > result) result = value;
+    }
+    va_end(values);
+    return result;
+}
+
+/*
+ * Used by the CellML API generated code to solve a nonlinear equation for the variable V, with func returning the
+ * residual of the equation for the current value of V. We use Newton's method with a finite difference derivative.
+ */
+void NR_MINIMISE(double(*func)(double VOI, double *C, double *R, double *S, double *A),
+                 double VOI, double *C, double *R, double *S, double *A, double *V)
+{
+    const double tolerance = 1.0e-12;
+    double residual, perturbed, delta, step;
+    int iteration;
+    for (iteration = 0; iteration < 100; ++iteration)
+    {
+        residual = func(VOI, C, R, S, A);
+        if (fabs(residual) < tolerance) return;
+        delta = 1.0e-7 * (fabs(*V) > 1.0 ? fabs(*V) : 1.0);
+        *V += delta;
+        perturbed = func(VOI, C, R, S, A);
+        *V -= delta;
+        if (perturbed == residual) return;
+        step = residual * delta / (perturbed - residual);
+        *V -= step;
+        if (fabs(step) < tolerance * (fabs(*V) > 1.0 ? fabs(*V) : 1.0)) return;
+    }
+}
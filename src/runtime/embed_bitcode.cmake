@@ -0,0 +1,12 @@
+# Convert the runtime bitcode file into a C header so it can be compiled into the CSim library.
+# usage: cmake -DINPUT=<bitcode file> -DOUTPUT=<header file> -P embed_bitcode.cmake
+
+file(READ ${INPUT} CONTENTS HEX)
+string(LENGTH "${CONTENTS}" LENGTH)
+math(EXPR SIZE "${LENGTH} / 2")
+string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1," BYTES "${CONTENTS}")
+file(WRITE ${OUTPUT}
+  "// Generated from ${INPUT}, do not edit.\n"
+  "static const unsigned char csimRuntimeBitcode[] = {\n${BYTES}\n};\n"
+  "static const unsigned int csimRuntimeBitcodeSize = ${SIZE};\n"
+)
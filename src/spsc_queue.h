@@ -0,0 +1,68 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+/**
+ * A lock-free, bounded queue between a single producer thread and a single consumer thread. The producer only ever
+ * writes the tail and the consumer only ever writes the head, each padded into a cache line of its own, so neither
+ * thread waits for the other unless the queue is full or empty.
+ */
+template<typename T>
+class SpscQueue
+{
+public:
+    /**
+     * Create the queue.
+     * @param capacity The largest number of items the queue can hold, rounded up to a power of two.
+     */
+    explicit SpscQueue(size_t capacity) : mHead(0), mTail(0)
+    {
+        size_t size = 1;
+        while (size < capacity) size *= 2;
+        mItems.resize(size);
+        mMask = size - 1;
+    }
+
+    /**
+     * Add an item to the back of the queue, only to be called by the producer.
+     * @param item The item to add.
+     * @return true if the item was added, false if the queue is full.
+     */
+    bool push(const T& item)
+    {
+        size_t tail = mTail.load(std::memory_order_relaxed);
+        if (tail - mHead.load(std::memory_order_acquire) > mMask) return false;
+        mItems[tail & mMask] = item;
+        mTail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Remove the item at the front of the queue, only to be called by the consumer.
+     * @param item Set to the item removed.
+     * @return true if an item was removed, false if the queue is empty.
+     */
+    bool pop(T& item)
+    {
+        size_t head = mHead.load(std::memory_order_relaxed);
+        if (head == mTail.load(std::memory_order_acquire)) return false;
+        item = mItems[head & mMask];
+        mHead.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    // padded rather than aligned, as queues are allocated with new, which may not honour the alignment
+    std::vector<T> mItems;
+    size_t mMask;
+    char mPadding0[64];
+    std::atomic<size_t> mHead;
+    char mPadding1[64];
+    std::atomic<size_t> mTail;
+    char mPadding2[64];
+};
+
+#endif // SPSC_QUEUE_H
@@ -0,0 +1,190 @@
+/*
+Copyright 2015 University of Auckland
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.Some license of other
+*/
+
+#include <algorithm>
+#include <limits>
+
+#include "csim/statistics.h"
+
+namespace csim {
+
+// the statistics across cells, in the order stored for each variable
+enum EnsembleStatistic
+{
+    EnsembleMean = 0,
+    EnsembleVariance,
+    EnsembleMinimum,
+    EnsembleMaximum,
+    NumberOfEnsembleStatistics
+};
+
+RunningStatistics::RunningStatistics()
+{
+}
+
+void RunningStatistics::reset(int numberOfSeries)
+{
+    size_t size = size_t(std::max(numberOfSeries, 0));
+    mCount.assign(size, 0);
+    mMean.assign(size, 0.0);
+    mM2.assign(size, 0.0);
+    mMinimum.assign(size, std::numeric_limits<double>::infinity());
+    mMaximum.assign(size, -std::numeric_limits<double>::infinity());
+    mTimeOfMinimum.assign(size, 0.0);
+    mTimeOfMaximum.assign(size, 0.0);
+}
+
+void RunningStatistics::add(double time, const double* values)
+{
+    add(time, values, 0, numberOfSeries());
+}
+
+void RunningStatistics::add(double time, const double* values, int first, int last)
+{
+    for (int i = first; i < last; ++i)
+    {
+        double value = values[i];
+        uint64_t n = ++mCount[i];
+        double delta = value - mMean[i];
+        mMean[i] += delta / double(n);
+        mM2[i] += delta * (value - mMean[i]);
+        if (value < mMinimum[i])
+        {
+            mMinimum[i] = value;
+            mTimeOfMinimum[i] = time;
+        }
+        if (value > mMaximum[i])
+        {
+            mMaximum[i] = value;
+            mTimeOfMaximum[i] = time;
+        }
+    }
+}
+
+PopulationStatistics::PopulationStatistics()
+{
+}
+
+int PopulationStatistics::addVariable(const std::string& variableId, unsigned char variableType)
+{
+    mVariableIds.push_back(variableId);
+    mVariableTypes.push_back(variableType);
+    mOverTime.push_back(RunningStatistics());
+    reset();
+    return numberOfVariables() - 1;
+}
+
+int PopulationStatistics::addBiomarkers(const std::string& variableId, unsigned char variableType, double threshold)
+{
+    mDetectorIds.push_back(variableId);
+    mDetectorTypes.push_back(variableType);
+    mDetectors.push_back(BiomarkerDetector());
+    mDetectors.back().reset(0, threshold);
+    reset();
+    return numberOfBiomarkerDetectors() - 1;
+}
+
+void PopulationStatistics::reset()
+{
+    for (auto& statistics: mOverTime) statistics.reset(0);
+    for (auto& detector: mDetectors) detector.reset(0, detector.threshold());
+    mSampleTimes.clear();
+    mEnsemble.assign(mVariableIds.size() * NumberOfEnsembleStatistics, std::vector<double>());
+}
+
+const RunningStatistics& PopulationStatistics::overTime(int variable) const
+{
+    return mOverTime.at(variable);
+}
+
+const BiomarkerDetector& PopulationStatistics::biomarkers(int detector) const
+{
+    return mDetectors.at(detector);
+}
+
+const double* PopulationStatistics::ensemble(int variable, int statistic) const
+{
+    if ((variable < 0) || (variable >= numberOfVariables())) return NULL;
+    return mEnsemble[size_t(variable) * NumberOfEnsembleStatistics + statistic].data();
+}
+
+const double* PopulationStatistics::ensembleMean(int variable) const
+{
+    return ensemble(variable, EnsembleMean);
+}
+
+const double* PopulationStatistics::ensembleVariance(int variable) const
+{
+    return ensemble(variable, EnsembleVariance);
+}
+
+const double* PopulationStatistics::ensembleMinimum(int variable) const
+{
+    return ensemble(variable, EnsembleMinimum);
+}
+
+const double* PopulationStatistics::ensembleMaximum(int variable) const
+{
+    return ensemble(variable, EnsembleMaximum);
+}
+
+void PopulationStatistics::reduce(int variable, double time, const double* values, int first, int last,
+                                  Partial& partial)
+{
+    mOverTime[variable].add(time, values, first, last);
+    partial.count = 0;
+    partial.mean = partial.m2 = 0.0;
+    partial.minimum = std::numeric_limits<double>::infinity();
+    partial.maximum = -std::numeric_limits<double>::infinity();
+    for (int i = first; i < last; ++i)
+    {
+        double delta = values[i] - partial.mean;
+        partial.mean += delta / double(++partial.count);
+        partial.m2 += delta * (values[i] - partial.mean);
+        partial.minimum = std::min(partial.minimum, values[i]);
+        partial.maximum = std::max(partial.maximum, values[i]);
+    }
+}
+
+void PopulationStatistics::addSample(double time, const std::vector<Partial>& partials, int numberOfPartials)
+{
+    // the partial reductions of each range of cells are combined pairwise (Chan et al.)
+    int numberOfVariables = this->numberOfVariables();
+    for (int v = 0; v < numberOfVariables; ++v)
+    {
+        Partial total = partials[v];
+        for (int p = 1; p < numberOfPartials; ++p)
+        {
+            const Partial& partial = partials[size_t(p) * numberOfVariables + v];
+            if (partial.count == 0) continue;
+            uint64_t count = total.count + partial.count;
+            double delta = partial.mean - total.mean;
+            total.mean += delta * double(partial.count) / double(count);
+            total.m2 += partial.m2 + delta * delta * double(total.count) * double(partial.count) / double(count);
+            total.minimum = std::min(total.minimum, partial.minimum);
+            total.maximum = std::max(total.maximum, partial.maximum);
+            total.count = count;
+        }
+        std::vector<double>* ensemble = &mEnsemble[size_t(v) * NumberOfEnsembleStatistics];
+        ensemble[EnsembleMean].push_back(total.mean);
+        ensemble[EnsembleVariance].push_back((total.count > 1) ? total.m2 / double(total.count - 1) : 0.0);
+        ensemble[EnsembleMinimum].push_back(total.minimum);
+        ensemble[EnsembleMaximum].push_back(total.maximum);
+    }
+    mSampleTimes.push_back(time);
+}
+
+} // namespace csim
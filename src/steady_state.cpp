@@ -0,0 +1,243 @@
+/*
+Copyright 2015 University of Auckland
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.Some license of other
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "csim/steady_state.h"
+#include "csim/error_codes.h"
+
+namespace csim {
+
+// the smallest fraction of a Newton step tried before giving up on it
+static const double MINIMUM_DAMPING = 1.0 / 1024.0;
+// the largest pseudo-time step, beyond which pseudo-transient continuation is Newton's method
+static const double MAXIMUM_PSEUDO_TIME_STEP = 1.0e12;
+
+static double norm2(const std::vector<double>& x)
+{
+    double sum = 0.0;
+    for (double value: x) sum += value * value;
+    return std::sqrt(sum);
+}
+
+static double maximumNorm(const double* x, int n)
+{
+    double norm = 0.0;
+    for (int i = 0; i < n; ++i)
+    {
+        if (!std::isfinite(x[i])) return std::numeric_limits<double>::infinity();
+        norm = std::max(norm, std::fabs(x[i]));
+    }
+    return norm;
+}
+
+SteadyStateSolver::SteadyStateSolver() : mModel(NULL), mVoi(0.0), mOutputs(NULL), mInputs(NULL), mNumberOfStates(0),
+    mTolerance(1.0e-8), mInitialPseudoTimeStep(1.0e-3), mMaximumNewtonIterations(50),
+    mMaximumPseudoTransientSteps(1000), mBestNorm(0.0)
+{
+    mDiagnostics.converged = false;
+    mDiagnostics.newtonIterations = mDiagnostics.pseudoTransientSteps = mDiagnostics.modelEvaluations = 0;
+    mDiagnostics.residualNorm = mDiagnostics.stepNorm = 0.0;
+}
+
+int SteadyStateSolver::setTolerance(double tolerance)
+{
+    if (!(tolerance > 0.0)) return INVALID_SOLVER_PARAMETERS;
+    mTolerance = tolerance;
+    return CSIM_OK;
+}
+
+int SteadyStateSolver::setMaximumIterations(int newtonIterations, int pseudoTransientSteps)
+{
+    if ((newtonIterations < 0) || (pseudoTransientSteps < 0)) return INVALID_SOLVER_PARAMETERS;
+    mMaximumNewtonIterations = newtonIterations;
+    mMaximumPseudoTransientSteps = pseudoTransientSteps;
+    return CSIM_OK;
+}
+
+int SteadyStateSolver::setInitialPseudoTimeStep(double step)
+{
+    if (!(step > 0.0)) return INVALID_SOLVER_PARAMETERS;
+    mInitialPseudoTimeStep = step;
+    return CSIM_OK;
+}
+
+double SteadyStateSolver::evaluate(const double* states, double* rates)
+{
+    mModel(mVoi, const_cast<double*>(states), rates, mOutputs, mInputs);
+    ++mDiagnostics.modelEvaluations;
+    return maximumNorm(rates, mNumberOfStates);
+}
+
+void SteadyStateSolver::jacobian(double* states, const double* rates)
+{
+    // forward differences, one state at a time
+    int n = mNumberOfStates;
+    for (int j = 0; j < n; ++j)
+    {
+        double state = states[j];
+        states[j] += std::sqrt(std::numeric_limits<double>::epsilon()) * std::max(std::fabs(state), 1.0);
+        double h = states[j] - state;
+        evaluate(states, mWork.data());
+        for (int i = 0; i < n; ++i) mJacobian[size_t(i) * n + j] = (mWork[i] - rates[i]) / h;
+        states[j] = state;
+    }
+}
+
+bool SteadyStateSolver::factorise(bool requireRegular)
+{
+    // LU decomposition of mMatrix in place, with partial pivoting
+    int n = mNumberOfStates;
+    double scale = 0.0;
+    for (double value: mMatrix) scale = std::max(scale, std::fabs(value));
+    double smallest = requireRegular ? 1.0e-13 * scale : 0.0;
+    for (int k = 0; k < n; ++k)
+    {
+        int pivot = k;
+        for (int i = k + 1; i < n; ++i)
+        {
+            if (std::fabs(mMatrix[size_t(i) * n + k]) > std::fabs(mMatrix[size_t(pivot) * n + k])) pivot = i;
+        }
+        double p = mMatrix[size_t(pivot) * n + k];
+        if (!(std::fabs(p) > smallest) || !std::isfinite(p)) return false;
+        mPivots[k] = pivot;
+        if (pivot != k)
+        {
+            std::swap_ranges(mMatrix.begin() + size_t(k) * n, mMatrix.begin() + size_t(k + 1) * n,
+                             mMatrix.begin() + size_t(pivot) * n);
+        }
+        for (int i = k + 1; i < n; ++i)
+        {
+            double factor = (mMatrix[size_t(i) * n + k] /= p);
+            for (int j = k + 1; j < n; ++j) mMatrix[size_t(i) * n + j] -= factor * mMatrix[size_t(k) * n + j];
+        }
+    }
+    return true;
+}
+
+void SteadyStateSolver::backSubstitute(double* x) const
+{
+    int n = mNumberOfStates;
+    for (int k = 0; k < n; ++k)
+    {
+        std::swap(x[k], x[mPivots[k]]);
+        for (int i = k + 1; i < n; ++i) x[i] -= mMatrix[size_t(i) * n + k] * x[k];
+    }
+    for (int k = n - 1; k >= 0; --k)
+    {
+        for (int j = k + 1; j < n; ++j) x[k] -= mMatrix[size_t(k) * n + j] * x[j];
+        x[k] /= mMatrix[size_t(k) * n + k];
+    }
+}
+
+void SteadyStateSolver::keepBest(const double* states, double norm)
+{
+    if (norm >= mBestNorm) return;
+    mBestNorm = norm;
+    std::copy(states, states + mNumberOfStates, mBest.begin());
+}
+
+int SteadyStateSolver::solve(ModelFunction model, double voi, int numberOfStates, double* states, double* rates,
+                             double* outputs, double* inputs)
+{
+    if (!model || (numberOfStates < 0)) return INVALID_SOLVER_PARAMETERS;
+    mModel = model;
+    mVoi = voi;
+    mOutputs = outputs;
+    mInputs = inputs;
+    int n = mNumberOfStates = numberOfStates;
+    mJacobian.assign(size_t(n) * n, 0.0);
+    mMatrix.assign(size_t(n) * n, 0.0);
+    mWork.assign(n, 0.0);
+    mBest.assign(states, states + n);
+    mPivots.assign(n, 0);
+    mDiagnostics.converged = false;
+    mDiagnostics.newtonIterations = mDiagnostics.pseudoTransientSteps = mDiagnostics.modelEvaluations = 0;
+    mDiagnostics.stepNorm = 0.0;
+    std::vector<double> step(n), trial(n), trialRates(n), current(rates, rates + n);
+    double norm = mBestNorm = evaluate(states, rates);
+
+    // damped Newton, for as long as it makes progress
+    for (int k = 0; (norm > mTolerance) && (k < mMaximumNewtonIterations); ++k)
+    {
+        jacobian(states, rates);
+        mMatrix = mJacobian;
+        if (!factorise(true)) break;
+        for (int i = 0; i < n; ++i) step[i] = -rates[i];
+        backSubstitute(step.data());
+        current.assign(rates, rates + n);
+        double residual = norm2(current), damping = 1.0, trialNorm = 0.0;
+        for (; damping >= MINIMUM_DAMPING; damping *= 0.5)
+        {
+            for (int i = 0; i < n; ++i) trial[i] = states[i] + damping * step[i];
+            trialNorm = evaluate(trial.data(), trialRates.data());
+            if (std::isfinite(trialNorm) && (norm2(trialRates) <= (1.0 - 1.0e-4 * damping) * residual)) break;
+        }
+        if (damping < MINIMUM_DAMPING) break;
+        ++mDiagnostics.newtonIterations;
+        std::copy(trial.begin(), trial.end(), states);
+        std::copy(trialRates.begin(), trialRates.end(), rates);
+        mDiagnostics.stepNorm = damping * maximumNorm(step.data(), n);
+        norm = trialNorm;
+        keepBest(states, norm);
+    }
+
+    // pseudo-transient continuation, with the pseudo-time step growing as the rates fall
+    double pseudoTimeStep = mInitialPseudoTimeStep;
+    for (int k = 0; (norm > mTolerance) && (k < mMaximumPseudoTransientSteps); ++k)
+    {
+        ++mDiagnostics.pseudoTransientSteps;
+        current.assign(rates, rates + n);
+        jacobian(states, rates);
+        for (size_t i = 0; i < mMatrix.size(); ++i) mMatrix[i] = -mJacobian[i];
+        for (int i = 0; i < n; ++i) mMatrix[size_t(i) * n + i] += 1.0 / pseudoTimeStep;
+        bool solved = factorise(false);
+        double trialNorm = std::numeric_limits<double>::infinity();
+        if (solved)
+        {
+            step = current;
+            backSubstitute(step.data());
+            for (int i = 0; i < n; ++i) trial[i] = states[i] + step[i];
+            trialNorm = evaluate(trial.data(), trialRates.data());
+        }
+        double residual = norm2(current), trialResidual = norm2(trialRates);
+        if (!solved || !std::isfinite(trialNorm) || (trialResidual > 2.0 * residual))
+        {
+            // too far for the linearisation, try again with a smaller step
+            pseudoTimeStep *= 0.25;
+            continue;
+        }
+        std::copy(trial.begin(), trial.end(), states);
+        std::copy(trialRates.begin(), trialRates.end(), rates);
+        mDiagnostics.stepNorm = maximumNorm(step.data(), n);
+        norm = trialNorm;
+        keepBest(states, norm);
+        // switched evolution relaxation, at least doubling the step while the rates fall
+        double growth = (trialResidual > 0.0) ? residual / trialResidual : MAXIMUM_PSEUDO_TIME_STEP;
+        if (trialResidual < residual) growth = std::max(growth, 2.0);
+        pseudoTimeStep = std::min(pseudoTimeStep * growth, MAXIMUM_PSEUDO_TIME_STEP);
+    }
+
+    mDiagnostics.converged = norm <= mTolerance;
+    if (!mDiagnostics.converged) std::copy(mBest.begin(), mBest.end(), states);
+    // leave the rates and outputs matching the states
+    mDiagnostics.residualNorm = evaluate(states, rates);
+    return mDiagnostics.converged ? CSIM_OK : STEADY_STATE_NOT_CONVERGED;
+}
+
+} // namespace csim
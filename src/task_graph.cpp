@@ -0,0 +1,154 @@
+#include "task_graph.h"
+
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#include <immintrin.h>
+#define CSIM_SPIN_PAUSE() _mm_pause()
+#else
+#define CSIM_SPIN_PAUSE()
+#endif
+
+/*
+ * The number of times to check a flag before yielding the processor while waiting for a partition, and before going
+ * to sleep while waiting for the next evaluation.
+ */
+static const int WAIT_SPINS = 4096;
+static const int IDLE_SPINS = 1 << 18;
+
+/*
+ * The estimated cost, in the same units as the partition costs, of waiting on a partition evaluated by another thread.
+ */
+static const double SYNCHRONISATION_COST = 32.0;
+
+static void waitFor(const std::atomic<unsigned>& flag, unsigned epoch)
+{
+    int spins = 0;
+    while (flag.load(std::memory_order_acquire) != epoch)
+    {
+        if (++spins < WAIT_SPINS) CSIM_SPIN_PAUSE();
+        else std::this_thread::yield();
+    }
+}
+
+TaskGraph::TaskGraph(const std::vector<PartitionFunction>& functions,
+                     const std::vector<StatementPartition>& partitions, int numberOfConstants, int numberOfAlgebraic,
+                     int numberOfThreads) :
+    mFunctions(functions), mDependencies(partitions.size()), mConstants(numberOfConstants),
+    mAlgebraic(numberOfAlgebraic), mDone(new Flag[partitions.size()]), mSleeping(0), mStop(false), mVoi(0.0),
+    mStates(0), mRates(0), mOutputs(0), mInputs(0)
+{
+    // list scheduling: each partition goes to the thread able to start it the earliest, which favours the thread
+    // evaluating its dependencies as waiting on another thread has a cost of its own
+    // the threads spin while waiting for each other, so more threads than the hardware can run at once would only
+    // slow the evaluation down
+    unsigned hardwareThreads = std::thread::hardware_concurrency();
+    if ((hardwareThreads > 0) && (numberOfThreads > int(hardwareThreads))) numberOfThreads = int(hardwareThreads);
+    numberOfThreads = std::max(numberOfThreads, 1);
+    std::vector<std::vector<int> > schedule(numberOfThreads);
+    std::vector<double> available(numberOfThreads, 0.0), finish(partitions.size(), 0.0);
+    std::vector<int> owner(partitions.size(), 0);
+    for (size_t p = 0; p < partitions.size(); ++p)
+    {
+        int best = 0;
+        double bestStart = 0.0;
+        for (int t = 0; t < numberOfThreads; ++t)
+        {
+            double start = available[t];
+            for (int d: partitions[p].dependencies)
+                start = std::max(start, finish[d] + ((owner[d] == t) ? 0.0 : SYNCHRONISATION_COST));
+            if ((t == 0) || (start < bestStart))
+            {
+                best = t;
+                bestStart = start;
+            }
+        }
+        owner[p] = best;
+        finish[p] = available[best] = bestStart + partitions[p].cost;
+        schedule[best].push_back(int(p));
+    }
+    // the calling thread always takes part, but there's no need to start threads with nothing to do
+    for (int t = 0; t < numberOfThreads; ++t)
+    {
+        if ((t == 0) || !schedule[t].empty()) mSchedule.push_back(schedule[t]);
+    }
+    for (size_t p = 0; p < partitions.size(); ++p)
+    {
+        mDone[p].value = 0;
+        for (int d: partitions[p].dependencies)
+        {
+            if (owner[d] != owner[p]) mDependencies[p].push_back(d);
+        }
+    }
+    mFinished.reset(new Flag[mSchedule.size()]);
+    for (size_t t = 0; t < mSchedule.size(); ++t) mFinished[t].value = 0;
+    mEpoch.value = 0;
+    for (size_t t = 1; t < mSchedule.size(); ++t) mThreads.push_back(std::thread(&TaskGraph::work, this, int(t)));
+}
+
+TaskGraph::~TaskGraph()
+{
+    mStop = true;
+    mEpoch.value++;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mWake.notify_all();
+    }
+    for (auto& thread: mThreads) thread.join();
+}
+
+void TaskGraph::evaluate(double voi, double* states, double* rates, double* outputs, double* inputs)
+{
+    mVoi = voi;
+    mStates = states;
+    mRates = rates;
+    mOutputs = outputs;
+    mInputs = inputs;
+    unsigned epoch = mEpoch.value.load(std::memory_order_relaxed) + 1;
+    // the sleeping threads either see the new epoch or are counted here and need waking up
+    mEpoch.value.store(epoch);
+    if (mSleeping.load() > 0)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mWake.notify_all();
+    }
+    run(0, epoch);
+    for (size_t t = 1; t < mSchedule.size(); ++t) waitFor(mFinished[t].value, epoch);
+}
+
+void TaskGraph::run(int thread, unsigned epoch)
+{
+    for (int p: mSchedule[thread])
+    {
+        for (int d: mDependencies[p]) waitFor(mDone[d].value, epoch);
+        mFunctions[p](mVoi, mStates, mRates, mOutputs, mInputs, mConstants.data(), mAlgebraic.data());
+        mDone[p].value.store(epoch, std::memory_order_release);
+    }
+    mFinished[thread].value.store(epoch, std::memory_order_release);
+}
+
+void TaskGraph::work(int thread)
+{
+    unsigned seen = 0;
+    while (true)
+    {
+        unsigned epoch;
+        int spins = 0;
+        while ((epoch = mEpoch.value.load(std::memory_order_acquire)) == seen)
+        {
+            if (++spins < IDLE_SPINS)
+            {
+                CSIM_SPIN_PAUSE();
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(mMutex);
+            mSleeping++;
+            mWake.wait(lock, [this, seen]() { return mEpoch.value.load() != seen; });
+            mSleeping--;
+            spins = 0;
+        }
+        if (mStop) return;
+        run(thread, epoch);
+        seen = epoch;
+    }
+}
@@ -0,0 +1,85 @@
+#ifndef TASK_GRAPH_H
+#define TASK_GRAPH_H
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "compiler.h"
+
+/**
+ * Evaluates the partitions of a model function in parallel on a persistent pool of threads. The partitions are
+ * assigned to the threads when the graph is created, taking their dependencies and estimated cost into account, and
+ * each thread then evaluates its partitions in order, waiting only for the particular partitions each one depends
+ * on rather than for all of the threads at the end of a level. The calling thread takes part in the evaluation, the
+ * other threads spin for a short while between evaluations and then sleep until they are needed again.
+ *
+ * A task graph is only able to perform one evaluation at a time.
+ */
+class TaskGraph
+{
+public:
+    /**
+     * Create the task graph and start its threads.
+     * @param functions The function evaluating each partition.
+     * @param partitions The partitions, every partition must come after all of its dependencies.
+     * @param numberOfConstants The size of the constants array shared between the partitions.
+     * @param numberOfAlgebraic The size of the algebraic variables array shared between the partitions.
+     * @param numberOfThreads The maximum number of threads to use, including the calling thread. No more threads than
+     * the hardware is able to run at once are used, and threads which would have no partitions to evaluate are not
+     * started.
+     */
+    TaskGraph(const std::vector<PartitionFunction>& functions, const std::vector<StatementPartition>& partitions,
+              int numberOfConstants, int numberOfAlgebraic, int numberOfThreads);
+    ~TaskGraph();
+
+    /**
+     * Evaluate the model function, with the same arguments as csim::ModelFunction.
+     */
+    void evaluate(double voi, double* states, double* rates, double* outputs, double* inputs);
+
+    inline int numberOfThreads() const
+    {
+        return int(mThreads.size()) + 1;
+    }
+
+    inline int numberOfTasks() const
+    {
+        return int(mFunctions.size());
+    }
+
+private:
+    // keep the flags each thread spins on in their own cache line
+    struct Flag
+    {
+        std::atomic<unsigned> value;
+        char padding[64 - sizeof(std::atomic<unsigned>)];
+    };
+
+    void run(int thread, unsigned epoch);
+    void work(int thread);
+
+    std::vector<PartitionFunction> mFunctions;
+    std::vector<std::vector<int> > mDependencies; // only those evaluated by another thread
+    std::vector<std::vector<int> > mSchedule;     // the partitions evaluated by each thread, in order
+    std::vector<double> mConstants;
+    std::vector<double> mAlgebraic;
+    std::vector<std::thread> mThreads;
+    std::unique_ptr<Flag[]> mDone;     // the last evaluation each partition was completed for
+    std::unique_ptr<Flag[]> mFinished; // the last evaluation each thread finished its partitions for
+    Flag mEpoch;
+    std::atomic<int> mSleeping;
+    std::atomic<bool> mStop;
+    std::mutex mMutex;
+    std::condition_variable mWake;
+    double mVoi;
+    double* mStates;
+    double* mRates;
+    double* mOutputs;
+    double* mInputs;
+};
+
+#endif // TASK_GRAPH_H
@@ -0,0 +1,88 @@
+#include "thread_pool.h"
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#ifdef __linux__
+// pin the calling thread to the given CPU, a CPU which is not available to the process leaves the thread where it is
+static bool pinThread(int cpu)
+{
+    if ((cpu < 0) || (cpu >= CPU_SETSIZE)) return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+#endif
+
+ThreadPool::ThreadPool(int numberOfThreads, const std::vector<int>& cpus) : mCpus(cpus), mTask(0), mGeneration(0),
+    mRunning(0), mStop(false)
+{
+    for (int t = 1; t < numberOfThreads; ++t) mThreads.push_back(std::thread(&ThreadPool::work, this, t));
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStop = true;
+    }
+    mStart.notify_all();
+    for (auto& thread: mThreads) thread.join();
+}
+
+void ThreadPool::run(const std::function<void(int)>& task)
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mTask = &task;
+        mRunning = int(mThreads.size());
+        mGeneration++;
+    }
+    mStart.notify_all();
+#ifdef __linux__
+    // the calling thread is thread 0, so it is pinned while it takes part and then given back its own affinity
+    cpu_set_t original;
+    bool pinned = !mCpus.empty() && (pthread_getaffinity_np(pthread_self(), sizeof(original), &original) == 0)
+                  && pinThread(mCpus[0]);
+#endif
+    task(0);
+#ifdef __linux__
+    if (pinned) pthread_setaffinity_np(pthread_self(), sizeof(original), &original);
+#endif
+    std::unique_lock<std::mutex> lock(mMutex);
+    mFinished.wait(lock, [this]() { return mRunning == 0; });
+}
+
+bool ThreadPool::supportsAffinity()
+{
+#ifdef __linux__
+    return true;
+#else
+    return false;
+#endif
+}
+
+void ThreadPool::work(int thread)
+{
+#ifdef __linux__
+    if (!mCpus.empty()) pinThread(mCpus[thread % mCpus.size()]);
+#endif
+    unsigned seen = 0;
+    while (true)
+    {
+        const std::function<void(int)>* task;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mStart.wait(lock, [this, seen]() { return mStop || (mGeneration != seen); });
+            if (mStop) return;
+            seen = mGeneration;
+            task = mTask;
+        }
+        (*task)(thread);
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (--mRunning == 0) mFinished.notify_one();
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * A persistent pool of threads which all run the same task together, each on its own part of the work. The calling
+ * thread takes part as thread 0 and the other threads sleep between tasks, so the pool is cheap to keep around but
+ * each task should be worth waking the threads up for.
+ *
+ * A thread pool is only able to run one task at a time.
+ *
+ * The threads can be pinned to given CPUs, so that they stay next to the memory they first touch on machines with
+ * more than one NUMA node. Each thread pins itself before it runs any task, and the calling thread is pinned for as
+ * long as it takes part in each task.
+ */
+class ThreadPool
+{
+public:
+    /**
+     * Create the thread pool and start its threads.
+     * @param numberOfThreads The number of threads, including the calling thread.
+     * @param cpus The CPUs to pin the threads to, thread t being pinned to cpus[t % cpus.size()], or empty to leave
+     * the threads unpinned. The calling thread is pinned to cpus[0] while it runs a task, and its own affinity is
+     * restored when it returns from run().
+     */
+    explicit ThreadPool(int numberOfThreads, const std::vector<int>& cpus = std::vector<int>());
+    ~ThreadPool();
+
+    /**
+     * Run the given task on every thread of the pool and wait for them all to finish.
+     * @param task The task, which is given the index of the thread running it.
+     */
+    void run(const std::function<void(int)>& task);
+
+    inline int numberOfThreads() const
+    {
+        return int(mThreads.size()) + 1;
+    }
+
+    inline const std::vector<int>& cpus() const
+    {
+        return mCpus;
+    }
+
+    /**
+     * Check if threads can be pinned to CPUs on this platform.
+     * @return true if they can, false otherwise.
+     */
+    static bool supportsAffinity();
+
+private:
+    void work(int thread);
+
+    std::vector<int> mCpus;
+    std::vector<std::thread> mThreads;
+    std::mutex mMutex;
+    std::condition_variable mStart;
+    std::condition_variable mFinished;
+    const std::function<void(int)>* mTask;
+    unsigned mGeneration;
+    int mRunning;
+    bool mStop;
+};
+
+#endif // THREAD_POOL_H
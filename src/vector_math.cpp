@@ -0,0 +1,326 @@
+#include "vector_math.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define CSIM_VECTOR_MATH
+#endif
+
+#ifdef CSIM_VECTOR_MATH
+
+/*
+ * Vector versions of the transcendental functions which stop the generated code from being vectorised when they are
+ * called through libm, in the style of SLEEF. Each function is written once using the GCC vector extensions and
+ * compiled for each of the vector widths. The accurate versions are within 2 ulp of the correctly rounded result
+ * (4 ulp for tanh) and the fast versions, which use shorter polynomials, within about 10 ulp. Both handle infinities,
+ * NaNs and results which overflow or underflow the same way as libm.
+ *
+ * The extended precision arithmetic used by log and pow relies on every operation being rounded, so this file must
+ * be compiled without floating point contraction.
+ */
+
+namespace {
+
+typedef double Double2 __attribute__((vector_size(16)));
+typedef int64_t Int2 __attribute__((vector_size(16)));
+typedef double Double4 __attribute__((vector_size(32)));
+typedef int64_t Int4 __attribute__((vector_size(32)));
+typedef double Double8 __attribute__((vector_size(64)));
+typedef int64_t Int8 __attribute__((vector_size(64)));
+
+#define VECTOR_INLINE inline __attribute__((always_inline))
+
+const double INF = std::numeric_limits<double>::infinity();
+const double NOT_A_NUMBER = std::numeric_limits<double>::quiet_NaN();
+const double LN2_HI = 6.93147180369123816490e-01; // with enough trailing zeros to be multiplied exactly
+const double LN2_LO = 1.90821492927058770002e-10;
+const double LOG2E = 1.44269504088896338700e+00;
+const double SQRT2 = 1.41421356237309514547e+00;
+const double EXP_OVERFLOW = 709.782712893383973096;
+const double EXP_UNDERFLOW = -745.133219101941108420;
+const double SHIFT = 6755399441055744.0; // 1.5 * 2^52, rounds values below 2^51 to an integer
+const double TWO52 = 4503599627370496.0;
+const double TWO53 = 9007199254740992.0;
+const int64_t SIGN_MASK = INT64_MIN;
+
+// near minimax approximations of (e^r - 1 - r)/r^2 for |r| <= log(2)/2
+const double EXP_ACCURATE[] = {
+    0.50000000000000011, 0.16666666666666669, 0.041666666666620639, 0.0083333333333297926, 0.0013888888918939168,
+    0.00019841269864380513, 2.4801518641395993e-05, 2.7557266418612302e-06, 2.7621338669142925e-07,
+    2.5101346928350342e-08
+};
+const double EXP_FAST[] = {
+    0.5, 0.16666666666646782, 0.041666666666650101, 0.0083333333549719009, 0.0013888888906916628,
+    0.00019841206274785362, 2.4801534341237888e-05, 2.7626466044935001e-06, 2.7614931875440477e-07
+};
+
+// near minimax approximations of (log((1 + f)/(1 - f)) - 2f)/f^3 in terms of s = f^2, for the f given by
+// sqrt(1/2) <= m < sqrt(2) and f = (m - 1)/(m + 1)
+const double LOG_ACCURATE[] = {
+    0.66666666666666663, 0.39999999999999991, 0.28571428571435858, 0.22222222219710297, 0.18181818615177278,
+    0.15384573450028968, 0.13335711085008436, 0.11686508917312045, 0.11896558568412166
+};
+const double LOG_FAST[] = {
+    0.666666666666618, 0.40000000011787484, 0.28571423954752284, 0.22222882159268573, 0.18139329084810124,
+    0.16634817293436976
+};
+
+template<typename V> VECTOR_INLINE V broadcast(double x)
+{
+    return V{} + x;
+}
+
+template<typename V, typename I> VECTOR_INLINE V absolute(V x)
+{
+    return (V)((I)x & ~SIGN_MASK);
+}
+
+template<typename V, size_t N> VECTOR_INLINE V polynomial(V x, const double (&c)[N])
+{
+    V p = broadcast<V>(c[N - 1]);
+    for (size_t i = N - 1; i-- > 0;) p = p * x + c[i];
+    return p;
+}
+
+// 2^n for integer n in [-1022, 1023]
+template<typename V, typename I> VECTOR_INLINE V exp2Integer(I n)
+{
+    return (V)((n + 1023) << 52);
+}
+
+template<typename V, typename I> VECTOR_INLINE V scale(V x, I n)
+{
+    // split the scaling in two so that results close to overflowing or in the subnormal range are still correct
+    I half = n >> 1;
+    return x * exp2Integer<V, I>(half) * exp2Integer<V, I>(n - half);
+}
+
+template<typename V> VECTOR_INLINE V twoSum(V a, V b, V& error)
+{
+    V s = a + b;
+    V bb = s - a;
+    error = (a - (s - bb)) + (b - bb);
+    return s;
+}
+
+template<typename V> VECTOR_INLINE V split(V a, V& low)
+{
+    V c = a * 134217729.0; // 2^27 + 1
+    V high = c - (c - a);
+    low = a - high;
+    return high;
+}
+
+template<typename V> VECTOR_INLINE V twoProduct(V a, V b, V& error)
+{
+    V p = a * b;
+    V al, bl;
+    V ah = split(a, al);
+    V bh = split(b, bl);
+    error = ((ah * bh - p) + ah * bl + al * bh) + al * bl;
+    return p;
+}
+
+/*
+ * Reduce x to x = n log(2) + r with |r| <= log(2)/2, returning the polynomial part of e^r - 1 = r + r^2 q(r).
+ */
+template<typename V, typename I, bool Accurate> VECTOR_INLINE V expReduce(V x, V xl, I& n)
+{
+    V shifted = x * LOG2E + SHIFT;
+    V k = shifted - SHIFT;
+    n = (I)shifted - (I)broadcast<V>(SHIFT);
+    V r = (x - k * LN2_HI) - k * LN2_LO + xl;
+    return r + r * r * (Accurate ? polynomial(r, EXP_ACCURATE) : polynomial(r, EXP_FAST));
+}
+
+// e^(x + xl) for x in the range of exp and |xl| much smaller than x
+template<typename V, typename I, bool Accurate> VECTOR_INLINE V expKernel(V x, V xl)
+{
+    I n;
+    V q = expReduce<V, I, Accurate>(x, xl, n);
+    return scale<V, I>(1.0 + q, n);
+}
+
+template<typename V, typename I, bool Accurate> VECTOR_INLINE V vectorExp(V x)
+{
+    V y = expKernel<V, I, Accurate>(x, V{});
+    y = (x > broadcast<V>(EXP_OVERFLOW)) ? broadcast<V>(INF) : y;
+    y = (x < broadcast<V>(EXP_UNDERFLOW)) ? V{} : y;
+    return y;
+}
+
+// split positive, finite x into x = m 2^e with sqrt(1/2) <= m < sqrt(2)
+template<typename V, typename I> VECTOR_INLINE V decompose(V x, V& e)
+{
+    I subnormal = x < broadcast<V>(std::numeric_limits<double>::min());
+    x = subnormal ? x * 18014398509481984.0 : x; // 2^54
+    I bits = (I)x;
+    I exponent = ((bits >> 52) & 0x7ff) - 1023 - (subnormal & 54);
+    V m = (V)((bits & 0x000fffffffffffffLL) | 0x3ff0000000000000LL);
+    I big = m > broadcast<V>(SQRT2);
+    m = big ? m * 0.5 : m;
+    exponent -= big;
+    e = (V)(exponent + (I)broadcast<V>(SHIFT)) - SHIFT;
+    return m;
+}
+
+// log(x) = hi + lo for positive, finite x, accurate to around 2^-60
+template<typename V, typename I> VECTOR_INLINE V logExtended(V x, V& lo)
+{
+    V e;
+    V m = decompose<V, I>(x, e);
+    V numerator = m - 1.0; // exact
+    V denominatorLo;
+    V denominator = twoSum(m, broadcast<V>(1.0), denominatorLo);
+    V f = numerator / denominator;
+    V pl;
+    V p = twoProduct(f, denominator, pl);
+    V fl = (((numerator - p) - pl) - f * denominatorLo) / denominator;
+    V s = f * f;
+    V t = f * s * polynomial(s, LOG_ACCURATE);
+    V hl;
+    V h = twoSum(e * LN2_HI, f + f, hl);
+    hl = hl + ((fl + fl) + (t + e * LN2_LO));
+    V hi = h + hl;
+    lo = hl - (hi - h);
+    return hi;
+}
+
+template<typename V, typename I, bool Accurate> VECTOR_INLINE V vectorLog(V x)
+{
+    V y;
+    if (Accurate)
+    {
+        V lo;
+        y = logExtended<V, I>(x, lo);
+    }
+    else
+    {
+        V e;
+        V m = decompose<V, I>(x, e);
+        V f = (m - 1.0) / (m + 1.0);
+        V s = f * f;
+        V t = f * s * polynomial(s, LOG_FAST);
+        y = e * LN2_HI + ((f + f) + (t + e * LN2_LO));
+    }
+    y = (x < V{}) ? broadcast<V>(NOT_A_NUMBER) : y;
+    y = (x == V{}) ? broadcast<V>(-INF) : y;
+    y = (x == broadcast<V>(INF)) ? x : y;
+    y = (x != x) ? x : y;
+    return y;
+}
+
+template<typename V, typename I, bool Accurate> VECTOR_INLINE V vectorPow(V x, V y)
+{
+    const V inf = broadcast<V>(INF);
+    const V one = broadcast<V>(1.0);
+    V ax = absolute<V, I>(x);
+    V ay = absolute<V, I>(y);
+
+    // e^(y log|x|) with log|x| in extended precision, as any error is multiplied by y log|x|
+    V lo;
+    V l = logExtended<V, I>(ax, lo);
+    V zl;
+    V z = twoProduct(y, l, zl);
+    zl = zl + y * lo;
+    V r = expKernel<V, I, Accurate>(z, zl);
+    r = (z > broadcast<V>(EXP_OVERFLOW)) ? inf : r;
+    r = (z < broadcast<V>(EXP_UNDERFLOW)) ? V{} : r;
+
+    // the special cases from C99 Annex F
+    I yInfinite = ay == inf;
+    r = (ax == V{}) ? ((y < V{}) ? inf : V{}) : r;
+    r = (ax == inf) ? ((y < V{}) ? V{} : inf) : r;
+    r = yInfinite ? ((((ax > one) ^ (y > V{})) == 0) ? inf : V{}) : r;
+    r = ((x != x) | (y != y)) ? x + y : r;
+    I integer = (((ay + TWO52) - TWO52) == ay) | (ay >= broadcast<V>(TWO52));
+    I parity = (ay < broadcast<V>(TWO52)) ? ((I)(ay + TWO52) & 1) : ((I)ay & 1);
+    I odd = integer & (ay < broadcast<V>(TWO53)) & (parity == 1);
+    r = (((I)x < 0) & odd) ? -r : r;
+    r = ((x < V{}) & (x > -inf) & ~integer) ? broadcast<V>(NOT_A_NUMBER) : r;
+    r = ((y == V{}) | (x == one) | ((ax == one) & yInfinite)) ? one : r;
+    return r;
+}
+
+template<typename V, typename I, bool> VECTOR_INLINE V vectorTanh(V x)
+{
+    // tanh(a) = (e^2a - 1)/(e^2a + 1), which is 1 to double precision for a > 22
+    V a = absolute<V, I>(x);
+    V limit = broadcast<V>(22.0);
+    V clamped = (a > limit) ? limit : a;
+    I n;
+    // e^2a - 1 needs to be accurate relative to itself, so always use the accurate polynomial
+    V q = expReduce<V, I, true>(clamped + clamped, V{}, n);
+    V p = exp2Integer<V, I>(n);
+    V t = p * q + (p - 1.0);
+    V y = t / (t + 2.0);
+    y = (a > limit) ? broadcast<V>(1.0) : y;
+    return (V)((I)y | ((I)x & SIGN_MASK));
+}
+
+} // namespace
+
+#define VECTOR_MATH_FUNCTIONS(V, I, SUFFIX, ACCURACY, ACCURATE, TARGET) \
+    TARGET V csim_exp_##SUFFIX##_##ACCURACY(V x) { return vectorExp<V, I, ACCURATE>(x); } \
+    TARGET V csim_log_##SUFFIX##_##ACCURACY(V x) { return vectorLog<V, I, ACCURATE>(x); } \
+    TARGET V csim_pow_##SUFFIX##_##ACCURACY(V x, V y) { return vectorPow<V, I, ACCURATE>(x, y); } \
+    TARGET V csim_tanh_##SUFFIX##_##ACCURACY(V x) { return vectorTanh<V, I, ACCURATE>(x); }
+
+#define AVX2 __attribute__((target("avx2")))
+#define AVX512 __attribute__((target("avx512f")))
+
+VECTOR_MATH_FUNCTIONS(Double2, Int2, d2, accurate, true, )
+VECTOR_MATH_FUNCTIONS(Double2, Int2, d2, fast, false, )
+VECTOR_MATH_FUNCTIONS(Double4, Int4, d4, accurate, true, AVX2)
+VECTOR_MATH_FUNCTIONS(Double4, Int4, d4, fast, false, AVX2)
+VECTOR_MATH_FUNCTIONS(Double8, Int8, d8, accurate, true, AVX512)
+VECTOR_MATH_FUNCTIONS(Double8, Int8, d8, fast, false, AVX512)
+
+static void addFunction(std::vector<VectorMathFunction>& functions, const char* scalarName,
+                        const char* intrinsicName, const char* vectorName, unsigned width, void* address)
+{
+    functions.push_back({ scalarName, vectorName, width, address });
+    if (intrinsicName) functions.push_back({ intrinsicName, vectorName, width, address });
+}
+
+#define ADD_VECTOR_MATH_FUNCTIONS(functions, SUFFIX, WIDTH, ACCURACY) \
+    do { \
+        addFunction(functions, "exp", "llvm.exp.f64", "csim_exp_" #SUFFIX "_" #ACCURACY, WIDTH, \
+                    reinterpret_cast<void*>(&csim_exp_##SUFFIX##_##ACCURACY)); \
+        addFunction(functions, "log", "llvm.log.f64", "csim_log_" #SUFFIX "_" #ACCURACY, WIDTH, \
+                    reinterpret_cast<void*>(&csim_log_##SUFFIX##_##ACCURACY)); \
+        addFunction(functions, "pow", "llvm.pow.f64", "csim_pow_" #SUFFIX "_" #ACCURACY, WIDTH, \
+                    reinterpret_cast<void*>(&csim_pow_##SUFFIX##_##ACCURACY)); \
+        addFunction(functions, "tanh", NULL, "csim_tanh_" #SUFFIX "_" #ACCURACY, WIDTH, \
+                    reinterpret_cast<void*>(&csim_tanh_##SUFFIX##_##ACCURACY)); \
+    } while (0)
+
+std::vector<VectorMathFunction> getVectorMathFunctions(csim::VectorMath accuracy, bool avx2, bool avx512)
+{
+    std::vector<VectorMathFunction> functions;
+    if (accuracy == csim::AccurateVectorMath)
+    {
+        ADD_VECTOR_MATH_FUNCTIONS(functions, d2, 2, accurate);
+        if (avx2) ADD_VECTOR_MATH_FUNCTIONS(functions, d4, 4, accurate);
+        if (avx512) ADD_VECTOR_MATH_FUNCTIONS(functions, d8, 8, accurate);
+    }
+    else if (accuracy == csim::FastVectorMath)
+    {
+        ADD_VECTOR_MATH_FUNCTIONS(functions, d2, 2, fast);
+        if (avx2) ADD_VECTOR_MATH_FUNCTIONS(functions, d4, 4, fast);
+        if (avx512) ADD_VECTOR_MATH_FUNCTIONS(functions, d8, 8, fast);
+    }
+    return functions;
+}
+
+#else
+
+std::vector<VectorMathFunction> getVectorMathFunctions(csim::VectorMath, bool, bool)
+{
+    // only x86-64 with a GCC compatible compiler is supported for now
+    return std::vector<VectorMathFunction>();
+}
+
+#endif // CSIM_VECTOR_MATH
@@ -0,0 +1,31 @@
+#ifndef VECTOR_MATH_H
+#define VECTOR_MATH_H
+
+#include <vector>
+
+#include "csim/executable_functions.h"
+
+/**
+ * A vector version of one of the math functions used by the generated code, taking and returning a vector of width
+ * doubles.
+ */
+struct VectorMathFunction
+{
+    const char* scalarName; // the function or LLVM intrinsic this is a vector version of, e.g., exp or llvm.exp.f64
+    const char* vectorName;
+    unsigned width;
+    void* address;
+};
+
+/**
+ * Get the vector math functions (exp, log, pow and tanh) built into CSim which are able to be used by code generated
+ * for the given instruction sets. Two lane versions using SSE2 are always available on x86-64, four lane versions
+ * need AVX2 and eight lane versions need AVX-512.
+ * @param accuracy The accuracy of the functions to use, csim::NoVectorMath will give no functions.
+ * @param avx2 True if the calling code is generated for AVX2.
+ * @param avx512 True if the calling code is generated for AVX-512.
+ * @return The available functions, which will be empty if the vector math library is not supported on this platform.
+ */
+std::vector<VectorMathFunction> getVectorMathFunctions(csim::VectorMath accuracy, bool avx2, bool avx512);
+
+#endif // VECTOR_MATH_H
@@ -2,9 +2,14 @@
 
 #include <string>
 #include <cmath>
+#include <fstream>
+#include <sstream>
+#include <vector>
 
 #include "csimsbw.h"
 #include "csim/error_codes.h"
+#include "csim/result_format.h"
+#include "csim/mapped_results.h"
 
 // generated with test resource locations
 #include "test_resources.h"
@@ -402,6 +407,454 @@ TEST(SBW, simulate_import_delayed_start) {
     csim_freeMatrix((void**)values, length);
 }
 
+struct StreamedSamples
+{
+    std::vector<double> values;
+    std::vector<int> blocks;
+    int maxBlocks;
+};
+
+static int collectSamples(const double* samples, int numRows, int numCols, void* userData)
+{
+    StreamedSamples* streamed = static_cast<StreamedSamples*>(userData);
+    streamed->values.insert(streamed->values.end(), samples, samples + numRows * numCols);
+    streamed->blocks.push_back(numRows);
+    return (int(streamed->blocks.size()) == streamed->maxBlocks) ? 1 : 0;
+}
+
+TEST(SBW, simulate_streaming) {
+    char* modelString;
+    int length;
+    int code = csim_serialiseCellmlFromUrl(
+                TestResources::getLocation(
+                    TestResources::CELLML_SINE_IMPORTS_MODEL_RESOURCE),
+                &modelString, &length);
+    // no point continuing if this fails
+    ASSERT_EQ(code, 0);
+    code = csim_loadCellml(modelString);
+    ASSERT_EQ(code, 0);
+    csim_freeVector(modelString);
+    double** values;
+    int nData;
+    code = csim_setTolerances(1.0, 1.0, 10);
+    code = csim_simulate(0.0, 0.0, 7.0, 8, &values, &nData, &length);
+    ASSERT_EQ(code, 0);
+    // the same samples arrive in blocks of 3, the last one short
+    StreamedSamples streamed;
+    streamed.maxBlocks = -1;
+    EXPECT_NE(csim_simulateStreaming(0.0, 0.0, 7.0, 8, 0, collectSamples, &streamed), 0);
+    csim_reset();
+    code = csim_simulateStreaming(0.0, 0.0, 7.0, 8, 4, collectSamples, &streamed);
+    EXPECT_EQ(code, 0);
+    ASSERT_EQ(streamed.blocks.size(), 3u);
+    EXPECT_EQ(streamed.blocks[0], 4);
+    EXPECT_EQ(streamed.blocks[2], 1);
+    ASSERT_EQ(streamed.values.size(), size_t(nData * length));
+    for (int n=0; n<nData; ++n)
+    {
+        for (int i=0; i<length; ++i) EXPECT_NEAR(values[n][i], streamed.values[n * length + i], ABS_TOL);
+    }
+    csim_freeMatrix((void**)values, nData);
+    // the callback can stop the simulation early
+    csim_reset();
+    streamed.values.clear();
+    streamed.blocks.clear();
+    streamed.maxBlocks = 1;
+    code = csim_simulateStreaming(0.0, 0.0, 7.0, 8, 3, collectSamples, &streamed);
+    EXPECT_EQ(code, 0);
+    EXPECT_EQ(streamed.blocks.size(), 1u);
+    EXPECT_NEAR(csim_getVariableOfIntegration(), 7.0 / 4.0, ABS_TOL);
+}
+
+TEST(SBW, simulate_to_file) {
+    char* modelString;
+    int length;
+    int code = csim_serialiseCellmlFromUrl(
+                TestResources::getLocation(
+                    TestResources::CELLML_SINE_IMPORTS_MODEL_RESOURCE),
+                &modelString, &length);
+    // no point continuing if this fails
+    ASSERT_EQ(code, 0);
+    code = csim_loadCellml(modelString);
+    ASSERT_EQ(code, 0);
+    csim_freeVector(modelString);
+    double** values;
+    int nData;
+    code = csim_setTolerances(1.0, 1.0, 10);
+    code = csim_simulate(0.0, 0.0, 7.0, 8, &values, &nData, &length);
+    ASSERT_EQ(code, 0);
+    csim_reset();
+    EXPECT_NE(csim_simulateToFile(0.0, 0.0, 7.0, 8, "no-such-directory/results.txt"), 0);
+    code = csim_simulateToFile(0.0, 0.0, 7.0, 8, "simulate_to_file.txt");
+    EXPECT_EQ(code, 0);
+    // a header line with the variable IDs, then a line for each sample
+    std::ifstream file("simulate_to_file.txt");
+    std::string line;
+    ASSERT_TRUE(bool(std::getline(file, line)));
+    EXPECT_NE(line.find("main/x"), std::string::npos);
+    for (int n=0; n<nData; ++n)
+    {
+        ASSERT_TRUE(bool(std::getline(file, line)));
+        std::istringstream row(line);
+        for (int i=0; i<length; ++i)
+        {
+            double value;
+            ASSERT_TRUE(bool(row >> value));
+            EXPECT_NEAR(values[n][i], value, ABS_TOL);
+        }
+    }
+    EXPECT_FALSE(bool(std::getline(file, line)));
+    csim_freeMatrix((void**)values, nData);
+}
+
+TEST(SBW, simulate_to_compressed_file) {
+    char* modelString;
+    int length;
+    int code = csim_serialiseCellmlFromUrl(
+                TestResources::getLocation(
+                    TestResources::CELLML_SINE_IMPORTS_MODEL_RESOURCE),
+                &modelString, &length);
+    // no point continuing if this fails
+    ASSERT_EQ(code, 0);
+    code = csim_loadCellml(modelString);
+    ASSERT_EQ(code, 0);
+    csim_freeVector(modelString);
+    double** values;
+    int nData;
+    code = csim_setTolerances(1.0, 1.0, 10);
+    code = csim_simulate(0.0, 0.0, 7.0, 700, &values, &nData, &length);
+    ASSERT_EQ(code, 0);
+    csim_reset();
+    code = csim_simulateToCompressedFile(0.0, 0.0, 7.0, 700, "simulate_to_compressed_file.csimr");
+    EXPECT_EQ(code, 0);
+    csim::ResultReader reader;
+    ASSERT_EQ(reader.open("simulate_to_compressed_file.csimr"), csim::CSIM_OK);
+    ASSERT_EQ(int(reader.columnIds().size()), length + 1);
+    EXPECT_EQ(reader.columnIds()[0], "time");
+    EXPECT_EQ(reader.numberOfRows(), 701u);
+    // the values are stored exactly
+    std::vector<int> columns;
+    for (int i=0; i<=length; ++i) columns.push_back(i);
+    std::vector<double> stored;
+    EXPECT_EQ(reader.read(0.0, 7.0, columns, stored), csim::CSIM_OK);
+    ASSERT_EQ(stored.size(), size_t(nData * (length + 1)));
+    for (int n=0; n<nData; ++n)
+    {
+        for (int i=0; i<length; ++i) EXPECT_EQ(values[n][i], stored[n * (length + 1) + i + 1]);
+    }
+    // and can be read for a range of time
+    int x = reader.columnIndex("main/x");
+    ASSERT_GT(x, 0);
+    EXPECT_EQ(reader.read(3.495, 3.525, std::vector<int>(1, x), stored), csim::CSIM_OK);
+    ASSERT_EQ(stored.size(), 3u);
+    EXPECT_NEAR(stored[0], 3.5, ABS_TOL);
+    EXPECT_NEAR(stored[2], 3.52, ABS_TOL);
+    csim_freeMatrix((void**)values, nData);
+}
+
+TEST(SBW, compressed_file_while_writing) {
+    std::vector<std::string> columnIds;
+    columnIds.push_back("time");
+    columnIds.push_back("value");
+    csim::CompressedResultSink sink;
+    ASSERT_EQ(sink.open("compressed_file_while_writing.csimr", columnIds, 0), csim::CSIM_OK);
+    std::vector<double> block(20);
+    for (int chunk=0; chunk<5; ++chunk)
+    {
+        for (int r=0; r<10; ++r)
+        {
+            block[2 * r] = 0.1 * (10 * chunk + r);
+            block[2 * r + 1] = sin(block[2 * r]);
+        }
+        ASSERT_EQ(sink.write(block.data(), 10, 2), csim::CSIM_OK);
+    }
+    // the chunks written so far can be read before the file is finished
+    csim::ResultReader reader;
+    ASSERT_EQ(reader.open("compressed_file_while_writing.csimr"), csim::CSIM_OK);
+    EXPECT_EQ(reader.numberOfRows(), 50u);
+    std::vector<double> stored;
+    EXPECT_EQ(reader.read(0.0, 4.9, std::vector<int>(1, 1), stored), csim::CSIM_OK);
+    ASSERT_EQ(stored.size(), 50u);
+    for (int n=0; n<50; ++n) EXPECT_EQ(stored[n], sin(0.1 * n));
+    EXPECT_EQ(sink.finish(), csim::CSIM_OK);
+    ASSERT_EQ(reader.open("compressed_file_while_writing.csimr"), csim::CSIM_OK);
+    EXPECT_EQ(reader.numberOfRows(), 50u);
+}
+
+// write a copy of the given file contents with the little endian value stored at the given offset
+static void writeCorruptFile(const std::string& fileName, std::string contents, size_t offset, unsigned long long value,
+                             int numberOfBytes)
+{
+    for (int b=0; b<numberOfBytes; ++b) contents[offset + b] = char((value >> (8 * b)) & 0xff);
+    std::ofstream file(fileName.c_str(), std::ios::binary);
+    file << contents;
+}
+
+TEST(SBW, compressed_file_corrupt) {
+    std::vector<std::string> columnIds;
+    columnIds.push_back("time");
+    columnIds.push_back("value");
+    csim::CompressedResultSink sink;
+    ASSERT_EQ(sink.open("compressed_file_corrupt.csimr", columnIds, 0), csim::CSIM_OK);
+    std::vector<double> block(20);
+    for (int chunk=0; chunk<2; ++chunk)
+    {
+        for (int r=0; r<10; ++r)
+        {
+            block[2 * r] = 0.1 * (10 * chunk + r);
+            block[2 * r + 1] = sin(block[2 * r]);
+        }
+        ASSERT_EQ(sink.write(block.data(), 10, 2), csim::CSIM_OK);
+    }
+    EXPECT_EQ(sink.finish(), csim::CSIM_OK);
+    std::ifstream file("compressed_file_corrupt.csimr", std::ios::binary);
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    const std::string contents = buffer.str();
+    // the footer is the number of chunks, the offset of the index and the index magic
+    const size_t footer = contents.size() - 24;
+    csim::ResultReader reader;
+    writeCorruptFile("corrupt.csimr", contents, 16, 0xfffffff0ull, 4);
+    EXPECT_EQ(reader.open("corrupt.csimr"), csim::INVALID_RESULT_FILE);
+    writeCorruptFile("corrupt.csimr", contents, footer, 1ull << 40, 8);
+    EXPECT_EQ(reader.open("corrupt.csimr"), csim::INVALID_RESULT_FILE);
+    writeCorruptFile("corrupt.csimr", contents, footer, 3, 8);
+    EXPECT_EQ(reader.open("corrupt.csimr"), csim::INVALID_RESULT_FILE);
+    writeCorruptFile("corrupt.csimr", contents, footer + 8, contents.size(), 8);
+    EXPECT_EQ(reader.open("corrupt.csimr"), csim::INVALID_RESULT_FILE);
+    // a truncated file has no index, so the complete chunks are found from their headers
+    std::ofstream truncated("corrupt.csimr", std::ios::binary);
+    truncated << contents.substr(0, footer - 10);
+    truncated.close();
+    ASSERT_EQ(reader.open("corrupt.csimr"), csim::CSIM_OK);
+    EXPECT_EQ(reader.numberOfRows(), 20u);
+}
+
+TEST(SBW, mapped_file_while_writing) {
+    std::vector<std::string> columnIds;
+    columnIds.push_back("time");
+    columnIds.push_back("value");
+    csim::MappedResultSink sink;
+    // room for 4 rows to start with, growing 3 rows at a time
+    ASSERT_EQ(sink.open("mapped_file_while_writing.csimm", columnIds, 0, 4, 3), csim::CSIM_OK);
+    csim::MappedResults results;
+    ASSERT_EQ(results.open("mapped_file_while_writing.csimm"), csim::CSIM_OK);
+    EXPECT_FALSE(results.isFinished());
+    EXPECT_EQ(results.numberOfRows(), 0u);
+    double row[2];
+    for (int n=0; n<10; ++n)
+    {
+        row[0] = 0.1 * n;
+        row[1] = sin(row[0]);
+        ASSERT_EQ(sink.write(row, 1, 2), csim::CSIM_OK);
+        // the rows written so far can be read, whether or not the file has grown since it was last mapped
+        ASSERT_EQ(results.refresh(), csim::CSIM_OK);
+        ASSERT_EQ(results.numberOfRows(), uint64_t(n + 1));
+        EXPECT_FALSE(results.isFinished());
+        for (int r=0; r<=n; ++r)
+        {
+            EXPECT_EQ(results.values()[2 * r], 0.1 * r);
+            EXPECT_EQ(results.values()[2 * r + 1], sin(0.1 * r));
+        }
+    }
+    EXPECT_EQ(sink.finish(), csim::CSIM_OK);
+    ASSERT_EQ(results.refresh(), csim::CSIM_OK);
+    EXPECT_TRUE(results.isFinished());
+    EXPECT_EQ(results.numberOfRows(), 10u);
+}
+
+TEST(SBW, simulate_to_mapped_file) {
+    char* modelString;
+    int length;
+    int code = csim_serialiseCellmlFromUrl(
+                TestResources::getLocation(
+                    TestResources::CELLML_SINE_IMPORTS_MODEL_RESOURCE),
+                &modelString, &length);
+    // no point continuing if this fails
+    ASSERT_EQ(code, 0);
+    code = csim_loadCellml(modelString);
+    ASSERT_EQ(code, 0);
+    csim_freeVector(modelString);
+    double** values;
+    int nData;
+    code = csim_setTolerances(1.0, 1.0, 10);
+    code = csim_simulate(0.0, 0.0, 7.0, 700, &values, &nData, &length);
+    ASSERT_EQ(code, 0);
+    csim_reset();
+    code = csim_simulateToMappedFile(0.0, 0.0, 7.0, 700, "simulate_to_mapped_file.csimm");
+    EXPECT_EQ(code, 0);
+    csim::MappedResults results;
+    ASSERT_EQ(results.open("simulate_to_mapped_file.csimm"), csim::CSIM_OK);
+    EXPECT_TRUE(results.isFinished());
+    ASSERT_EQ(int(results.columnIds().size()), length + 1);
+    EXPECT_EQ(results.columnIds()[0], "time");
+    EXPECT_EQ(results.timeColumn(), 0);
+    ASSERT_EQ(results.numberOfRows(), uint64_t(nData));
+    const double* stored = results.values();
+    EXPECT_DOUBLE_EQ(stored[0], 0.0);
+    EXPECT_NEAR(stored[size_t(nData - 1) * (length + 1)], 7.0, ABS_TOL);
+    for (int n=0; n<nData; ++n)
+    {
+        for (int i=0; i<length; ++i) EXPECT_EQ(values[n][i], stored[size_t(n) * (length + 1) + i + 1]);
+    }
+    csim_freeMatrix((void**)values, nData);
+}
+
+TEST(SBW, simulate_statistics) {
+    char* modelString;
+    int length;
+    int code = csim_serialiseCellmlFromUrl(
+                TestResources::getLocation(
+                    TestResources::CELLML_SINE_IMPORTS_MODEL_RESOURCE),
+                &modelString, &length);
+    // no point continuing if this fails
+    ASSERT_EQ(code, 0);
+    code = csim_loadCellml(modelString);
+    ASSERT_EQ(code, 0);
+    csim_freeVector(modelString);
+    double** values;
+    int nData;
+    code = csim_setTolerances(1.0, 1.0, 10);
+    code = csim_simulate(0.0, 0.0, 7.0, 700, &values, &nData, &length);
+    ASSERT_EQ(code, 0);
+    csim_reset();
+    double** statistics;
+    int nStatistics, nVariables;
+    code = csim_simulateStatistics(0.0, 0.0, 7.0, 700, &statistics, &nStatistics, &nVariables);
+    EXPECT_EQ(code, 0);
+    ASSERT_EQ(nStatistics, 6);
+    ASSERT_EQ(nVariables, length);
+    for (int i=0; i<length; ++i)
+    {
+        double sum = 0.0, squares = 0.0, minimum = values[0][i], maximum = values[0][i];
+        int nMinimum = 0, nMaximum = 0;
+        for (int n=0; n<nData; ++n) sum += values[n][i];
+        for (int n=0; n<nData; ++n)
+        {
+            squares += (values[n][i] - sum / nData) * (values[n][i] - sum / nData);
+            if (values[n][i] < minimum) { minimum = values[n][i]; nMinimum = n; }
+            if (values[n][i] > maximum) { maximum = values[n][i]; nMaximum = n; }
+        }
+        EXPECT_NEAR(statistics[0][i], sum / nData, ABS_TOL);
+        EXPECT_NEAR(statistics[1][i], squares / (nData - 1), ABS_TOL);
+        EXPECT_EQ(statistics[2][i], minimum);
+        EXPECT_EQ(statistics[3][i], maximum);
+        EXPECT_NEAR(statistics[4][i], 0.01 * nMinimum, ABS_TOL);
+        EXPECT_NEAR(statistics[5][i], 0.01 * nMaximum, ABS_TOL);
+    }
+    csim_freeMatrix((void**)statistics, nStatistics);
+    csim_freeMatrix((void**)values, nData);
+}
+
+TEST(SBW, biomarkers) {
+    char* modelString;
+    int length;
+    int code = csim_serialiseCellmlFromUrl(
+                TestResources::getLocation(
+                    TestResources::CELLML_SINE_IMPORTS_MODEL_RESOURCE),
+                &modelString, &length);
+    // no point continuing if this fails
+    ASSERT_EQ(code, 0);
+    code = csim_loadCellml(modelString);
+    ASSERT_EQ(code, 0);
+    csim_freeVector(modelString);
+    code = csim_setTolerances(1.0, 1.0, 10);
+    EXPECT_NE(csim_addBiomarkers("main/not_a_variable", 0.0), 0);
+    EXPECT_EQ(csim_addBiomarkers("main/sin1", 0.0), 0);
+    double* biomarkers;
+    EXPECT_NE(csim_getBiomarkers("main/sin2", &biomarkers, &length), 0);
+    // the sine starts at zero, so the first upstroke is at 2 pi and the beat after it is still going at the end
+    code = csim_simulateBiomarkers(0.0, 0.0, 20.0, 2000);
+    EXPECT_EQ(code, 0);
+    code = csim_getBiomarkers("main/sin1", &biomarkers, &length);
+    ASSERT_EQ(code, 0);
+    ASSERT_EQ(length, 7);
+    EXPECT_EQ(biomarkers[0], 2.0);
+    EXPECT_NEAR(biomarkers[1], -1.0, 1.0e-3); // resting value
+    EXPECT_NEAR(biomarkers[2], 1.0, 1.0e-3); // peak
+    EXPECT_NEAR(biomarkers[3], 1.0, 1.0e-3); // maximum upstroke velocity
+    EXPECT_NEAR(biomarkers[4], M_PI, 1.0e-3); // APD50
+    EXPECT_NEAR(biomarkers[5], M_PI + asin(0.8), 1.0e-3); // APD90
+    EXPECT_NEAR(biomarkers[6], 2.0 * M_PI, 1.0e-3); // cycle length
+    csim_freeVector(biomarkers);
+    // the biomarkers are also detected while keeping the data
+    double** values;
+    int nData;
+    csim_reset();
+    code = csim_simulate(0.0, 0.0, 12.0, 1200, &values, &nData, &length);
+    EXPECT_EQ(code, 0);
+    code = csim_getBiomarkers("main/sin1", &biomarkers, &length);
+    ASSERT_EQ(code, 0);
+    EXPECT_EQ(biomarkers[0], 1.0);
+    EXPECT_NEAR(biomarkers[4], M_PI, 1.0e-3);
+    EXPECT_TRUE(std::isnan(biomarkers[6]));
+    csim_freeVector(biomarkers);
+    csim_freeMatrix((void**)values, nData);
+    EXPECT_EQ(csim_clearBiomarkers(), 0);
+    EXPECT_NE(csim_getBiomarkers("main/sin1", &biomarkers, &length), 0);
+}
+
+TEST(SBW, steady_state) {
+    char* modelString;
+    int length;
+    int code = csim_serialiseCellmlFromUrl(
+                TestResources::getLocation(
+                    TestResources::CELLML_SINE_IMPORTS_MODEL_RESOURCE),
+                &modelString, &length);
+    // no point continuing if this fails
+    ASSERT_EQ(code, 0);
+    code = csim_loadCellml(modelString);
+    ASSERT_EQ(code, 0);
+    csim_freeVector(modelString);
+    EXPECT_NE(csim_setSteadyStateOptions(0.0, 5, 20), 0);
+    EXPECT_EQ(csim_setSteadyStateOptions(1.0e-8, 5, 20), 0);
+    // the sines keep changing, so there is no steady state
+    EXPECT_NE(csim_steadyState(), 0);
+    double* diagnostics;
+    code = csim_getSteadyStateDiagnostics(&diagnostics, &length);
+    EXPECT_EQ(code, 0);
+    ASSERT_EQ(length, 6);
+    EXPECT_EQ(diagnostics[0], 0.0);
+    EXPECT_LE(diagnostics[2], 20.0);
+    EXPECT_GT(diagnostics[4], 1.0e-8);
+    csim_freeVector(diagnostics);
+}
+
+TEST(SBW, limit_cycle) {
+    char* modelString;
+    int length;
+    int code = csim_serialiseCellmlFromUrl(
+                TestResources::getLocation(
+                    TestResources::CELLML_SINE_IMPORTS_MODEL_RESOURCE),
+                &modelString, &length);
+    // no point continuing if this fails
+    ASSERT_EQ(code, 0);
+    code = csim_loadCellml(modelString);
+    ASSERT_EQ(code, 0);
+    csim_freeVector(modelString);
+    EXPECT_NE(csim_limitCycle(0.0, 100, 10), 0);
+    EXPECT_NE(csim_limitCycle(1.0, 100, 0), 0);
+    EXPECT_NE(csim_setLimitCycleOptions(1.0e-6, 0.0, 5, 20), 0);
+    EXPECT_EQ(csim_setLimitCycleOptions(1.0e-6, 1.0e-8, 5, 20), 0);
+    // the VOI is left at the start of the period
+    code = csim_oneStep(1.0);
+    csim_limitCycle(2.0 * M_PI, 100, 3);
+    EXPECT_NEAR(csim_getVariableOfIntegration(), 1.0, ABS_TOL);
+    double* diagnostics;
+    code = csim_getLimitCycleDiagnostics(&diagnostics, &length);
+    EXPECT_EQ(code, 0);
+    ASSERT_EQ(length, 6);
+    EXPECT_LE(diagnostics[1], 3.0);
+    EXPECT_EQ(diagnostics[2], diagnostics[1]);
+    csim_freeVector(diagnostics);
+    // and can be made the state to reset to
+    EXPECT_EQ(csim_checkpoint(), 0);
+    code = csim_oneStep(2.345);
+    EXPECT_NEAR(csim_getVariableOfIntegration(), 3.345, ABS_TOL);
+    code = csim_reset();
+    EXPECT_NEAR(csim_getVariableOfIntegration(), 1.0, ABS_TOL);
+}
+
 TEST(SBW, get_voi) {
     char* modelString;
     int length;
@@ -441,3 +894,169 @@ TEST(SBW, get_voi) {
     EXPECT_NEAR(voi, 2.345, ABS_TOL);
 }
 
+
+TEST(SBW, rush_larsen_integrator) {
+    char* modelString;
+    int length;
+    int code = csim_serialiseCellmlFromUrl(
+                TestResources::getLocation(
+                    TestResources::CELLML_GATING_MODEL_RESOURCE),
+                &modelString, &length);
+    // no point continuing if this fails
+    ASSERT_EQ(code, 0);
+    code = csim_loadCellml(modelString);
+    ASSERT_EQ(code, 0);
+    csim_freeVector(modelString);
+    EXPECT_NE(csim_setIntegrator("not-a-method"), 0);
+    code = csim_setIntegrator("rush-larsen");
+    EXPECT_EQ(code, 0);
+    // big steps are fine for gating variables
+    code = csim_setTolerances(1.0, 1.0, 1);
+    code = csim_oneStep(5.0);
+    code = csim_oneStep(5.0);
+    EXPECT_EQ(code, 0);
+    double* values;
+    code = csim_getValues(&values, &length);
+    EXPECT_EQ(length, 14);
+    EXPECT_NEAR(values[1], -80.0 + 100.0 * exp(-1.0), ABS_TOL); // main/V
+    EXPECT_GT(values[6], 0.0); // main/h
+    EXPECT_LT(values[6], 1.0); // main/h
+    csim_freeVector(values);
+}
+
+TEST(SBW, termination) {
+    char* modelString;
+    int length;
+    int code = csim_serialiseCellmlFromUrl(
+                TestResources::getLocation(
+                    TestResources::CELLML_SINE_IMPORTS_MODEL_RESOURCE),
+                &modelString, &length);
+    // no point continuing if this fails
+    ASSERT_EQ(code, 0);
+    code = csim_loadCellml(modelString);
+    ASSERT_EQ(code, 0);
+    csim_freeVector(modelString);
+    code = csim_setTolerances(1.0, 1.0, 10);
+    EXPECT_NE(csim_setTerminationBounds("main/not_a_variable", -1.0, 1.0), 0);
+    EXPECT_NE(csim_setTerminationBounds("main/sin1", 1.0, -1.0), 0);
+    EXPECT_NE(csim_setTermination(1.0, -1.0, 1), 0);
+    // main/sin1 first drops below -0.5 at 7 pi / 6
+    EXPECT_EQ(csim_setTerminationBounds("main/sin1", -0.5, 2.0), 0);
+    double** values;
+    int nData;
+    code = csim_simulate(0.0, 0.0, 7.0, 700, &values, &nData, &length);
+    EXPECT_EQ(code, 0);
+    ASSERT_GT(nData, 1);
+    EXPECT_LT(nData, 701);
+    EXPECT_LT(values[nData-1][1], -0.5); // main/sin1
+    EXPECT_GE(values[nData-2][1], -0.5); // main/sin1
+    EXPECT_NEAR(values[nData-1][4], 7.0 * M_PI / 6.0, 0.011); // main/x
+    csim_freeMatrix((void**)values, nData);
+    double* termination;
+    code = csim_getTermination(&termination, &length);
+    ASSERT_EQ(code, 0);
+    ASSERT_EQ(length, 3);
+    EXPECT_EQ(termination[0], 3.0); // out of bounds
+    EXPECT_NEAR(termination[1], csim_getVariableOfIntegration(), ABS_TOL);
+    csim_freeVector(termination);
+    // main/x always changes at a rate of 1 and the sine approximations never much faster
+    EXPECT_EQ(csim_clearTermination(), 0);
+    EXPECT_EQ(csim_setTermination(2.0, 1.0, 1), 0);
+    csim_reset();
+    code = csim_simulate(0.0, 0.0, 7.0, 700, &values, &nData, &length);
+    EXPECT_EQ(code, 0);
+    EXPECT_GE(nData, 101);
+    EXPECT_LE(nData, 102);
+    csim_freeMatrix((void**)values, nData);
+    code = csim_getTermination(&termination, &length);
+    ASSERT_EQ(code, 0);
+    EXPECT_EQ(termination[0], 1.0); // steady state
+    EXPECT_NEAR(termination[1], 1.0, 0.011);
+    EXPECT_GE(termination[2], 1.0);
+    EXPECT_LE(termination[2], 2.0);
+    csim_freeVector(termination);
+    // without any criteria the simulation runs to the end
+    EXPECT_EQ(csim_clearTermination(), 0);
+    csim_reset();
+    code = csim_simulate(0.0, 0.0, 7.0, 700, &values, &nData, &length);
+    EXPECT_EQ(code, 0);
+    EXPECT_EQ(nData, 701);
+    csim_freeMatrix((void**)values, nData);
+    code = csim_getTermination(&termination, &length);
+    ASSERT_EQ(code, 0);
+    EXPECT_EQ(termination[0], 0.0);
+    EXPECT_NEAR(termination[1], 7.0, ABS_TOL);
+    csim_freeVector(termination);
+}
+
+TEST(SBW, termination_non_finite) {
+    char* modelString;
+    int length;
+    int code = csim_serialiseCellmlFromUrl(
+                TestResources::getLocation(
+                    TestResources::CELLML_GATING_MODEL_RESOURCE),
+                &modelString, &length);
+    // no point continuing if this fails
+    ASSERT_EQ(code, 0);
+    code = csim_loadCellml(modelString);
+    ASSERT_EQ(code, 0);
+    csim_freeVector(modelString);
+    // Euler steps a hundred times the time constant of main/V blow it up, overflowing to infinity and then NaN
+    code = csim_setTolerances(1.0, 1.0, 1);
+    EXPECT_EQ(csim_setTermination(1.0e-3, 0.0, 0), 0);
+    double** values;
+    int nData;
+    code = csim_simulate(0.0, 0.0, 400000.0, 400, &values, &nData, &length);
+    EXPECT_EQ(code, 0);
+    ASSERT_EQ(nData, 401);
+    EXPECT_FALSE(std::isfinite(values[400][1])); // main/V
+    csim_freeMatrix((void**)values, nData);
+    // a run which has blown up is never taken to be at a steady state
+    double* termination;
+    code = csim_getTermination(&termination, &length);
+    ASSERT_EQ(code, 0);
+    EXPECT_EQ(termination[0], 0.0);
+    EXPECT_FALSE(std::isfinite(termination[2]));
+    csim_freeVector(termination);
+    EXPECT_EQ(csim_setTermination(1.0e-3, 0.0, 1), 0);
+    csim_reset();
+    code = csim_simulate(0.0, 0.0, 400000.0, 400, &values, &nData, &length);
+    EXPECT_EQ(code, 0);
+    ASSERT_GT(nData, 1);
+    EXPECT_LT(nData, 401);
+    code = csim_getTermination(&termination, &length);
+    ASSERT_EQ(code, 0);
+    EXPECT_EQ(termination[0], 2.0); // a state is not finite
+    EXPECT_NEAR(termination[1], 1000.0 * (nData - 1), 1.0e-6);
+    csim_freeVector(termination);
+    csim_freeMatrix((void**)values, nData);
+    csim_clearTermination();
+}
+
+static int countRows(const double*, int numRows, int, void* userData)
+{
+    *static_cast<int*>(userData) += numRows;
+    return 0;
+}
+
+TEST(SBW, no_model) {
+    // a model which fails to load leaves nothing to simulate
+    EXPECT_NE(csim_loadCellml("not a CellML model"), 0);
+    EXPECT_NE(csim_setIntegrator("euler"), 0);
+    EXPECT_NE(csim_oneStep(1.0), 0);
+    int rows = 0;
+    EXPECT_NE(csim_simulateStreaming(0.0, 0.0, 1.0, 10, 4, countRows, &rows), 0);
+    EXPECT_EQ(rows, 0);
+    EXPECT_NE(csim_simulateToFile(0.0, 0.0, 1.0, 10, "no_model.txt"), 0);
+    EXPECT_NE(csim_simulateToCompressedFile(0.0, 0.0, 1.0, 10, "no_model.csimr"), 0);
+    EXPECT_NE(csim_simulateToMappedFile(0.0, 0.0, 1.0, 10, "no_model.csimm"), 0);
+    double** statistics;
+    int nStatistics, nVariables;
+    EXPECT_NE(csim_simulateStatistics(0.0, 0.0, 1.0, 10, &statistics, &nStatistics, &nVariables), 0);
+    EXPECT_NE(csim_addBiomarkers("main/x", 0.0), 0);
+    EXPECT_NE(csim_simulateBiomarkers(0.0, 0.0, 1.0, 10), 0);
+    EXPECT_NE(csim_steadyState(), 0);
+    EXPECT_NE(csim_limitCycle(1.0, 10, 10), 0);
+    EXPECT_NE(csim_checkpoint(), 0);
+    EXPECT_NE(csim_setTermination(1.0, 1.0, 1), 0);
+}
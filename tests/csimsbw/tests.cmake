@@ -11,4 +11,5 @@ set(CELLML_SINE_MODEL_RESOURCE "${CMAKE_CURRENT_SOURCE_DIR}/resources/sine/sin_a
 set(CELLML_SINE_IMPORTS_MODEL_RESOURCE "${CMAKE_CURRENT_SOURCE_DIR}/resources/sine/sin_approximations_import.xml")
 set(CELLML_INVALID_MODEL_RESOURCE "${CMAKE_CURRENT_SOURCE_DIR}/resources/invalid_cellml_1.0.xml")
 set(CELLML_UNDERCONSTRAINED_MODEL_RESOURCE "${CMAKE_CURRENT_SOURCE_DIR}/resources/underconstrained_cellml_1.0.xml")
+set(CELLML_GATING_MODEL_RESOURCE "${CMAKE_CURRENT_SOURCE_DIR}/resources/gating_cellml_1.0.xml")
 
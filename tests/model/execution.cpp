@@ -1,12 +1,103 @@
 #include "gtest/gtest.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
 #include "csim/model.h"
+#include "csim/population.h"
+#include "csim/statistics.h"
+#include "csim/steady_state.h"
+#include "csim/limit_cycle.h"
+#include "csim/monodomain.h"
+#include "csim/variable_types.h"
 #include "csim/executable_functions.h"
 #include "csim/error_codes.h"
 
 // generated with test resource locations
 #include "test_resources.h"
 
+/*
+ * A CellML model of the given number of independent cells, each with a state x_i relaxing towards a_i = exp(-x_i / c_i),
+ * wide enough for its model function to be split into chunks and tasks.
+ */
+static std::string wideModel(int numberOfCells)
+{
+    std::ostringstream model;
+    model << "<?xml version=\"1.0\"?>\n"
+          << "<model xmlns=\"http://www.cellml.org/cellml/1.0#\" xmlns:cellml=\"http://www.cellml.org/cellml/1.0#\""
+          << " name=\"wide\">\n<component name=\"main\">\n"
+          << "<variable name=\"time\" public_interface=\"out\" units=\"dimensionless\"/>\n";
+    for (int i = 0; i < numberOfCells; ++i)
+    {
+        model << "<variable name=\"x_" << i << "\" initial_value=\"" << 1.0 + 0.001 * i
+              << "\" public_interface=\"out\" units=\"dimensionless\"/>\n"
+              << "<variable name=\"a_" << i << "\" public_interface=\"out\" units=\"dimensionless\"/>\n";
+    }
+    model << "<math xmlns=\"http://www.w3.org/1998/Math/MathML\">\n";
+    for (int i = 0; i < numberOfCells; ++i)
+    {
+        model << "<apply><eq/><ci>a_" << i << "</ci><apply><exp/><apply><divide/><apply><minus/><ci>x_" << i
+              << "</ci></apply><cn cellml:units=\"dimensionless\">" << 10 + i << "</cn></apply></apply></apply>\n"
+              << "<apply><eq/><apply><diff/><bvar><ci>time</ci></bvar><ci>x_" << i << "</ci></apply>"
+              << "<apply><minus/><ci>a_" << i << "</ci><ci>x_" << i << "</ci></apply></apply>\n";
+    }
+    model << "</math>\n</component>\n</model>\n";
+    return model.str();
+}
+
+/*
+ * A CellML model calling each of the math functions with vector versions, exp(u), ln(u), u^v and tanh(u), for the
+ * inputs u and v.
+ */
+static std::string mathFunctionsModel()
+{
+    std::ostringstream model;
+    model << "<?xml version=\"1.0\"?>\n"
+          << "<model xmlns=\"http://www.cellml.org/cellml/1.0#\" xmlns:cellml=\"http://www.cellml.org/cellml/1.0#\""
+          << " name=\"math_functions\">\n<component name=\"main\">\n"
+          << "<variable name=\"time\" public_interface=\"out\" units=\"dimensionless\"/>\n"
+          << "<variable name=\"x\" initial_value=\"1\" public_interface=\"out\" units=\"dimensionless\"/>\n"
+          << "<variable name=\"u\" initial_value=\"1\" public_interface=\"out\" units=\"dimensionless\"/>\n"
+          << "<variable name=\"v\" initial_value=\"1\" public_interface=\"out\" units=\"dimensionless\"/>\n";
+    const char* outputs[] = { "e", "l", "p", "t" };
+    for (const auto output: outputs)
+    {
+        model << "<variable name=\"" << output << "\" public_interface=\"out\" units=\"dimensionless\"/>\n";
+    }
+    model << "<math xmlns=\"http://www.w3.org/1998/Math/MathML\">\n"
+          << "<apply><eq/><ci>e</ci><apply><exp/><ci>u</ci></apply></apply>\n"
+          << "<apply><eq/><ci>l</ci><apply><ln/><ci>u</ci></apply></apply>\n"
+          << "<apply><eq/><ci>p</ci><apply><power/><ci>u</ci><ci>v</ci></apply></apply>\n"
+          << "<apply><eq/><ci>t</ci><apply><tanh/><ci>u</ci></apply></apply>\n"
+          << "<apply><eq/><apply><diff/><bvar><ci>time</ci></bvar><ci>x</ci></apply>"
+          << "<apply><minus/><ci>x</ci></apply></apply>\n"
+          << "</math>\n</component>\n</model>\n";
+    return model.str();
+}
+
+/*
+ * The number of representable doubles between a and b, zero if both are NaN.
+ */
+static double ulpDistance(double a, double b)
+{
+    if (std::isnan(a) || std::isnan(b)) return (std::isnan(a) && std::isnan(b)) ? 0.0 : HUGE_VAL;
+    if (a == b) return 0.0;
+    // map the bits onto integers ordered the same way as the doubles
+    int64_t x, y;
+    std::memcpy(&x, &a, sizeof(x));
+    std::memcpy(&y, &b, sizeof(y));
+    if (x < 0) x = INT64_MIN - x;
+    if (y < 0) y = INT64_MIN - y;
+    return (x > y) ? double(x - y) : double(y - x);
+}
+
 TEST(Execution, function_retrieval) {
     csim::Model model;
     EXPECT_EQ(csim::CSIM_OK,
@@ -60,3 +151,810 @@ TEST(Execution, function_execution) {
     modelFunction(x, states, rates, outputs, inputs);
     EXPECT_EQ(1.0, outputs[1]);
 }
+
+TEST(Execution, lookup_tables) {
+    csim::Model model;
+    EXPECT_EQ(csim::CSIM_OK,
+              model.loadCellmlModel(TestResources::getLocation(TestResources::CELLML_GATING_MODEL_RESOURCE)));
+    EXPECT_EQ(csim::INVALID_LOOKUP_TABLE_RANGE, model.setLookupTable("main/V", 50.0, -100.0, 0.1));
+    EXPECT_EQ(csim::UNABLE_TO_FLAG_VARIABLE, model.setLookupTable("main/VV", -100.0, 50.0, 0.1));
+    EXPECT_EQ(csim::CSIM_OK, model.setLookupTable("main/V", -100.0, 50.0, 0.1));
+    EXPECT_EQ(0, model.setVariableAsOutput("main/i_ion"));
+    ASSERT_EQ(csim::CSIM_OK, model.instantiate());
+    EXPECT_EQ(csim::MODEL_ALREADY_INSTANTIATED, model.setLookupTable("main/V", -100.0, 50.0, 0.1));
+    EXPECT_GT(model.lookupTableError(), 0.0);
+    EXPECT_LT(model.lookupTableError(), 1.0e-4);
+
+    csim::Model reference;
+    EXPECT_EQ(csim::CSIM_OK,
+              reference.loadCellmlModel(TestResources::getLocation(TestResources::CELLML_GATING_MODEL_RESOURCE)));
+    EXPECT_EQ(0, reference.setVariableAsOutput("main/i_ion"));
+    ASSERT_EQ(csim::CSIM_OK, reference.instantiate());
+    EXPECT_EQ(0.0, reference.lookupTableError());
+
+    double states[3], rates[3], outputs[1], inputs[1], referenceRates[3];
+    model.getInitialiseFunction()(states, outputs, inputs);
+    // check values inside and outside the range of the tables
+    for (double v = -120.0; v < 70.0; v += 3.7)
+    {
+        states[0] = v;
+        model.getModelFunction()(0.0, states, rates, outputs, inputs);
+        reference.getModelFunction()(0.0, states, referenceRates, outputs, inputs);
+        for (int i = 0; i < 3; ++i) EXPECT_NEAR(referenceRates[i], rates[i], 1.0e-4);
+    }
+}
+
+TEST(Execution, rush_larsen) {
+    csim::Model model;
+    EXPECT_EQ(csim::CSIM_OK,
+              model.loadCellmlModel(TestResources::getLocation(TestResources::CELLML_GATING_MODEL_RESOURCE)));
+    EXPECT_EQ(0, model.setVariableAsOutput("main/i_ion"));
+    ASSERT_EQ(csim::CSIM_OK, model.instantiate());
+    // V, h and n all have rates linear in themselves
+    EXPECT_EQ(3, model.numberOfGatingVariables());
+    csim::StepFunction stepFunction = model.getRushLarsenFunction();
+    ASSERT_TRUE(stepFunction != NULL);
+    double states[3], rates[3], outputs[1], inputs[1];
+    model.getInitialiseFunction()(states, outputs, inputs);
+    // V relaxes exponentially to rest, which the exponential update integrates exactly with any step size
+    stepFunction(0.0, 5.0, states, rates, outputs, inputs);
+    stepFunction(5.0, 5.0, states, rates, outputs, inputs);
+    EXPECT_NEAR(-80.0 + 100.0 * exp(-1.0), states[0], 1.0e-10);
+    // and the gates must stay within their bounds
+    EXPECT_GT(states[1], 0.0);
+    EXPECT_LT(states[1], 1.0);
+    EXPECT_GT(states[2], 0.0);
+    EXPECT_LT(states[2], 1.0);
+}
+
+TEST(Execution, single_precision) {
+    csim::Model model;
+    EXPECT_EQ(csim::CSIM_OK,
+              model.loadCellmlModel(TestResources::getLocation(TestResources::CELLML_GATING_MODEL_RESOURCE)));
+    EXPECT_EQ(0, model.setVariableAsOutput("main/i_ion"));
+    ASSERT_EQ(csim::CSIM_OK, model.instantiate(false, false, csim::SinglePrecision));
+    EXPECT_LT(model.precisionError(), 1.0e-5);
+    csim::InitialiseFunctionFloat initialiseFunction = model.getSinglePrecisionInitialiseFunction();
+    csim::ModelFunctionFloat modelFunction = model.getSinglePrecisionModelFunction();
+    ASSERT_TRUE(initialiseFunction != NULL);
+    ASSERT_TRUE(modelFunction != NULL);
+
+    float states[3], rates[3], outputs[1], inputs[1];
+    double referenceStates[3], referenceRates[3], referenceOutputs[1], referenceInputs[1];
+    initialiseFunction(states, outputs, inputs);
+    model.getInitialiseFunction()(referenceStates, referenceOutputs, referenceInputs);
+    for (int i = 0; i < 3; ++i) EXPECT_FLOAT_EQ(referenceStates[i], states[i]);
+    for (double v = -100.0; v < 50.0; v += 7.3)
+    {
+        states[0] = v;
+        referenceStates[0] = v;
+        modelFunction(0.0f, states, rates, outputs, inputs);
+        model.getModelFunction()(0.0, referenceStates, referenceRates, referenceOutputs, referenceInputs);
+        for (int i = 0; i < 3; ++i) EXPECT_NEAR(referenceRates[i], rates[i], 1.0e-5 * (1.0 + fabs(referenceRates[i])));
+        EXPECT_NEAR(referenceOutputs[0], outputs[0], 1.0e-5 * (1.0 + fabs(referenceOutputs[0])));
+    }
+}
+
+TEST(Execution, mixed_precision) {
+    csim::Model model;
+    EXPECT_EQ(csim::CSIM_OK,
+              model.loadCellmlModel(TestResources::getLocation(TestResources::CELLML_GATING_MODEL_RESOURCE)));
+    ASSERT_EQ(csim::CSIM_OK, model.instantiate(false, false, csim::MixedPrecision));
+    EXPECT_LT(model.precisionError(), 1.0e-5);
+    // only the evaluation is reduced precision, there are no single precision arrays
+    EXPECT_TRUE(model.getSinglePrecisionModelFunction() == NULL);
+
+    csim::Model reference;
+    EXPECT_EQ(csim::CSIM_OK,
+              reference.loadCellmlModel(TestResources::getLocation(TestResources::CELLML_GATING_MODEL_RESOURCE)));
+    ASSERT_EQ(csim::CSIM_OK, reference.instantiate());
+    EXPECT_EQ(0.0, reference.precisionError());
+
+    double states[3], rates[3], outputs[1], inputs[1], referenceStates[3], referenceRates[3];
+    model.getInitialiseFunction()(states, outputs, inputs);
+    reference.getInitialiseFunction()(referenceStates, outputs, inputs);
+    // integrate the states in double precision with both the mixed and double precision rates
+    for (int n = 0; n < 1000; ++n)
+    {
+        model.getModelFunction()(n * 0.01, states, rates, outputs, inputs);
+        reference.getModelFunction()(n * 0.01, referenceStates, referenceRates, outputs, inputs);
+        for (int i = 0; i < 3; ++i)
+        {
+            states[i] += rates[i] * 0.01;
+            referenceStates[i] += referenceRates[i] * 0.01;
+        }
+    }
+    for (int i = 0; i < 3; ++i) EXPECT_NEAR(referenceStates[i], states[i], 1.0e-4);
+}
+
+TEST(Execution, remove_unused_statements) {
+    csim::Model model;
+    EXPECT_EQ(csim::CSIM_OK,
+              model.loadCellmlModel(TestResources::getLocation(TestResources::CELLML_GATING_MODEL_RESOURCE)));
+    ASSERT_EQ(csim::CSIM_OK, model.instantiate());
+    // neither i_ion nor unused are needed for the rates
+    EXPECT_EQ(2, model.numberOfRemovedStatements());
+
+    csim::Model withOutput;
+    EXPECT_EQ(csim::CSIM_OK,
+              withOutput.loadCellmlModel(TestResources::getLocation(TestResources::CELLML_GATING_MODEL_RESOURCE)));
+    EXPECT_EQ(0, withOutput.setVariableAsOutput("main/i_ion"));
+    ASSERT_EQ(csim::CSIM_OK, withOutput.instantiate());
+    EXPECT_EQ(1, withOutput.numberOfRemovedStatements());
+
+    double states[3], rates[3], outputs[1], inputs[1], referenceRates[3];
+    model.getInitialiseFunction()(states, outputs, inputs);
+    model.getModelFunction()(0.0, states, rates, outputs, inputs);
+    withOutput.getModelFunction()(0.0, states, referenceRates, outputs, inputs);
+    for (int i = 0; i < 3; ++i) EXPECT_EQ(referenceRates[i], rates[i]);
+    // i_ion = g*h*n*(V-E)
+    EXPECT_DOUBLE_EQ(36.0 * 0.6 * 0.3 * (20.0 + 77.0), outputs[0]);
+}
+
+TEST(Execution, compiler_backends) {
+    csim::Model model;
+    EXPECT_EQ(csim::CSIM_OK,
+              model.loadCellmlModel(TestResources::getLocation(TestResources::CELLML_GATING_MODEL_RESOURCE)));
+    EXPECT_EQ(0, model.setVariableAsOutput("main/i_ion"));
+    EXPECT_EQ(csim::IrBackend, model.compilerBackend());
+    ASSERT_EQ(csim::CSIM_OK, model.instantiate());
+    EXPECT_EQ(csim::IrBackend, model.compilerBackend());
+    EXPECT_EQ(csim::MODEL_ALREADY_INSTANTIATED, model.setCompilerBackend(csim::ClangBackend));
+
+    csim::Model reference;
+    EXPECT_EQ(csim::CSIM_OK,
+              reference.loadCellmlModel(TestResources::getLocation(TestResources::CELLML_GATING_MODEL_RESOURCE)));
+    EXPECT_EQ(0, reference.setVariableAsOutput("main/i_ion"));
+    EXPECT_EQ(csim::CSIM_OK, reference.setCompilerBackend(csim::ClangBackend));
+    ASSERT_EQ(csim::CSIM_OK, reference.instantiate());
+    EXPECT_EQ(csim::ClangBackend, reference.compilerBackend());
+
+    double states[3], rates[3], outputs[1], inputs[1];
+    double referenceStates[3], referenceRates[3], referenceOutputs[1];
+    model.getInitialiseFunction()(states, outputs, inputs);
+    reference.getInitialiseFunction()(referenceStates, referenceOutputs, inputs);
+    for (int i = 0; i < 3; ++i) EXPECT_EQ(referenceStates[i], states[i]);
+    model.getModelFunction()(0.0, states, rates, outputs, inputs);
+    reference.getModelFunction()(0.0, referenceStates, referenceRates, referenceOutputs, inputs);
+    for (int i = 0; i < 3; ++i) EXPECT_NEAR(referenceRates[i], rates[i], 1.0e-12);
+    EXPECT_NEAR(referenceOutputs[0], outputs[0], 1.0e-10);
+    model.getRushLarsenFunction()(0.0, 5.0, states, rates, outputs, inputs);
+    reference.getRushLarsenFunction()(0.0, 5.0, referenceStates, referenceRates, referenceOutputs, inputs);
+    for (int i = 0; i < 3; ++i) EXPECT_NEAR(referenceStates[i], states[i], 1.0e-12);
+
+    // lookup tables need C code, so will always use clang
+    csim::Model tables;
+    EXPECT_EQ(csim::CSIM_OK,
+              tables.loadCellmlModel(TestResources::getLocation(TestResources::CELLML_GATING_MODEL_RESOURCE)));
+    EXPECT_EQ(csim::CSIM_OK, tables.setLookupTable("main/V", -100.0, 50.0, 0.1));
+    ASSERT_EQ(csim::CSIM_OK, tables.instantiate());
+    EXPECT_EQ(csim::ClangBackend, tables.compilerBackend());
+}
+
+TEST(Execution, vector_math) {
+    const csim::VectorMath libraries[] = { csim::NoVectorMath, csim::AccurateVectorMath, csim::FastVectorMath };
+    double referenceRates[3], referenceOutputs[1];
+    for (const auto library: libraries)
+    {
+        csim::Model model;
+        EXPECT_EQ(csim::CSIM_OK,
+                  model.loadCellmlModel(TestResources::getLocation(TestResources::CELLML_GATING_MODEL_RESOURCE)));
+        EXPECT_EQ(0, model.setVariableAsOutput("main/i_ion"));
+        EXPECT_EQ(csim::AccurateVectorMath, model.vectorMath());
+        EXPECT_EQ(csim::CSIM_OK, model.setVectorMath(library));
+        EXPECT_EQ(library, model.vectorMath());
+        ASSERT_EQ(csim::CSIM_OK, model.instantiate());
+        EXPECT_EQ(csim::MODEL_ALREADY_INSTANTIATED, model.setVectorMath(csim::NoVectorMath));
+
+        double states[3], rates[3], outputs[1], inputs[1];
+        model.getInitialiseFunction()(states, outputs, inputs);
+        model.getModelFunction()(0.0, states, rates, outputs, inputs);
+        if (library == csim::NoVectorMath)
+        {
+            for (int i = 0; i < 3; ++i) referenceRates[i] = rates[i];
+            referenceOutputs[0] = outputs[0];
+        }
+        for (int i = 0; i < 3; ++i) EXPECT_NEAR(referenceRates[i], rates[i], 1.0e-12);
+        EXPECT_NEAR(referenceOutputs[0], outputs[0], 1.0e-10);
+    }
+}
+
+TEST(Execution, vector_math_accuracy) {
+    // the cells are evaluated a vector at a time, with the special values and the limits of overflow and underflow
+    const double inf = std::numeric_limits<double>::infinity();
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    const double u[] = {
+        -0.0, 0.0, std::numeric_limits<double>::denorm_min(), 1.0e-310, std::numeric_limits<double>::min(), 0.1, 0.5,
+        1.0, 2.5, 7.0, 20.0, 23.0, 700.0, 709.78, 710.0, -708.5, -745.0, -746.0, -1.0, -3.5, 1.0e300, inf, -inf, nan
+    };
+    const double v[] = { 2.5, -1.0, 3.0, 0.5, 0.0, -0.5, 1.0e10, -3.0, 1.0, 0.25, -inf, inf, nan };
+    const int numberOfCells = 128;
+    const csim::VectorMath libraries[] = { csim::NoVectorMath, csim::AccurateVectorMath, csim::FastVectorMath };
+    for (const auto library: libraries)
+    {
+        csim::Model model;
+        ASSERT_EQ(csim::CSIM_OK, model.loadCellmlModelFromString(mathFunctionsModel()));
+        EXPECT_EQ(0, model.setVariableAsInput("main/u"));
+        EXPECT_EQ(1, model.setVariableAsInput("main/v"));
+        EXPECT_EQ(0, model.setVariableAsOutput("main/e"));
+        EXPECT_EQ(1, model.setVariableAsOutput("main/l"));
+        EXPECT_EQ(2, model.setVariableAsOutput("main/p"));
+        EXPECT_EQ(3, model.setVariableAsOutput("main/t"));
+        EXPECT_EQ(csim::CSIM_OK, model.setVectorMath(library));
+        ASSERT_EQ(csim::CSIM_OK, model.instantiate());
+        csim::Population population;
+        ASSERT_EQ(csim::CSIM_OK, population.create(&model, numberOfCells));
+        for (int cell = 0; cell < numberOfCells; ++cell)
+        {
+            EXPECT_EQ(csim::CSIM_OK, population.setInput(0, cell, u[cell % (sizeof(u) / sizeof(u[0]))]));
+            EXPECT_EQ(csim::CSIM_OK, population.setInput(1, cell, v[cell % (sizeof(v) / sizeof(v[0]))]));
+        }
+        ASSERT_EQ(csim::CSIM_OK, population.step(0.0, 0.01, 1, csim::EulerMethod));
+
+        // within the documented accuracy of the correctly rounded result, plus an ulp for libm
+        const double bound = (library == csim::FastVectorMath) ? 11.0 : 3.0;
+        const double tanhBound = (library == csim::FastVectorMath) ? 11.0 : 5.0;
+        for (int cell = 0; cell < numberOfCells; ++cell)
+        {
+            const double x = population.inputs(0)[cell];
+            const double y = population.inputs(1)[cell];
+            EXPECT_LE(ulpDistance(std::exp(x), population.outputs(0)[cell]), bound) << "exp(" << x << ")";
+            EXPECT_LE(ulpDistance(std::log(x), population.outputs(1)[cell]), bound) << "log(" << x << ")";
+            EXPECT_LE(ulpDistance(std::pow(x, y), population.outputs(2)[cell]), bound)
+                << "pow(" << x << ", " << y << ")";
+            EXPECT_LE(ulpDistance(std::tanh(x), population.outputs(3)[cell]), tanhBound) << "tanh(" << x << ")";
+        }
+    }
+}
+
+TEST(Execution, specialise) {
+    csim::Model model;
+    EXPECT_EQ(csim::CSIM_OK,
+              model.loadCellmlModel(TestResources::getLocation(TestResources::CELLML_GATING_MODEL_RESOURCE)));
+    EXPECT_EQ(0, model.setVariableAsInput("main/V_rest"));
+    EXPECT_EQ(1, model.setVariableAsInput("main/g"));
+    EXPECT_EQ(0, model.setVariableAsOutput("main/i_ion"));
+    std::map<std::string, double> values;
+    values["main/g"] = 10.0;
+    EXPECT_EQ(csim::MODEL_NOT_INSTANTIATED, model.specialise(values));
+    ASSERT_EQ(csim::CSIM_OK, model.instantiate());
+    EXPECT_TRUE(model.getSpecialisedModelFunction() == NULL);
+    std::map<std::string, double> notInput;
+    notInput["main/E"] = 10.0;
+    EXPECT_EQ(csim::UNABLE_TO_SPECIALISE_MODEL, model.specialise(notInput));
+    ASSERT_EQ(csim::CSIM_OK, model.specialise(values));
+    EXPECT_GT(model.numberOfSpecialisedStatements(), 0);
+    ASSERT_TRUE(model.getSpecialisedInitialiseFunction() != NULL);
+    ASSERT_TRUE(model.getSpecialisedModelFunction() != NULL);
+    ASSERT_TRUE(model.getSpecialisedRushLarsenFunction() != NULL);
+
+    // the specialised functions ignore the fixed input, so should match the general ones given its value
+    double states[3], rates[3], outputs[1], inputs[2];
+    double specialisedStates[3], specialisedRates[3], specialisedOutputs[1], specialisedInputs[2];
+    model.getInitialiseFunction()(states, outputs, inputs);
+    model.getSpecialisedInitialiseFunction()(specialisedStates, specialisedOutputs, specialisedInputs);
+    EXPECT_EQ(-80.0, specialisedInputs[0]);
+    EXPECT_EQ(10.0, specialisedInputs[1]);
+    for (int i = 0; i < 3; ++i) EXPECT_EQ(states[i], specialisedStates[i]);
+    inputs[1] = 10.0;
+    specialisedInputs[1] = 1.0e300;
+    model.getModelFunction()(0.0, states, rates, outputs, inputs);
+    model.getSpecialisedModelFunction()(0.0, specialisedStates, specialisedRates, specialisedOutputs,
+                                        specialisedInputs);
+    for (int i = 0; i < 3; ++i) EXPECT_NEAR(rates[i], specialisedRates[i], 1.0e-12);
+    EXPECT_NEAR(10.0 * 0.6 * 0.3 * (20.0 + 77.0), specialisedOutputs[0], 1.0e-10);
+    model.getRushLarsenFunction()(0.0, 5.0, states, rates, outputs, inputs);
+    model.getSpecialisedRushLarsenFunction()(0.0, 5.0, specialisedStates, specialisedRates, specialisedOutputs,
+                                             specialisedInputs);
+    for (int i = 0; i < 3; ++i) EXPECT_NEAR(states[i], specialisedStates[i], 1.0e-12);
+
+    // the inputs which are not fixed are still used
+    specialisedInputs[0] = -60.0;
+    model.getSpecialisedModelFunction()(0.0, specialisedStates, specialisedRates, specialisedOutputs,
+                                        specialisedInputs);
+    EXPECT_NEAR((-60.0 - specialisedStates[0]) / 10.0, specialisedRates[0], 1.0e-12);
+
+    // lookup tables need C code, which can't be specialised
+    csim::Model tables;
+    EXPECT_EQ(csim::CSIM_OK,
+              tables.loadCellmlModel(TestResources::getLocation(TestResources::CELLML_GATING_MODEL_RESOURCE)));
+    EXPECT_EQ(0, tables.setVariableAsInput("main/g"));
+    EXPECT_EQ(csim::CSIM_OK, tables.setLookupTable("main/V", -100.0, 50.0, 0.1));
+    ASSERT_EQ(csim::CSIM_OK, tables.instantiate());
+    EXPECT_EQ(csim::UNABLE_TO_SPECIALISE_MODEL, tables.specialise(values));
+}
+
+TEST(Execution, fused_integrators) {
+    csim::Model model;
+    EXPECT_EQ(csim::CSIM_OK,
+              model.loadCellmlModel(TestResources::getLocation(TestResources::CELLML_GATING_MODEL_RESOURCE)));
+    EXPECT_EQ(0, model.setVariableAsOutput("main/i_ion"));
+    ASSERT_EQ(csim::CSIM_OK, model.instantiate());
+    csim::IntegratorFunction euler = model.getIntegratorFunction(csim::EulerMethod);
+    csim::IntegratorFunction rk4 = model.getIntegratorFunction(csim::RungeKutta4Method);
+    csim::IntegratorFunction rushLarsen = model.getIntegratorFunction(csim::RushLarsenMethod);
+    ASSERT_TRUE(euler != NULL);
+    ASSERT_TRUE(rk4 != NULL);
+    ASSERT_TRUE(rushLarsen != NULL);
+
+    const int numberOfSteps = 100;
+    const double step = 0.01;
+    double states[3], rates[3], outputs[1], inputs[1], samples[3 * numberOfSteps];
+    double referenceStates[3], referenceRates[3], referenceOutputs[1];
+    model.getInitialiseFunction()(states, outputs, inputs);
+    model.getInitialiseFunction()(referenceStates, referenceOutputs, inputs);
+    euler(0.0, step, numberOfSteps, states, rates, outputs, inputs, samples);
+    for (int n = 0; n < numberOfSteps; ++n)
+    {
+        model.getModelFunction()(n * step, referenceStates, referenceRates, referenceOutputs, inputs);
+        for (int i = 0; i < 3; ++i) referenceStates[i] += referenceRates[i] * step;
+        for (int i = 0; i < 3; ++i) EXPECT_NEAR(referenceStates[i], samples[3 * n + i], 1.0e-12);
+    }
+    for (int i = 0; i < 3; ++i)
+    {
+        EXPECT_NEAR(referenceStates[i], states[i], 1.0e-12);
+        EXPECT_NEAR(referenceRates[i], rates[i], 1.0e-12);
+    }
+    EXPECT_NEAR(referenceOutputs[0], outputs[0], 1.0e-10);
+
+    model.getInitialiseFunction()(states, outputs, inputs);
+    model.getInitialiseFunction()(referenceStates, referenceOutputs, inputs);
+    rushLarsen(0.0, 5.0, 2, states, rates, outputs, inputs, NULL);
+    model.getRushLarsenFunction()(0.0, 5.0, referenceStates, referenceRates, referenceOutputs, inputs);
+    model.getRushLarsenFunction()(5.0, 5.0, referenceStates, referenceRates, referenceOutputs, inputs);
+    for (int i = 0; i < 3; ++i) EXPECT_NEAR(referenceStates[i], states[i], 1.0e-12);
+    EXPECT_NEAR(-80.0 + 100.0 * exp(-1.0), states[0], 1.0e-10);
+
+    // V relaxes exponentially to rest, which the fourth order method follows closely with a coarse step
+    model.getInitialiseFunction()(states, outputs, inputs);
+    rk4(0.0, 0.5, 20, states, rates, outputs, inputs, NULL);
+    EXPECT_NEAR(-80.0 + 100.0 * exp(-1.0), states[0], 1.0e-5);
+    EXPECT_GT(states[1], 0.0);
+    EXPECT_LT(states[1], 1.0);
+
+    // no steps leaves everything as it was
+    model.getInitialiseFunction()(states, outputs, inputs);
+    rates[0] = 1.0;
+    euler(0.0, step, 0, states, rates, outputs, inputs, NULL);
+    EXPECT_EQ(20.0, states[0]);
+    EXPECT_EQ(1.0, rates[0]);
+}
+
+TEST(Execution, selected_variables) {
+    csim::Model model;
+    EXPECT_EQ(csim::CSIM_OK,
+              model.loadCellmlModel(TestResources::getLocation(TestResources::CELLML_GATING_MODEL_RESOURCE)));
+    EXPECT_TRUE(model.getAllVariableIndices().empty());
+    ASSERT_EQ(csim::CSIM_OK, model.instantiate());
+    std::map<std::string, int> variables = model.getAllVariableIndices();
+    ASSERT_EQ(1, variables.count("main/i_ion"));
+    ASSERT_EQ(1, variables.count("main/unused"));
+    ASSERT_EQ(1, variables.count("main/V"));
+    ASSERT_EQ(1, variables.count("main/time"));
+    EXPECT_EQ(14, model.numberOfVariables());
+    csim::VariablesFunction variablesFunction = model.getVariablesFunction();
+    ASSERT_TRUE(variablesFunction != NULL);
+    EXPECT_TRUE(model.selectVariables(std::vector<int>(1, model.numberOfVariables())).empty());
+
+    double states[3], outputs[1], inputs[1];
+    model.getInitialiseFunction()(states, outputs, inputs);
+    std::vector<double> values(model.numberOfVariables(), -1.0);
+    // neither i_ion nor unused are outputs of the model, but they can still be evaluated
+    std::vector<double> selection = model.selectVariables(std::vector<int>(1, variables["main/i_ion"]));
+    ASSERT_FALSE(selection.empty());
+    variablesFunction(0.0, states, inputs, values.data(), selection.data());
+    EXPECT_DOUBLE_EQ(36.0 * 0.6 * 0.3 * (20.0 + 77.0), values[variables["main/i_ion"]]);
+    EXPECT_EQ(-1.0, values[variables["main/unused"]]);
+
+    std::vector<int> indices;
+    indices.push_back(variables["main/unused"]);
+    indices.push_back(variables["main/V"]);
+    indices.push_back(variables["main/time"]);
+    selection = model.selectVariables(indices);
+    variablesFunction(2.0, states, inputs, values.data(), selection.data());
+    EXPECT_NEAR(exp(0.2) / (1.0 + exp(-14.0)), values[variables["main/unused"]], 1.0e-12);
+    EXPECT_EQ(20.0, values[variables["main/V"]]);
+    EXPECT_EQ(2.0, values[variables["main/time"]]);
+}
+
+TEST(Execution, parallel_evaluation) {
+    csim::Model model;
+    EXPECT_EQ(csim::CSIM_OK,
+              model.loadCellmlModel(TestResources::getLocation(TestResources::CELLML_GATING_MODEL_RESOURCE)));
+    EXPECT_EQ(0, model.setVariableAsOutput("main/i_ion"));
+    EXPECT_EQ(csim::INVALID_NUMBER_OF_THREADS, model.setNumberOfThreads(0));
+    EXPECT_EQ(csim::CSIM_OK, model.setNumberOfThreads(4));
+    ASSERT_EQ(csim::CSIM_OK, model.instantiate());
+    EXPECT_EQ(csim::MODEL_ALREADY_INSTANTIATED, model.setNumberOfThreads(2));
+    // such a small model isn't worth splitting up, but it still needs to be evaluated the same way
+    EXPECT_GE(model.numberOfTasks(), 1);
+    EXPECT_GE(model.numberOfThreads(), 1);
+    EXPECT_LE(model.numberOfThreads(), 4);
+
+    double states[3], rates[3], outputs[1], inputs[1];
+    double referenceRates[3], referenceOutputs[1];
+    model.getInitialiseFunction()(states, outputs, inputs);
+    for (int n = 0; n < 10; ++n)
+    {
+        EXPECT_EQ(csim::CSIM_OK, model.evaluateModel(n * 0.1, states, rates, outputs, inputs));
+        model.getModelFunction()(n * 0.1, states, referenceRates, referenceOutputs, inputs);
+        for (int i = 0; i < 3; ++i)
+        {
+            EXPECT_EQ(referenceRates[i], rates[i]);
+            states[i] += 0.1 * rates[i];
+        }
+        EXPECT_EQ(referenceOutputs[0], outputs[0]);
+    }
+}
+
+TEST(Execution, parallel_evaluation_tasks) {
+    csim::Model model;
+    ASSERT_EQ(csim::CSIM_OK, model.loadCellmlModelFromString(wideModel(200)));
+    // the tasks and the model function may be vectorised differently, so only libm gives the same results bit for bit
+    EXPECT_EQ(csim::CSIM_OK, model.setVectorMath(csim::NoVectorMath));
+    EXPECT_EQ(csim::CSIM_OK, model.setNumberOfThreads(4));
+    ASSERT_EQ(csim::CSIM_OK, model.instantiate());
+    // the cells are independent, so the model function is split into many tasks
+    EXPECT_GT(model.numberOfTasks(), 1);
+    if (std::thread::hardware_concurrency() > 1) EXPECT_GT(model.numberOfThreads(), 1);
+    EXPECT_LE(model.numberOfThreads(), 4);
+
+    ASSERT_EQ(200, model.numberOfStateVariables());
+    std::vector<double> states(200), rates(200), referenceRates(200);
+    double outputs[1], inputs[1];
+    model.getInitialiseFunction()(states.data(), outputs, inputs);
+    for (int n = 0; n < 10; ++n)
+    {
+        EXPECT_EQ(csim::CSIM_OK, model.evaluateModel(n * 0.1, states.data(), rates.data(), outputs, inputs));
+        model.getModelFunction()(n * 0.1, states.data(), referenceRates.data(), outputs, inputs);
+        for (int i = 0; i < 200; ++i)
+        {
+            EXPECT_EQ(referenceRates[i], rates[i]);
+            states[i] += 0.1 * rates[i];
+        }
+    }
+
+    // instantiating again replaces the task graph along with the code its threads evaluate
+    ASSERT_EQ(csim::CSIM_OK, model.instantiate());
+    EXPECT_GT(model.numberOfTasks(), 1);
+    EXPECT_EQ(csim::CSIM_OK, model.evaluateModel(1.0, states.data(), rates.data(), outputs, inputs));
+    model.getModelFunction()(1.0, states.data(), referenceRates.data(), outputs, inputs);
+    for (int i = 0; i < 200; ++i) EXPECT_EQ(referenceRates[i], rates[i]);
+}
+
+TEST(Execution, compile_time_budget) {
+    csim::Model model;
+    EXPECT_EQ(csim::CSIM_OK,
+              model.loadCellmlModel(TestResources::getLocation(TestResources::CELLML_GATING_MODEL_RESOURCE)));
+    EXPECT_EQ(0, model.setVariableAsOutput("main/i_ion"));
+    // even when the budget is used up the model still has to be compiled correctly
+    EXPECT_EQ(csim::CSIM_OK, model.setCompileTimeBudget(1.0e-9));
+    ASSERT_EQ(csim::CSIM_OK, model.instantiate());
+    EXPECT_EQ(csim::MODEL_ALREADY_INSTANTIATED, model.setCompileTimeBudget(10.0));
+    double states[3], rates[3], outputs[1], inputs[1];
+    model.getInitialiseFunction()(states, outputs, inputs);
+    model.getModelFunction()(0.0, states, rates, outputs, inputs);
+    EXPECT_DOUBLE_EQ(-10.0, rates[0]);
+    EXPECT_DOUBLE_EQ(36.0 * 0.6 * 0.3 * (20.0 + 77.0), outputs[0]);
+}
+
+TEST(Execution, compile_time_budget_chunked) {
+    // far more than the 1000 statements a routine is split into chunks of
+    const std::string cellml = wideModel(600);
+    csim::Model model;
+    ASSERT_EQ(csim::CSIM_OK, model.loadCellmlModelFromString(cellml));
+    EXPECT_EQ(csim::CSIM_OK, model.setCompileTimeBudget(1.0e-9));
+    testing::internal::CaptureStderr();
+    ASSERT_EQ(csim::CSIM_OK, model.instantiate());
+    std::string messages = testing::internal::GetCapturedStderr();
+    EXPECT_NE(std::string::npos, messages.find("reduced the optimisation"));
+    EXPECT_EQ(csim::IrBackend, model.compilerBackend());
+
+    // compiled in one piece from the C code
+    csim::Model reference;
+    ASSERT_EQ(csim::CSIM_OK, reference.loadCellmlModelFromString(cellml));
+    EXPECT_EQ(csim::CSIM_OK, reference.setCompilerBackend(csim::ClangBackend));
+    ASSERT_EQ(csim::CSIM_OK, reference.instantiate());
+
+    ASSERT_EQ(600, model.numberOfStateVariables());
+    ASSERT_EQ(600, reference.numberOfStateVariables());
+    std::vector<double> states(600), rates(600), referenceStates(600), referenceRates(600);
+    double outputs[1], inputs[1];
+    model.getInitialiseFunction()(states.data(), outputs, inputs);
+    reference.getInitialiseFunction()(referenceStates.data(), outputs, inputs);
+    for (int i = 0; i < 600; ++i) EXPECT_EQ(referenceStates[i], states[i]);
+    for (int n = 0; n < 5; ++n)
+    {
+        model.getModelFunction()(n * 0.1, states.data(), rates.data(), outputs, inputs);
+        reference.getModelFunction()(n * 0.1, referenceStates.data(), referenceRates.data(), outputs, inputs);
+        for (int i = 0; i < 600; ++i)
+        {
+            EXPECT_NEAR(referenceRates[i], rates[i], 1.0e-12);
+            states[i] += 0.1 * rates[i];
+            referenceStates[i] += 0.1 * referenceRates[i];
+        }
+    }
+}
+
+TEST(Execution, population) {
+    csim::Model model;
+    EXPECT_EQ(csim::CSIM_OK,
+              model.loadCellmlModel(TestResources::getLocation(TestResources::CELLML_GATING_MODEL_RESOURCE)));
+    EXPECT_EQ(0, model.setVariableAsInput("main/V_rest"));
+    EXPECT_EQ(0, model.setVariableAsOutput("main/i_ion"));
+    csim::Population population;
+    EXPECT_EQ(csim::MODEL_NOT_INSTANTIATED, population.create(&model, 20));
+    ASSERT_EQ(csim::CSIM_OK, model.instantiate());
+    EXPECT_EQ(csim::INVALID_NUMBER_OF_CELLS, population.create(&model, 0));
+    ASSERT_EQ(csim::CSIM_OK, population.create(&model, 20));
+    EXPECT_EQ(24, population.stride());
+    EXPECT_EQ(population.states(0), population.values("main/V", csim::StateType));
+    EXPECT_EQ(population.inputs(0), population.values("main/V_rest", csim::InputType));
+    EXPECT_TRUE(population.states(3) == NULL);
+    EXPECT_DOUBLE_EQ(20.0, population.states(0)[19]);
+    EXPECT_EQ(csim::CSIM_OK, population.setInput(0, 5, -60.0));
+    EXPECT_EQ(csim::INVALID_CELL_INDEX, population.setInput(0, 20, -60.0));
+    EXPECT_EQ(csim::CSIM_OK, population.setNumberOfThreads(3));
+    EXPECT_EQ(csim::NOT_IMPLEMENTED, population.step(0.0, 0.01, 100, csim::RungeKutta4Method));
+
+    // the values are kept when the arrays are moved for new threads or a new placement
+    EXPECT_EQ(csim::INVALID_THREAD_AFFINITY, population.setThreadAffinity(std::vector<int>(1, -1)));
+    EXPECT_EQ(csim::CSIM_OK, population.setMemoryPlacement(csim::InterleavedPlacement));
+    EXPECT_EQ(csim::CSIM_OK, population.setNumberOfThreads(2));
+    EXPECT_DOUBLE_EQ(-60.0, population.inputs(0)[5]);
+    EXPECT_DOUBLE_EQ(-80.0, population.inputs(0)[4]);
+    EXPECT_EQ(csim::CSIM_OK, population.setMemoryPlacement(csim::FirstTouchPlacement));
+    EXPECT_EQ(csim::CSIM_OK, population.setNumberOfThreads(3));
+
+    // every cell follows the fused integrator for the same model, with its own inputs
+    for (int method = csim::EulerMethod; method <= csim::RushLarsenMethod; method += 2)
+    {
+        ASSERT_EQ(csim::CSIM_OK, population.initialise());
+        EXPECT_EQ(csim::CSIM_OK, population.setInput(0, 5, -60.0));
+        EXPECT_EQ(csim::CSIM_OK, population.step(0.0, 0.01, 100, csim::IntegrationMethod(method)));
+        csim::IntegratorFunction integrate = model.getIntegratorFunction(csim::IntegrationMethod(method));
+        for (int cell = 0; cell < 20; ++cell)
+        {
+            double states[3], rates[3], outputs[1], inputs[1];
+            model.getInitialiseFunction()(states, outputs, inputs);
+            inputs[0] = population.inputs(0)[cell];
+            integrate(0.0, 0.01, 100, states, rates, outputs, inputs, NULL);
+            for (int i = 0; i < 3; ++i)
+            {
+                EXPECT_NEAR(states[i], population.states(i)[cell], 1.0e-12);
+                EXPECT_NEAR(rates[i], population.rates(i)[cell], 1.0e-12);
+            }
+            EXPECT_NEAR(outputs[0], population.outputs(0)[cell], 1.0e-10);
+        }
+        EXPECT_GT(population.states(0)[5], population.states(0)[4]);
+    }
+}
+
+TEST(Execution, population_chunked) {
+    // too large for population integrators, so the cells are advanced one at a time by the fused integrator
+    csim::Model model;
+    ASSERT_EQ(csim::CSIM_OK, model.loadCellmlModelFromString(wideModel(600)));
+    ASSERT_EQ(csim::CSIM_OK, model.instantiate());
+    EXPECT_TRUE(model.getPopulationIntegratorFunction(csim::EulerMethod) == NULL);
+    csim::IntegratorFunction integrator = model.getIntegratorFunction(csim::EulerMethod);
+    ASSERT_TRUE(integrator != NULL);
+    csim::Population population;
+    ASSERT_EQ(csim::CSIM_OK, population.create(&model, 20));
+    EXPECT_EQ(csim::CSIM_OK, population.setNumberOfThreads(2));
+    EXPECT_EQ(csim::CSIM_OK, population.step(0.0, 0.01, 100, csim::EulerMethod));
+    EXPECT_EQ(csim::NOT_IMPLEMENTED, population.step(1.0, 0.01, 100, csim::RungeKutta4Method));
+
+    std::vector<double> states(600), rates(600);
+    double outputs[1], inputs[1];
+    model.getInitialiseFunction()(states.data(), outputs, inputs);
+    integrator(0.0, 0.01, 100, states.data(), rates.data(), outputs, inputs, NULL);
+    for (int i = 0; i < 600; ++i)
+    {
+        EXPECT_EQ(states[i], population.states(i)[0]);
+        EXPECT_EQ(states[i], population.states(i)[19]);
+        EXPECT_EQ(rates[i], population.rates(i)[19]);
+    }
+}
+
+TEST(Execution, population_statistics) {
+    csim::Model model;
+    EXPECT_EQ(csim::CSIM_OK,
+              model.loadCellmlModel(TestResources::getLocation(TestResources::CELLML_GATING_MODEL_RESOURCE)));
+    EXPECT_EQ(0, model.setVariableAsInput("main/V_rest"));
+    ASSERT_EQ(csim::CSIM_OK, model.instantiate());
+    csim::Population population, reference;
+    ASSERT_EQ(csim::CSIM_OK, population.create(&model, 20));
+    ASSERT_EQ(csim::CSIM_OK, reference.create(&model, 20));
+    for (int cell = 0; cell < 20; ++cell)
+    {
+        EXPECT_EQ(csim::CSIM_OK, population.setInput(0, cell, -80.0 + cell));
+        EXPECT_EQ(csim::CSIM_OK, reference.setInput(0, cell, -80.0 + cell));
+    }
+    EXPECT_EQ(csim::CSIM_OK, population.setNumberOfThreads(3));
+    csim::PopulationStatistics statistics;
+    EXPECT_EQ(0, statistics.addVariable("main/V", csim::StateType));
+    EXPECT_EQ(0, statistics.addBiomarkers("main/V", csim::StateType, 0.0));
+    EXPECT_EQ(csim::INVALID_SAMPLING, population.sample(0.0, 0.01, 10, 0, csim::EulerMethod, statistics));
+    EXPECT_EQ(csim::CSIM_OK, population.sample(0.0, 0.01, 4, 10, csim::EulerMethod, statistics));
+    EXPECT_EQ(csim::CSIM_OK, population.sample(0.4, 0.01, 6, 10, csim::EulerMethod, statistics));
+    ASSERT_EQ(10u, statistics.sampleTimes().size());
+    EXPECT_NEAR(0.1, statistics.sampleTimes()[0], 1.0e-12);
+    EXPECT_NEAR(1.0, statistics.sampleTimes()[9], 1.0e-12);
+
+    // the same samples stored and reduced afterwards
+    std::vector<double> trace;
+    for (int n = 0; n < 10; ++n)
+    {
+        EXPECT_EQ(csim::CSIM_OK, reference.step(0.1 * n, 0.01, 10, csim::EulerMethod));
+        trace.insert(trace.end(), reference.states(0), reference.states(0) + 20);
+    }
+    const csim::RunningStatistics& overTime = statistics.overTime(0);
+    ASSERT_EQ(20, overTime.numberOfSeries());
+    for (int cell = 0; cell < 20; ++cell)
+    {
+        double sum = 0.0, squares = 0.0;
+        for (int n = 0; n < 10; ++n) sum += trace[n * 20 + cell];
+        for (int n = 0; n < 10; ++n) squares += (trace[n * 20 + cell] - sum / 10) * (trace[n * 20 + cell] - sum / 10);
+        EXPECT_EQ(10u, overTime.count(cell));
+        EXPECT_NEAR(sum / 10, overTime.mean(cell), 1.0e-10);
+        EXPECT_NEAR(squares / 9, overTime.variance(cell), 1.0e-10);
+        // the voltage decays towards each cell's resting value, monotonically
+        EXPECT_DOUBLE_EQ(trace[cell], overTime.maximum(cell));
+        EXPECT_DOUBLE_EQ(trace[9 * 20 + cell], overTime.minimum(cell));
+        EXPECT_NEAR(0.1, overTime.timeOfMaximum(cell), 1.0e-12);
+        EXPECT_NEAR(1.0, overTime.timeOfMinimum(cell), 1.0e-12);
+    }
+    for (int n = 0; n < 10; ++n)
+    {
+        double sum = 0.0, squares = 0.0;
+        for (int cell = 0; cell < 20; ++cell) sum += trace[n * 20 + cell];
+        for (int cell = 0; cell < 20; ++cell)
+            squares += (trace[n * 20 + cell] - sum / 20) * (trace[n * 20 + cell] - sum / 20);
+        EXPECT_NEAR(sum / 20, statistics.ensembleMean(0)[n], 1.0e-10);
+        EXPECT_NEAR(squares / 19, statistics.ensembleVariance(0)[n], 1.0e-10);
+        EXPECT_DOUBLE_EQ(*std::min_element(&trace[n * 20], &trace[n * 20] + 20), statistics.ensembleMinimum(0)[n]);
+        EXPECT_DOUBLE_EQ(*std::max_element(&trace[n * 20], &trace[n * 20] + 20), statistics.ensembleMaximum(0)[n]);
+    }
+    EXPECT_TRUE(statistics.ensembleMean(1) == NULL);
+    // the voltage only decays, so there are no beats
+    ASSERT_EQ(20, statistics.biomarkers(0).numberOfSeries());
+    EXPECT_EQ(0, statistics.biomarkers(0).biomarkers(19).numberOfBeats);
+}
+
+TEST(Execution, steady_state) {
+    csim::Model model;
+    EXPECT_EQ(csim::CSIM_OK,
+              model.loadCellmlModel(TestResources::getLocation(TestResources::CELLML_GATING_MODEL_RESOURCE)));
+    EXPECT_EQ(0, model.setVariableAsInput("main/V_rest"));
+    ASSERT_EQ(csim::CSIM_OK, model.instantiate());
+    csim::SteadyStateSolver solver;
+    EXPECT_EQ(csim::INVALID_SOLVER_PARAMETERS, solver.setTolerance(0.0));
+    EXPECT_EQ(csim::INVALID_SOLVER_PARAMETERS, solver.setMaximumIterations(-1, 10));
+    EXPECT_EQ(csim::INVALID_SOLVER_PARAMETERS, solver.setInitialPseudoTimeStep(0.0));
+    double alpha = 0.07 * exp(-(-60.0 + 75.0) / 20.0), beta = 1.0 / (exp(-(-60.0 + 45.0) / 10.0) + 1.0);
+
+    // Newton's method, and pseudo-transient continuation alone, both find the same steady state
+    for (int newtonIterations = 50; newtonIterations >= 0; newtonIterations -= 50)
+    {
+        EXPECT_EQ(csim::CSIM_OK, solver.setMaximumIterations(newtonIterations, 1000));
+        double states[3], rates[3], outputs[1], inputs[1];
+        model.getInitialiseFunction()(states, outputs, inputs);
+        inputs[0] = -60.0;
+        EXPECT_EQ(csim::CSIM_OK, solver.solve(model.getModelFunction(), 0.0, 3, states, rates, outputs, inputs));
+        const csim::SteadyStateDiagnostics& diagnostics = solver.diagnostics();
+        EXPECT_TRUE(diagnostics.converged);
+        EXPECT_GE(1.0e-8, diagnostics.residualNorm);
+        if (newtonIterations > 0) EXPECT_EQ(0, diagnostics.pseudoTransientSteps);
+        else EXPECT_LT(0, diagnostics.pseudoTransientSteps);
+        EXPECT_LT(0, diagnostics.modelEvaluations);
+        for (int i = 0; i < 3; ++i) EXPECT_GE(1.0e-8, std::fabs(rates[i]));
+        EXPECT_NEAR(-60.0, states[0], 1.0e-6);
+        EXPECT_NEAR(alpha / (alpha + beta), states[1], 1.0e-6);
+    }
+
+    // the states with the smallest rates are kept when there are too few iterations
+    EXPECT_EQ(csim::CSIM_OK, solver.setMaximumIterations(0, 2));
+    double states[3], rates[3], outputs[1], inputs[1];
+    model.getInitialiseFunction()(states, outputs, inputs);
+    EXPECT_EQ(csim::STEADY_STATE_NOT_CONVERGED,
+              solver.solve(model.getModelFunction(), 0.0, 3, states, rates, outputs, inputs));
+    EXPECT_FALSE(solver.diagnostics().converged);
+    EXPECT_LT(states[0], 20.0);
+    EXPECT_NEAR(fabs(rates[0]), (states[0] + 80.0) / 10.0, 1.0e-12);
+}
+
+TEST(Execution, limit_cycle) {
+    // a linear period map with a slow mode, which takes thousands of beats to converge by pacing alone
+    double a[3][3] = {{0.999, 0.0005, 0.0}, {0.0005, 0.5, 0.1}, {0.0, 0.1, 0.2}}, b[3] = {1.0, 2.0, 3.0};
+    csim::PeriodMap linear = [&](double* x) {
+        double y[3];
+        for (int i = 0; i < 3; ++i) y[i] = b[i] + a[i][0] * x[0] + a[i][1] * x[1] + a[i][2] * x[2];
+        std::copy(y, y + 3, x);
+    };
+    csim::LimitCycleSolver solver;
+    EXPECT_EQ(csim::INVALID_SOLVER_PARAMETERS, solver.setTolerances(0.0, 1.0e-8));
+    EXPECT_EQ(csim::INVALID_SOLVER_PARAMETERS, solver.setMaximumBeats(0));
+    EXPECT_EQ(csim::INVALID_SOLVER_PARAMETERS, solver.setShooting(5, 0));
+    EXPECT_EQ(csim::CSIM_OK, solver.setMaximumBeats(30));
+    double x[3] = {0.0, 0.0, 0.0};
+    EXPECT_EQ(csim::CSIM_OK, solver.solve(linear, 3, x));
+    EXPECT_TRUE(solver.diagnostics().converged);
+    EXPECT_GE(1.0, solver.diagnostics().residualNorm);
+    EXPECT_LT(0, solver.diagnostics().newtonIterations);
+    EXPECT_EQ(5, solver.diagnostics().pacedBeats);
+    double y[3] = {x[0], x[1], x[2]};
+    linear(y);
+    for (int i = 0; i < 3; ++i) EXPECT_NEAR(x[i], y[i], 1.0e-6 * fabs(x[i]) + 1.0e-8);
+    EXPECT_EQ(csim::CSIM_OK, solver.setShooting(0, 20));
+    std::fill(x, x + 3, 0.0);
+    EXPECT_EQ(csim::LIMIT_CYCLE_NOT_CONVERGED, solver.solve(linear, 3, x));
+    EXPECT_EQ(30, solver.diagnostics().beats);
+
+    // without pacing the limit cycle of the gating model is its steady state
+    csim::Model model;
+    EXPECT_EQ(csim::CSIM_OK,
+              model.loadCellmlModel(TestResources::getLocation(TestResources::CELLML_GATING_MODEL_RESOURCE)));
+    ASSERT_EQ(csim::CSIM_OK, model.instantiate());
+    EXPECT_EQ(csim::CSIM_OK, solver.setShooting(5, 20));
+    EXPECT_EQ(csim::CSIM_OK, solver.setMaximumBeats(100));
+    double states[3], rates[3], outputs[1], inputs[1];
+    model.getInitialiseFunction()(states, outputs, inputs);
+    csim::IntegratorFunction integrator = model.getIntegratorFunction(csim::RushLarsenMethod);
+    EXPECT_EQ(csim::INVALID_SOLVER_PARAMETERS, solver.solve(integrator, 0.0, 0.0, 100, 3, states, rates, outputs,
+                                                            inputs));
+    EXPECT_EQ(csim::CSIM_OK, solver.solve(integrator, 0.0, 1.0, 100, 3, states, rates, outputs, inputs));
+    EXPECT_NEAR(-80.0, states[0], 1.0e-4);
+    for (int i = 0; i < 3; ++i) EXPECT_NEAR(0.0, rates[i], 1.0e-5);
+}
+
+TEST(Execution, monodomain) {
+    csim::Model model;
+    EXPECT_EQ(csim::CSIM_OK,
+              model.loadCellmlModel(TestResources::getLocation(TestResources::CELLML_GATING_MODEL_RESOURCE)));
+    EXPECT_EQ(0, model.setVariableAsInput("main/V_rest"));
+    csim::Monodomain monodomain;
+    EXPECT_EQ(csim::MODEL_NOT_INSTANTIATED, monodomain.create(&model, "main/V", 10));
+    ASSERT_EQ(csim::CSIM_OK, model.instantiate());
+    EXPECT_EQ(csim::INVALID_NUMBER_OF_CELLS, monodomain.create(&model, "main/V", 10, 0));
+    EXPECT_EQ(csim::UNDEFINED_VARIABLE_TYPE, monodomain.create(&model, "main/V_rest", 10));
+    EXPECT_EQ(csim::INVALID_DIFFUSION_PARAMETERS, monodomain.setDiffusion(0.1, 0.0));
+    EXPECT_EQ(csim::INVALID_DIFFUSION_PARAMETERS, monodomain.setDiffusion(-0.1, 0.1));
+
+    // with a uniform voltage the diffusion has no effect, so every cell follows the fused integrator
+    ASSERT_EQ(csim::CSIM_OK, monodomain.create(&model, "main/V", 6, 5));
+    EXPECT_EQ(17, monodomain.cellIndex(5, 2));
+    EXPECT_EQ(-1, monodomain.cellIndex(6, 2));
+    EXPECT_EQ(csim::CSIM_OK, monodomain.setDiffusion(0.1, 0.1));
+    EXPECT_EQ(csim::CSIM_OK, monodomain.step(0.0, 0.01, 100, csim::RushLarsenMethod));
+    double states[3], rates[3], outputs[1], inputs[1];
+    model.getInitialiseFunction()(states, outputs, inputs);
+    model.getIntegratorFunction(csim::RushLarsenMethod)(0.0, 0.01, 100, states, rates, outputs, inputs, NULL);
+    for (int cell = 0; cell < 30; ++cell) EXPECT_NEAR(states[0], monodomain.voltage()[cell], 1.0e-10);
+
+    // the voltage equation is linear, so its mean over the grid follows a single cell with the mean initial voltage
+    for (int scheme = csim::GodunovSplitting; scheme <= csim::StrangSplitting; ++scheme)
+    {
+        for (int rows = 1; rows <= 5; rows += 4)
+        {
+            for (int threads = 1; threads <= 2; ++threads)
+            {
+                ASSERT_EQ(csim::CSIM_OK, monodomain.create(&model, "main/V", 6, rows));
+                EXPECT_EQ(csim::CSIM_OK, monodomain.setDiffusion(0.1, 0.1));
+                EXPECT_EQ(csim::CSIM_OK, monodomain.setSplitting(csim::SplittingScheme(scheme)));
+                EXPECT_EQ(csim::CSIM_OK, monodomain.setNumberOfThreads(threads));
+                double* v = monodomain.voltage();
+                for (int row = 0; row < rows; ++row) v[monodomain.cellIndex(0, row)] = -80.0;
+                double mean = (20.0 * (6 * rows - rows) - 80.0 * rows) / (6 * rows);
+                EXPECT_EQ(csim::CSIM_OK, monodomain.step(0.0, 0.01, 10, csim::EulerMethod));
+                for (int n = 0; n < 10; ++n) mean += 0.01 * (-80.0 - mean) / 10.0;
+                double sum = 0.0;
+                for (int cell = 0; cell < 6 * rows; ++cell) sum += v[cell];
+                EXPECT_NEAR(mean, sum / (6 * rows), 1.0e-5);
+                EXPECT_GT(v[monodomain.cellIndex(0)], -80.0 + 0.1);
+                EXPECT_LT(v[monodomain.cellIndex(1)], v[monodomain.cellIndex(5)]);
+                if (rows == 1) EXPECT_EQ(0, monodomain.solverIterations());
+                else EXPECT_LT(0, monodomain.solverIterations());
+            }
+        }
+    }
+}